@@ -43,11 +43,27 @@
 ;
 ;   - Revision 0.4: 11/12/2023 Marko Trickovic
 ;     Refactored the comments to improve readability.
+;
+;   - Revision 0.5: 10/14/2026 Marko Trickovic
+;     Record the time stamp counter at start and LoadLoader in the boot time
+;     block at BOOT_TIMES, see kernel/boottime.h.
 ; ------------------------------------------------------------------------------
 
 [BITS 16]           ; Use 16-bit mode
 [ORG 0x7c00]        ; Set origin to boot sector address
 
+BOOT_TIMES  equ 0x600   ; Boot time block, BOOT_TIMES_ADDR of kernel/boottime.h
+
+; @macro:            BOOT_STAMP
+; @brief:            Stores the time stamp counter in slot %1 of the boot time
+;                    block. Changes eax and edx.
+;
+%macro BOOT_STAMP 1
+    rdtsc                           ; Time stamp counter to edx:eax
+    mov [BOOT_TIMES+8*(%1)],eax     ; Low half
+    mov [BOOT_TIMES+8*(%1)+4],edx   ; High half
+%endmacro
+
 ; @routine:          start
 ; @brief:            The entry point of the program, which sets up the registers
 ;                    and the stack for the execution of the main program.
@@ -73,6 +89,9 @@ start:
     mov es,ax       ; Set extra segment to 0
     mov ss,ax       ; Set stack segment to 0
     mov sp,0x7c00   ; Set stack pointer to boot sector address
+    push dx         ; Keep the drive ID in dl
+    BOOT_STAMP 0    ; BOOT_STAGE_BOOT
+    pop dx
 ;
 ; @routine:           TestDiskExtension
 ; @brief:             A routine to test if the disk supports extended functions.
@@ -116,6 +135,7 @@ TestDiskExtension:
 ;                     the read operation, or 0 if not.
 ;
 LoadLoader:
+    BOOT_STAMP 1            ; BOOT_STAGE_LOAD_LOADER
     mov si,ReadPacket       ; Set SI to the address of ReadPacket
     mov word[si],0x10       ; Set the size of the ReadPacket structure to 16 B
     mov word[si+2],5        ; Set the number of sectors to read to 5
@@ -10,23 +10,9 @@
 ;
 ;               It performs the following steps:
 ;
-;                   1. Checks if the processor supports long mode (64-bit mode)
-;                      and 1GB Page support.
+;                   1. Checks if the processor supports long mode (64-bit mode).
 ;
-;                   2. LoadKernel subroutine:
-;
-;                       - Sets up the necessary parameters for a BIOS disk read
-;                         operation in extended mode.
-;
-;                       - Triggers the operation via interrupt 0x13.
-;
-;                       - Handles potential read errors.
-;
-;                       - The parameters for the disk read operation are stored
-;                         in a data structure pointed to by the Source Index
-;                         (si) register.
-;
-;                   3. Memory map retrieval:
+;                   2. Memory map retrieval:
 ;
 ;                       - GetMemInfoStart function gets the initial memory map
 ;                         by triggering a BIOS interrupt.
@@ -37,7 +23,7 @@
 ;                       - GetMemDone function writes a string to the console
 ;                         indicating the completion of memory map retrieval.
 ;
-;                   4. Implement TestA20 routine. This routine is testing if the
+;                   3. Implement TestA20 routine. This routine is testing if the
 ;                      A20 line is enabled by:
 ;
 ;                       - Writing different values to two addresses that differ
@@ -49,6 +35,23 @@
 ;
 ;                       - If they are the same, then A20 line is disabled.
 ;
+;                   4. LoadKernel subroutine:
+;
+;                       - Switches DS and ES to unreal mode, real mode segments
+;                         with a 4 GiB limit, so that the loader can write
+;                         above 1 MiB.
+;
+;                       - Reads the ELF64 header and the program headers of the
+;                         kernel image.
+;
+;                       - Reads the file part of every PT_LOAD segment with
+;                         Extended Disk Read calls of up to 127 sectors into a
+;                         bounce buffer at 0x10000, copies each chunk straight
+;                         to the physical address of the segment and zeroes
+;                         the rest of the segment (.bss).
+;
+;                       - Handles potential read errors.
+;
 ;                   5. Code to enter protected mode from real mode.
 ;
 ;                       - It defines the Global Descriptor Table (GDT) and the
@@ -64,8 +67,10 @@
 ;                   6. Code to enable paging and enter long mode from protected
 ;                      mode.
 ;
-;                       - Prepare the machine for paging by setting up the page
-;                         directory and page table entries.
+;                       - Prepare the machine for paging by mapping the first
+;                         1 GiB with 2 MiB pages at address 0, at the kernel
+;                         direct map base 0xffff800000000000 and at the kernel
+;                         image base 0xffffffff80000000.
 ;
 ;                       - Load the global descriptor table (GDT) by using the
 ;                         lgdt instruction.
@@ -77,12 +82,9 @@
 ;                         the extended feature enable register (EFER) and
 ;                         jumping to a 64-bit code segment.
 ;
-;                   7. Code to relocate the Kernel from 0x10000 to 0x200000
-;                      memory address.
+;                   7. Code to jump to the kernel.
 ;
-;                       - Relocates the Kernel from 0x10000 to 0x200000.
-;
-;                       - Jumps to the kernel entry point at 0x200000.
+;                       - Jumps to the entry point of the ELF header.
 ;
 ;                       - Halts the processor in an infinite loop.
 ;
@@ -135,22 +137,88 @@
 ;
 ;   - Revision 1.0: 11/12/2023 Marko Trickovic
 ;     Refactored the comments to improve readability.
+;
+;   - Revision 1.1: 10/14/2026 Marko Trickovic
+;     GetMemInfo now loops until the BIOS reports the last descriptor and
+;     terminates the memory map with a zeroed descriptor for the kernel.
+;
+;   - Revision 1.2: 10/14/2026 Marko Trickovic
+;     Map the first 1 GiB with 2 MiB pages (0x72000) at address 0 and at the
+;     direct map base, and drop the 1G page requirement.
+;
+;   - Revision 1.3: 10/14/2026 Marko Trickovic
+;     LoadKernel runs after the A20 test, takes the kernel size from the image
+;     header and streams the kernel in chunks of up to 127 sectors to 0x200000
+;     through unreal mode. The relocation copy in LMEntry is gone and the
+;     kernel is no longer limited to 100 sectors.
+;
+;   - Revision 1.4: 10/14/2026 Marko Trickovic
+;     The kernel image is an ELF64 file. LoadKernel places the PT_LOAD
+;     segments at their physical addresses, zeroes .bss instead of reading it
+;     from the disk and LMEntry jumps to the ELF entry point.
+;
+;   - Revision 1.5: 10/14/2026 Marko Trickovic
+;     Map the first 1 GiB also at 0xffffffff80000000, where the kernel is
+;     linked.
+;
+;   - Revision 1.6: 10/14/2026 Marko Trickovic
+;     Record the time stamp counter after the memory map, at LoadKernel,
+;     after the kernel is placed, at PMEntry and at LMEntry in the boot time
+;     block at BOOT_TIMES, see kernel/boottime.h.
+;
+;   - Revision 1.7: 10/14/2026 Marko Trickovic
+;     Enter unreal mode again after every disk read, the BIOS may reload the
+;     segment registers.
 ;------------------------------------------------------------------------------
 
 [BITS 16]           ; Use 16-bit mode
 [ORG 0x7e00]        ; Set origin to loader program address
 
+KERNEL_LBA      equ 6           ; First sector of the kernel image
+BOUNCE_SEG      equ 0x1000      ; Segment of the disk read bounce buffer
+BOUNCE_ADDR     equ 0x10000     ; Address of the disk read bounce buffer
+CHUNK_SECTORS   equ 127         ; Sectors per Extended Disk Read call
+HEADER_ADDR     equ 0x20000     ; Copy of the ELF header and program headers
+HEADER_SECTORS  equ 8           ; Sectors read for the headers
+BOOT_TIMES      equ 0x600       ; Boot time block, see kernel/boottime.h
+
+ELF_MAGIC       equ 0x464c457f  ; "\x7fELF"
+ELF_CLASS_DATA  equ 0x0102      ; ELFCLASS64, ELFDATA2LSB
+ELF_MACHINE     equ 0x3e        ; EM_X86_64
+E_ENTRY         equ 0x18        ; Offsets in the ELF header
+E_PHOFF         equ 0x20
+E_PHENTSIZE     equ 0x36
+E_PHNUM         equ 0x38
+PT_LOAD         equ 1           ; Loadable segment type
+P_TYPE          equ 0x00        ; Offsets in a program header
+P_OFFSET        equ 0x08
+P_PADDR         equ 0x18
+P_FILESZ        equ 0x20
+P_MEMSZ         equ 0x28
+
+; @macro:           BOOT_STAMP
+; @brief:           Stores the time stamp counter in slot %1 of the boot time
+;                   block, in any mode, as DS is 0 or flat. Changes eax and
+;                   edx.
+;
+%macro BOOT_STAMP 1
+    rdtsc                           ; Time stamp counter to edx:eax
+    mov [BOOT_TIMES+8*(%1)],eax     ; Low half
+    mov [BOOT_TIMES+8*(%1)+4],edx   ; High half
+%endmacro
+
 ; @routine:         start
-; @brief:           Checks if the processor supports long mode and 1G page.
+; @brief:           Checks if the processor supports long mode.
 ;
 ; @param:     dl    A register that holds the drive ID from which the program
 ;                   was loaded.
 ; @param:     eax   A register that holds the function number for the CPUID
 ;                   instruction.
 ;
-; @return:          None. If the processor supports long mode and 1G page, the
-;                   routine continues to the next step. If not, the routine
-;                   jumps to NotSupport label.
+; @return:          None. If the processor supports long mode, the routine
+;                   continues to the next step. If not, the routine jumps to
+;                   NotSupport label. 1G page support is optional, the kernel
+;                   checks for it when it builds its own page tables.
 ;
 start:
     mov [DriveId],dl    ; Store the drive ID in memory
@@ -163,34 +231,6 @@ start:
     cpuid               ; Execute the CPUID instruction with EAX=0x80000001
     test edx,(1<<29)    ; Test if bit 29 (Long Mode support) in EDX is set
     jz NotSupport       ; If bit 29 is not set, jump to NotSupport
-    test edx,(1<<26)    ; Test if bit 26 (1G Page support) in EDX is set
-    jz NotSupport       ; If bit 26 is not set, jump to NotSupport
-
-; @routine:   LoadKernel
-; @brief:     Loads a kernel from a disk into memory.
-;
-; @param:     si    A pointer to the ReadPacket structure that contains the
-;                   parameters for the disk read operation.
-; @param:     dl    The drive number from which to read the kernel.
-; @param:     ah    The function number for the Extended Disk Read BIOS
-;                   interrupt (0x42).
-;
-; @return:    None. If the disk read operation is successful, the kernel is
-;             loaded into memory at segment 0x1000. If there is an error, the
-;             routine jumps to ReadError label.
-;
-LoadKernel:
-    mov si,ReadPacket       ; Set SI to the address of ReadPacket
-    mov word[si],0x10       ; Set the size of the ReadPacket structure to 16B
-    mov word[si+2],100      ; Set the number of sectors to read to 100
-    mov word[si+4],0        ; Set the memory address where to read data
-    mov word[si+6],0x1000   ; Set the segment offset to 0x1000
-    mov dword[si+8],6       ; We write our kernel from 6th sector
-    mov dword[si+0xc],0     ; Address high for reading from hard disk partition
-    mov dl,[DriveId]        ; Set the drive number from which to read
-    mov ah,0x42             ; Function for Extended Disk Read
-    int 0x13                ; Call BIOS interrupt 0x13
-    jc ReadError            ; Jump if error
 
 ; @routine:   GetMemInfoStart
 ; @brief:     Gets the initial memory map entry from the BIOS.
@@ -244,18 +284,30 @@ GetMemInfoStart:
 ;
 GetMemInfo:
     add edi,20              ; Point to next descriptor in buffer
+    test ebx,ebx            ; Continuation value of zero means last entry
+    jz GetMemDone           ; All memory range descriptors have been obtained
+    cmp edi,0x9000+20*127   ; Keep one slot free for the terminator
+    jae GetMemDone          ; Buffer is full
     mov eax,0xe820          ; Function for Getting System Memory Map
     mov edx,0x534d4150      ; This is 'SMAP' signature
     mov ecx,20              ; Size of the memory range descriptor
     int 0x15                ; Call BIOS interrupt 0x15
-    jc GetMemDone           ; Jump if error
+    jnc GetMemInfo          ; Get next descriptor
 
 ; @label:     GetMemDone
-; @brief:     Get the memory map finished.
+; @brief:     Get the memory map finished. Writes a zeroed descriptor after the
+;             last valid one so the kernel knows where the map ends.
+;
+; @param:     edi   A pointer to the first unused descriptor slot.
 ;
 ; @return:    None.
 ;
 GetMemDone:
+    cld                     ; Increment edi after store
+    xor eax,eax             ; Zero descriptor terminates the memory map
+    mov ecx,20/4            ; Size of a descriptor in dwords
+    rep stosd               ; Store eax to edi
+    BOOT_STAMP 2            ; BOOT_STAGE_E820
 
 ; @routine:   TestA20
 ; @brief:     Tests if the A20 line is enabled or disabled.
@@ -295,6 +347,194 @@ SetA20LineDone:
     xor ax,ax                    ; Zero out AX
     mov es,ax                    ; Set extra segment to 0
 
+    call EnterUnreal            ; 4 GiB limits for the copies of LoadKernel
+
+; @routine:   LoadKernel
+; @brief:     Loads the ELF64 kernel image from the disk.
+;
+; @param:     ebx   The current program header.
+;
+; @return:    None. The first HEADER_SECTORS of the image are copied to
+;             HEADER_ADDR, as the bounce buffer is reused for the segments.
+;             Each PT_LOAD segment is placed at its physical address, the
+;             entry point is kept in KernelEntry. If the image is not an
+;             x86_64 ELF64 file, its program headers do not fit into the
+;             sectors read, or a read fails, the routine jumps to ReadError
+;             label.
+;
+LoadKernel:
+    BOOT_STAMP 3                ; BOOT_STAGE_LOAD_KERNEL
+    mov ebx,KERNEL_LBA          ; Start with the first sector of the image
+    mov cx,HEADER_SECTORS       ; Read the ELF header and program headers
+    call ReadSectors            ; Read them to the bounce buffer
+    jc ReadError                ; Jump if error
+    mov esi,BOUNCE_ADDR         ; Source is the bounce buffer
+    mov edi,HEADER_ADDR         ; Keep the headers out of the bounce buffer
+    mov ecx,HEADER_SECTORS*512  ; Size of the headers
+    cld                         ; Increment esi and edi after move
+    a32 rep movsb               ; Copy with 32-bit addresses
+
+    cmp dword[dword HEADER_ADDR],ELF_MAGIC
+    jne ReadError               ; Not an ELF file
+    cmp word[dword HEADER_ADDR+4],ELF_CLASS_DATA
+    jne ReadError               ; Not a 64-bit little endian file
+    cmp word[dword HEADER_ADDR+0x12],ELF_MACHINE
+    jne ReadError               ; Not an x86_64 file
+
+    mov eax,[dword HEADER_ADDR+E_ENTRY]
+    mov [KernelEntry],eax       ; Low half of the entry point
+    mov eax,[dword HEADER_ADDR+E_ENTRY+4]
+    mov [KernelEntry+4],eax     ; High half of the entry point
+
+    movzx eax,word[dword HEADER_ADDR+E_PHENTSIZE]
+    movzx ecx,word[dword HEADER_ADDR+E_PHNUM]
+    mov [PhdrLeft],cx           ; Program headers to walk
+    imul ecx,eax                ; Size of the program header table
+    mov ebx,[dword HEADER_ADDR+E_PHOFF]
+    add ecx,ebx                 ; End of the program header table
+    cmp ecx,HEADER_SECTORS*512  ; The table must lie in the copied headers
+    ja ReadError                ; Jump if it does not
+    add ebx,HEADER_ADDR         ; First program header
+
+LoadKernelNext:
+    cmp word[PhdrLeft],0        ; Program headers left
+    je SetVideoMode             ; The kernel is loaded
+    dec word[PhdrLeft]          ; Count this program header
+    cmp dword[ebx+P_TYPE],PT_LOAD
+    jne LoadKernelSkip          ; Only PT_LOAD segments are placed
+
+    mov eax,[ebx+P_OFFSET]      ; File offset of the segment
+    mov [SegOffset],eax
+    mov eax,[ebx+P_PADDR]       ; Physical address of the segment
+    mov [SegDest],eax
+    mov eax,[ebx+P_FILESZ]      ; Bytes stored in the file
+    mov [SegCount],eax
+    mov eax,[ebx+P_MEMSZ]       ; Bytes in memory
+    sub eax,[ebx+P_FILESZ]      ; Bytes to zero after the file part
+    mov [SegZero],eax
+    call LoadSegment            ; Read, copy and zero the segment
+    jc ReadError                ; Jump if error
+
+LoadKernelSkip:
+    movzx eax,word[dword HEADER_ADDR+E_PHENTSIZE]
+    add ebx,eax                 ; Next program header
+    jmp LoadKernelNext
+
+; @routine:   LoadSegment
+; @brief:     Loads one PT_LOAD segment.
+;
+; @param:     SegOffset  The file offset of the part still to read.
+; @param:     SegDest    The address the part is copied to.
+; @param:     SegCount   The bytes still to read.
+; @param:     SegZero    The bytes to zero after the file part.
+;
+; @return:    CF set if a disk read failed. ebx is preserved. Each chunk
+;             starts at the sector that holds SegOffset and only its bytes of
+;             the segment are copied, so the segment needs no particular
+;             alignment in the file.
+;
+LoadSegment:
+    mov eax,[SegCount]          ; Bytes left in the file part
+    test eax,eax
+    jz LoadSegmentZero          ; The file part is loaded
+
+    push ebx                    ; Keep the program header
+    mov ebx,[SegOffset]         ; File offset of the next byte
+    mov esi,ebx
+    and esi,511                 ; Offset of the byte in its sector
+    shr ebx,9                   ; Sector of the byte in the image
+    add ebx,KERNEL_LBA          ; Sector of the byte on the disk
+    lea ecx,[eax+esi+511]       ; Bytes from the sector start, rounded up
+    shr ecx,9                   ; Sectors that hold the rest of the segment
+    cmp ecx,CHUNK_SECTORS       ; Read at most a chunk
+    jbe LoadSegmentRead
+    mov ecx,CHUNK_SECTORS
+LoadSegmentRead:
+    call ReadSectors            ; Read cx sectors at ebx
+    pop ebx                     ; Restore the program header
+    jc LoadSegmentDone          ; Return if error
+
+    shl ecx,9                   ; Bytes read
+    sub ecx,esi                 ; Bytes of the segment in the chunk
+    cmp ecx,eax                 ; Unless the segment ends earlier
+    jbe LoadSegmentCopy
+    mov ecx,eax                 ; Only the rest of the segment
+LoadSegmentCopy:
+    add [SegOffset],ecx         ; Advance past the chunk
+    sub [SegCount],ecx
+    mov edi,[SegDest]           ; Destination of the chunk
+    add [SegDest],ecx
+    add esi,BOUNCE_ADDR         ; Source in the bounce buffer
+    cld                         ; Increment esi and edi after move
+    a32 rep movsb               ; Copy with 32-bit addresses
+    jmp LoadSegment             ; Next chunk
+
+LoadSegmentZero:
+    mov ecx,[SegZero]           ; Size of .bss in the segment
+    mov edi,[SegDest]           ; Right after the file part
+    xor eax,eax                 ; Store zeros
+    cld                         ; Increment edi after store
+    a32 rep stosb               ; Zero with 32-bit addresses
+    clc                         ; Success
+LoadSegmentDone:
+    ret
+
+; @routine:   ReadSectors
+; @brief:     Reads sectors into the bounce buffer.
+;
+; @param:     ebx   The first sector to read.
+; @param:     cx    The number of sectors, at most CHUNK_SECTORS.
+;
+; @return:    CF set if the disk read failed. All registers are preserved.
+;
+ReadSectors:
+    pushad                      ; The BIOS may change any register
+    mov si,ReadPacket           ; Set SI to the address of ReadPacket
+    mov word[si],0x10           ; Set the size of the ReadPacket to 16B
+    mov [si+2],cx               ; Set the number of sectors to read
+    mov word[si+4],0            ; Set the memory address where to read data
+    mov word[si+6],BOUNCE_SEG   ; Set the segment of the bounce buffer
+    mov [si+8],ebx              ; Set the first sector to read
+    mov dword[si+0xc],0         ; High half of the sector number
+    mov dl,[DriveId]            ; Set the drive number from which to read
+    mov ah,0x42                 ; Function for Extended Disk Read
+    int 0x13                    ; Call BIOS interrupt 0x13
+    pushf                       ; Keep CF of the read
+    call EnterUnreal            ; The BIOS may have dropped the 4 GiB limit
+    popf
+    popad                       ; Restore the registers, keep CF
+    ret
+
+; @routine:   EnterUnreal
+; @brief:     Loads DS and ES with the flat 4 GiB data segment in protected
+;             mode and returns to real mode. The segment registers keep the
+;             4 GiB limit in their descriptor caches (unreal mode), so 32-bit
+;             addresses reach the whole memory while the BIOS still works.
+;
+;             A BIOS call may reload the segment registers and drop the
+;             limit, so ReadSectors calls it again after every read.
+;
+; @return:    None. DS and ES are 0 again with a 4 GiB limit. eax, bx and
+;             the flags are changed.
+;
+EnterUnreal:
+    cli                         ; No interrupts while in protected mode
+    push ds                     ; Save the real mode segments
+    push es
+    lgdt [Gdt32Ptr]             ; Load GDTR from Gdt32Ptr
+    mov eax,cr0                 ; Move CR0 to EAX
+    or al,1                     ; Enable protected mode in EAX
+    mov cr0,eax                 ; Move EAX back to CR0
+    mov bx,0x10                 ; Flat data segment selector
+    mov ds,bx                   ; Load the 4 GiB limit into DS
+    mov es,bx                   ; Load the 4 GiB limit into ES
+    and al,0xfe                 ; Disable protected mode in EAX
+    mov cr0,eax                 ; Back to real mode
+    pop es                      ; Restore the real mode bases, the limits stay
+    pop ds
+    sti                         ; Enable interrupts for the BIOS
+    ret
+
 ; @routine:   SetVideoMode
 ; @brief:     Sets the video mode to 80x25 text and switches to protected mode.
 ;
@@ -305,6 +545,7 @@ SetA20LineDone:
 ;             jump to the PMEntry label in the code segment 8.
 ;
 SetVideoMode:
+    BOOT_STAMP 4                ; BOOT_STAGE_KERNEL_LOADED
     mov ax,3                    ; Video mode number in AX (3 = 80x25 text)
     int 0x10                    ; BIOS interrupt 0x10 to set video mode
 
@@ -328,7 +569,7 @@ ReadError:
 
 ; @label:     NotSupport
 ; @brief:     Handles the error case when the processor does not support long
-;             mode or 1G page.
+;             mode.
 ;
 ; @return:    None. This label does not return any value.
 ;
@@ -371,6 +612,7 @@ PMEntry:                        ; Entry point for protected mode
     mov es,ax                   ; Move data segment selector from AX to ES
     mov ss,ax                   ; Move stack segment selector from AX to SS
     mov esp,0x7c00              ; Move stack pointer address (0x7c00) to ESP
+    BOOT_STAMP 5                ; BOOT_STAGE_PM_ENTRY
 
     cld                         ; Increment edi after store
     mov edi,0x70000             ; Page directory base
@@ -378,8 +620,20 @@ PMEntry:                        ; Entry point for protected mode
     mov ecx,0x10000/4           ; Page directory size
     rep stosd                   ; Store eax to edi
 
-    mov dword[0x70000],0x71007      ; First page directory entry
-    mov dword[0x71000],10000111b    ; First page table entry
+    mov dword[0x70000],0x71007      ; PML4[0], identity map
+    mov dword[0x70800],0x71007      ; PML4[256], direct map at KERNEL_BASE
+    mov dword[0x71000],0x72007      ; PDPT[0] to the page directory
+    mov dword[0x70ff8],0x73007      ; PML4[511], kernel image at KERNEL_VMA
+    mov dword[0x73ff0],0x72007      ; PDPT[510] to the same page directory
+
+    mov edi,0x72000             ; Page directory, 512 entries of 2 MiB
+    mov eax,10000111b           ; Present, writable, user, 2 MiB page
+    mov ecx,512                 ; Map the first 1 GiB
+SetPde:
+    mov [edi],eax               ; Store the page directory entry
+    add eax,0x200000            ; Next 2 MiB frame
+    add edi,8                   ; Next page directory entry
+    loop SetPde                 ; Repeat for all 512 entries
 
     lgdt [Gdt64Ptr]             ; Load GDT pointer
 
@@ -416,26 +670,18 @@ PEnd:
 ; @brief:     Entry point for long mode.
 ;
 ; @param:     rsp   A register that holds the stack pointer address (0x7c00).
-; @param:     rdi   A register that holds the new destination address for the
-;                   kernel (0x200000).
-; @param:     rsi   A register that holds the old destination address for the
-;                   kernel (0x10000).
-; @param:     rcx   A register that holds the number of quadwords to move
-;                   (51200/8).
 ;
-; @return:    None. This label sets the stack pointer, relocates the kernel to a
-;             higher memory address, and jumps to the kernel entry point.
+; @param:     rax   A register that holds the entry point of the kernel.
+;
+; @return:    None. This label sets the stack pointer and jumps to the kernel
+;             entry point, LoadKernel has already placed the kernel.
 ;
 LMEntry:                        ; Entry point for long mode
     mov rsp,0x7c00              ; Stack pointer
+    BOOT_STAMP 6                ; BOOT_STAGE_LM_ENTRY
 
-    cld                         ; Increment rdi after store
-    mov rdi,0x200000            ; New destination for Kernel
-    mov rsi,0x10000             ; Old destination for Kernel
-    mov rcx,51200/8             ; 512B * 100 sectors / 8
-    rep movsq                   ; Quadwords move (reloacte kernel)
-
-    jmp 0x200000                ; Jump to kernel
+    mov rax,[KernelEntry]       ; Entry point from the ELF header
+    jmp rax                     ; Jump to kernel
 
 ; @brief:     Halts the CPU and creates an infinite loop in long mode.
 ;
@@ -458,6 +704,27 @@ DriveId:    db 0            ; Byte for DriveId
 ;
 ReadPacket: times 16 db 0   ; Allocate 16B, for storing a packet from the disk
 
+; @var:       KernelEntry
+;
+; @brief:     The entry point of the kernel, from the ELF header.
+;
+KernelEntry: dq 0
+
+; @var:       PhdrLeft
+;
+; @brief:     The number of program headers LoadKernel has not walked yet.
+;
+PhdrLeft:   dw 0
+
+; @var:       SegOffset, SegDest, SegCount, SegZero
+;
+; @brief:     The state of LoadSegment for the current PT_LOAD segment.
+;
+SegOffset:  dd 0            ; File offset of the next byte to read
+SegDest:    dd 0            ; Destination of the next byte
+SegCount:   dd 0            ; Bytes left in the file part
+SegZero:    dd 0            ; Bytes to zero after the file part
+
 ; @var:       Gdt32
 ;
 ; @brief:     A 32-bit GDT descriptor that contains the code and data segment
@@ -0,0 +1,319 @@
+/******************************************************************************
+ * @file:        acpi.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the ACPI table parser of the kernel.
+ *
+ *               The Root System Description Pointer (RSDP) is searched on
+ *               16-byte boundaries in the first KiB of the extended BIOS data
+ *               area and in the BIOS ROM at 0xe0000 - 0xfffff. The RSDP points
+ *               at the XSDT (ACPI 2.0 and later) or the RSDT, which list the
+ *               physical addresses of all other tables. Every table is read
+ *               through the direct map and only trusted when its checksum is
+ *               valid.
+ *
+ *               The MADT entries used by the kernel are the processor local
+ *               APIC (type 0), the IOAPIC (type 1), the interrupt source
+ *               override (type 2), the local APIC address override (type 5)
+ *               and the processor local x2APIC (type 9).
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the MADT parser.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "acpi.h"
+#include "memory.h"
+
+#define EBDA_SEGMENT_ADDR   0x40e
+#define BIOS_ROM_START      0xe0000
+#define BIOS_ROM_END        0x100000
+
+#define MADT_LAPIC          0
+#define MADT_IOAPIC         1
+#define MADT_OVERRIDE       2
+#define MADT_LAPIC_ADDR     5
+#define MADT_X2APIC         9
+
+#define MADT_ENABLED        (1<<0)
+
+/**
+ * @brief:                The Root System Description Pointer.
+ *
+ * @struct:               AcpiRsdp
+ */
+struct AcpiRsdp {
+    char signature[8];
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t ext_checksum;
+    uint8_t res0[3];
+} __attribute__((packed));
+
+/**
+ * @brief:                The fixed part of the MADT, followed by the
+ *                        variable length entries.
+ *
+ * @struct:               AcpiMadt
+ */
+struct AcpiMadt {
+    struct AcpiHeader header;
+    uint32_t lapic_address;
+    uint32_t flags;
+    uint8_t entries[];
+} __attribute__((packed));
+
+static struct AcpiHeader *root_table;
+static bool root_is_xsdt;
+static struct MadtInfo madt_info;
+
+/**
+ * @brief:     Compares the first n characters of two strings.
+ */
+static bool match(const char *a, const char *b, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief:     Returns true if the bytes of a table add up to zero.
+ */
+static bool checksum_ok(const void *table, uint32_t length)
+{
+    const uint8_t *p = table;
+    uint8_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < length; i++) {
+        sum += p[i];
+    }
+
+    return sum == 0;
+}
+
+/**
+ * @brief:     Searches [start, end) of physical memory for the RSDP.
+ *
+ * @return:    The RSDP accessed through the direct map, or 0.
+ */
+static struct AcpiRsdp *scan_rsdp(uint64_t start, uint64_t end)
+{
+    struct AcpiRsdp *rsdp;
+    uint64_t addr;
+
+    for (addr = start; addr+sizeof(struct AcpiRsdp) <= end; addr += 16) {
+        rsdp = (struct AcpiRsdp *)P2V(addr);
+        if (match(rsdp->signature, "RSD PTR ", 8) && checksum_ok(rsdp, 20)) {
+            return rsdp;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief:     Returns the header of the table at a physical address if its
+ *             checksum is valid, or 0.
+ */
+static struct AcpiHeader *map_table(uint64_t addr)
+{
+    struct AcpiHeader *table;
+
+    if (addr == 0) {
+        return 0;
+    }
+
+    table = (struct AcpiHeader *)P2V(addr);
+    if (!checksum_ok(table, table->length)) {
+        return 0;
+    }
+
+    return table;
+}
+
+/**
+ * @brief:      A function that looks up an ACPI table.
+ *
+ * @param[in]:  signature  the 4-character signature, for example "APIC"
+ *
+ * @return:     The table accessed through the direct map, or 0.
+ */
+struct AcpiHeader *acpi_find_table(const char *signature)
+{
+    struct AcpiHeader *table;
+    uint32_t count, i;
+    uint64_t addr;
+    uint8_t *entries;
+
+    if (root_table == 0) {
+        return 0;
+    }
+
+    entries = (uint8_t *)(root_table+1);
+    count = (root_table->length-sizeof(struct AcpiHeader))/(root_is_xsdt ? 8 : 4);
+
+    for (i = 0; i < count; i++) {
+        if (root_is_xsdt) {
+            addr = ((uint64_t *)entries)[i];
+        }
+        else {
+            addr = ((uint32_t *)entries)[i];
+        }
+
+        table = (struct AcpiHeader *)P2V(addr);
+        if (addr != 0 && match(table->signature, signature, 4)) {
+            return map_table(addr);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief:     Records the APIC ID of an enabled CPU.
+ */
+static void add_cpu(uint32_t apic_id, uint32_t flags)
+{
+    if ((flags&MADT_ENABLED) == 0 || madt_info.cpu_count == MAX_CPUS) {
+        return;
+    }
+
+    madt_info.apic_ids[madt_info.cpu_count++] = apic_id;
+}
+
+/**
+ * @brief:     Copies the entries of the MADT into madt_info.
+ */
+static void parse_madt(struct AcpiMadt *madt)
+{
+    uint8_t *p = madt->entries;
+    uint8_t *end = (uint8_t *)madt+madt->header.length;
+    struct MadtIoApic *ioapic;
+    uint8_t irq;
+
+    madt_info.lapic_address = madt->lapic_address;
+    madt_info.ioapic_count = 0;
+
+    while (p+2 <= end && p[1] >= 2 && p+p[1] <= end) {
+        switch (p[0]) {
+        case MADT_LAPIC:
+            add_cpu(p[3], *(uint32_t *)(p+4));
+            break;
+
+        case MADT_X2APIC:
+            add_cpu(*(uint32_t *)(p+4), *(uint32_t *)(p+8));
+            break;
+
+        case MADT_IOAPIC:
+            if (madt_info.ioapic_count < MAX_IOAPICS) {
+                ioapic = &madt_info.ioapics[madt_info.ioapic_count++];
+                ioapic->id = p[2];
+                ioapic->address = *(uint32_t *)(p+4);
+                ioapic->gsi_base = *(uint32_t *)(p+8);
+            }
+            break;
+
+        case MADT_OVERRIDE:
+            irq = p[3];
+            if (p[2] == 0 && irq < ISA_IRQS) {
+                madt_info.isa[irq].gsi = *(uint32_t *)(p+4);
+                madt_info.isa[irq].flags = *(uint16_t *)(p+8);
+            }
+            break;
+
+        case MADT_LAPIC_ADDR:
+            madt_info.lapic_address = *(uint64_t *)(p+4);
+            break;
+        }
+
+        p += p[1];
+    }
+}
+
+/**
+ * @brief:          A function that parses the ACPI tables.
+ *
+ * @param:          None
+ *
+ * @return:         true if a MADT was found, false otherwise.
+ *
+ * @description:    The function must run after init_paging, because ACPI
+ *                  tables may lie anywhere below the 4 GiB limit of the
+ *                  direct map. Without a MADT the defaults of a PC are used:
+ *                  the local APIC at 0xfee00000, one IOAPIC at 0xfec00000
+ *                  and ISA IRQs wired to the IOAPIC input of the same number.
+ */
+bool init_acpi(void)
+{
+    struct AcpiRsdp *rsdp;
+    struct AcpiMadt *madt;
+    uint64_t ebda;
+    int i;
+
+    madt_info.lapic_address = LAPIC_DEFAULT_ADDR;
+    madt_info.cpu_count = 0;
+    madt_info.ioapic_count = 1;
+    madt_info.ioapics[0].id = 0;
+    madt_info.ioapics[0].address = IOAPIC_DEFAULT_ADDR;
+    madt_info.ioapics[0].gsi_base = 0;
+    for (i = 0; i < ISA_IRQS; i++) {
+        madt_info.isa[i].gsi = i;
+        madt_info.isa[i].flags = 0;
+    }
+
+    ebda = (uint64_t)*(uint16_t *)P2V(EBDA_SEGMENT_ADDR)<<4;
+    rsdp = 0;
+    if (ebda != 0) {
+        rsdp = scan_rsdp(ebda, ebda+1024);
+    }
+    if (rsdp == 0) {
+        rsdp = scan_rsdp(BIOS_ROM_START, BIOS_ROM_END);
+    }
+    if (rsdp == 0) {
+        return false;
+    }
+
+    root_table = 0;
+    if (rsdp->revision >= 2 && checksum_ok(rsdp, rsdp->length)) {
+        root_table = map_table(rsdp->xsdt_address);
+        root_is_xsdt = true;
+    }
+    if (root_table == 0) {
+        root_table = map_table(rsdp->rsdt_address);
+        root_is_xsdt = false;
+    }
+
+    madt = (struct AcpiMadt *)acpi_find_table("APIC");
+    if (madt == 0) {
+        return false;
+    }
+
+    parse_madt(madt);
+    return true;
+}
+
+/**
+ * @brief:      Returns the interrupt topology collected by init_acpi.
+ */
+const struct MadtInfo *get_madt_info(void)
+{
+    return &madt_info;
+}
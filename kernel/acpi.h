@@ -0,0 +1,133 @@
+/* -----------------------------------------------------------------------------
+ * @file:        acpi.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the ACPI table
+ *               parser.
+ *
+ *               The kernel only needs the Multiple APIC Description Table
+ *               (MADT) to find the local APIC of every CPU, the IOAPICs and
+ *               the interrupt source overrides that connect the ISA IRQs to
+ *               IOAPIC inputs. init_acpi locates the RSDP in the BIOS areas,
+ *               follows the XSDT or RSDT to the MADT and copies the entries
+ *               into a MadtInfo structure.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the MADT parser.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _ACPI_H_
+#define _ACPI_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define MAX_CPUS            16
+#define MAX_IOAPICS         4
+#define ISA_IRQS            16
+
+#define LAPIC_DEFAULT_ADDR  0xfee00000UL
+#define IOAPIC_DEFAULT_ADDR 0xfec00000UL
+
+#define MADT_POLARITY_MASK  0x3
+#define MADT_ACTIVE_LOW     0x3
+#define MADT_TRIGGER_MASK   0xc
+#define MADT_LEVEL          0xc
+
+/**
+ * @brief:                The header shared by all ACPI system description
+ *                        tables.
+ *
+ * @struct:               AcpiHeader
+ */
+struct AcpiHeader {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+/**
+ * @brief:                An IOAPIC reported by the MADT.
+ *
+ * @struct:               MadtIoApic
+ *
+ * @param:     id         The IOAPIC ID
+ * @param:     address    The physical address of the registers
+ * @param:     gsi_base   The first global system interrupt of the IOAPIC
+ */
+struct MadtIoApic {
+    uint32_t id;
+    uint32_t address;
+    uint32_t gsi_base;
+};
+
+/**
+ * @brief:                The IOAPIC input of an ISA IRQ.
+ *
+ * @struct:               MadtIrq
+ *
+ * @param:     gsi        The global system interrupt the IRQ is wired to
+ * @param:     flags      The MPS INTI polarity and trigger mode flags
+ */
+struct MadtIrq {
+    uint32_t gsi;
+    uint16_t flags;
+};
+
+/**
+ * @brief:                The interrupt topology collected from the MADT.
+ *
+ * @struct:               MadtInfo
+ *
+ * @param:     lapic_address  The physical address of the local APICs
+ * @param:     cpu_count      The number of enabled local APICs
+ * @param:     apic_ids       The APIC IDs of the enabled CPUs
+ * @param:     ioapic_count   The number of IOAPICs
+ * @param:     ioapics        The IOAPICs
+ * @param:     isa            The IOAPIC input of each ISA IRQ, identity
+ *                            mapped unless an override says otherwise
+ */
+struct MadtInfo {
+    uint64_t lapic_address;
+    uint32_t cpu_count;
+    uint32_t apic_ids[MAX_CPUS];
+    uint32_t ioapic_count;
+    struct MadtIoApic ioapics[MAX_IOAPICS];
+    struct MadtIrq isa[ISA_IRQS];
+};
+
+/**
+ * @fn:        init_acpi(void)
+ *
+ * @brief:     Finds the ACPI tables and parses the MADT.
+ *
+ * @return:    true if a MADT was found. Otherwise the MadtInfo describes a
+ *             single IOAPIC at its default address and no CPUs.
+ */
+bool init_acpi(void);
+/**
+ * @fn:        acpi_find_table(const char *signature)
+ *
+ * @brief:     Returns the table with the 4-character signature, accessed
+ *             through the direct map, or 0 if there is none.
+ */
+struct AcpiHeader *acpi_find_table(const char *signature);
+/**
+ * @fn:        get_madt_info(void)
+ *
+ * @brief:     Returns the interrupt topology collected by init_acpi.
+ */
+const struct MadtInfo *get_madt_info(void);
+
+#endif
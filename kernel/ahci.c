@@ -0,0 +1,725 @@
+/******************************************************************************
+ * @file:        ahci.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the AHCI SATA disk driver.
+ *
+ *               Each port has up to 32 command slots. A slot holds a
+ *               command header in the command list, which points at a
+ *               command table with the command FIS and the list of physical
+ *               regions (PRDs) of the data. Setting the bit of a slot in
+ *               PxCI hands it to the controller, which clears the bit when
+ *               the command is done, and the data moves by DMA without the
+ *               CPU:
+ *
+ *                  - With native command queuing (NCQ) a request is a READ
+ *                    or WRITE FPDMA QUEUED command, tagged with its slot
+ *                    number, and the bit of the slot is also set in PxSACT.
+ *                    The disk sets the bits of all commands it has finished
+ *                    in one Set Device Bits FIS, and reorders them to suit
+ *                    its head, so the block layer keeps up to 32 requests
+ *                    in flight.
+ *
+ *                  - Without NCQ a request is a READ or WRITE DMA EXT
+ *                    command, and one is in flight at a time.
+ *
+ *               Every Bio of a request is one PRD, as its buffer is
+ *               physically contiguous, so a request has at most AHCI_PRDS
+ *               Bios.
+ *
+ *               The MSI handler clears the interrupt status of the ports
+ *               and schedules their tasklets. A tasklet ends the requests
+ *               whose slots are clear in both PxCI and PxSACT. After a task
+ *               file error the port stops processing, the tasklet then
+ *               fails the requests still in flight and restarts the engine.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the AHCI driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "ahci.h"
+#include "blk.h"
+#include "pci.h"
+#include "softirq.h"
+#include "apic.h"
+#include "trap.h"
+#include "clock.h"
+#include "memory.h"
+#include "paging.h"
+#include "slab.h"
+#include "sync.h"
+#include "printk.h"
+#include "string.h"
+#include "lib.h"
+
+#define AHCI_CLASS          0x01
+#define AHCI_SUBCLASS       0x06
+#define AHCI_PROGIF         0x01
+#define AHCI_ABAR           5
+
+#define HBA_CAP             0x00
+#define HBA_GHC             0x04
+#define HBA_IS              0x08
+#define HBA_PI              0x0c
+#define HBA_SIZE            0x1100
+
+#define HBA_CAP_NCS(c)      ((((c)>>8)&0x1f)+1)
+#define HBA_CAP_SNCQ        (1U<<30)
+#define HBA_CAP_S64A        (1U<<31)
+#define HBA_GHC_IE          (1U<<1)
+#define HBA_GHC_AE          (1U<<31)
+
+#define PORT_REGS(n)        (0x100+(n)*0x80)
+#define PX_CLB              0x00
+#define PX_CLBU             0x04
+#define PX_FB               0x08
+#define PX_FBU              0x0c
+#define PX_IS               0x10
+#define PX_IE               0x14
+#define PX_CMD              0x18
+#define PX_TFD              0x20
+#define PX_SIG              0x24
+#define PX_SSTS             0x28
+#define PX_SCTL             0x2c
+#define PX_SERR             0x30
+#define PX_SACT             0x34
+#define PX_CI               0x38
+
+#define PX_CMD_ST           (1U<<0)
+#define PX_CMD_SUD          (1U<<1)
+#define PX_CMD_POD          (1U<<2)
+#define PX_CMD_FRE          (1U<<4)
+#define PX_CMD_FR           (1U<<14)
+#define PX_CMD_CR           (1U<<15)
+
+#define PX_IS_DHRS          (1U<<0)
+#define PX_IS_PSS           (1U<<1)
+#define PX_IS_DSS           (1U<<2)
+#define PX_IS_SDBS          (1U<<3)
+#define PX_IS_IFS           (1U<<27)
+#define PX_IS_HBDS          (1U<<28)
+#define PX_IS_HBFS          (1U<<29)
+#define PX_IS_TFES          (1U<<30)
+#define PX_IS_ERRORS        (PX_IS_IFS|PX_IS_HBDS|PX_IS_HBFS|PX_IS_TFES)
+
+#define PX_TFD_ERR          0x01
+#define PX_TFD_DRQ          0x08
+#define PX_TFD_BSY          0x80
+
+#define PX_SSTS_DET         0x0f
+#define PX_SSTS_PRESENT     0x03
+#define PX_SCTL_DET_INIT    0x01
+#define PX_SIG_ATA          0x00000101
+
+#define FIS_TYPE_H2D        0x27
+#define FIS_H2D_COMMAND     0x80
+#define FIS_LENGTH          5
+#define FIS_DEVICE_LBA      0x40
+
+#define CMD_WRITE           (1U<<6)
+
+#define ATA_CMD_READ_DMA_EXT   0x25
+#define ATA_CMD_WRITE_DMA_EXT  0x35
+#define ATA_CMD_READ_FPDMA     0x60
+#define ATA_CMD_WRITE_FPDMA    0x61
+#define ATA_CMD_IDENTIFY       0xec
+
+#define ATA_ID_QUEUE_DEPTH  75
+#define ATA_ID_SATA_CAPS    76
+#define ATA_ID_FEATURES     83
+#define ATA_ID_SECTORS48    100
+#define ATA_ID_NCQ          (1<<8)
+#define ATA_ID_LBA48        (1<<10)
+
+#define AHCI_MAX_PORTS      32
+#define AHCI_SLOTS          32
+#define AHCI_PRDS           8
+#define AHCI_MAX_SECTORS    1024
+#define AHCI_FIS_OFFSET     1024
+#define AHCI_TABLES_ORDER   1
+#define AHCI_TIMEOUT_NS     (500*NSEC_PER_MSEC)
+#define AHCI_RESET_NS       (2*NSEC_PER_MSEC)
+
+/**
+ * @brief:                A command header in the command list.
+ *
+ * @struct:               AhciHeader
+ *
+ * @param:     flags      The FIS length in dwords and CMD_WRITE
+ * @param:     prdtl      The number of PRDs
+ * @param:     prdbc      The bytes transferred, set by the controller
+ * @param:     ctba       The physical address of the command table
+ */
+struct AhciHeader {
+    uint16_t flags;
+    uint16_t prdtl;
+    uint32_t prdbc;
+    uint64_t ctba;
+    uint32_t reserved[4];
+};
+
+/**
+ * @brief:                A physical region of the data.
+ *
+ * @struct:               AhciPrd
+ *
+ * @param:     dba        The physical address, word-aligned
+ * @param:     dbc        The byte count minus one
+ */
+struct AhciPrd {
+    uint64_t dba;
+    uint32_t reserved;
+    uint32_t dbc;
+};
+
+/**
+ * @brief:                The command table of a slot, 256 bytes.
+ *
+ * @struct:               AhciTable
+ *
+ * @param:     cfis       The command FIS
+ * @param:     acmd       The ATAPI command, unused
+ * @param:     prdt       The PRDs
+ */
+struct AhciTable {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    struct AhciPrd prdt[AHCI_PRDS];
+};
+
+/**
+ * @brief:                A port with a disk.
+ *
+ * @struct:               AhciPort
+ *
+ * @param:     dev        The block device
+ * @param:     regs       The port registers
+ * @param:     list       The command list, followed by the received FIS area
+ * @param:     tables     The command tables of all slots
+ * @param:     tables_pa  The physical address of tables
+ * @param:     ncq        Whether the commands are queued
+ * @param:     slots      The mask of the usable slots
+ * @param:     lock       Protects active and reqs
+ * @param:     active     The mask of the slots in flight
+ * @param:     reqs       The request of each slot in flight
+ * @param:     events     The port interrupt status collected by the handler
+ * @param:     tasklet    Ends the requests after an interrupt
+ */
+struct AhciPort {
+    struct BlkDev dev;
+    volatile uint32_t *regs;
+    struct AhciHeader *list;
+    struct AhciTable *tables;
+    uint64_t tables_pa;
+    bool ncq;
+    uint32_t slots;
+    struct Spinlock lock;
+    uint32_t active;
+    struct BlkRequest *reqs[AHCI_SLOTS];
+    uint32_t events;
+    struct Tasklet tasklet;
+};
+
+static volatile uint32_t *hba_regs;
+static bool hba_64bit;
+static struct AhciPort *ports[AHCI_MAX_PORTS];
+static uint32_t port_mask;
+
+/**
+ * @brief:      Waits until the bits of mask are clear in a register, false
+ *              on timeout.
+ */
+static bool wait_clear(volatile uint32_t *reg, uint32_t mask, uint64_t ns)
+{
+    uint64_t end = ktime_ns()+ns;
+
+    while ((*reg&mask) != 0) {
+        if (ktime_ns() > end) {
+            return false;
+        }
+        cpu_relax();
+    }
+
+    return true;
+}
+
+/**
+ * @brief:      Whether the controller can reach a physical address.
+ */
+static bool reachable(uint64_t pa)
+{
+    return hba_64bit || pa+PAGE_SIZE*2 <= (1UL<<32);
+}
+
+/**
+ * @brief:      Stops the command engine and the FIS receive of a port.
+ */
+static bool port_stop(volatile uint32_t *regs)
+{
+    regs[PX_CMD>>2] &= ~PX_CMD_ST;
+    if (!wait_clear(&regs[PX_CMD>>2], PX_CMD_CR, AHCI_TIMEOUT_NS)) {
+        return false;
+    }
+
+    regs[PX_CMD>>2] &= ~PX_CMD_FRE;
+    return wait_clear(&regs[PX_CMD>>2], PX_CMD_FR, AHCI_TIMEOUT_NS);
+}
+
+/**
+ * @brief:      Starts the FIS receive and the command engine of a port.
+ */
+static void port_start(volatile uint32_t *regs)
+{
+    regs[PX_SERR>>2] = 0xffffffff;
+    regs[PX_IS>>2] = 0xffffffff;
+    regs[PX_CMD>>2] |= PX_CMD_SUD|PX_CMD_POD|PX_CMD_FRE;
+    regs[PX_CMD>>2] |= PX_CMD_ST;
+}
+
+/**
+ * @brief:          A function that brings a port back after an error.
+ *
+ * @param:          port  the port
+ *
+ * @return:         None
+ *
+ * @description:    Stopping the engine clears PxCI and PxSACT. A disk that
+ *                  is still busy gets a COMRESET through PxSCTL, which the
+ *                  link must answer by coming up again.
+ */
+static void port_recover(struct AhciPort *port)
+{
+    volatile uint32_t *regs = port->regs;
+
+    port_stop(regs);
+
+    if ((regs[PX_TFD>>2]&(PX_TFD_BSY|PX_TFD_DRQ)) != 0) {
+        regs[PX_SCTL>>2] = (regs[PX_SCTL>>2]&~0xfU)|PX_SCTL_DET_INIT;
+        ndelay(AHCI_RESET_NS);
+        regs[PX_SCTL>>2] &= ~0xfU;
+        wait_clear(&regs[PX_TFD>>2], PX_TFD_BSY|PX_TFD_DRQ,
+                   AHCI_TIMEOUT_NS);
+    }
+
+    port_start(regs);
+}
+
+/**
+ * @brief:          A function that fills the command slot of a request.
+ *
+ * @param:          port     the port
+ * @param:          tag      the slot
+ * @param:          command  the ATA command
+ * @param:          lba      the first sector
+ * @param:          count    the number of sectors
+ * @param:          bio      the first Bio, 0 for the IDENTIFY buffer
+ * @param:          pa       the physical address of the IDENTIFY buffer
+ *
+ * @return:         false if a buffer cannot be used for DMA.
+ *
+ * @description:    A queued command carries the sector count in the feature
+ *                  registers and the tag in bits 7:3 of the count register.
+ */
+static bool fill_slot(struct AhciPort *port, uint32_t tag, uint8_t command,
+                      uint64_t lba, uint32_t count, struct Bio *bio,
+                      uint64_t pa)
+{
+    struct AhciHeader *header = &port->list[tag];
+    struct AhciTable *table = &port->tables[tag];
+    uint8_t *fis = table->cfis;
+    bool write = false;
+    uint16_t n = 0;
+
+    if (bio == 0) {
+        table->prdt[0].dba = pa;
+        table->prdt[0].dbc = SECTOR_SIZE-1;
+        n = 1;
+    }
+    for (; bio != 0; bio = bio->next) {
+        pa = V2P(bio->buf);
+        if ((pa&1) != 0 || !reachable(pa)) {
+            return false;
+        }
+        table->prdt[n].dba = pa;
+        table->prdt[n].dbc = (bio->count<<SECTOR_SHIFT)-1;
+        write = bio->write;
+        n++;
+    }
+
+    memset(fis, 0, 20);
+    fis[0] = FIS_TYPE_H2D;
+    fis[1] = FIS_H2D_COMMAND;
+    fis[2] = command;
+    fis[4] = (uint8_t)lba;
+    fis[5] = (uint8_t)(lba>>8);
+    fis[6] = (uint8_t)(lba>>16);
+    fis[8] = (uint8_t)(lba>>24);
+    fis[9] = (uint8_t)(lba>>32);
+    fis[10] = (uint8_t)(lba>>40);
+
+    if (command == ATA_CMD_READ_FPDMA || command == ATA_CMD_WRITE_FPDMA) {
+        fis[3] = (uint8_t)count;
+        fis[11] = (uint8_t)(count>>8);
+        fis[12] = (uint8_t)(tag<<3);
+    }
+    else {
+        fis[12] = (uint8_t)count;
+        fis[13] = (uint8_t)(count>>8);
+    }
+    if (command != ATA_CMD_IDENTIFY) {
+        fis[7] = FIS_DEVICE_LBA;
+    }
+
+    header->flags = (uint16_t)(FIS_LENGTH|(write ? CMD_WRITE : 0));
+    header->prdtl = n;
+    header->prdbc = 0;
+    header->ctba = port->tables_pa+tag*sizeof(struct AhciTable);
+
+    return true;
+}
+
+/**
+ * @brief:      Issues a request in a free slot.
+ */
+static int ahci_start(struct BlkDev *dev, struct BlkRequest *req)
+{
+    struct AhciPort *port = dev->priv;
+    uint32_t free, tag;
+    uint8_t command;
+
+    spin_lock(&port->lock);
+
+    free = port->slots&~port->active;
+    if (free == 0) {
+        spin_unlock(&port->lock);
+        return BLK_EIO;
+    }
+    tag = (uint32_t)__builtin_ctz(free);
+
+    if (port->ncq) {
+        command = req->write ? ATA_CMD_WRITE_FPDMA : ATA_CMD_READ_FPDMA;
+    }
+    else {
+        command = req->write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+    }
+    if (!fill_slot(port, tag, command, req->sector, req->count, req->head,
+                   0)) {
+        spin_unlock(&port->lock);
+        return BLK_EIO;
+    }
+
+    req->tag = tag;
+    port->reqs[tag] = req;
+    port->active |= 1U<<tag;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (port->ncq) {
+        port->regs[PX_SACT>>2] = 1U<<tag;
+    }
+    port->regs[PX_CI>>2] = 1U<<tag;
+
+    spin_unlock(&port->lock);
+    return BLK_OK;
+}
+
+/**
+ * @brief:          The tasklet that ends the finished requests of a port.
+ *
+ * @param:          ctx  the port
+ *
+ * @return:         None
+ *
+ * @description:    The requests are ended after the port lock is released,
+ *                  blk_complete starts the next ones through ahci_start.
+ */
+static void ahci_work(void *ctx)
+{
+    struct AhciPort *port = ctx;
+    struct BlkRequest *reqs[AHCI_SLOTS];
+    uint32_t events, busy, done, failed, tag;
+    uint64_t flags;
+
+    events = __atomic_exchange_n(&port->events, 0, __ATOMIC_ACQ_REL);
+
+    flags = spin_lock_irqsave(&port->lock);
+
+    busy = port->regs[PX_CI>>2]|port->regs[PX_SACT>>2];
+    done = port->active&~busy;
+    failed = 0;
+    if ((events&PX_IS_ERRORS) != 0) {
+        failed = port->active&busy;
+        printk("ahci: %s error, status %x, task file %x\n", port->dev.name,
+               events, port->regs[PX_TFD>>2]);
+        port_recover(port);
+    }
+    for (tag = 0; tag < AHCI_SLOTS; tag++) {
+        if (((done|failed)&(1U<<tag)) != 0) {
+            reqs[tag] = port->reqs[tag];
+            port->reqs[tag] = 0;
+        }
+    }
+    port->active &= ~(done|failed);
+
+    spin_unlock_irqrestore(&port->lock, flags);
+
+    while ((done|failed) != 0) {
+        tag = (uint32_t)__builtin_ctz(done|failed);
+        blk_complete(&port->dev, reqs[tag],
+                     (failed&(1U<<tag)) != 0 ? BLK_EIO : BLK_OK);
+        done &= ~(1U<<tag);
+        failed &= ~(1U<<tag);
+    }
+}
+
+/**
+ * @brief:      The MSI handler of the controller. The port status is
+ *              cleared before HBA_IS, which would otherwise stay set.
+ */
+static void ahci_interrupt(struct TrapFrame *tf, void *ctx)
+{
+    uint32_t pending = hba_regs[HBA_IS>>2]&port_mask;
+    uint32_t bits = pending, status, n;
+    struct AhciPort *port;
+
+    while (bits != 0) {
+        n = (uint32_t)__builtin_ctz(bits);
+        bits &= bits-1;
+
+        port = ports[n];
+        status = port->regs[PX_IS>>2];
+        port->regs[PX_IS>>2] = status;
+        __atomic_or_fetch(&port->events, status, __ATOMIC_RELEASE);
+        tasklet_schedule(&port->tasklet);
+    }
+
+    hba_regs[HBA_IS>>2] = pending;
+    eoi();
+}
+
+/**
+ * @brief:      Runs IDENTIFY DEVICE in slot 0 and waits for it.
+ */
+static bool port_identify(struct AhciPort *port, uint64_t pa)
+{
+    volatile uint32_t *regs = port->regs;
+
+    fill_slot(port, 0, ATA_CMD_IDENTIFY, 0, 0, 0, pa);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    regs[PX_CI>>2] = 1;
+
+    if (!wait_clear(&regs[PX_CI>>2], 1, AHCI_TIMEOUT_NS)) {
+        return false;
+    }
+
+    return (regs[PX_IS>>2]&PX_IS_TFES) == 0 &&
+           (regs[PX_TFD>>2]&PX_TFD_ERR) == 0;
+}
+
+/**
+ * @brief:          A function that sets up the disk of a port.
+ *
+ * @param:          n    the port number
+ * @param:          cap  the HBA capabilities
+ *
+ * @return:         The port, or 0 if it has no usable ATA disk.
+ *
+ * @description:    The command list and the received FIS area share one
+ *                  frame, the command tables of the 32 slots take two. The
+ *                  queue depth is the smaller of what the controller and
+ *                  the disk support.
+ */
+static struct AhciPort *port_setup(uint32_t n, uint32_t cap)
+{
+    volatile uint32_t *regs = hba_regs+(PORT_REGS(n)>>2);
+    struct AhciPort *port;
+    uint64_t list_pa, tables_pa, id_pa, sectors;
+    uint16_t *id;
+    uint32_t depth;
+
+    if ((regs[PX_SSTS>>2]&PX_SSTS_DET) != PX_SSTS_PRESENT ||
+        regs[PX_SIG>>2] != PX_SIG_ATA) {
+        return 0;
+    }
+
+    port = kmalloc(sizeof(struct AhciPort));
+    list_pa = alloc_frame();
+    tables_pa = alloc_frames(AHCI_TABLES_ORDER);
+    id_pa = alloc_frame();
+    if (port == 0 || list_pa == 0 || tables_pa == 0 || id_pa == 0 ||
+        !reachable(list_pa) || !reachable(tables_pa) || !reachable(id_pa)) {
+        printk("ahci: no memory for port %u\n", n);
+        goto fail;
+    }
+
+    memset(port, 0, sizeof(struct AhciPort));
+    memset((void *)P2V(list_pa), 0, PAGE_SIZE);
+    memset((void *)P2V(tables_pa), 0, PAGE_SIZE<<AHCI_TABLES_ORDER);
+    port->regs = regs;
+    port->list = (struct AhciHeader *)P2V(list_pa);
+    port->tables = (struct AhciTable *)P2V(tables_pa);
+    port->tables_pa = tables_pa;
+    spin_init(&port->lock);
+
+    if (!port_stop(regs)) {
+        printk("ahci: port %u does not stop\n", n);
+        goto fail;
+    }
+    regs[PX_IE>>2] = 0;
+    regs[PX_CLB>>2] = (uint32_t)list_pa;
+    regs[PX_CLBU>>2] = (uint32_t)(list_pa>>32);
+    regs[PX_FB>>2] = (uint32_t)(list_pa+AHCI_FIS_OFFSET);
+    regs[PX_FBU>>2] = (uint32_t)((list_pa+AHCI_FIS_OFFSET)>>32);
+    port_start(regs);
+
+    id = (uint16_t *)P2V(id_pa);
+    if (!port_identify(port, id_pa)) {
+        printk("ahci: IDENTIFY on port %u failed\n", n);
+        goto fail;
+    }
+    if ((id[ATA_ID_FEATURES]&ATA_ID_LBA48) == 0) {
+        printk("ahci: disk on port %u has no LBA48\n", n);
+        goto fail;
+    }
+    sectors = (uint64_t)id[ATA_ID_SECTORS48]|
+              ((uint64_t)id[ATA_ID_SECTORS48+1]<<16)|
+              ((uint64_t)id[ATA_ID_SECTORS48+2]<<32)|
+              ((uint64_t)id[ATA_ID_SECTORS48+3]<<48);
+
+    port->ncq = (cap&HBA_CAP_SNCQ) != 0 &&
+                (id[ATA_ID_SATA_CAPS]&ATA_ID_NCQ) != 0;
+    depth = 1;
+    if (port->ncq) {
+        depth = (id[ATA_ID_QUEUE_DEPTH]&0x1f)+1;
+        if (depth > HBA_CAP_NCS(cap)) {
+            depth = HBA_CAP_NCS(cap);
+        }
+    }
+    port->slots = depth == AHCI_SLOTS ? 0xffffffff : (1U<<depth)-1;
+    free_frame(id_pa);
+
+    snprintf(port->dev.name, BLK_NAME_SIZE, "ahci%u", n);
+    port->dev.sectors = sectors;
+    port->dev.max_sectors = AHCI_MAX_SECTORS;
+    port->dev.max_segments = AHCI_PRDS;
+    port->dev.queue_depth = depth;
+    port->dev.priv = port;
+    tasklet_init(&port->tasklet, ahci_work, port);
+
+    return port;
+
+fail:
+    if (port != 0 && list_pa != 0) {
+        port_stop(regs);
+    }
+    if (id_pa != 0) {
+        free_frame(id_pa);
+    }
+    if (tables_pa != 0) {
+        free_frames(tables_pa, AHCI_TABLES_ORDER);
+    }
+    if (list_pa != 0) {
+        free_frame(list_pa);
+    }
+    kfree(port);
+    return 0;
+}
+
+static const struct BlkOps ahci_ops = {
+    .start = ahci_start,
+};
+
+/**
+ * @brief:          A function that sets up the first AHCI controller.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    GHC.AE switches the controller from IDE emulation to
+ *                  AHCI. The disks are set up with polled commands, then
+ *                  the MSI is routed to the boot CPU and the port
+ *                  interrupts are enabled. Without an MSI the controller is
+ *                  left alone, its disks may still be reachable through the
+ *                  ATA driver.
+ */
+void init_ahci(void)
+{
+    uint32_t addr, cap, pi, n;
+    uint64_t abar;
+
+    addr = pci_find_class(AHCI_CLASS, AHCI_SUBCLASS, AHCI_PROGIF, 0);
+    if (addr == PCI_NONE) {
+        printk("ahci: no controller\n");
+        return;
+    }
+    if (get_apic_mode() == APIC_MODE_PIC) {
+        printk("ahci: MSI needs the local APIC\n");
+        return;
+    }
+
+    pci_write(addr, PCI_COMMAND, pci_read(addr, PCI_COMMAND)|
+              PCI_CMD_MEMORY|PCI_CMD_MASTER);
+    abar = pci_bar(addr, AHCI_ABAR);
+    hba_regs = (volatile uint32_t *)map_mmio(abar, HBA_SIZE);
+    if (hba_regs == 0) {
+        printk("ahci: cannot map the registers at %lx\n", abar);
+        return;
+    }
+
+    hba_regs[HBA_GHC>>2] |= HBA_GHC_AE;
+    cap = hba_regs[HBA_CAP>>2];
+    hba_64bit = (cap&HBA_CAP_S64A) != 0;
+    pi = hba_regs[HBA_PI>>2];
+
+    for (n = 0; n < AHCI_MAX_PORTS; n++) {
+        if ((pi&(1U<<n)) == 0) {
+            continue;
+        }
+        ports[n] = port_setup(n, cap);
+        if (ports[n] != 0) {
+            ports[n]->dev.ops = &ahci_ops;
+            port_mask |= 1U<<n;
+        }
+    }
+    if (port_mask == 0) {
+        printk("ahci: no disks\n");
+        return;
+    }
+
+    register_irq_handler(AHCI_VECTOR, ahci_interrupt, 0);
+    if (pci_enable_msi(addr, AHCI_VECTOR, lapic_id()) != 0) {
+        printk("ahci: controller has no MSI\n");
+        unregister_irq_handler(AHCI_VECTOR);
+        for (n = 0; n < AHCI_MAX_PORTS; n++) {
+            if (ports[n] != 0) {
+                port_stop(ports[n]->regs);
+            }
+        }
+        port_mask = 0;
+        return;
+    }
+
+    for (n = 0; n < AHCI_MAX_PORTS; n++) {
+        if (ports[n] != 0) {
+            ports[n]->regs[PX_IS>>2] = 0xffffffff;
+            ports[n]->regs[PX_IE>>2] = PX_IS_DHRS|PX_IS_PSS|PX_IS_DSS|
+                                        PX_IS_SDBS|PX_IS_ERRORS;
+        }
+    }
+    hba_regs[HBA_IS>>2] = 0xffffffff;
+    hba_regs[HBA_GHC>>2] |= HBA_GHC_IE;
+
+    for (n = 0; n < AHCI_MAX_PORTS; n++) {
+        if (ports[n] != 0) {
+            blk_register(&ports[n]->dev);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+/* -----------------------------------------------------------------------------
+ * @file:        ahci.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the AHCI SATA
+ *               disk driver.
+ *
+ *               Every port of the first AHCI controller with an ATA disk
+ *               becomes a block device ahci0, ahci1 and so on. Transfers
+ *               are DMA through the command slots of the port, with native
+ *               command queuing where the controller and the disk support
+ *               it, and complete through an MSI on AHCI_VECTOR.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the AHCI driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _AHCI_H_
+#define _AHCI_H_
+
+#include "stdint.h"
+
+/**
+ * @fn:        init_ahci(void)
+ *
+ * @brief:     Sets up the disks of the first AHCI controller and registers
+ *             them. Must run after init_blk, init_apic and init_softirq.
+ */
+void init_ahci(void);
+
+#endif
@@ -0,0 +1,482 @@
+/******************************************************************************
+ * @file:        apic.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the local APIC and IOAPIC drivers.
+ *
+ *               The 8259 pair needs two port writes to acknowledge an
+ *               interrupt and a port round trip to tell a spurious IRQ7 from
+ *               a real one. The local APIC is acknowledged with one write to
+ *               its EOI register, either an MSR in x2APIC mode or an uncached
+ *               MMIO store in xAPIC mode, and reports spurious interrupts on
+ *               their own vector, which needs no acknowledgement at all.
+ *
+ *               init_apic keeps the 8259 path when the CPU has no local APIC
+ *               or the MADT lists no IOAPIC. Otherwise it enables the local
+ *               APIC, masks every IOAPIC input, routes the PIT (ISA IRQ 0,
+ *               usually wired to GSI 2) to vector 32 on the boot CPU and
+ *               masks both 8259 chips. From then on eoi() goes to the local
+ *               APIC.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the local APIC and IOAPIC drivers.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Added enable_isa_irq for the device drivers.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "apic.h"
+#include "acpi.h"
+#include "memory.h"
+#include "paging.h"
+#include "trap.h"
+#include "lib.h"
+
+#define IA32_APIC_BASE      0x1b
+#define APIC_BASE_X2APIC    (1<<10)
+#define APIC_BASE_ENABLE    (1<<11)
+#define APIC_BASE_ADDR(v)   ((v)&0x000ffffffffff000UL)
+
+#define X2APIC_MSR_BASE     0x800
+#define X2APIC_ICR          0x830
+
+#define SVR_ENABLE          (1<<8)
+
+#define IOAPIC_REGSEL       0
+#define IOAPIC_WINDOW       4
+#define IOAPIC_VER          1
+#define IOAPIC_REDTBL(n)    (0x10+2*(n))
+#define IOAPIC_MASKED       (1<<16)
+
+#define PIC1_DATA           0x21
+#define PIC2_DATA           0xa1
+
+/**
+ * @brief:       The state of one IOAPIC.
+ *
+ * @struct:      IoApic
+ *
+ * @param:       regs      The uncached mapping of the register window
+ * @param:       gsi_base  The first global system interrupt of the IOAPIC
+ * @param:       inputs    The number of redirection table entries
+ */
+struct IoApic {
+    volatile uint32_t *regs;
+    uint32_t gsi_base;
+    uint32_t inputs;
+};
+
+static int apic_mode = APIC_MODE_PIC;
+static volatile uint32_t *lapic_regs;
+static struct IoApic ioapics[MAX_IOAPICS];
+static uint32_t ioapic_count;
+
+/**
+ * @brief:      Reads a local APIC register.
+ *
+ * @param[in]:  reg  the xAPIC MMIO offset of the register
+ *
+ * @return:     The value of the register.
+ */
+uint32_t lapic_read(uint32_t reg)
+{
+    if (apic_mode == APIC_MODE_X2APIC) {
+        return (uint32_t)read_msr(X2APIC_MSR_BASE+(reg>>4));
+    }
+
+    return lapic_regs[reg>>2];
+}
+
+/**
+ * @brief:      Writes a local APIC register.
+ *
+ * @param[in]:  reg    the xAPIC MMIO offset of the register
+ * @param[in]:  value  the new value
+ *
+ * @return:     None
+ */
+void lapic_write(uint32_t reg, uint32_t value)
+{
+    if (apic_mode == APIC_MODE_X2APIC) {
+        write_msr(X2APIC_MSR_BASE+(reg>>4), value);
+        return;
+    }
+
+    lapic_regs[reg>>2] = value;
+}
+
+/**
+ * @brief:      Returns the APIC ID of the calling CPU.
+ */
+uint32_t lapic_id(void)
+{
+    if (apic_mode == APIC_MODE_X2APIC) {
+        return lapic_read(LAPIC_ID);
+    }
+
+    return lapic_read(LAPIC_ID)>>24;
+}
+
+/**
+ * @brief:      Returns the interrupt controller mode chosen by init_apic.
+ */
+int get_apic_mode(void)
+{
+    return apic_mode;
+}
+
+/**
+ * @brief:          A function that sends an interprocessor interrupt.
+ *
+ * @param[in]:      apic_id  the APIC ID of the target CPU
+ * @param[in]:      icr      the low half of the interrupt command register
+ *
+ * @return:         None
+ *
+ * @description:    In x2APIC mode the ICR is a single 64-bit MSR. In xAPIC
+ *                  mode the destination is written first, because the write
+ *                  of the low half sends the interrupt.
+ */
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr)
+{
+    if (apic_mode == APIC_MODE_X2APIC) {
+        write_msr(X2APIC_ICR, ((uint64_t)apic_id<<32)|icr);
+        return;
+    }
+
+    lapic_write(LAPIC_ICR_HIGH, apic_id<<24);
+    lapic_write(LAPIC_ICR_LOW, icr);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) { }
+}
+
+/**
+ * @brief:          A function that sends end of interrupt signal.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The EOI goes to the local APIC once init_apic has switched
+ *                  to it and to the 8259 before.
+ */
+void eoi(void)
+{
+    if (apic_mode == APIC_MODE_X2APIC) {
+        write_msr(X2APIC_MSR_BASE+(LAPIC_EOI>>4), 0);
+    }
+    else if (apic_mode == APIC_MODE_XAPIC) {
+        lapic_regs[LAPIC_EOI>>2] = 0;
+    }
+    else {
+        pic_eoi();
+    }
+}
+
+/**
+ * @brief:     The fast handler of the local APIC spurious vector. A spurious
+ *             interrupt does not set an in-service bit, so no EOI is sent.
+ */
+static void lapic_spurious_handler(void *ctx)
+{
+}
+
+/**
+ * @brief:     The fast handler of the local APIC error vector. Writing the
+ *             error status register latches and clears the errors.
+ */
+static void lapic_error_handler(void *ctx)
+{
+    lapic_write(LAPIC_ESR, 0);
+    eoi();
+}
+
+/**
+ * @brief:          A function that programs the local APIC of the calling
+ *                  CPU.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The APIC is enabled in IA32_APIC_BASE, and in x2APIC mode
+ *                  switched to it in a second write, as the hardware does not
+ *                  allow a direct transition from disabled to x2APIC. LINT0,
+ *                  where the 8259 would deliver, is masked, LINT1 stays the
+ *                  NMI input, the timer and performance counter entries are
+ *                  masked until their drivers claim them, and the task
+ *                  priority is lowered to accept all vectors.
+ */
+void init_lapic(void)
+{
+    uint64_t base = read_msr(IA32_APIC_BASE);
+
+    base |= APIC_BASE_ENABLE;
+    write_msr(IA32_APIC_BASE, base);
+    if (apic_mode == APIC_MODE_X2APIC) {
+        write_msr(IA32_APIC_BASE, base|APIC_BASE_X2APIC);
+    }
+
+    lapic_write(LAPIC_SVR, SVR_ENABLE|SPURIOUS_VECTOR);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_LVT_PERF, LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT0, LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LVT_NMI);
+    lapic_write(LAPIC_LVT_ERROR, ERROR_VECTOR);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_EOI, 0);
+}
+
+static uint32_t ioapic_read(struct IoApic *ioapic, uint32_t reg)
+{
+    ioapic->regs[IOAPIC_REGSEL] = reg;
+    return ioapic->regs[IOAPIC_WINDOW];
+}
+
+static void ioapic_write(struct IoApic *ioapic, uint32_t reg, uint32_t value)
+{
+    ioapic->regs[IOAPIC_REGSEL] = reg;
+    ioapic->regs[IOAPIC_WINDOW] = value;
+}
+
+/**
+ * @brief:     Returns the IOAPIC that owns a global system interrupt, or 0.
+ */
+static struct IoApic *find_ioapic(uint32_t gsi)
+{
+    uint32_t i;
+
+    for (i = 0; i < ioapic_count; i++) {
+        if (gsi >= ioapics[i].gsi_base &&
+            gsi < ioapics[i].gsi_base+ioapics[i].inputs) {
+            return &ioapics[i];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief:      Routes a global system interrupt to a vector.
+ *
+ * @param[in]:  gsi      the global system interrupt
+ * @param[in]:  vector   the vector delivered to the CPU
+ * @param[in]:  apic_id  the APIC ID of the CPU, physical destination mode
+ * @param[in]:  flags    IOAPIC_LEVEL and IOAPIC_ACTIVE_LOW, or 0 for an edge
+ *                       triggered active high input
+ *
+ * @return:     0 on success, -1 if no IOAPIC has the input.
+ *
+ * @description: The destination is written while the entry is still masked,
+ *               so the input never fires at a half updated entry.
+ */
+int ioapic_route_gsi(uint32_t gsi, uint8_t vector, uint32_t apic_id,
+                     uint32_t flags)
+{
+    struct IoApic *ioapic = find_ioapic(gsi);
+    uint32_t pin;
+
+    if (ioapic == 0) {
+        return -1;
+    }
+
+    pin = gsi-ioapic->gsi_base;
+    ioapic_write(ioapic, IOAPIC_REDTBL(pin), IOAPIC_MASKED);
+    ioapic_write(ioapic, IOAPIC_REDTBL(pin)+1, apic_id<<24);
+    ioapic_write(ioapic, IOAPIC_REDTBL(pin), vector|flags);
+
+    return 0;
+}
+
+/**
+ * @brief:      Returns the global system interrupt of an ISA IRQ.
+ */
+uint32_t irq_to_gsi(uint8_t irq)
+{
+    if (irq >= ISA_IRQS) {
+        return irq;
+    }
+
+    return get_madt_info()->isa[irq].gsi;
+}
+
+/**
+ * @brief:      Routes an ISA IRQ to vector IRQ_BASE + irq.
+ *
+ * @param[in]:  irq      the ISA IRQ number
+ * @param[in]:  apic_id  the APIC ID of the CPU
+ *
+ * @return:     0 on success, -1 otherwise.
+ *
+ * @description: ISA interrupts are edge triggered and active high unless the
+ *               interrupt source override of the IRQ says otherwise.
+ */
+int ioapic_route_irq(uint8_t irq, uint32_t apic_id)
+{
+    uint32_t flags = 0;
+    uint16_t inti;
+
+    if (irq >= ISA_IRQS) {
+        return -1;
+    }
+
+    inti = get_madt_info()->isa[irq].flags;
+    if ((inti&MADT_POLARITY_MASK) == MADT_ACTIVE_LOW) {
+        flags |= IOAPIC_ACTIVE_LOW;
+    }
+    if ((inti&MADT_TRIGGER_MASK) == MADT_LEVEL) {
+        flags |= IOAPIC_LEVEL;
+    }
+
+    return ioapic_route_gsi(irq_to_gsi(irq), IRQ_BASE+irq, apic_id, flags);
+}
+
+/**
+ * @brief:      Enables an ISA IRQ on the calling CPU.
+ *
+ * @param[in]:  irq  the ISA IRQ number
+ *
+ * @return:     0 on success, -1 otherwise.
+ *
+ * @description: On the 8259 the slave IRQs 8 - 15 also need the cascade
+ *               input IRQ2 of the master unmasked. The mask registers are
+ *               read and written back, so drivers enable their IRQs at boot,
+ *               one after the other.
+ */
+int enable_isa_irq(uint8_t irq)
+{
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+
+    if (irq >= ISA_IRQS) {
+        return -1;
+    }
+
+    if (apic_mode != APIC_MODE_PIC) {
+        return ioapic_route_irq(irq, lapic_id());
+    }
+
+    out_byte(port, (uint8_t)(in_byte(port)&~(1<<(irq&7))));
+    if (irq >= 8) {
+        out_byte(PIC1_DATA, (uint8_t)(in_byte(PIC1_DATA)&~(1<<2)));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief:      Masks or unmasks an IOAPIC input.
+ *
+ * @param[in]:  gsi     the global system interrupt
+ * @param[in]:  masked  true to mask the input
+ *
+ * @return:     None
+ */
+void ioapic_set_masked(uint32_t gsi, bool masked)
+{
+    struct IoApic *ioapic = find_ioapic(gsi);
+    uint32_t reg, value;
+
+    if (ioapic == 0) {
+        return;
+    }
+
+    reg = IOAPIC_REDTBL(gsi-ioapic->gsi_base);
+    value = ioapic_read(ioapic, reg);
+    if (masked) {
+        value |= IOAPIC_MASKED;
+    }
+    else {
+        value &= ~IOAPIC_MASKED;
+    }
+    ioapic_write(ioapic, reg, value);
+}
+
+/**
+ * @brief:     Maps the IOAPICs of the MADT and masks all their inputs.
+ *
+ * @return:    The number of usable IOAPICs.
+ */
+static uint32_t init_ioapics(void)
+{
+    const struct MadtInfo *madt = get_madt_info();
+    struct IoApic *ioapic;
+    uint32_t i, pin;
+
+    ioapic_count = 0;
+    for (i = 0; i < madt->ioapic_count; i++) {
+        ioapic = &ioapics[ioapic_count];
+        ioapic->regs = (volatile uint32_t *)map_mmio(madt->ioapics[i].address,
+                                                     PAGE_SIZE);
+        if (ioapic->regs == 0) {
+            continue;
+        }
+
+        ioapic->gsi_base = madt->ioapics[i].gsi_base;
+        ioapic->inputs = ((ioapic_read(ioapic, IOAPIC_VER)>>16)&0xff)+1;
+        for (pin = 0; pin < ioapic->inputs; pin++) {
+            ioapic_write(ioapic, IOAPIC_REDTBL(pin), IOAPIC_MASKED);
+        }
+        ioapic_count++;
+    }
+
+    return ioapic_count;
+}
+
+/**
+ * @brief:          A function that switches interrupt delivery from the 8259
+ *                  to the APICs.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The function must run after init_acpi and before
+ *                  interrupts are enabled. The 8259 stays remapped to vectors
+ *                  32 - 47 by InitPIC, so even a spurious interrupt it might
+ *                  still raise cannot be taken for an exception.
+ */
+void init_apic(void)
+{
+    struct CpuidRegs regs;
+    uint64_t base;
+
+    read_cpuid(1, 0, &regs);
+    if ((regs.edx&(1<<9)) == 0) {
+        return;
+    }
+
+    if (regs.ecx & (1<<21)) {
+        apic_mode = APIC_MODE_X2APIC;
+    }
+    else {
+        base = APIC_BASE_ADDR(read_msr(IA32_APIC_BASE));
+        lapic_regs = (volatile uint32_t *)map_mmio(base, PAGE_SIZE);
+        if (lapic_regs == 0) {
+            return;
+        }
+        apic_mode = APIC_MODE_XAPIC;
+    }
+
+    if (init_ioapics() == 0) {
+        apic_mode = APIC_MODE_PIC;
+        return;
+    }
+
+    register_fast_irq_handler(SPURIOUS_VECTOR, lapic_spurious_handler, 0);
+    register_fast_irq_handler(ERROR_VECTOR, lapic_error_handler, 0);
+    init_lapic();
+
+    out_byte(PIC1_DATA, 0xff);
+    out_byte(PIC2_DATA, 0xff);
+    unregister_irq_handler(IRQ_BASE+7);
+
+    ioapic_route_irq(0, lapic_id());
+}
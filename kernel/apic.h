@@ -0,0 +1,186 @@
+/* -----------------------------------------------------------------------------
+ * @file:        apic.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the local APIC
+ *               and IOAPIC drivers.
+ *
+ *               The local APIC is used in x2APIC mode, where its registers
+ *               are MSRs, when CPUID reports it (leaf 1, ECX bit 21), and in
+ *               xAPIC mode through an uncached MMIO mapping otherwise. The
+ *               register numbers below are the xAPIC MMIO offsets, x2APIC MSR
+ *               0x800 + offset / 16 holds the same register.
+ *
+ *               External interrupts are routed through the IOAPICs listed in
+ *               the MADT. ISA IRQ n keeps the vector 32 + n it had on the
+ *               remapped 8259, which is masked once the IOAPICs are set up.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the local APIC and IOAPIC drivers.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Added the timer LVT modes and TIMER_VECTOR.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Added RESCHED_VECTOR.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Added TLB_VECTOR.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     Added PMU_VECTOR.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     Added enable_isa_irq.
+ *
+ *   - Revision 0.7: 10/14/2026 Marko Trickovic
+ *     Added AHCI_VECTOR.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _APIC_H_
+#define _APIC_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define LAPIC_ID            0x020
+#define LAPIC_VERSION       0x030
+#define LAPIC_TPR           0x080
+#define LAPIC_EOI           0x0b0
+#define LAPIC_SVR           0x0f0
+#define LAPIC_ESR           0x280
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_PERF      0x340
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_LVT_ERROR     0x370
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_COUNT   0x390
+#define LAPIC_TIMER_DIV     0x3e0
+
+#define LVT_MASKED          (1<<16)
+#define LVT_NMI             (4<<8)
+#define LVT_ONESHOT         (0<<17)
+#define LVT_PERIODIC        (1<<17)
+#define LVT_TSC_DEADLINE    (2<<17)
+
+#define TIMER_DIV_16        0x3
+
+#define ICR_INIT            (5<<8)
+#define ICR_STARTUP         (6<<8)
+#define ICR_PENDING         (1<<12)
+#define ICR_ASSERT          (1<<14)
+#define ICR_LEVEL           (1<<15)
+
+#define IOAPIC_LEVEL        (1<<15)
+#define IOAPIC_ACTIVE_LOW   (1<<13)
+
+#define IRQ_BASE            32
+#define AHCI_VECTOR         0xe0
+#define TIMER_VECTOR        0xf0
+#define RESCHED_VECTOR      0xf1
+#define TLB_VECTOR          0xf2
+#define PMU_VECTOR          0xf3
+#define ERROR_VECTOR        0xfe
+#define SPURIOUS_VECTOR     0xff
+
+#define APIC_MODE_PIC       0
+#define APIC_MODE_XAPIC     1
+#define APIC_MODE_X2APIC    2
+
+/**
+ * @fn:        init_apic(void)
+ *
+ * @brief:     Enables the local APIC of the boot CPU, masks all IOAPIC inputs,
+ *             routes the timer IRQ and masks the 8259.
+ */
+void init_apic(void);
+/**
+ * @fn:        init_lapic(void)
+ *
+ * @brief:     Enables and programs the local APIC of the calling CPU.
+ */
+void init_lapic(void);
+/**
+ * @fn:        get_apic_mode(void)
+ *
+ * @brief:     Returns APIC_MODE_PIC, APIC_MODE_XAPIC or APIC_MODE_X2APIC.
+ */
+int get_apic_mode(void);
+/**
+ * @fn:        lapic_read(uint32_t reg)
+ *
+ * @brief:     Reads a local APIC register.
+ */
+uint32_t lapic_read(uint32_t reg);
+/**
+ * @fn:        lapic_write(uint32_t reg, uint32_t value)
+ *
+ * @brief:     Writes a local APIC register.
+ */
+void lapic_write(uint32_t reg, uint32_t value);
+/**
+ * @fn:        lapic_id(void)
+ *
+ * @brief:     Returns the APIC ID of the calling CPU.
+ */
+uint32_t lapic_id(void);
+/**
+ * @fn:        lapic_send_ipi(uint32_t apic_id, uint32_t icr)
+ *
+ * @brief:     Sends an interprocessor interrupt. icr holds the vector and the
+ *             ICR_* delivery bits, and the function waits until the local
+ *             APIC has accepted it.
+ */
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr);
+/**
+ * @fn:        ioapic_route_gsi(uint32_t gsi, uint8_t vector,
+ *                              uint32_t apic_id, uint32_t flags)
+ *
+ * @brief:     Delivers a global system interrupt as vector to a CPU and
+ *             unmasks it. flags holds IOAPIC_LEVEL and IOAPIC_ACTIVE_LOW.
+ *
+ * @return:    0 on success, -1 if no IOAPIC has the input.
+ */
+int ioapic_route_gsi(uint32_t gsi, uint8_t vector, uint32_t apic_id,
+                     uint32_t flags);
+/**
+ * @fn:        ioapic_route_irq(uint8_t irq, uint32_t apic_id)
+ *
+ * @brief:     Delivers an ISA IRQ as vector IRQ_BASE + irq to a CPU, applying
+ *             the interrupt source overrides of the MADT.
+ *
+ * @return:    0 on success, -1 otherwise.
+ */
+int ioapic_route_irq(uint8_t irq, uint32_t apic_id);
+/**
+ * @fn:        ioapic_set_masked(uint32_t gsi, bool masked)
+ *
+ * @brief:     Masks or unmasks an IOAPIC input.
+ */
+void ioapic_set_masked(uint32_t gsi, bool masked);
+/**
+ * @fn:        irq_to_gsi(uint8_t irq)
+ *
+ * @brief:     Returns the global system interrupt of an ISA IRQ.
+ */
+uint32_t irq_to_gsi(uint8_t irq);
+/**
+ * @fn:        enable_isa_irq(uint8_t irq)
+ *
+ * @brief:     Delivers an ISA IRQ as vector IRQ_BASE + irq to the calling CPU,
+ *             through the IOAPIC or by unmasking it in the 8259. The handler
+ *             is registered first with register_irq_handler.
+ *
+ * @return:    0 on success, -1 otherwise.
+ */
+int enable_isa_irq(uint8_t irq);
+
+#endif
@@ -0,0 +1,418 @@
+/******************************************************************************
+ * @file:        ata.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the ATA PIO disk driver.
+ *
+ *               A PIO command moves one sector per interrupt through the
+ *               data port. For a read the drive raises IRQ14 once a sector
+ *               is in its buffer, for a write once it has taken a sector,
+ *               the first one of which is written when the command is
+ *               issued. The handler reads the status register, which
+ *               acknowledges the drive, and leaves the 256 port reads or
+ *               writes of the sector to a tasklet, so interrupts stay
+ *               enabled while the data moves.
+ *
+ *               The channel runs one command at a time, the queue depth is
+ *               one and the block layer keeps the other requests. A request
+ *               is at most 256 sectors, the most that a 28-bit command can
+ *               name, and LBA48 commands are only used where the drive has
+ *               more sectors than LBA28 reaches.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the ATA PIO driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "ata.h"
+#include "blk.h"
+#include "softirq.h"
+#include "apic.h"
+#include "trap.h"
+#include "printk.h"
+#include "string.h"
+#include "lib.h"
+
+#define ATA_BASE            0x1f0
+#define ATA_CTRL            0x3f6
+
+#define ATA_DATA            0
+#define ATA_ERROR           1
+#define ATA_COUNT           2
+#define ATA_LBA0            3
+#define ATA_LBA1            4
+#define ATA_LBA2            5
+#define ATA_DEVICE          6
+#define ATA_STATUS          7
+#define ATA_COMMAND         7
+
+#define ATA_STATUS_ERR      0x01
+#define ATA_STATUS_DRQ      0x08
+#define ATA_STATUS_DF       0x20
+#define ATA_STATUS_BSY      0x80
+
+#define ATA_CTRL_NIEN       0x02
+#define ATA_DEVICE_MASTER   0xa0
+#define ATA_DEVICE_LBA      0x40
+
+#define ATA_CMD_READ        0x20
+#define ATA_CMD_READ_EXT    0x24
+#define ATA_CMD_WRITE       0x30
+#define ATA_CMD_WRITE_EXT   0x34
+#define ATA_CMD_IDENTIFY    0xec
+
+#define ATA_ID_SECTORS      60
+#define ATA_ID_FEATURES     83
+#define ATA_ID_SECTORS48    100
+#define ATA_ID_LBA48        (1<<10)
+
+#define ATA_MAX_SECTORS     256
+#define ATA_LBA28_LIMIT     (1UL<<28)
+#define ATA_TIMEOUT         1000000
+#define ATA_SECTOR_WORDS    (SECTOR_SIZE/2)
+
+/**
+ * @brief:                The drive and the command in flight.
+ *
+ * @struct:               AtaDrive
+ *
+ * @param:     dev        The block device
+ * @param:     lba48      Whether the commands use 48-bit sector numbers
+ * @param:     req        The request in flight, or 0
+ * @param:     bio        The Bio of the next sector
+ * @param:     offset     The sectors of bio already moved
+ * @param:     left       The sectors of req not yet moved
+ * @param:     status     The status read by the last interrupt
+ * @param:     tasklet    Moves the data after an interrupt
+ */
+struct AtaDrive {
+    struct BlkDev dev;
+    bool lba48;
+    struct BlkRequest *volatile req;
+    struct Bio *bio;
+    uint32_t offset;
+    uint32_t left;
+    uint8_t status;
+    struct Tasklet tasklet;
+};
+
+static struct AtaDrive ata0;
+
+/**
+ * @brief:      Waits 400 ns by reading the alternate status register, for
+ *              the status to become valid after a device select.
+ */
+static void ata_delay(void)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        in_byte(ATA_CTRL);
+    }
+}
+
+/**
+ * @brief:      Waits until the drive is not busy and returns its status,
+ *              or 0xff on timeout.
+ */
+static uint8_t wait_not_busy(void)
+{
+    uint8_t status;
+    uint32_t i;
+
+    for (i = 0; i < ATA_TIMEOUT; i++) {
+        status = in_byte(ATA_BASE+ATA_STATUS);
+        if ((status&ATA_STATUS_BSY) == 0) {
+            return status;
+        }
+        cpu_relax();
+    }
+
+    return 0xff;
+}
+
+/**
+ * @brief:      Waits until the drive wants data, false on error or timeout.
+ */
+static bool wait_drq(void)
+{
+    uint8_t status = wait_not_busy();
+
+    return status != 0xff &&
+           (status&(ATA_STATUS_ERR|ATA_STATUS_DF|ATA_STATUS_DRQ)) ==
+           ATA_STATUS_DRQ;
+}
+
+/**
+ * @brief:      Moves the next sector between the data port and the Bio.
+ */
+static void move_sector(struct AtaDrive *drive, bool write)
+{
+    uint8_t *p = (uint8_t *)drive->bio->buf+
+                 ((uint64_t)drive->offset<<SECTOR_SHIFT);
+
+    if (write) {
+        out_words(ATA_BASE+ATA_DATA, p, ATA_SECTOR_WORDS);
+    }
+    else {
+        in_words(ATA_BASE+ATA_DATA, p, ATA_SECTOR_WORDS);
+    }
+
+    drive->left--;
+    if (++drive->offset == drive->bio->count) {
+        drive->bio = drive->bio->next;
+        drive->offset = 0;
+    }
+}
+
+/**
+ * @brief:          A function that issues a request.
+ *
+ * @param:          dev  the block device
+ * @param:          req  the request
+ *
+ * @return:         BLK_OK, or BLK_EIO if the drive does not take it.
+ *
+ * @description:    The registers that take the high bytes of an LBA48
+ *                  command are written first, each register keeps the last
+ *                  two bytes written to it. A write waits for the drive to
+ *                  ask for the first sector, which takes microseconds.
+ */
+static int ata_start(struct BlkDev *dev, struct BlkRequest *req)
+{
+    struct AtaDrive *drive = dev->priv;
+    uint64_t lba = req->sector;
+    uint8_t command;
+
+    if (wait_not_busy() == 0xff) {
+        return BLK_EIO;
+    }
+
+    drive->bio = req->head;
+    drive->offset = 0;
+    drive->left = req->count;
+    drive->req = req;
+
+    if (drive->lba48) {
+        out_byte(ATA_BASE+ATA_DEVICE, ATA_DEVICE_MASTER|ATA_DEVICE_LBA);
+        out_byte(ATA_BASE+ATA_COUNT, (uint8_t)(req->count>>8));
+        out_byte(ATA_BASE+ATA_LBA0, (uint8_t)(lba>>24));
+        out_byte(ATA_BASE+ATA_LBA1, (uint8_t)(lba>>32));
+        out_byte(ATA_BASE+ATA_LBA2, (uint8_t)(lba>>40));
+        command = req->write ? ATA_CMD_WRITE_EXT : ATA_CMD_READ_EXT;
+    }
+    else {
+        out_byte(ATA_BASE+ATA_DEVICE, (uint8_t)(ATA_DEVICE_MASTER|
+                 ATA_DEVICE_LBA|((lba>>24)&0x0f)));
+        command = req->write ? ATA_CMD_WRITE : ATA_CMD_READ;
+    }
+    out_byte(ATA_BASE+ATA_COUNT, (uint8_t)req->count);
+    out_byte(ATA_BASE+ATA_LBA0, (uint8_t)lba);
+    out_byte(ATA_BASE+ATA_LBA1, (uint8_t)(lba>>8));
+    out_byte(ATA_BASE+ATA_LBA2, (uint8_t)(lba>>16));
+    out_byte(ATA_BASE+ATA_COMMAND, command);
+
+    if (req->write) {
+        if (!wait_drq()) {
+            drive->req = 0;
+            return BLK_EIO;
+        }
+        move_sector(drive, true);
+    }
+
+    return BLK_OK;
+}
+
+/**
+ * @brief:      Ends the request in flight.
+ */
+static void ata_finish(struct AtaDrive *drive, int status)
+{
+    struct BlkRequest *req = drive->req;
+
+    drive->req = 0;
+    blk_complete(&drive->dev, req, status);
+}
+
+/**
+ * @brief:          The tasklet that continues the request after IRQ14.
+ *
+ * @param:          ctx  the drive
+ *
+ * @return:         None
+ *
+ * @description:    A read has a sector ready, a write has taken one. The
+ *                  interrupt after the last sector of a write ends the
+ *                  request, after the last sector of a read none follows.
+ */
+static void ata_work(void *ctx)
+{
+    struct AtaDrive *drive = ctx;
+    struct BlkRequest *req = drive->req;
+
+    if (req == 0) {
+        return;
+    }
+
+    if ((drive->status&(ATA_STATUS_ERR|ATA_STATUS_DF)) != 0) {
+        printk("ata: %s of sector %lu failed, error %x\n",
+               req->write ? "write" : "read", req->sector,
+               in_byte(ATA_BASE+ATA_ERROR));
+        ata_finish(drive, BLK_EIO);
+        return;
+    }
+
+    if (req->write) {
+        if (drive->left == 0) {
+            ata_finish(drive, BLK_OK);
+        }
+        else if (!wait_drq()) {
+            ata_finish(drive, BLK_EIO);
+        }
+        else {
+            move_sector(drive, true);
+        }
+        return;
+    }
+
+    if ((drive->status&ATA_STATUS_DRQ) == 0) {
+        ata_finish(drive, BLK_EIO);
+        return;
+    }
+    move_sector(drive, false);
+    if (drive->left == 0) {
+        ata_finish(drive, BLK_OK);
+    }
+}
+
+/**
+ * @brief:      The handler of IRQ14.
+ */
+static void ata_interrupt(struct TrapFrame *tf, void *ctx)
+{
+    struct AtaDrive *drive = ctx;
+    uint8_t status = in_byte(ATA_BASE+ATA_STATUS);
+
+    if (drive->req != 0) {
+        drive->status = status;
+        tasklet_schedule(&drive->tasklet);
+    }
+    eoi();
+}
+
+/**
+ * @brief:          A function that reads the IDENTIFY data of the drive.
+ *
+ * @param:          id  the buffer of 256 words
+ *
+ * @return:         Whether an ATA drive answered.
+ *
+ * @description:    A status of 0xff is a floating bus without a controller,
+ *                  0 after the command is a channel without the drive. An
+ *                  ATAPI drive aborts the command and sets the signature in
+ *                  the LBA registers.
+ */
+static bool ata_identify(uint16_t *id)
+{
+    uint8_t status;
+
+    if (in_byte(ATA_BASE+ATA_STATUS) == 0xff) {
+        return false;
+    }
+
+    out_byte(ATA_BASE+ATA_DEVICE, ATA_DEVICE_MASTER);
+    ata_delay();
+    out_byte(ATA_BASE+ATA_COUNT, 0);
+    out_byte(ATA_BASE+ATA_LBA0, 0);
+    out_byte(ATA_BASE+ATA_LBA1, 0);
+    out_byte(ATA_BASE+ATA_LBA2, 0);
+    out_byte(ATA_BASE+ATA_COMMAND, ATA_CMD_IDENTIFY);
+    ata_delay();
+
+    status = in_byte(ATA_BASE+ATA_STATUS);
+    if (status == 0 || status == 0xff) {
+        return false;
+    }
+    if (wait_not_busy() == 0xff) {
+        return false;
+    }
+    if (in_byte(ATA_BASE+ATA_LBA1) != 0 || in_byte(ATA_BASE+ATA_LBA2) != 0) {
+        return false;
+    }
+    if (!wait_drq()) {
+        return false;
+    }
+
+    in_words(ATA_BASE+ATA_DATA, id, ATA_SECTOR_WORDS);
+    return true;
+}
+
+static const struct BlkOps ata_ops = {
+    .start = ata_start,
+};
+
+/**
+ * @brief:          A function that sets up the primary master drive.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The drive interrupt is disabled with nIEN while the
+ *                  driver probes, and enabled once the handler is in place.
+ *                  Without IRQ14 the drive is left unused.
+ */
+void init_ata(void)
+{
+    struct AtaDrive *drive = &ata0;
+    uint16_t id[ATA_SECTOR_WORDS];
+    uint64_t sectors;
+
+    out_byte(ATA_CTRL, ATA_CTRL_NIEN);
+
+    if (!ata_identify(id)) {
+        printk("ata: no primary master drive\n");
+        return;
+    }
+
+    sectors = id[ATA_ID_SECTORS]|((uint32_t)id[ATA_ID_SECTORS+1]<<16);
+    if ((id[ATA_ID_FEATURES]&ATA_ID_LBA48) != 0) {
+        sectors = (uint64_t)id[ATA_ID_SECTORS48]|
+                  ((uint64_t)id[ATA_ID_SECTORS48+1]<<16)|
+                  ((uint64_t)id[ATA_ID_SECTORS48+2]<<32)|
+                  ((uint64_t)id[ATA_ID_SECTORS48+3]<<48);
+        drive->lba48 = sectors > ATA_LBA28_LIMIT;
+    }
+    else if (sectors > ATA_LBA28_LIMIT) {
+        sectors = ATA_LBA28_LIMIT;
+    }
+
+    memcpy(drive->dev.name, "ata0", 5);
+    drive->dev.sectors = sectors;
+    drive->dev.max_sectors = ATA_MAX_SECTORS;
+    drive->dev.max_segments = ATA_MAX_SECTORS;
+    drive->dev.queue_depth = 1;
+    drive->dev.ops = &ata_ops;
+    drive->dev.priv = drive;
+
+    tasklet_init(&drive->tasklet, ata_work, drive);
+    register_irq_handler(IRQ_BASE+ATA_IRQ, ata_interrupt, drive);
+
+    in_byte(ATA_BASE+ATA_STATUS);
+    out_byte(ATA_CTRL, 0);
+
+    if (enable_isa_irq(ATA_IRQ) != 0) {
+        out_byte(ATA_CTRL, ATA_CTRL_NIEN);
+        unregister_irq_handler(IRQ_BASE+ATA_IRQ);
+        printk("ata: IRQ%u not available\n", ATA_IRQ);
+        return;
+    }
+
+    blk_register(&drive->dev);
+}
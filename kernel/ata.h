@@ -0,0 +1,39 @@
+/* -----------------------------------------------------------------------------
+ * @file:        ata.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the ATA PIO
+ *               disk driver.
+ *
+ *               The driver serves the master drive of the primary IDE
+ *               channel as the block device ata0, which every PC emulator
+ *               provides. It moves the data with the CPU, one command at a
+ *               time, and is the fallback where there is no AHCI
+ *               controller.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the ATA PIO driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _ATA_H_
+#define _ATA_H_
+
+#include "stdint.h"
+
+#define ATA_IRQ             14
+
+/**
+ * @fn:        init_ata(void)
+ *
+ * @brief:     Identifies the primary master drive, routes IRQ14 and
+ *             registers the drive as ata0. Must run after init_blk, init_apic
+ *             and init_softirq.
+ */
+void init_ata(void);
+
+#endif
@@ -0,0 +1,681 @@
+/******************************************************************************
+ * @file:        bcache.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the block buffer cache.
+ *
+ *               A block is found through a hash table keyed by its device
+ *               and number, so repeated reads of a block, in any order, are
+ *               served from memory. All blocks are also on one ring that
+ *               the CLOCK hand sweeps when the cache is full:
+ *
+ *                  - A read sets BUF_REF. The hand clears it and passes the
+ *                    block, and takes the first block it finds without it,
+ *                    so a block that is used again gets a second sweep.
+ *
+ *                  - Pinned blocks, blocks with I/O in flight and dirty
+ *                    blocks are passed. Finding dirty blocks wakes the
+ *                    writeback task, a reader that finds no block waits
+ *                    for it.
+ *
+ *               Up to BCACHE_MAX_BUFS blocks are allocated from the frame
+ *               allocator as they are needed, and then reused.
+ *
+ *               The cache follows the last block read of each device. A
+ *               read of the block after it starts a read-ahead window of
+ *               BCACHE_RA_MIN blocks, which doubles up to BCACHE_RA_MAX
+ *               each time the reader has used half of it, and any other
+ *               read ends the window. The blocks of a window are queued at
+ *               once and the block layer merges them into one request, so
+ *               a sequential reader such as one of the kernel in the boot
+ *               image, which follows the loader from sector 6 on, finds
+ *               its blocks in memory.
+ *
+ *               Writes only mark the blocks dirty. The writeback task
+ *               writes all dirty blocks every BCACHE_FLUSH_NS, or as soon
+ *               as BCACHE_DIRTY_HIGH are dirty, in batches of
+ *               BCACHE_FLUSH_BATCH whose adjacent blocks the block layer
+ *               merges as well. A block written again while its writeback
+ *               is in flight is marked dirty again and written once more.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the buffer cache.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "bcache.h"
+#include "slab.h"
+#include "sched.h"
+#include "sync.h"
+#include "printk.h"
+#include "string.h"
+
+#define BCACHE_FLUSH_PRIO   SCHED_DEFAULT_PRIO
+
+/**
+ * @brief:                A task waiting for the read of a block.
+ *
+ * @struct:               BufWaiter
+ *
+ * @param:     next       The next waiter of the block
+ * @param:     task       The task
+ * @param:     done       Set once the read has ended
+ */
+struct BufWaiter {
+    struct BufWaiter *next;
+    struct Task *task;
+    uint32_t done;
+};
+
+/**
+ * @brief:                A task waiting for a batch of writebacks.
+ *
+ * @struct:               FlushWait
+ *
+ * @param:     task       The task
+ * @param:     pending    The number of blocks not yet written
+ * @param:     status     BLK_OK or BLK_EIO
+ */
+struct FlushWait {
+    struct Task *task;
+    uint32_t pending;
+    int status;
+};
+
+/**
+ * @brief:                The read-ahead state of a device.
+ *
+ * @struct:               Stream
+ *
+ * @param:     dev        The device
+ * @param:     next       The block after the last one read
+ * @param:     ahead      The first block not yet read ahead
+ * @param:     window     The number of blocks to keep ahead, 0 if the
+ *                        reads are not sequential
+ */
+struct Stream {
+    struct BlkDev *dev;
+    uint64_t next;
+    uint64_t ahead;
+    uint32_t window;
+};
+
+static struct Spinlock bcache_lock = SPINLOCK_INIT;
+static struct KmemCache *buf_cache;
+static struct Buf *hash_table[1U<<BCACHE_HASH_SHIFT];
+static struct Buf *clock_hand;
+static struct Stream streams[BCACHE_STREAMS];
+static uint32_t stream_victim;
+static struct Task *flush_task;
+static struct BcacheStats stats;
+
+/**
+ * @brief:      Returns the number of blocks of a device, the last one may
+ *              be partial.
+ */
+static uint64_t dev_blocks(struct BlkDev *dev)
+{
+    return (dev->sectors+BCACHE_BLOCK_SECTORS-1)/BCACHE_BLOCK_SECTORS;
+}
+
+/**
+ * @brief:      Returns the hash chain of a block.
+ */
+static struct Buf **hash_chain(struct BlkDev *dev, uint64_t block)
+{
+    uint64_t key = (((uint64_t)dev>>6)+block)*0x9e3779b97f4a7c15UL;
+
+    return &hash_table[key>>(64-BCACHE_HASH_SHIFT)];
+}
+
+/**
+ * @brief:      Finds a cached block.
+ */
+static struct Buf *lookup(struct BlkDev *dev, uint64_t block)
+{
+    struct Buf *buf;
+
+    for (buf = *hash_chain(dev, block); buf != 0; buf = buf->hash_next) {
+        if (buf->dev == dev && buf->block == block) {
+            return buf;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief:      Removes a block from its hash chain.
+ */
+static void hash_remove(struct Buf *buf)
+{
+    struct Buf **link = hash_chain(buf->dev, buf->block);
+
+    while (*link != buf) {
+        link = &(*link)->hash_next;
+    }
+    *link = buf->hash_next;
+}
+
+/**
+ * @brief:      Allocates a new block and puts it on the ring behind the
+ *              hand.
+ */
+static struct Buf *new_buf(void)
+{
+    struct Buf *buf = kmem_cache_alloc(buf_cache);
+    uint64_t frame;
+
+    if (buf == 0) {
+        return 0;
+    }
+    frame = alloc_frame();
+    if (frame == 0) {
+        kmem_cache_free(buf_cache, buf);
+        return 0;
+    }
+    buf->data = (void *)P2V(frame);
+
+    if (clock_hand == 0) {
+        buf->clock_next = buf;
+        clock_hand = buf;
+    }
+    else {
+        buf->clock_next = clock_hand->clock_next;
+        clock_hand->clock_next = buf;
+        clock_hand = buf;
+    }
+    stats.buffers++;
+
+    return buf;
+}
+
+/**
+ * @brief:          A function that finds a block to reuse.
+ *
+ * @param:          None
+ *
+ * @return:         The block, taken off its hash chain, or 0.
+ *
+ * @description:    Two sweeps clear every BUF_REF on the way, so a block
+ *                  that can be reused is found if there is one.
+ */
+static struct Buf *evict(void)
+{
+    uint32_t n = 2*stats.buffers;
+    struct Buf *buf;
+    bool dirty = false;
+
+    while (n-- > 0) {
+        buf = clock_hand = clock_hand->clock_next;
+
+        if ((buf->flags&BUF_DIRTY) != 0) {
+            dirty = true;
+        }
+        if (buf->pins != 0 || (buf->flags&(BUF_IO|BUF_DIRTY)) != 0) {
+            continue;
+        }
+        if ((buf->flags&BUF_REF) != 0) {
+            buf->flags &= ~BUF_REF;
+            continue;
+        }
+
+        hash_remove(buf);
+        return buf;
+    }
+
+    if (dirty && flush_task != 0) {
+        sched_wakeup(flush_task);
+    }
+    return 0;
+}
+
+/**
+ * @brief:      Takes a new or reused block for dev and block and hashes it.
+ *              Its data is not valid.
+ */
+static struct Buf *get_buf(struct BlkDev *dev, uint64_t block)
+{
+    struct Buf *buf = 0;
+
+    if (stats.buffers < BCACHE_MAX_BUFS) {
+        buf = new_buf();
+    }
+    if (buf == 0 && stats.buffers != 0) {
+        buf = evict();
+    }
+    if (buf == 0) {
+        return 0;
+    }
+
+    buf->dev = dev;
+    buf->block = block;
+    buf->flags = 0;
+    buf->pins = 0;
+    buf->waiters = 0;
+    buf->flush = 0;
+
+    buf->hash_next = *hash_chain(dev, block);
+    *hash_chain(dev, block) = buf;
+
+    return buf;
+}
+
+/**
+ * @brief:      Wakes the tasks of a waiter list. The task and the next
+ *              waiter are read first, a waiter is gone once done is set.
+ */
+static void wake_waiters(struct BufWaiter *waiter)
+{
+    struct BufWaiter *next;
+    struct Task *task;
+
+    while (waiter != 0) {
+        next = waiter->next;
+        task = waiter->task;
+        __atomic_store_n(&waiter->done, 1, __ATOMIC_RELEASE);
+        sched_wakeup(task);
+        waiter = next;
+    }
+}
+
+/**
+ * @brief:      The done function of a block read.
+ */
+static void read_done(struct Bio *bio)
+{
+    struct Buf *buf = bio->ctx;
+    struct BufWaiter *waiters;
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+
+    buf->flags &= ~BUF_IO;
+    buf->flags |= bio->status == BLK_OK ? BUF_VALID : BUF_ERROR;
+    waiters = buf->waiters;
+    buf->waiters = 0;
+
+    spin_unlock_irqrestore(&bcache_lock, flags);
+
+    if (bio->status != BLK_OK) {
+        printk("bcache: read of block %lu of %s failed\n", buf->block,
+               buf->dev->name);
+    }
+    wake_waiters(waiters);
+}
+
+/**
+ * @brief:      The done function of a block writeback.
+ */
+static void write_done(struct Bio *bio)
+{
+    struct Buf *buf = bio->ctx;
+    struct FlushWait *wait;
+    struct Task *task = 0;
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+
+    buf->flags &= ~BUF_IO;
+    if (bio->status != BLK_OK) {
+        buf->flags |= BUF_ERROR;
+    }
+    wait = buf->flush;
+    buf->flush = 0;
+    stats.writebacks++;
+
+    spin_unlock_irqrestore(&bcache_lock, flags);
+
+    if (bio->status != BLK_OK) {
+        printk("bcache: write of block %lu of %s failed\n", buf->block,
+               buf->dev->name);
+    }
+    if (wait != 0) {
+        task = wait->task;
+        if (bio->status != BLK_OK) {
+            wait->status = BLK_EIO;
+        }
+        if (__atomic_sub_fetch(&wait->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+            sched_wakeup(task);
+        }
+    }
+}
+
+/**
+ * @brief:      Submits the I/O of a block marked BUF_IO. The last block of
+ *              a device may have fewer sectors, the rest of its page reads
+ *              as zeroes.
+ */
+static void start_io(struct Buf *buf, bool write)
+{
+    struct BlkDev *dev = buf->dev;
+    uint64_t sector = buf->block*BCACHE_BLOCK_SECTORS;
+    uint32_t count = BCACHE_BLOCK_SECTORS;
+
+    if (dev->sectors-sector < count) {
+        count = (uint32_t)(dev->sectors-sector);
+        if (!write) {
+            memset(buf->data, 0, BCACHE_BLOCK_SIZE);
+        }
+    }
+
+    buf->bio.next = 0;
+    buf->bio.sector = sector;
+    buf->bio.count = count;
+    buf->bio.write = write;
+    buf->bio.buf = buf->data;
+    buf->bio.done = write ? write_done : read_done;
+    buf->bio.ctx = buf;
+    blk_submit(dev, &buf->bio);
+}
+
+/**
+ * @brief:          A function that chooses the blocks to read ahead.
+ *
+ * @param:          dev    the device
+ * @param:          block  the block being read
+ * @param:          ra     the blocks to read, at most BCACHE_RA_MAX
+ *
+ * @return:         The number of blocks in ra, marked BUF_IO.
+ *
+ * @description:    Once fewer than half of the window are ahead of the
+ *                  reader the window doubles and is filled up again, so the
+ *                  reads ahead go out in batches rather than one block per
+ *                  read.
+ */
+static uint32_t readahead(struct BlkDev *dev, uint64_t block,
+                          struct Buf **ra)
+{
+    struct Stream *stream = 0;
+    struct Buf *buf;
+    uint64_t end, b;
+    uint32_t i, n = 0;
+
+    for (i = 0; i < BCACHE_STREAMS; i++) {
+        if (streams[i].dev == dev) {
+            stream = &streams[i];
+            break;
+        }
+    }
+    if (stream == 0) {
+        stream = &streams[stream_victim++%BCACHE_STREAMS];
+        stream->dev = dev;
+        stream->next = ~0UL;
+    }
+
+    if (block != stream->next) {
+        stream->next = block+1;
+        stream->ahead = block+1;
+        stream->window = 0;
+        return 0;
+    }
+
+    stream->next = block+1;
+    if (stream->ahead < block+1) {
+        stream->ahead = block+1;
+    }
+    if (stream->window == 0) {
+        stream->window = BCACHE_RA_MIN;
+    }
+    else if (stream->ahead-(block+1) > stream->window/2) {
+        return 0;
+    }
+    else if (stream->window < BCACHE_RA_MAX) {
+        stream->window *= 2;
+    }
+
+    end = block+1+stream->window;
+    if (end > dev_blocks(dev)) {
+        end = dev_blocks(dev);
+    }
+    for (b = stream->ahead; b < end; b++) {
+        if (lookup(dev, b) != 0) {
+            continue;
+        }
+        buf = get_buf(dev, b);
+        if (buf == 0) {
+            break;
+        }
+        buf->flags = BUF_IO;
+        ra[n++] = buf;
+        stats.readaheads++;
+    }
+    stream->ahead = b;
+
+    return n;
+}
+
+/**
+ * @brief:          A function that starts the writeback of dirty blocks.
+ *
+ * @param:          dev   the device, or 0 for all devices
+ * @param:          wait  counts the blocks
+ * @param:          busy  set if writebacks of dev by another task are in
+ *                        flight
+ *
+ * @return:         The number of blocks submitted, at most
+ *                  BCACHE_FLUSH_BATCH.
+ */
+static uint32_t flush_batch(struct BlkDev *dev, struct FlushWait *wait,
+                            bool *busy)
+{
+    struct Buf *list[BCACHE_FLUSH_BATCH];
+    struct Buf *buf;
+    uint32_t i, n = 0;
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+
+    *busy = false;
+    buf = clock_hand;
+    for (i = 0; i < stats.buffers && n < BCACHE_FLUSH_BATCH; i++) {
+        buf = buf->clock_next;
+        if (dev != 0 && buf->dev != dev) {
+            continue;
+        }
+        if ((buf->flags&BUF_IO) != 0) {
+            *busy |= buf->bio.write;
+            continue;
+        }
+        if ((buf->flags&BUF_DIRTY) == 0) {
+            continue;
+        }
+
+        buf->flags = (buf->flags&~(BUF_DIRTY|BUF_ERROR))|BUF_IO;
+        buf->flush = wait;
+        stats.dirty--;
+        list[n++] = buf;
+    }
+    __atomic_add_fetch(&wait->pending, n, __ATOMIC_RELEASE);
+
+    spin_unlock_irqrestore(&bcache_lock, flags);
+
+    for (i = 0; i < n; i++) {
+        start_io(list[i], true);
+    }
+
+    return n;
+}
+
+/**
+ * @brief:      Writes back the dirty blocks of dev batch by batch and waits
+ *              for the writebacks of other tasks.
+ */
+static int writeback(struct BlkDev *dev)
+{
+    struct FlushWait wait;
+    int status = BLK_OK;
+    bool busy;
+
+    while (1) {
+        wait.task = current_task();
+        wait.pending = 0;
+        wait.status = BLK_OK;
+
+        if (flush_batch(dev, &wait, &busy) != 0) {
+            while (__atomic_load_n(&wait.pending, __ATOMIC_ACQUIRE) != 0) {
+                sched_block();
+            }
+            if (wait.status != BLK_OK) {
+                status = BLK_EIO;
+            }
+            continue;
+        }
+
+        if (!busy) {
+            return status;
+        }
+        task_sleep(BCACHE_RETRY_NS);
+    }
+}
+
+/**
+ * @brief:      The writeback task. A sched_wakeup ends its sleep early.
+ */
+static void flush_main(void *arg)
+{
+    while (1) {
+        task_sleep(BCACHE_FLUSH_NS);
+        writeback(0);
+    }
+}
+
+/**
+ * @brief:      Creates the descriptor cache and the writeback task.
+ */
+void init_bcache(void)
+{
+    buf_cache = kmem_cache_create("buf", sizeof(struct Buf), 0, 0);
+    flush_task = task_create("bflush", flush_main, 0, BCACHE_FLUSH_PRIO);
+    if (buf_cache == 0 || flush_task == 0) {
+        printk("bcache: cannot start\n");
+        while (1) { }
+    }
+}
+
+/**
+ * @brief:          A function that returns a block pinned.
+ *
+ * @param:          dev    the device
+ * @param:          block  the block number
+ *
+ * @return:         The block, or 0.
+ *
+ * @description:    A block whose read is in flight, by this call or an
+ *                  earlier one, is waited for. A block whose read failed
+ *                  is read again. The read of the block is submitted before
+ *                  its read-ahead, the queue starts it first.
+ */
+struct Buf *bcache_read(struct BlkDev *dev, uint64_t block)
+{
+    struct Buf *ra[BCACHE_RA_MAX];
+    struct BufWaiter waiter;
+    struct Buf *buf;
+    bool read = false, wait = false;
+    uint32_t i, n;
+    uint64_t flags;
+
+    if (block >= dev_blocks(dev)) {
+        return 0;
+    }
+
+    flags = spin_lock_irqsave(&bcache_lock);
+
+    while ((buf = lookup(dev, block)) == 0 &&
+           (buf = get_buf(dev, block)) == 0) {
+        spin_unlock_irqrestore(&bcache_lock, flags);
+        task_sleep(BCACHE_RETRY_NS);
+        flags = spin_lock_irqsave(&bcache_lock);
+    }
+
+    buf->pins++;
+    buf->flags |= BUF_REF;
+    if ((buf->flags&BUF_VALID) != 0) {
+        stats.hits++;
+    }
+    else {
+        if ((buf->flags&BUF_IO) == 0) {
+            buf->flags = (buf->flags&~BUF_ERROR)|BUF_IO;
+            stats.misses++;
+            read = true;
+        }
+        waiter.task = current_task();
+        waiter.done = 0;
+        waiter.next = buf->waiters;
+        buf->waiters = &waiter;
+        wait = true;
+    }
+    n = readahead(dev, block, ra);
+
+    spin_unlock_irqrestore(&bcache_lock, flags);
+
+    if (read) {
+        start_io(buf, false);
+    }
+    for (i = 0; i < n; i++) {
+        start_io(ra[i], false);
+    }
+
+    if (wait) {
+        while (__atomic_load_n(&waiter.done, __ATOMIC_ACQUIRE) == 0) {
+            sched_block();
+        }
+        if ((buf->flags&BUF_VALID) == 0) {
+            bcache_release(buf);
+            return 0;
+        }
+    }
+
+    return buf;
+}
+
+/**
+ * @brief:      Unpins a block.
+ */
+void bcache_release(struct Buf *buf)
+{
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+
+    buf->pins--;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+}
+
+/**
+ * @brief:      Marks a block dirty and wakes the writeback task once
+ *              enough blocks are dirty.
+ */
+void bcache_mark_dirty(struct Buf *buf)
+{
+    bool kick = false;
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+
+    if ((buf->flags&BUF_DIRTY) == 0) {
+        buf->flags |= BUF_DIRTY;
+        kick = ++stats.dirty >= BCACHE_DIRTY_HIGH;
+    }
+
+    spin_unlock_irqrestore(&bcache_lock, flags);
+
+    if (kick) {
+        sched_wakeup(flush_task);
+    }
+}
+
+/**
+ * @brief:      Writes back the dirty blocks of a device and waits.
+ */
+int bcache_sync(struct BlkDev *dev)
+{
+    return writeback(dev);
+}
+
+/**
+ * @brief:      Copies the counters.
+ */
+void bcache_stats(struct BcacheStats *out)
+{
+    uint64_t flags = spin_lock_irqsave(&bcache_lock);
+
+    *out = stats;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+}
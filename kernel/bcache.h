@@ -0,0 +1,151 @@
+/* -----------------------------------------------------------------------------
+ * @file:        bcache.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the block
+ *               buffer cache.
+ *
+ *               The cache holds blocks of one page, BCACHE_BLOCK_SECTORS
+ *               sectors of a block device, in frames of the frame
+ *               allocator. A reader pins a block with bcache_read, which
+ *               only goes to the disk on a miss, and unpins it with
+ *               bcache_release. A writer changes the data of a pinned
+ *               block and calls bcache_mark_dirty, the block is written
+ *               back later together with other dirty blocks, or by
+ *               bcache_sync.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the buffer cache.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _BCACHE_H_
+#define _BCACHE_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "blk.h"
+#include "memory.h"
+#include "clock.h"
+
+#define BCACHE_BLOCK_SIZE    PAGE_SIZE
+#define BCACHE_BLOCK_SECTORS (BCACHE_BLOCK_SIZE/SECTOR_SIZE)
+
+#define BCACHE_MAX_BUFS     1024
+#define BCACHE_HASH_SHIFT   10
+#define BCACHE_STREAMS      8
+#define BCACHE_RA_MIN       4
+#define BCACHE_RA_MAX       32
+#define BCACHE_DIRTY_HIGH   256
+#define BCACHE_FLUSH_BATCH  64
+#define BCACHE_FLUSH_NS     (5000*NSEC_PER_MSEC)
+#define BCACHE_RETRY_NS     NSEC_PER_MSEC
+
+#define BUF_VALID           (1U<<0)
+#define BUF_DIRTY           (1U<<1)
+#define BUF_IO              (1U<<2)
+#define BUF_REF             (1U<<3)
+#define BUF_ERROR           (1U<<4)
+
+struct BufWaiter;
+struct FlushWait;
+
+/**
+ * @brief:                A cached block.
+ *
+ * @struct:               Buf
+ *
+ * @param:     hash_next  The next block of the hash chain
+ * @param:     clock_next The next block of the CLOCK ring
+ * @param:     dev        The device
+ * @param:     block      The block number
+ * @param:     data       The data, one page
+ * @param:     flags      BUF_VALID, BUF_DIRTY, BUF_IO, BUF_REF, BUF_ERROR
+ * @param:     pins       The number of bcache_read without bcache_release
+ * @param:     waiters    The tasks waiting for the read in flight
+ * @param:     flush      The writeback that waits for this block, or 0
+ * @param:     bio        The Bio of the I/O in flight
+ */
+struct Buf {
+    struct Buf *hash_next;
+    struct Buf *clock_next;
+    struct BlkDev *dev;
+    uint64_t block;
+    void *data;
+    uint32_t flags;
+    uint32_t pins;
+    struct BufWaiter *waiters;
+    struct FlushWait *flush;
+    struct Bio bio;
+};
+
+/**
+ * @brief:                The counters of the cache.
+ *
+ * @struct:               BcacheStats
+ *
+ * @param:     hits       Reads that found the block
+ * @param:     misses     Reads that went to the disk
+ * @param:     readaheads Blocks read before they were asked for
+ * @param:     writebacks Blocks written back
+ * @param:     buffers    The number of blocks in the cache
+ * @param:     dirty      The number of dirty blocks
+ */
+struct BcacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t readaheads;
+    uint64_t writebacks;
+    uint32_t buffers;
+    uint32_t dirty;
+};
+
+/**
+ * @fn:        init_bcache(void)
+ *
+ * @brief:     Creates the cache of the block descriptors and starts the
+ *             writeback task. Must run after init_blk and init_sched.
+ */
+void init_bcache(void);
+/**
+ * @fn:        bcache_read(struct BlkDev *dev, uint64_t block)
+ *
+ * @brief:     Returns the block pinned, reading it if it is not cached.
+ *             Must be called from task context.
+ *
+ * @return:    The block, or 0 if it is beyond the device or cannot be read.
+ */
+struct Buf *bcache_read(struct BlkDev *dev, uint64_t block);
+/**
+ * @fn:        bcache_release(struct Buf *buf)
+ *
+ * @brief:     Unpins a block returned by bcache_read.
+ */
+void bcache_release(struct Buf *buf);
+/**
+ * @fn:        bcache_mark_dirty(struct Buf *buf)
+ *
+ * @brief:     Marks a pinned block for writeback after its data changed.
+ */
+void bcache_mark_dirty(struct Buf *buf);
+/**
+ * @fn:        bcache_sync(struct BlkDev *dev)
+ *
+ * @brief:     Writes back the dirty blocks of dev, or of all devices if dev
+ *             is 0, and waits for them. Must be called from task context.
+ *
+ * @return:    BLK_OK or BLK_EIO if a block could not be written.
+ */
+int bcache_sync(struct BlkDev *dev);
+/**
+ * @fn:        bcache_stats(struct BcacheStats *stats)
+ *
+ * @brief:     Copies the counters of the cache.
+ */
+void bcache_stats(struct BcacheStats *stats);
+
+#endif
@@ -0,0 +1,454 @@
+/******************************************************************************
+ * @file:        bench.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the kernel micro-benchmarks.
+ *
+ *               A benchmark is a function that performs a number of
+ *               operations and returns the TSC cycles they took, or 0 if it
+ *               could not run. New benchmarks are added to bench_table.
+ *
+ *               The benchmark task is pinned to the BSP, and so is the
+ *               partner of the context switch benchmark, so a switch never
+ *               involves a second CPU. The contended spinlock benchmark
+ *               instead creates one worker per other CPU and lets the idle
+ *               CPUs steal them. The timer and the other tasks keep running
+ *               and show up in the slower rounds, which is why the fastest
+ *               round is the figure to compare.
+ *
+ *               The power-off ports are those of the QEMU device
+ *               "isa-debug-exit,iobase=0xf4" and of the Bochs shutdown port.
+ *               Both are unused on real hardware, where the machine just
+ *               idles after the last line.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the benchmark suite.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     The copy benchmarks measure memcpy and memset.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Count the CPUs of spin_contended without __builtin_popcount, which
+ *     needs __popcountdi2 of libgcc.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "bench.h"
+#include "trap.h"
+#include "smp.h"
+#include "sched.h"
+#include "memory.h"
+#include "slab.h"
+#include "sync.h"
+#include "clock.h"
+#include "printk.h"
+#include "string.h"
+#include "lib.h"
+
+#define BENCH_BUFFER_ORDER  4
+#define BENCH_BUFFER_SIZE   (PAGE_SIZE<<BENCH_BUFFER_ORDER)
+#define BENCH_SLAB_SIZE     64
+#define BENCH_SETTLE_NS     (10*NSEC_PER_MSEC)
+
+#define QEMU_EXIT_PORT      0xf4
+#define BOCHS_SHUTDOWN_PORT 0x8900
+
+/**
+ * @brief:                One benchmark.
+ *
+ * @struct:               Bench
+ *
+ * @param:     name       The name in the log
+ * @param:     ops        The operations of one round
+ * @param:     bytes      The bytes moved by one operation, 0 if the
+ *                        benchmark does not move memory
+ * @param:     run        Runs ops operations and returns their cycles
+ */
+struct Bench {
+    const char *name;
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t (*run)(uint64_t ops);
+};
+
+static uint8_t *bench_src;
+static uint8_t *bench_dst;
+
+static volatile bool switch_stop;
+static volatile bool switch_done;
+
+static struct Spinlock bench_lock = SPINLOCK_INIT;
+static volatile uint64_t bench_counter;
+static volatile bool spin_go;
+static uint32_t spin_ready;
+static uint32_t spin_left;
+static uint32_t spin_cpus;
+static uint64_t spin_ops;
+static uint64_t spin_end;
+
+/**
+ * @brief:      The handler of BENCH_VECTOR.
+ */
+static void bench_irq_handler(struct TrapFrame *tf, void *ctx)
+{
+}
+
+/**
+ * @brief:      Takes BENCH_VECTOR ops times, each a full round trip through
+ *              Trap, the dispatch table and TrapReturn.
+ */
+static uint64_t bench_irq(uint64_t ops)
+{
+    uint64_t start = read_tsc();
+    uint64_t i;
+
+    for (i = 0; i < ops; i++) {
+        bench_trap();
+    }
+
+    return read_tsc()-start;
+}
+
+/**
+ * @brief:      The partner of the context switch benchmark.
+ */
+static void switch_partner(void *arg)
+{
+    while (!switch_stop) {
+        sched_yield();
+    }
+    switch_done = true;
+}
+
+/**
+ * @brief:      Switches ops times between the benchmark task and a partner
+ *              on the same CPU, each sched_yield is two switches.
+ */
+static uint64_t bench_switch(uint64_t ops)
+{
+    uint64_t start, cycles;
+    uint64_t i;
+
+    switch_stop = false;
+    switch_done = false;
+    if (task_create_pinned("bench-switch", switch_partner, 0,
+                           SCHED_DEFAULT_PRIO) == 0) {
+        return 0;
+    }
+    sched_yield();
+
+    start = read_tsc();
+    for (i = 0; i < ops/2; i++) {
+        sched_yield();
+    }
+    cycles = read_tsc()-start;
+
+    switch_stop = true;
+    while (!switch_done) {
+        sched_yield();
+    }
+
+    return cycles;
+}
+
+/**
+ * @brief:      Allocates and frees one frame ops times.
+ */
+static uint64_t bench_frame(uint64_t ops)
+{
+    uint64_t start = read_tsc();
+    uint64_t frame;
+    uint64_t i;
+
+    for (i = 0; i < ops; i++) {
+        frame = alloc_frame();
+        if (frame == 0) {
+            return 0;
+        }
+        free_frame(frame);
+    }
+
+    return read_tsc()-start;
+}
+
+/**
+ * @brief:      Allocates and frees one BENCH_SLAB_SIZE object ops times.
+ */
+static uint64_t bench_slab(uint64_t ops)
+{
+    uint64_t start = read_tsc();
+    void *obj;
+    uint64_t i;
+
+    for (i = 0; i < ops; i++) {
+        obj = kmalloc(BENCH_SLAB_SIZE);
+        if (obj == 0) {
+            return 0;
+        }
+        kfree(obj);
+    }
+
+    return read_tsc()-start;
+}
+
+/**
+ * @brief:      Takes and releases bench_lock n times, returns when it was
+ *              done.
+ */
+static uint64_t spin_loop(uint64_t n)
+{
+    uint64_t end;
+    uint64_t i;
+
+    preempt_disable();
+    __atomic_fetch_or(&spin_cpus, 1U<<this_cpu()->id, __ATOMIC_RELAXED);
+    for (i = 0; i < n; i++) {
+        spin_lock(&bench_lock);
+        bench_counter++;
+        spin_unlock(&bench_lock);
+    }
+    end = read_tsc();
+    preempt_enable();
+
+    return end;
+}
+
+/**
+ * @brief:      Takes and releases an uncontended spinlock ops times.
+ */
+static uint64_t bench_spin(uint64_t ops)
+{
+    uint64_t start = read_tsc();
+
+    return spin_loop(ops)-start;
+}
+
+/**
+ * @brief:      A worker of the contended spinlock benchmark, it records the
+ *              latest end of all workers in spin_end.
+ */
+static void spin_worker(void *arg)
+{
+    uint64_t end, last;
+
+    __atomic_fetch_add(&spin_ready, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&spin_go, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+
+    end = spin_loop(spin_ops);
+    last = __atomic_load_n(&spin_end, __ATOMIC_RELAXED);
+    while (end > last && !__atomic_compare_exchange_n(&spin_end, &last, end,
+        false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    __atomic_fetch_sub(&spin_left, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief:          A function that takes one spinlock from all CPUs at once.
+ *
+ * @param:          ops  the lock acquisitions of all CPUs together
+ *
+ * @return:         The cycles from the start until the last CPU was done,
+ *                  scaled to ops acquisitions
+ *
+ * @description:    The workers get BENCH_SETTLE_NS to be stolen by the
+ *                  idle CPUs before they are released. A CPU that has no
+ *                  worker then is logged.
+ */
+static uint64_t bench_spin_contended(uint64_t ops)
+{
+    uint32_t count = get_cpu_count();
+    uint32_t workers = 0;
+    uint32_t ran = 0;
+    uint64_t start, end;
+    uint32_t bits, i;
+
+    spin_ops = ops/count;
+    spin_go = false;
+    spin_ready = 0;
+    spin_cpus = 0;
+    spin_end = 0;
+
+    for (i = 1; i < count; i++) {
+        if (task_create("bench-spin", spin_worker, 0,
+                        SCHED_DEFAULT_PRIO) == 0) {
+            break;
+        }
+        workers++;
+    }
+    spin_left = workers;
+    while (__atomic_load_n(&spin_ready, __ATOMIC_ACQUIRE) < workers) {
+        sched_yield();
+    }
+    task_sleep(BENCH_SETTLE_NS);
+
+    start = read_tsc();
+    __atomic_store_n(&spin_go, true, __ATOMIC_RELEASE);
+    end = spin_loop(spin_ops);
+    while (__atomic_load_n(&spin_left, __ATOMIC_ACQUIRE) != 0) {
+        sched_yield();
+    }
+
+    if (spin_end > end) {
+        end = spin_end;
+    }
+    for (bits = spin_cpus; bits != 0; bits &= bits-1) {
+        ran++;
+    }
+    if (ran != count) {
+        printk("bench: spin_contended ran on %u of %u CPUs\n", ran, count);
+    }
+
+    return (end-start)*ops/(spin_ops*(workers+1));
+}
+
+/**
+ * @brief:      Copies BENCH_BUFFER_SIZE bytes with memcpy ops times.
+ */
+static uint64_t bench_copy(uint64_t ops)
+{
+    uint64_t start = read_tsc();
+    uint64_t i;
+
+    for (i = 0; i < ops; i++) {
+        memcpy(bench_dst, bench_src, BENCH_BUFFER_SIZE);
+    }
+
+    return read_tsc()-start;
+}
+
+/**
+ * @brief:      Fills BENCH_BUFFER_SIZE bytes with memset ops times.
+ */
+static uint64_t bench_fill(uint64_t ops)
+{
+    uint64_t start = read_tsc();
+    uint64_t i;
+
+    for (i = 0; i < ops; i++) {
+        memset(bench_dst, (int)i, BENCH_BUFFER_SIZE);
+    }
+
+    return read_tsc()-start;
+}
+
+static const struct Bench bench_table[] = {
+    { "irq_trap",       20000,  0,                 bench_irq },
+    { "ctx_switch",     20000,  0,                 bench_switch },
+    { "frame_alloc",    20000,  0,                 bench_frame },
+    { "slab_alloc",     20000,  0,                 bench_slab },
+    { "spin",           100000, 0,                 bench_spin },
+    { "spin_contended", 100000, 0,                 bench_spin_contended },
+    { "memcpy",         64,     BENCH_BUFFER_SIZE, bench_copy },
+    { "memset",         64,     BENCH_BUFFER_SIZE, bench_fill },
+};
+
+/**
+ * @brief:          A function that runs one benchmark and logs its line.
+ *
+ * @param[in]:      bench  the benchmark
+ *
+ * @return:         None
+ *
+ * @description:    The rounds are sorted by insertion, there are only
+ *                  BENCH_ROUNDS of them.
+ */
+static void run_bench(const struct Bench *bench)
+{
+    uint64_t cycles[BENCH_ROUNDS];
+    uint64_t c, mib_s;
+    char line[LOG_LINE_SIZE];
+    int len;
+    int r, i;
+
+    for (r = 0; r < BENCH_ROUNDS; r++) {
+        c = bench->run(bench->ops);
+        if (c == 0) {
+            printk("bench: %s failed\n", bench->name);
+            printk_flush();
+            return;
+        }
+
+        for (i = r; i > 0 && cycles[i-1] > c; i--) {
+            cycles[i] = cycles[i-1];
+        }
+        cycles[i] = c;
+    }
+
+    len = snprintf(line, sizeof(line), "bench: %s ops=%lu min=%lu med=%lu "
+                   "max=%lu", bench->name, bench->ops,
+                   cycles[0]/bench->ops, cycles[BENCH_ROUNDS/2]/bench->ops,
+                   cycles[BENCH_ROUNDS-1]/bench->ops);
+    if (bench->bytes != 0 && len < (int)sizeof(line)) {
+        mib_s = bench->bytes*bench->ops*(clock_tsc_hz()/1000)/cycles[0]*
+                1000>>20;
+        snprintf(line+len, sizeof(line)-len, " mib_s=%lu", mib_s);
+    }
+
+    printk("%s\n", line);
+    printk_flush();
+}
+
+/**
+ * @brief:      Asks the emulator to power off.
+ */
+static void bench_exit(void)
+{
+    const char *cmd = "Shutdown";
+
+    out_byte(QEMU_EXIT_PORT, 0);
+    while (*cmd != 0) {
+        out_byte(BOCHS_SHUTDOWN_PORT, (uint8_t)*cmd++);
+    }
+}
+
+/**
+ * @brief:      The benchmark task.
+ */
+static void bench_task(void *arg)
+{
+    uint64_t src, dst;
+    uint32_t i;
+
+    src = alloc_frames(BENCH_BUFFER_ORDER);
+    dst = alloc_frames(BENCH_BUFFER_ORDER);
+    if (src == 0 || dst == 0) {
+        printk("bench: no memory\n");
+        printk_flush();
+        return;
+    }
+    bench_src = (uint8_t *)P2V(src);
+    bench_dst = (uint8_t *)P2V(dst);
+    register_irq_handler(BENCH_VECTOR, bench_irq_handler, 0);
+
+    printk("bench: begin cpus=%u tsc_hz=%lu rounds=%u\n", get_cpu_count(),
+           clock_tsc_hz(), BENCH_ROUNDS);
+    printk_flush();
+
+    for (i = 0; i < sizeof(bench_table)/sizeof(bench_table[0]); i++) {
+        run_bench(&bench_table[i]);
+    }
+
+    printk("bench: end\n");
+    printk_flush();
+
+    unregister_irq_handler(BENCH_VECTOR);
+    free_frames(src, BENCH_BUFFER_ORDER);
+    free_frames(dst, BENCH_BUFFER_ORDER);
+    bench_exit();
+}
+
+/**
+ * @brief:      Starts the benchmark task.
+ */
+void init_bench(void)
+{
+    task_create_pinned("bench", bench_task, 0, SCHED_DEFAULT_PRIO);
+}
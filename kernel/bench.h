@@ -0,0 +1,47 @@
+/* -----------------------------------------------------------------------------
+ * @file:        bench.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the kernel
+ *               micro-benchmarks.
+ *
+ *               "make bench" builds bench.img, whose kernel is linked from
+ *               the same objects as kernel.elf plus bench.o, with main.c
+ *               compiled with BENCH. Its KMain boots normally and then starts
+ *               a task that runs every benchmark of the table in bench.c
+ *               BENCH_ROUNDS times, logs the results and powers off QEMU or
+ *               Bochs. Each benchmark produces one line
+ *
+ *                   bench: <name> ops=<n> min=<c> med=<c> max=<c>
+ *
+ *               with the TSC cycles per operation of the fastest, the median
+ *               and the slowest round, and a MiB/s figure of the fastest
+ *               round for the copy benchmarks. The log starts with
+ *               "bench: begin" and ends with "bench: end", tools/benchcmp.py
+ *               compares two of them.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the benchmark suite.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include "stdint.h"
+
+#define BENCH_ROUNDS        5
+
+/**
+ * @fn:        init_bench(void)
+ *
+ * @brief:     Starts the benchmark task on the calling CPU. Must run after
+ *             start_aps.
+ */
+void init_bench(void);
+
+#endif
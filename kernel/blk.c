@@ -0,0 +1,440 @@
+/******************************************************************************
+ * @file:        blk.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the block device layer.
+ *
+ *               Every device has one queue of requests, kept in sector
+ *               order under the device lock:
+ *
+ *                  - A new Bio that starts where a queued request of the
+ *                    same direction ends, or ends where one starts, is
+ *                    added to that request while it stays within the
+ *                    max_sectors and max_segments of the driver. The disk
+ *                    then sees one command instead of several, which is
+ *                    what turns a run of small sequential writes into one
+ *                    large transfer.
+ *
+ *                  - The next request to start is the first one at or
+ *                    after the sector where the last started request
+ *                    ended, and the first one of the queue once there is
+ *                    none (C-LOOK). The head of a spinning disk sweeps in
+ *                    one direction and no sector waits for more than one
+ *                    sweep.
+ *
+ *               Requests are started from blk_submit and from blk_complete,
+ *               so the queue only runs while the driver has room and there
+ *               is no thread of its own. The done functions are called
+ *               after the lock is released, a done function may submit the
+ *               next Bio.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the block device layer.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "blk.h"
+#include "slab.h"
+#include "sched.h"
+#include "printk.h"
+
+/**
+ * @brief:                The state of a blk_read or blk_write on its stack.
+ *
+ * @struct:               SyncWait
+ *
+ * @param:     task       The waiting task
+ * @param:     pending    The number of Bios that have not ended
+ * @param:     status     BLK_OK or the error of a Bio
+ */
+struct SyncWait {
+    struct Task *task;
+    uint32_t pending;
+    int status;
+};
+
+static struct KmemCache *request_cache;
+static struct BlkDev *devices;
+static struct Spinlock devices_lock = SPINLOCK_INIT;
+
+/**
+ * @brief:      Sets the status of a chain of Bios and calls their done
+ *              functions. A done function may free its Bio.
+ */
+static void end_bios(struct Bio *bio, int status)
+{
+    struct Bio *next;
+
+    while (bio != 0) {
+        next = bio->next;
+        bio->status = status;
+        bio->done(bio);
+        bio = next;
+    }
+}
+
+/**
+ * @brief:      Ends the requests that a driver refused to start.
+ */
+static void end_failed(struct BlkRequest *req)
+{
+    struct BlkRequest *next;
+
+    while (req != 0) {
+        next = req->next;
+        end_bios(req->head, BLK_EIO);
+        kmem_cache_free(request_cache, req);
+        req = next;
+    }
+}
+
+/**
+ * @brief:          A function that merges a Bio into a queued request.
+ *
+ * @param:          dev  the device, locked
+ * @param:          bio  the Bio
+ *
+ * @return:         Whether the Bio was merged.
+ *
+ * @description:    A Bio may continue one request and precede the next one,
+ *                  it then joins the first, as the queue is searched in
+ *                  sector order. The two requests are not merged with each
+ *                  other.
+ */
+static bool merge_bio(struct BlkDev *dev, struct Bio *bio)
+{
+    struct BlkRequest *req;
+
+    for (req = dev->queue; req != 0; req = req->next) {
+        if (req->write != bio->write ||
+            req->segments >= dev->max_segments ||
+            req->count+bio->count > dev->max_sectors) {
+            continue;
+        }
+
+        if (req->sector+req->count == bio->sector) {
+            req->tail->next = bio;
+            req->tail = bio;
+        }
+        else if (bio->sector+bio->count == req->sector) {
+            bio->next = req->head;
+            req->head = bio;
+            req->sector = bio->sector;
+        }
+        else {
+            continue;
+        }
+
+        req->count += bio->count;
+        req->segments++;
+        dev->merges++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief:      Inserts a request into the queue in sector order.
+ */
+static void queue_request(struct BlkDev *dev, struct BlkRequest *req)
+{
+    struct BlkRequest **link = &dev->queue;
+
+    while (*link != 0 && (*link)->sector <= req->sector) {
+        link = &(*link)->next;
+    }
+    req->next = *link;
+    *link = req;
+}
+
+/**
+ * @brief:          A function that starts queued requests.
+ *
+ * @param:          dev     the device, locked
+ * @param:          failed  the list of refused requests
+ *
+ * @return:         None
+ *
+ * @description:    Requests are started in C-LOOK order while fewer than
+ *                  queue_depth are in flight. A request the driver refuses
+ *                  is put on failed, the caller ends it after unlocking.
+ */
+static void dispatch(struct BlkDev *dev, struct BlkRequest **failed)
+{
+    struct BlkRequest **link, **pick;
+    struct BlkRequest *req;
+
+    while (dev->in_flight < dev->queue_depth && dev->queue != 0) {
+        pick = &dev->queue;
+        for (link = &dev->queue; *link != 0; link = &(*link)->next) {
+            if ((*link)->sector >= dev->position) {
+                pick = link;
+                break;
+            }
+        }
+
+        req = *pick;
+        *pick = req->next;
+        req->next = 0;
+
+        dev->in_flight++;
+        dev->requests++;
+        dev->position = req->sector+req->count;
+
+        if (dev->ops->start(dev, req) != BLK_OK) {
+            dev->in_flight--;
+            req->next = *failed;
+            *failed = req;
+        }
+    }
+}
+
+/**
+ * @brief:      The done function of the Bios of blk_read and blk_write. The
+ *              task is read first, the wait is gone once pending is zero.
+ */
+static void sync_done(struct Bio *bio)
+{
+    struct SyncWait *wait = bio->ctx;
+    struct Task *task = wait->task;
+
+    if (bio->status != BLK_OK) {
+        wait->status = bio->status;
+    }
+    if (__atomic_sub_fetch(&wait->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        sched_wakeup(task);
+    }
+}
+
+/**
+ * @brief:          A function that transfers sectors and waits for them.
+ *
+ * @param:          dev     the device
+ * @param:          sector  the first sector
+ * @param:          count   the number of sectors
+ * @param:          buf     the buffer
+ * @param:          write   whether the sectors are written
+ *
+ * @return:         BLK_OK or an error.
+ *
+ * @description:    The transfer is split in Bios of max_sectors sectors, and
+ *                  up to BLK_SYNC_BATCH of them are in the queue at once, so
+ *                  a driver with a queue depth above one can overlap them.
+ */
+static int sync_rw(struct BlkDev *dev, uint64_t sector, uint32_t count,
+                   void *buf, bool write)
+{
+    struct Bio bios[BLK_SYNC_BATCH];
+    struct SyncWait wait;
+    uint8_t *p = buf;
+    uint32_t n, i, chunk;
+
+    while (count > 0) {
+        wait.task = current_task();
+        wait.status = BLK_OK;
+
+        for (n = 0; n < BLK_SYNC_BATCH && count > 0; n++) {
+            chunk = count < dev->max_sectors ? count : dev->max_sectors;
+            bios[n].next = 0;
+            bios[n].sector = sector;
+            bios[n].count = chunk;
+            bios[n].write = write;
+            bios[n].buf = p;
+            bios[n].done = sync_done;
+            bios[n].ctx = &wait;
+
+            sector += chunk;
+            count -= chunk;
+            p += (uint64_t)chunk<<SECTOR_SHIFT;
+        }
+
+        __atomic_store_n(&wait.pending, n, __ATOMIC_RELEASE);
+        for (i = 0; i < n; i++) {
+            blk_submit(dev, &bios[i]);
+        }
+        while (__atomic_load_n(&wait.pending, __ATOMIC_ACQUIRE) != 0) {
+            sched_block();
+        }
+
+        if (wait.status != BLK_OK) {
+            return wait.status;
+        }
+    }
+
+    return BLK_OK;
+}
+
+/**
+ * @brief:      Compares two device names.
+ */
+static bool name_equal(const char *a, const char *b)
+{
+    uint32_t i;
+
+    for (i = 0; i < BLK_NAME_SIZE; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+        if (a[i] == 0) {
+            return true;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief:      Creates the cache of the requests.
+ */
+void init_blk(void)
+{
+    request_cache = kmem_cache_create("blk_request",
+                                      sizeof(struct BlkRequest), 0, 0);
+    if (request_cache == 0) {
+        printk("blk: no request cache\n");
+        while (1) { }
+    }
+}
+
+/**
+ * @brief:      Adds a device to the list of devices.
+ */
+void blk_register(struct BlkDev *dev)
+{
+    uint64_t flags;
+
+    spin_init(&dev->lock);
+    dev->queue = 0;
+    dev->in_flight = 0;
+    dev->position = 0;
+    dev->merges = 0;
+    dev->requests = 0;
+
+    flags = spin_lock_irqsave(&devices_lock);
+    dev->next = devices;
+    devices = dev;
+    spin_unlock_irqrestore(&devices_lock, flags);
+
+    printk("blk: %s, %lu MiB, %u sectors per request, depth %u\n",
+           dev->name, dev->sectors>>(20-SECTOR_SHIFT), dev->max_sectors,
+           dev->queue_depth);
+}
+
+/**
+ * @brief:      Finds a device by its name.
+ */
+struct BlkDev *blk_find(const char *name)
+{
+    uint64_t flags = spin_lock_irqsave(&devices_lock);
+    struct BlkDev *dev;
+
+    for (dev = devices; dev != 0; dev = dev->next) {
+        if (name_equal(dev->name, name)) {
+            break;
+        }
+    }
+
+    spin_unlock_irqrestore(&devices_lock, flags);
+    return dev;
+}
+
+/**
+ * @brief:          A function that queues a Bio.
+ *
+ * @param:          dev  the device
+ * @param:          bio  the Bio
+ *
+ * @return:         None
+ *
+ * @description:    The request is allocated before the lock is taken, as
+ *                  most Bios of a sequential stream are merged it is freed
+ *                  again then.
+ */
+void blk_submit(struct BlkDev *dev, struct Bio *bio)
+{
+    struct BlkRequest *req, *failed = 0;
+    bool merged;
+    uint64_t flags;
+
+    if (bio->count == 0 || bio->count > dev->max_sectors ||
+        bio->sector >= dev->sectors ||
+        bio->count > dev->sectors-bio->sector) {
+        bio->status = BLK_EINVAL;
+        bio->done(bio);
+        return;
+    }
+    bio->next = 0;
+
+    req = kmem_cache_alloc(request_cache);
+
+    flags = spin_lock_irqsave(&dev->lock);
+
+    merged = merge_bio(dev, bio);
+    if (!merged) {
+        if (req == 0) {
+            spin_unlock_irqrestore(&dev->lock, flags);
+            bio->status = BLK_ENOMEM;
+            bio->done(bio);
+            return;
+        }
+
+        req->head = bio;
+        req->tail = bio;
+        req->sector = bio->sector;
+        req->count = bio->count;
+        req->segments = 1;
+        req->write = bio->write;
+        req->tag = 0;
+        queue_request(dev, req);
+    }
+    dispatch(dev, &failed);
+
+    spin_unlock_irqrestore(&dev->lock, flags);
+
+    if (merged && req != 0) {
+        kmem_cache_free(request_cache, req);
+    }
+    end_failed(failed);
+}
+
+/**
+ * @brief:      Ends a request and starts the next ones.
+ */
+void blk_complete(struct BlkDev *dev, struct BlkRequest *req, int status)
+{
+    struct BlkRequest *failed = 0;
+    uint64_t flags = spin_lock_irqsave(&dev->lock);
+
+    dev->in_flight--;
+    dispatch(dev, &failed);
+
+    spin_unlock_irqrestore(&dev->lock, flags);
+
+    end_bios(req->head, status);
+    kmem_cache_free(request_cache, req);
+    end_failed(failed);
+}
+
+/**
+ * @brief:      Reads sectors and waits for them.
+ */
+int blk_read(struct BlkDev *dev, uint64_t sector, uint32_t count, void *buf)
+{
+    return sync_rw(dev, sector, count, buf, false);
+}
+
+/**
+ * @brief:      Writes sectors and waits for them.
+ */
+int blk_write(struct BlkDev *dev, uint64_t sector, uint32_t count,
+              const void *buf)
+{
+    return sync_rw(dev, sector, count, (void *)buf, true);
+}
@@ -0,0 +1,209 @@
+/* -----------------------------------------------------------------------------
+ * @file:        blk.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the block
+ *               device layer.
+ *
+ *               A caller describes a transfer with a Bio and hands it to
+ *               blk_submit, which returns at once. It is merged into a
+ *               queued request that it continues or precedes on the disk,
+ *               or queued in sector order by itself. The driver gets a
+ *               request through its start operation whenever fewer than
+ *               queue_depth requests are in flight, and ends it with
+ *               blk_complete, which calls the done function of every Bio.
+ *
+ *               The buffer of a Bio is a kernel address of physically
+ *               contiguous memory, such as memory from kmalloc or
+ *               alloc_frames, so a DMA engine can use one segment for it.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the block device layer.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _BLK_H_
+#define _BLK_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "sync.h"
+
+#define SECTOR_SIZE         512
+#define SECTOR_SHIFT        9
+
+#define BLK_OK              0
+#define BLK_EIO             (-1)
+#define BLK_EINVAL          (-2)
+#define BLK_ENOMEM          (-3)
+
+#define BLK_NAME_SIZE       8
+#define BLK_SYNC_BATCH      8
+
+/**
+ * @brief:                A transfer of sectors to or from one buffer.
+ *
+ * @struct:               Bio
+ *
+ * @param:     next       The next Bio of a request
+ * @param:     sector     The first sector
+ * @param:     count      The number of sectors
+ * @param:     write      Whether the sectors are written
+ * @param:     buf        The buffer, physically contiguous
+ * @param:     status     BLK_OK or an error, set before done is called
+ * @param:     done       Called once the transfer has ended, from softirq
+ *                        context
+ * @param:     ctx        A value for the done function
+ */
+struct Bio {
+    struct Bio *next;
+    uint64_t sector;
+    uint32_t count;
+    bool write;
+    void *buf;
+    int status;
+    void (*done)(struct Bio *bio);
+    void *ctx;
+};
+
+/**
+ * @brief:                Bios of adjacent sectors that the driver transfers
+ *                        with one command.
+ *
+ * @struct:               BlkRequest
+ *
+ * @param:     next       The next request in the queue
+ * @param:     head       The first Bio, at sector
+ * @param:     tail       The last Bio
+ * @param:     sector     The first sector
+ * @param:     count      The number of sectors of all Bios
+ * @param:     segments   The number of Bios
+ * @param:     write      Whether the sectors are written
+ * @param:     tag        For the driver, such as the command slot
+ */
+struct BlkRequest {
+    struct BlkRequest *next;
+    struct Bio *head;
+    struct Bio *tail;
+    uint64_t sector;
+    uint32_t count;
+    uint32_t segments;
+    bool write;
+    uint32_t tag;
+};
+
+struct BlkDev;
+
+/**
+ * @brief:                The operations of a driver.
+ *
+ * @struct:               BlkOps
+ *
+ * @param:     start      Issues a request. It is called with the device
+ *                        lock held and interrupts disabled and must not
+ *                        block, and returns BLK_OK or an error, which ends
+ *                        the request at once.
+ */
+struct BlkOps {
+    int (*start)(struct BlkDev *dev, struct BlkRequest *req);
+};
+
+/**
+ * @brief:                A block device and its request queue.
+ *
+ * @struct:               BlkDev
+ *
+ * @param:     name       The name, such as ata0
+ * @param:     sectors    The size in sectors
+ * @param:     max_sectors  The most sectors of one request
+ * @param:     max_segments The most Bios of one request
+ * @param:     queue_depth  The most requests in flight
+ * @param:     ops        The driver operations
+ * @param:     priv       For the driver
+ * @param:     lock       Protects the fields below
+ * @param:     queue      The queued requests in sector order
+ * @param:     in_flight  The number of started requests
+ * @param:     position   The sector after the last started request
+ * @param:     merges     The number of Bios merged into a request
+ * @param:     requests   The number of started requests
+ * @param:     next       The next registered device
+ */
+struct BlkDev {
+    char name[BLK_NAME_SIZE];
+    uint64_t sectors;
+    uint32_t max_sectors;
+    uint32_t max_segments;
+    uint32_t queue_depth;
+    const struct BlkOps *ops;
+    void *priv;
+    struct Spinlock lock;
+    struct BlkRequest *queue;
+    uint32_t in_flight;
+    uint64_t position;
+    uint64_t merges;
+    uint64_t requests;
+    struct BlkDev *next;
+};
+
+/**
+ * @fn:        init_blk(void)
+ *
+ * @brief:     Creates the cache of the requests. Must run after init_slab and
+ *             before the drivers.
+ */
+void init_blk(void);
+/**
+ * @fn:        blk_register(struct BlkDev *dev)
+ *
+ * @brief:     Adds a device whose name, size, limits and operations are set.
+ */
+void blk_register(struct BlkDev *dev);
+/**
+ * @fn:        blk_find(const char *name)
+ *
+ * @brief:     Returns the registered device with the name, or 0.
+ */
+struct BlkDev *blk_find(const char *name);
+/**
+ * @fn:        blk_submit(struct BlkDev *dev, struct Bio *bio)
+ *
+ * @brief:     Queues a Bio of at most max_sectors sectors. Its done function
+ *             is called when it has ended, also when it is rejected.
+ */
+void blk_submit(struct BlkDev *dev, struct Bio *bio);
+/**
+ * @fn:        blk_complete(struct BlkDev *dev, struct BlkRequest *req,
+ *                          int status)
+ *
+ * @brief:     Ends a started request, starts the next ones and calls the
+ *             done functions. Must not be called from a start operation or
+ *             with interrupts disabled.
+ */
+void blk_complete(struct BlkDev *dev, struct BlkRequest *req, int status);
+/**
+ * @fn:        blk_read(struct BlkDev *dev, uint64_t sector, uint32_t count,
+ *                      void *buf)
+ *
+ * @brief:     Reads count sectors into buf and waits for them. Must be
+ *             called from task context.
+ *
+ * @return:    BLK_OK or an error.
+ */
+int blk_read(struct BlkDev *dev, uint64_t sector, uint32_t count, void *buf);
+/**
+ * @fn:        blk_write(struct BlkDev *dev, uint64_t sector, uint32_t count,
+ *                       const void *buf)
+ *
+ * @brief:     Writes count sectors of buf and waits for them. Must be called
+ *             from task context.
+ *
+ * @return:    BLK_OK or an error.
+ */
+int blk_write(struct BlkDev *dev, uint64_t sector, uint32_t count,
+              const void *buf);
+
+#endif
@@ -0,0 +1,104 @@
+/******************************************************************************
+ * @file:        boottime.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the boot time stamps.
+ *
+ *               The stamps of the boot sector and the loader are taken
+ *               before the TSC is calibrated, and in real mode, so they are
+ *               kept as raw counter values and only converted when they are
+ *               printed. The BIOS disk reads are the time between
+ *               LoadLoader and E820 and between LoadKernel and the kernel
+ *               being loaded, the kernel initialization is the time after
+ *               KernelEntry.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the boot time stamps.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "boottime.h"
+#include "memory.h"
+#include "clock.h"
+#include "printk.h"
+#include "lib.h"
+
+static const char *stage_names[BOOT_STAGES] = {
+    "boot sector",
+    "LoadLoader",
+    "E820 done",
+    "LoadKernel",
+    "kernel loaded",
+    "PMEntry",
+    "LMEntry",
+    "KernelEntry",
+    "init_idt done",
+};
+
+/**
+ * @brief:      Returns the boot time block through the direct map.
+ */
+static struct BootTimes *boot_times(void)
+{
+    return (struct BootTimes *)P2V(BOOT_TIMES_ADDR);
+}
+
+/**
+ * @brief:      Converts a difference of time stamp counter values to
+ *              microseconds.
+ */
+static uint64_t tsc_to_us(uint64_t delta, uint64_t hz)
+{
+    return delta/hz*1000000+delta%hz*1000000/hz;
+}
+
+/**
+ * @brief:      Stores the time stamp counter in the slot of a stage.
+ *
+ * @param[in]:  stage  the BOOT_STAGE number
+ *
+ * @return:     None
+ */
+void boot_time_stamp(int stage)
+{
+    boot_times()->tsc[stage] = read_tsc();
+}
+
+/**
+ * @brief:       Prints the boot time stamps.
+ *
+ * @description: A stage is shown with the time from the start of the boot
+ *               sector and the time since the previous stage. If the block
+ *               is not filled in order, the kernel was not started by the
+ *               loader of this tree, and nothing but a note is printed.
+ */
+void print_boot_times(void)
+{
+    struct BootTimes *times = boot_times();
+    uint64_t hz = clock_tsc_hz();
+    uint64_t start = times->tsc[0];
+    int i;
+
+    for (i = 1; i < BOOT_STAGES; i++) {
+        if (times->tsc[i] < times->tsc[i-1]) {
+            break;
+        }
+    }
+
+    if (hz == 0 || start == 0 || i < BOOT_STAGES) {
+        printk("boot: no time stamps\n");
+        return;
+    }
+
+    for (i = 0; i < BOOT_STAGES; i++) {
+        printk("boot: %-13s %8lu us  +%lu us\n", stage_names[i],
+               tsc_to_us(times->tsc[i]-start, hz),
+               tsc_to_us(times->tsc[i]-times->tsc[i > 0 ? i-1 : 0], hz));
+    }
+}
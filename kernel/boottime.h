@@ -0,0 +1,69 @@
+/* -----------------------------------------------------------------------------
+ * @file:        boottime.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the boot time
+ *               stamps.
+ *
+ *               The boot sector, the loader and kernel.asm store the time
+ *               stamp counter at the boundaries of their stages in the boot
+ *               time block at BOOT_TIMES_ADDR, one 64-bit slot per stage in
+ *               the order of the BOOT_STAGE numbers below. The assembly
+ *               files use the same slot numbers and address. The kernel
+ *               adds the end of init_idt and prints the time of every stage
+ *               once the TSC is calibrated.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the boot time stamps.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _BOOTTIME_H_
+#define _BOOTTIME_H_
+
+#include "stdint.h"
+
+/* Below the boot sector and its stack, reserved by init_memory */
+#define BOOT_TIMES_ADDR             0x600
+
+#define BOOT_STAGE_BOOT             0   /* start of boot.asm */
+#define BOOT_STAGE_LOAD_LOADER      1   /* LoadLoader of boot.asm */
+#define BOOT_STAGE_E820             2   /* memory map read, loader.asm */
+#define BOOT_STAGE_LOAD_KERNEL      3   /* LoadKernel of loader.asm */
+#define BOOT_STAGE_KERNEL_LOADED    4   /* segments placed, loader.asm */
+#define BOOT_STAGE_PM_ENTRY         5   /* PMEntry of loader.asm */
+#define BOOT_STAGE_LM_ENTRY         6   /* LMEntry of loader.asm */
+#define BOOT_STAGE_KERNEL_ENTRY     7   /* start of kernel.asm */
+#define BOOT_STAGE_IDT              8   /* end of init_idt */
+#define BOOT_STAGES                 9
+
+/**
+ * @brief:                The boot time block.
+ *
+ * @struct:               BootTimes
+ *
+ * @param:     tsc        The time stamp counter at the start of every stage
+ */
+struct BootTimes {
+    uint64_t tsc[BOOT_STAGES];
+};
+
+/**
+ * @fn:        boot_time_stamp(int stage)
+ *
+ * @brief:     Stores the time stamp counter in the slot of a stage.
+ */
+void boot_time_stamp(int stage);
+/**
+ * @fn:        print_boot_times(void)
+ *
+ * @brief:     Prints the time from the start of the boot sector to every
+ *             stage and the time spent in it. Must run after init_clock.
+ */
+void print_boot_times(void);
+
+#endif
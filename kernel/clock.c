@@ -0,0 +1,167 @@
+/******************************************************************************
+ * @file:        clock.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the monotonic clock of the kernel.
+ *
+ *               InitPIT leaves PIT channel 0 running as a 100 Hz rate
+ *               generator at 1193182 Hz input. init_clock reads the TSC
+ *               before and after 50 ms of latched PIT counts and derives the
+ *               TSC frequency from the two.
+ *
+ *               Conversions use 32.32 fixed point factors computed once, so
+ *               ktime_ns is an rdtsc, a subtraction and a 64 x 64 -> 128 bit
+ *               multiplication. The factor of nanoseconds to cycles has more
+ *               than 32 integer bits from a 4.3 GHz TSC on, so its integer
+ *               and fraction parts are computed apart. A 128-bit division
+ *               would need __udivti3 of libgcc, which the kernel does not
+ *               link.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the TSC clock.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Compute tsc_mult without overflow for a TSC of 4.3 GHz and more.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Compute tsc_mult without a 128-bit division.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "clock.h"
+#include "lib.h"
+
+#define PIT_HZ              1193182UL
+#define PIT_RELOAD          11931
+#define PIT_CHANNEL0        0x40
+#define PIT_COMMAND         0x43
+#define PIT_LATCH0          0x00
+
+#define CALIBRATE_COUNTS    (PIT_HZ/20)
+
+static uint64_t tsc_base;
+static uint64_t tsc_hz;
+static uint64_t ns_mult;
+static uint64_t tsc_mult;
+static bool tsc_invariant;
+
+/**
+ * @brief:     Latches and reads the current count of PIT channel 0.
+ */
+static uint16_t pit_read(void)
+{
+    uint16_t low;
+
+    out_byte(PIT_COMMAND, PIT_LATCH0);
+    low = in_byte(PIT_CHANNEL0);
+    return low|((uint16_t)in_byte(PIT_CHANNEL0)<<8);
+}
+
+/**
+ * @brief:     Returns (value * mult) >> 32 without losing the high bits.
+ */
+static uint64_t scale(uint64_t value, uint64_t mult)
+{
+    return (uint64_t)(((unsigned __int128)value*mult)>>32);
+}
+
+/**
+ * @brief:          A function that calibrates the TSC.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The PIT counts down from PIT_RELOAD to 1 and reloads, which
+ *                  is taken into account when the count of a read is above
+ *                  the one of the previous read. The function must run before
+ *                  the timer subsystem masks the PIT interrupt, which does not
+ *                  stop the counter, and it uses the time stamp counter of the
+ *                  boot CPU as the origin of ktime_ns.
+ */
+void init_clock(void)
+{
+    struct CpuidRegs regs;
+    uint64_t elapsed = 0;
+    uint64_t start, stop;
+    uint16_t prev, cur;
+
+    read_cpuid(0x80000000, 0, &regs);
+    if (regs.eax >= 0x80000007) {
+        read_cpuid(0x80000007, 0, &regs);
+        tsc_invariant = (regs.edx&(1<<8)) != 0;
+    }
+
+    prev = pit_read();
+    start = read_tsc();
+    while (elapsed < CALIBRATE_COUNTS) {
+        cur = pit_read();
+        elapsed += cur <= prev ? prev-cur : prev+PIT_RELOAD-cur;
+        prev = cur;
+    }
+    stop = read_tsc();
+
+    tsc_hz = (stop-start)*PIT_HZ/elapsed;
+    ns_mult = (NSEC_PER_SEC<<32)/tsc_hz;
+    tsc_mult = ((tsc_hz/NSEC_PER_SEC)<<32)+
+               ((tsc_hz%NSEC_PER_SEC)<<32)/NSEC_PER_SEC;
+    tsc_base = start;
+}
+
+/**
+ * @brief:      Returns the nanoseconds since init_clock.
+ */
+uint64_t ktime_ns(void)
+{
+    return scale(read_tsc()-tsc_base, ns_mult);
+}
+
+/**
+ * @brief:      Converts a time stamp counter value to nanoseconds since
+ *              init_clock.
+ */
+uint64_t tsc_to_ns(uint64_t tsc)
+{
+    return scale(tsc-tsc_base, ns_mult);
+}
+
+/**
+ * @brief:      Converts nanoseconds since init_clock to a time stamp counter
+ *              value.
+ */
+uint64_t ns_to_tsc(uint64_t ns)
+{
+    return tsc_base+scale(ns, tsc_mult);
+}
+
+/**
+ * @brief:      Returns the measured TSC frequency in Hz.
+ */
+uint64_t clock_tsc_hz(void)
+{
+    return tsc_hz;
+}
+
+/**
+ * @brief:      Returns true if the CPU reports an invariant TSC.
+ */
+bool clock_tsc_invariant(void)
+{
+    return tsc_invariant;
+}
+
+/**
+ * @brief:      Spins for at least ns nanoseconds.
+ */
+void ndelay(uint64_t ns)
+{
+    uint64_t stop = read_tsc()+scale(ns, tsc_mult)+1;
+
+    while (read_tsc() < stop) { }
+}
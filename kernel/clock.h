@@ -0,0 +1,79 @@
+/* -----------------------------------------------------------------------------
+ * @file:        clock.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the monotonic
+ *               clock.
+ *
+ *               The clock is the time stamp counter, calibrated once against
+ *               the PIT. Reading it costs one rdtsc and one multiplication,
+ *               no port I/O. The TSC is only guaranteed to tick at a constant
+ *               rate in all power states when CPUID reports an invariant TSC
+ *               (leaf 0x80000007, EDX bit 8), which clock_tsc_invariant
+ *               tells.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the TSC clock.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define NSEC_PER_USEC       1000UL
+#define NSEC_PER_MSEC       1000000UL
+#define NSEC_PER_SEC        1000000000UL
+
+/**
+ * @fn:        init_clock(void)
+ *
+ * @brief:     Calibrates the TSC against the PIT.
+ */
+void init_clock(void);
+/**
+ * @fn:        ktime_ns(void)
+ *
+ * @brief:     Returns the nanoseconds since init_clock.
+ */
+uint64_t ktime_ns(void);
+/**
+ * @fn:        tsc_to_ns(uint64_t tsc)
+ *
+ * @brief:     Returns the time stamp counter value as nanoseconds since
+ *             init_clock.
+ */
+uint64_t tsc_to_ns(uint64_t tsc);
+/**
+ * @fn:        ns_to_tsc(uint64_t ns)
+ *
+ * @brief:     Returns the time stamp counter value at ns nanoseconds since
+ *             init_clock.
+ */
+uint64_t ns_to_tsc(uint64_t ns);
+/**
+ * @fn:        clock_tsc_hz(void)
+ *
+ * @brief:     Returns the measured TSC frequency.
+ */
+uint64_t clock_tsc_hz(void);
+/**
+ * @fn:        clock_tsc_invariant(void)
+ *
+ * @brief:     Returns true if the CPU reports an invariant TSC.
+ */
+bool clock_tsc_invariant(void);
+/**
+ * @fn:        ndelay(uint64_t ns)
+ *
+ * @brief:     Spins for at least ns nanoseconds.
+ */
+void ndelay(uint64_t ns);
+
+#endif
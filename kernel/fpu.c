@@ -0,0 +1,398 @@
+/******************************************************************************
+ * @file:        fpu.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the x87, SSE and AVX setup and the lazy
+ *               switching of that state between tasks.
+ *
+ *               SSE instructions raise #UD until CR4.OSFXSR is set, and
+ *               CR0.EM must be clear for both x87 and SSE. CR0.MP and CR0.NE
+ *               select native x87 error reporting, CR4.OSXMMEXCPT reports
+ *               unmasked SIMD exceptions as #XM. AVX instructions further
+ *               need CR4.OSXSAVE and the AVX component in XCR0, which may
+ *               only hold components that CPUID leaf 0xD reports.
+ *
+ *               Every CPU runs the same setup, with the components chosen on
+ *               the BSP, so code that picks a SIMD variant once can run it
+ *               on any CPU.
+ *
+ *               The registers are switched lazily. CR0.TS stays set while no
+ *               task owns the registers of a CPU, so the first x87 or SIMD
+ *               instruction of a task raises #NM. The handler clears TS,
+ *               loads the state of the task unless the registers still hold
+ *               it and makes the task the owner. A switch saves the owner
+ *               before the task can run on another CPU and sets TS again,
+ *               so a task that does not touch the registers in a time slice
+ *               costs nothing, and one that does pays one save and one #NM.
+ *               The save uses XSAVEOPT where the CPU has it, which skips the
+ *               components that are still in their initial state or were
+ *               not written since the last XRSTOR from the same area, such
+ *               as the upper halves of the ymm registers of an SSE-only
+ *               task.
+ *
+ *               A CPU remembers whose state its registers hold after a save
+ *               and a task remembers where it was saved last, so a task that
+ *               comes back to a CPU nobody else used the registers on meanwhile
+ *               skips the load. Tasks are compared by id, as a Task structure
+ *               is reused after an exit.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the FPU setup.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Lazy switching of the state with per-task XSAVE areas.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     init_fpu_cpu takes the CPU id, an AP calls it before its GS base is
+ *     set.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "fpu.h"
+#include "smp.h"
+#include "sched.h"
+#include "slab.h"
+#include "trap.h"
+#include "string.h"
+#include "printk.h"
+#include "lib.h"
+
+#define CR0_MP              (1UL<<1)
+#define CR0_EM              (1UL<<2)
+#define CR0_TS              (1UL<<3)
+#define CR0_NE              (1UL<<5)
+
+#define CR4_OSFXSR          (1UL<<9)
+#define CR4_OSXMMEXCPT      (1UL<<10)
+#define CR4_OSXSAVE         (1UL<<18)
+
+#define CPUID_1_ECX_XSAVE   (1U<<26)
+#define CPUID_1_ECX_AVX     (1U<<28)
+#define CPUID_D1_EAX_XSAVEOPT (1U<<0)
+
+#define NM_VECTOR           7
+
+#define FXSAVE_SIZE         512
+#define FPU_AREA_ALIGN      64
+#define FXSAVE_FCW          0
+#define FXSAVE_MXCSR        24
+#define FCW_DEFAULT         0x037f
+#define MXCSR_DEFAULT       0x1f80
+
+#define FPU_FXSR            0
+#define FPU_XSAVE           1
+#define FPU_XSAVEOPT        2
+
+#define FPU_NO_TASK         0xffffffffU
+
+/**
+ * @brief:                The register state of one CPU.
+ *
+ * @struct:               FpuCpu
+ *
+ * @param:     owner      The task whose state is live in the registers with
+ *                        TS clear, 0 while TS is set
+ * @param:     last       The id of the task whose saved state the registers
+ *                        still hold, FPU_NO_TASK if none
+ */
+struct FpuCpu {
+    struct Task *owner;
+    uint32_t last;
+};
+
+static struct FpuCpu fpu_cpus[MAX_CPUS];
+static struct KmemCache *fpu_cache;
+static uint64_t xfeatures = XFEATURE_X87|XFEATURE_SSE;
+static size_t area_size = FXSAVE_SIZE;
+static int fpu_mode = FPU_FXSR;
+
+/**
+ * @brief:      Returns the register state of the calling CPU, which is that
+ *              of the BSP before init_smp.
+ */
+static struct FpuCpu *this_fpu(void)
+{
+    return &fpu_cpus[get_cpu_count() ? this_cpu()->id : 0];
+}
+
+/**
+ * @brief:      Sets CR0.TS.
+ */
+static void set_ts(void)
+{
+    write_cr0(read_cr0()|CR0_TS);
+}
+
+/**
+ * @brief:      Saves the registers to the area of a task.
+ */
+static void save_state(struct Task *task)
+{
+    if (fpu_mode == FPU_XSAVEOPT) {
+        xsaveopt_state(task->fpu, xfeatures);
+    }
+    else if (fpu_mode == FPU_XSAVE) {
+        xsave_state(task->fpu, xfeatures);
+    }
+    else {
+        fxsave_state(task->fpu);
+    }
+}
+
+/**
+ * @brief:      Loads the registers from the area of a task.
+ */
+static void restore_state(struct Task *task)
+{
+    if (fpu_mode == FPU_FXSR) {
+        fxrstor_state(task->fpu);
+    }
+    else {
+        xrstor_state(task->fpu, xfeatures);
+    }
+}
+
+/**
+ * @brief:          A function that allocates the state area of a task.
+ *
+ * @param:          None
+ *
+ * @return:         The area, or 0 if no memory is available
+ *
+ * @description:    The area holds the initial state. With XSAVE the header,
+ *                  whose XSTATE_BV is zero, already tells XRSTOR to
+ *                  initialize every component, FXRSTOR reads the control
+ *                  words from the legacy part. MXCSR is loaded from the
+ *                  legacy part in both cases.
+ */
+static void *alloc_area(void)
+{
+    uint8_t *area = kmem_cache_alloc(fpu_cache);
+
+    if (area == 0) {
+        return 0;
+    }
+
+    memset(area, 0, area_size);
+    *(uint16_t *)(area+FXSAVE_FCW) = FCW_DEFAULT;
+    *(uint32_t *)(area+FXSAVE_MXCSR) = MXCSR_DEFAULT;
+
+    return area;
+}
+
+/**
+ * @brief:          The handler of #NM, the first use of the registers by the
+ *                  running task since it was switched in.
+ *
+ * @param:          tf   the trap frame of the faulting instruction
+ * @param:          ctx  unused
+ *
+ * @return:         None
+ *
+ * @description:    The area is allocated before TS is cleared, as the
+ *                  memset of a large area is a kernel SIMD section, which
+ *                  sets TS again at its end. A task that cannot get an area
+ *                  stops the kernel, as it cannot continue without its
+ *                  registers.
+ */
+static void fpu_trap(struct TrapFrame *tf, void *ctx)
+{
+    struct FpuCpu *fc = this_fpu();
+    struct Task *task = current_task();
+    uint32_t cpu = this_cpu()->id;
+
+    if (task->fpu == 0) {
+        task->fpu = alloc_area();
+        if (task->fpu == 0) {
+            printk("fpu: no memory for the state of task %u\n", task->id);
+            printk_flush();
+            while (1) { }
+        }
+        task->fpu_cpu = FPU_NO_CPU;
+    }
+
+    clear_ts();
+    if (fc->last != task->id || task->fpu_cpu != cpu) {
+        restore_state(task);
+    }
+
+    fc->owner = task;
+    fc->last = task->id;
+    task->fpu_cpu = cpu;
+}
+
+/**
+ * @brief:      Enables the chosen state components on the calling CPU and
+ *              sets CR0.TS.
+ *
+ * @param[in]:  cpu  the id of the calling CPU, this_cpu does not work yet
+ *                   on an AP
+ */
+void init_fpu_cpu(uint32_t cpu)
+{
+    uint64_t cr4 = read_cr4()|CR4_OSFXSR|CR4_OSXMMEXCPT;
+    struct FpuCpu *fc = &fpu_cpus[cpu];
+
+    write_cr0((read_cr0()&~(CR0_EM|CR0_TS))|CR0_MP|CR0_NE);
+    if (fpu_mode != FPU_FXSR) {
+        cr4 |= CR4_OSXSAVE;
+    }
+    write_cr4(cr4);
+    if (fpu_mode != FPU_FXSR) {
+        write_xcr0(xfeatures);
+    }
+
+    reset_fpu();
+    set_ts();
+
+    fc->owner = 0;
+    fc->last = FPU_NO_TASK;
+}
+
+/**
+ * @brief:          A function that chooses the state components.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    Without XSAVE only x87 and SSE are enabled, which every
+ *                  64-bit CPU has, and saved with FXSAVE. AVX is added when
+ *                  both CPUID leaf 1 and the supported XCR0 bits of leaf 0xD
+ *                  report it. Once XCR0 is written, EBX of leaf 0xD is the
+ *                  area size of the enabled components.
+ */
+void init_fpu(void)
+{
+    struct CpuidRegs regs;
+    uint32_t max_leaf;
+    bool avx;
+
+    read_cpuid(0, 0, &regs);
+    max_leaf = regs.eax;
+
+    read_cpuid(1, 0, &regs);
+    avx = (regs.ecx&CPUID_1_ECX_AVX) != 0;
+    if ((regs.ecx&CPUID_1_ECX_XSAVE) != 0 && max_leaf >= 0xd) {
+        fpu_mode = FPU_XSAVE;
+
+        read_cpuid(0xd, 0, &regs);
+        if (avx && (regs.eax&XFEATURE_AVX) != 0) {
+            xfeatures |= XFEATURE_AVX;
+        }
+
+        read_cpuid(0xd, 1, &regs);
+        if ((regs.eax&CPUID_D1_EAX_XSAVEOPT) != 0) {
+            fpu_mode = FPU_XSAVEOPT;
+        }
+    }
+
+    init_fpu_cpu(0);
+
+    if (fpu_mode != FPU_FXSR) {
+        read_cpuid(0xd, 0, &regs);
+        area_size = regs.ebx;
+    }
+
+    fpu_cache = kmem_cache_create("fpu", area_size, FPU_AREA_ALIGN, 0);
+    if (fpu_cache == 0) {
+        while (1) { }
+    }
+    register_irq_handler(NM_VECTOR, fpu_trap, 0);
+
+    printk("fpu: %s, xfeatures %lx, %lu byte areas\n",
+           fpu_mode == FPU_XSAVEOPT ? "xsaveopt" :
+           fpu_mode == FPU_XSAVE ? "xsave" : "fxsave", xfeatures, area_size);
+}
+
+/**
+ * @brief:      Returns the enabled state components.
+ */
+uint64_t fpu_xfeatures(void)
+{
+    return xfeatures;
+}
+
+/**
+ * @brief:          A function that starts a kernel SIMD section.
+ *
+ * @param:          None
+ *
+ * @return:         The interrupt flag to restore
+ *
+ * @description:    The live state of the owner is saved first. The section
+ *                  overwrites the registers, so afterwards they hold nobody's
+ *                  state.
+ */
+uint64_t kernel_fpu_begin(void)
+{
+    uint64_t flags = irq_save();
+    struct FpuCpu *fc = this_fpu();
+
+    if (fc->owner != 0) {
+        save_state(fc->owner);
+        fc->owner = 0;
+    }
+    else {
+        clear_ts();
+    }
+    fc->last = FPU_NO_TASK;
+
+    return flags;
+}
+
+/**
+ * @brief:      Ends a kernel SIMD section, the next use by a task raises
+ *              #NM again.
+ */
+void kernel_fpu_end(uint64_t flags)
+{
+    set_ts();
+    irq_restore(flags);
+}
+
+/**
+ * @brief:          A function that saves the state of a task switched out.
+ *
+ * @param:          prev  the task that ran until now
+ *
+ * @return:         None
+ *
+ * @description:    The registers keep the saved state, last and
+ *                  prev->fpu_cpu tell whether prev can use it when it runs
+ *                  here again. An exiting task is not saved.
+ */
+void fpu_switch(struct Task *prev)
+{
+    struct FpuCpu *fc = this_fpu();
+
+    if (fc->owner != prev) {
+        return;
+    }
+
+    if (prev->state != TASK_ZOMBIE) {
+        save_state(prev);
+    }
+    else {
+        fc->last = FPU_NO_TASK;
+    }
+    fc->owner = 0;
+    set_ts();
+}
+
+/**
+ * @brief:      Frees the state area of an exited task.
+ */
+void fpu_release(struct Task *task)
+{
+    if (task->fpu != 0) {
+        kmem_cache_free(fpu_cache, task->fpu);
+        task->fpu = 0;
+    }
+}
@@ -0,0 +1,99 @@
+/* -----------------------------------------------------------------------------
+ * @file:        fpu.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the x87, SSE
+ *               and AVX setup and of the lazy switching of that state.
+ *
+ *               init_fpu enables the SSE instructions on every CPU and, when
+ *               the CPU has XSAVE, the AVX state in XCR0. The trap frame does
+ *               not hold the SIMD registers. Each task that uses them gets
+ *               an extended state area instead, on its first x87 or SIMD
+ *               instruction, in ring 3 as well as in ring 0. Kernel code may
+ *               only use the registers between kernel_fpu_begin and
+ *               kernel_fpu_end, which keep interrupts and with them
+ *               preemption away.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the FPU setup.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Lazy switching of the state with per-task XSAVE areas.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     init_fpu_cpu takes the CPU id, an AP calls it before its GS base is
+ *     set.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _FPU_H_
+#define _FPU_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define XFEATURE_X87        (1UL<<0)
+#define XFEATURE_SSE        (1UL<<1)
+#define XFEATURE_AVX        (1UL<<2)
+
+#define FPU_NO_CPU          0xffffffffU
+
+struct Task;
+
+/**
+ * @fn:        init_fpu(void)
+ *
+ * @brief:     Detects the SIMD state components, enables them on the BSP and
+ *             creates the cache of the state areas. Must run after
+ *             init_slab.
+ */
+void init_fpu(void);
+/**
+ * @fn:        init_fpu_cpu(uint32_t cpu)
+ *
+ * @brief:     Enables the SIMD state components of init_fpu on the AP with
+ *             the logical id cpu. Must run before the AP executes any other
+ *             C code, so it does not rely on the GS base.
+ */
+void init_fpu_cpu(uint32_t cpu);
+/**
+ * @fn:        fpu_xfeatures(void)
+ *
+ * @brief:     Returns the enabled XFEATURE_* components, XFEATURE_X87 and
+ *             XFEATURE_SSE once init_fpu has run.
+ */
+uint64_t fpu_xfeatures(void);
+/**
+ * @fn:        kernel_fpu_begin(void)
+ *
+ * @brief:     Makes the SIMD registers usable by the calling kernel code.
+ *
+ * @return:    The value to pass to kernel_fpu_end.
+ */
+uint64_t kernel_fpu_begin(void);
+/**
+ * @fn:        kernel_fpu_end(uint64_t flags)
+ *
+ * @brief:     Ends the SIMD section started by kernel_fpu_begin.
+ */
+void kernel_fpu_end(uint64_t flags);
+/**
+ * @fn:        fpu_switch(struct Task *prev)
+ *
+ * @brief:     Saves the state of a task that is switched out, if it used
+ *             the registers since it was switched in. Called by schedule
+ *             with interrupts disabled, before prev can run elsewhere.
+ */
+void fpu_switch(struct Task *prev);
+/**
+ * @fn:        fpu_release(struct Task *task)
+ *
+ * @brief:     Frees the state area of an exited task.
+ */
+void fpu_release(struct Task *task);
+
+#endif
@@ -0,0 +1,307 @@
+/******************************************************************************
+ * @file:        kbd.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the PS/2 keyboard driver.
+ *
+ *               The i8042 controller raises IRQ1 for every byte from the
+ *               keyboard. The handler reads the bytes while the output
+ *               buffer is full, puts them into scan_ring and schedules a
+ *               tasklet that wakes the reader, so the interrupt costs two
+ *               port reads per byte and nothing else. The decoding keeps
+ *               the modifier state, which only the reader touches.
+ *
+ *               In scan code set 1 a key sends its make code when it is
+ *               pressed and the make code with bit 7 set when it is
+ *               released. Keys added after the XT keyboard send 0xe0 first,
+ *               of which right control, keypad enter and keypad slash are
+ *               decoded, the other ones produce no character.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the keyboard driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "kbd.h"
+#include "ring.h"
+#include "softirq.h"
+#include "sched.h"
+#include "apic.h"
+#include "trap.h"
+#include "printk.h"
+#include "lib.h"
+
+#define KBD_DATA            0x60
+#define KBD_STATUS          0x64
+#define KBD_COMMAND         0x64
+
+#define KBD_STATUS_OUT      0x01
+#define KBD_STATUS_IN       0x02
+#define KBD_STATUS_AUX      0x20
+
+#define KBD_CMD_READ_CONFIG  0x20
+#define KBD_CMD_WRITE_CONFIG 0x60
+#define KBD_CONFIG_IRQ1     0x01
+#define KBD_CONFIG_NO_CLOCK 0x10
+#define KBD_CONFIG_XLATE    0x40
+
+#define KBD_TIMEOUT         100000
+#define KBD_FLUSH_MAX       16
+
+#define SC_EXTENDED         0xe0
+#define SC_RELEASE          0x80
+#define SC_CTRL             0x1d
+#define SC_LSHIFT           0x2a
+#define SC_RSHIFT           0x36
+#define SC_CAPS             0x3a
+#define SC_ENTER            0x1c
+#define SC_SLASH            0x35
+
+/**
+ * @brief:       The characters of scan codes 0x00 - 0x39 without and with
+ *               shift, 0 for keys without a character.
+ */
+static const char keymap[] =
+    "\0" "\x1b" "1234567890-=" "\b\t" "qwertyuiop[]" "\n" "\0"
+    "asdfghjkl;'`" "\0" "\\zxcvbnm,./" "\0" "*" "\0" " ";
+static const char keymap_shift[] =
+    "\0" "\x1b" "!@#$%^&*()_+" "\b\t" "QWERTYUIOP{}" "\n" "\0"
+    "ASDFGHJKL:\"~" "\0" "|ZXCVBNM<>?" "\0" "*" "\0" " ";
+
+static struct ByteRing scan_ring;
+static struct Tasklet kbd_tasklet;
+static struct Task *kbd_waiter;
+static uint32_t kbd_drops;
+
+static uint32_t shift_keys;
+static bool caps_lock;
+static bool ctrl_key;
+static bool extended;
+
+/**
+ * @brief:      Waits until the controller has room for a byte.
+ */
+static bool wait_input(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < KBD_TIMEOUT; i++) {
+        if ((in_byte(KBD_STATUS)&KBD_STATUS_IN) == 0) {
+            return true;
+        }
+        cpu_relax();
+    }
+
+    return false;
+}
+
+/**
+ * @brief:      Waits until the controller has a byte for the CPU.
+ */
+static bool wait_output(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < KBD_TIMEOUT; i++) {
+        if ((in_byte(KBD_STATUS)&KBD_STATUS_OUT) != 0) {
+            return true;
+        }
+        cpu_relax();
+    }
+
+    return false;
+}
+
+/**
+ * @brief:      The tasklet that wakes the reader after keys arrived.
+ */
+static void kbd_wake(void *ctx)
+{
+    struct Task *task = __atomic_exchange_n(&kbd_waiter, 0, __ATOMIC_SEQ_CST);
+
+    if (task != 0) {
+        sched_wakeup(task);
+    }
+}
+
+/**
+ * @brief:      The handler of IRQ1. Bytes of a PS/2 mouse, flagged by the
+ *              status register, are dropped.
+ */
+static void kbd_interrupt(struct TrapFrame *tf, void *ctx)
+{
+    bool got = false;
+    uint8_t status, code;
+
+    while (((status = in_byte(KBD_STATUS))&KBD_STATUS_OUT) != 0) {
+        code = in_byte(KBD_DATA);
+        if ((status&KBD_STATUS_AUX) != 0) {
+            continue;
+        }
+        if (!ring_put(&scan_ring, code)) {
+            kbd_drops++;
+        }
+        got = true;
+    }
+
+    if (got) {
+        tasklet_schedule(&kbd_tasklet);
+    }
+    eoi();
+}
+
+/**
+ * @brief:      Takes the next scan code, blocking while there is none. The
+ *              wakeup works as in uart_read.
+ */
+static uint8_t next_scan_code(void)
+{
+    uint8_t code;
+
+    while (!ring_get(&scan_ring, &code)) {
+        __atomic_store_n(&kbd_waiter, current_task(), __ATOMIC_SEQ_CST);
+        if (ring_empty(&scan_ring)) {
+            sched_block();
+        }
+    }
+
+    return code;
+}
+
+/**
+ * @brief:          A function that sets up the keyboard.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    Bytes left in the output buffer by the BIOS are thrown
+ *                  away first, a full buffer raises no new interrupt. A
+ *                  controller that does not answer leaves the keyboard off.
+ */
+void init_kbd(void)
+{
+    uint8_t config;
+    uint32_t i;
+
+    for (i = 0; i < KBD_FLUSH_MAX; i++) {
+        if ((in_byte(KBD_STATUS)&KBD_STATUS_OUT) == 0) {
+            break;
+        }
+        in_byte(KBD_DATA);
+    }
+
+    if (!wait_input()) {
+        printk("kbd: no PS/2 controller\n");
+        return;
+    }
+    out_byte(KBD_COMMAND, KBD_CMD_READ_CONFIG);
+    if (!wait_output()) {
+        printk("kbd: no PS/2 controller\n");
+        return;
+    }
+    config = in_byte(KBD_DATA);
+    config |= KBD_CONFIG_IRQ1|KBD_CONFIG_XLATE;
+    config &= (uint8_t)~KBD_CONFIG_NO_CLOCK;
+
+    tasklet_init(&kbd_tasklet, kbd_wake, 0);
+    register_irq_handler(IRQ_BASE+KBD_IRQ, kbd_interrupt, 0);
+
+    if (!wait_input()) {
+        printk("kbd: no PS/2 controller\n");
+        unregister_irq_handler(IRQ_BASE+KBD_IRQ);
+        return;
+    }
+    out_byte(KBD_COMMAND, KBD_CMD_WRITE_CONFIG);
+    wait_input();
+    out_byte(KBD_DATA, config);
+
+    if (enable_isa_irq(KBD_IRQ) != 0) {
+        printk("kbd: IRQ%u not available\n", KBD_IRQ);
+        unregister_irq_handler(IRQ_BASE+KBD_IRQ);
+    }
+}
+
+/**
+ * @brief:          A function that reads one character.
+ *
+ * @param:          None
+ *
+ * @return:         The character.
+ *
+ * @description:    Caps lock shifts the letters only, control turns a
+ *                  letter into its control character.
+ */
+char kbd_getc(void)
+{
+    uint8_t code, key;
+    bool release;
+    char c;
+
+    while (1) {
+        code = next_scan_code();
+        if (code == SC_EXTENDED) {
+            extended = true;
+            continue;
+        }
+
+        release = (code&SC_RELEASE) != 0;
+        key = code&~SC_RELEASE;
+
+        if (extended) {
+            extended = false;
+            if (key == SC_CTRL) {
+                ctrl_key = !release;
+            }
+            else if (!release && key == SC_ENTER) {
+                return '\n';
+            }
+            else if (!release && key == SC_SLASH) {
+                return '/';
+            }
+            continue;
+        }
+
+        if (key == SC_LSHIFT || key == SC_RSHIFT) {
+            if (release) {
+                shift_keys &= ~(1U<<(key == SC_RSHIFT));
+            }
+            else {
+                shift_keys |= 1U<<(key == SC_RSHIFT);
+            }
+            continue;
+        }
+        if (key == SC_CTRL) {
+            ctrl_key = !release;
+            continue;
+        }
+        if (key == SC_CAPS) {
+            if (!release) {
+                caps_lock = !caps_lock;
+            }
+            continue;
+        }
+        if (release || key >= sizeof(keymap)-1) {
+            continue;
+        }
+
+        c = shift_keys != 0 ? keymap_shift[key] : keymap[key];
+        if (c == 0) {
+            continue;
+        }
+        if (caps_lock && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+            c ^= 0x20;
+        }
+        if (ctrl_key && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+            c &= 0x1f;
+        }
+
+        return c;
+    }
+}
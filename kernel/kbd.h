@@ -0,0 +1,46 @@
+/* -----------------------------------------------------------------------------
+ * @file:        kbd.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the PS/2
+ *               keyboard driver.
+ *
+ *               The controller translates the keys to scan code set 1. The
+ *               handler of IRQ1 only moves the scan codes into a ring, the
+ *               reader turns them into characters of the US layout, with
+ *               shift, caps lock and control applied.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the keyboard driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _KBD_H_
+#define _KBD_H_
+
+#include "stdint.h"
+
+#define KBD_IRQ             1
+
+/**
+ * @fn:        init_kbd(void)
+ *
+ * @brief:     Enables the keyboard interrupt of the PS/2 controller and
+ *             routes IRQ1. Must run after init_apic.
+ */
+void init_kbd(void);
+/**
+ * @fn:        kbd_getc(void)
+ *
+ * @brief:     Blocks until a key that produces a character is pressed. Must
+ *             be called from task context, by one task at a time.
+ *
+ * @return:    The character.
+ */
+char kbd_getc(void);
+
+#endif
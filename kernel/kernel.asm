@@ -72,49 +72,42 @@
 ;
 ;   - Revision 1.1: 11/06/2023 Marko Trickovic
 ;     Enable interrupts and set stack segment offset to 0.
+;
+;   - Revision 1.2: 10/14/2026 Marko Trickovic
+;     The image starts with a header that gives the loader its size.
+;
+;   - Revision 1.3: 10/14/2026 Marko Trickovic
+;     Removed the image header, the loader reads the ELF headers instead.
+;
+;   - Revision 1.4: 10/14/2026 Marko Trickovic
+;     The kernel is linked at KERNEL_VMA, the boot stack and the TSS stack
+;     are addressed there too.
+;
+;   - Revision 1.5: 10/14/2026 Marko Trickovic
+;     Reordered Gdt64 into the layout that SYSCALL and SYSRET expect.
+;
+;   - Revision 1.6: 10/14/2026 Marko Trickovic
+;     The GDT is generated at link time as boot_gdt, the TSS descriptor no
+;     longer needs to be patched at boot.
+;
+;   - Revision 1.7: 10/14/2026 Marko Trickovic
+;     Record the time stamp counter at start in the boot time block.
 ;------------------------------------------------------------------------------
 
-section .data
+BOOT_TIMES equ 0x600            ; Boot time block, see boottime.h
 
-; This code defines a 64-bit GDT descriptor, which is a table that contains
-; information about the segments and tasks in the system.
-; The GDT descriptor has four entries:
-; - Null entry: this entry is required and must be zero.
-; - Code segment: this entry defines the code segment for long mode, which is
-;   the 64-bit operating mode of the processor.
-; - Data segment: this entry defines the data segment for long mode, which is
-;   where the program data is stored.
-; - TSS segment: this entry defines the task state segment (TSS) for long mode,
-;   which is a structure that holds information about a task, such as processor
-;   register state, I/O port permissions, inner-level stack pointers, and
-;   previous TSS link.
-; The TSS segment entry has the following fields:
-; - Limit: the 16-bit size of the TSS.
-; - Base: the 64-bit linear base address of the TSS.
-; - Type: the type of the TSS, either 9 for non-busy or 11 for busy.
-; - DPL: the descriptor privilege level, which determines who can access the
-; TSS descriptor.
-; - P: the present bit, which indicates whether the TSS is in memory or not.
-; - G: the granularity bit, which determines how the limit is interpreted.
+section .data
 
-; @var:         Gdt32
-;
-; @brief:       A 64-bit GDT descriptor that contains the code and data segment
-;               descriptors for protected mode.
-;
-Gdt64:                          ; 64-bit GDT descriptor, zero-initialized
-    dq 0                        ; Null entry, required
-    dq 0x0020980000000000       ; Long mode code segment, ring 0
-    dq 0x0020f80000000000       ; Long mode data segment, ring 0
-    dq 0x0000f20000000000       ; Long mode TSS segment, ring 0
-TssDesc:
-    dw TssLen-1                 ; Limit of TSS
-    dw 0                        ; Base of TSS (low)
-    db 0                        ; Base of TSS (middle)
-    db 0x89                     ; Type (9), DPL (0), P (1)
-    db 0                        ; Limit (high), G (0)
-    db 0                        ; Base of TSS (high)
-    dq 0                        ; Base of TSS (upper)
+; The GDT is boot_gdt, which tools/mkdesc.py generates into the linker
+; script together with the IDT. ld fills the base of the TSS descriptor at
+; selector 0x28 with the address of Tss, so the table is complete in the
+; image and start only loads it.
+;
+; @var:         boot_gdt_ptr
+;
+; @brief:       The 10-byte length and address of boot_gdt, for lgdt.
+;
+extern boot_gdt_ptr
 
 %macro pop_regs 0               ; Define macro for restoring the registers
     pop	r15
@@ -134,20 +127,6 @@ TssDesc:
     pop	rax
 %endmacro
 
-; @var:         Gdt64Len
-;
-; @brief:       A constant that holds the length of the Gdt64 descriptor.
-;
-Gdt64Len: equ $-Gdt64           ; Length of Gdt64
-
-; @var:         Gdt64Ptr
-;
-; @brief:       A 10-byte structure that contains the length and address of the
-;               Gdt64 descriptor.
-;
-Gdt64Ptr: dw Gdt64Len-1         ; (Length of Gdt64)-1
-          dq Gdt64              ; Address of Gdt64
-
 ; TSS descriptor for current task
 ; TSS holds info about a task, e.g. registers, I/O, stacks, link
 ; - Base: 32-bit linear address of TSS
@@ -164,12 +143,15 @@ Gdt64Ptr: dw Gdt64Len-1         ; (Length of Gdt64)-1
 ;               a task, such as processor register state, I/O port permissions,
 ;               inner-level stack pointers, and previous TSS link.
 ;
+global Tss
+global Tss_end
 Tss:
     dd 0                        ; First 32 bits reserved, zero
-    dq 0x150000                 ; Next 64 bits are base address
+    dq 0xffffffff80150000       ; Next 64 bits are base address
     times 88 db 0               ; Next 88 bytes reserved, zero
     dd TssLen                   ; Last 32 bits are limit
 
+Tss_end:
 TssLen: equ $-Tss               ; Label for size of TSS
 
 ;
@@ -212,27 +194,11 @@ global start                    ; Declare a global symbol named start
 ;               to the KMain routine, which is the main function of the kernel.
 ;
 start:
-    lgdt [Gdt64Ptr]             ; Load GDT pointer into the GDTR register
-
-; @routine:     SetTss
-; @brief:       Sets the base address and the segment selector of the TSS in the
-;               TSS descriptor and the TR register.
-;
-; @param:       rax   The new base address of the TSS, a 64-bit value.
-;
-; @return:      None, as this routine does not return any value, but modifies
-;               the TSS descriptor and the TR register.
-;
-SetTss:
-    mov rax,Tss                 ; Base address of TSS to RAX
-    mov [TssDesc+2],ax          ; Low 16 bits of RAX to bytes 2 and 3
-    shr rax,16                  ; Shift RAX right by 16 bits
-    mov [TssDesc+4],al          ; Low 8 bits of RAX to byte 4
-    shr rax,8                   ; Shift RAX right by 8 bits
-    mov [TssDesc+7],al          ; Low 8 bits of RAX to byte 7
-    shr rax,8                   ; Shift RAX right by 8 bits
-    mov [TssDesc+8],eax         ; Low 32 bits of RAX to bytes 8 to 11
-    mov ax,0x20                 ; Segment selector for TSS descriptor to AX
+    rdtsc                       ; Time stamp counter to edx:eax
+    mov [BOOT_TIMES+8*7],eax    ; BOOT_STAGE_KERNEL_ENTRY, low half
+    mov [BOOT_TIMES+8*7+4],edx  ; High half, the block is identity mapped
+    lgdt [boot_gdt_ptr]         ; Load GDT pointer into the GDTR register
+    mov ax,0x28                 ; Segment selector for TSS descriptor to AX
     ltr ax                      ; Load TR with AX
 
 ; @routine:     InitPIT
@@ -346,8 +312,9 @@ KernelEntry:
     ;              0xFFFFFFFF, which means that the stack can use the entire
     ;              4 GB of memory.
 
-    mov rsp,0x200000            ; Adjust Kernel stack pointer
-    ; @note:       The stack pointer is set to 0x200000, which is the top of the
+    mov rsp,0xffffffff80200000  ; Adjust Kernel stack pointer
+    ; @note:       The stack pointer is set to 0x200000 in the kernel image
+    ;              window at 0xffffffff80000000, which is the top of the
     ;              kernel stack. The kernel stack grows downward from this
     ;              address. The kernel stack is separate from the boot stack,
     ;              which is used by the boot-loader and the assembly code.
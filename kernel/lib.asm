@@ -0,0 +1,448 @@
+;------------------------------------------------------------------------------
+; @file:        lib.asm
+; @author:      Marko Trickovic (contact@markotrickovic.com)
+; @date:        10/14/2026 09:00 AM
+; @license:     MIT
+; @language:    Assembly
+; @platform:    x86_64
+; @description: This file contains small assembly routines that give the C
+;               code access to processor instructions which have no C
+;               equivalent, such as cpuid, control register access and TLB
+;               invalidation.
+;
+;               All routines follow the System V AMD64 calling convention, the
+;               arguments are passed in rdi, rsi, rdx, rcx, r8 and r9 and the
+;               return value is stored in rax.
+;
+; Revision History:
+;
+;   - Revision 0.1: 10/14/2026 Marko Trickovic
+;     Initial version with read_cpuid, read_cr3, load_cr3 and
+;     invalidate_tlb.
+;
+;   - Revision 0.2: 10/14/2026 Marko Trickovic
+;     Added in_byte, out_byte, read_msr and write_msr.
+;
+;   - Revision 0.3: 10/14/2026 Marko Trickovic
+;     Added irq_save and irq_restore.
+;
+;   - Revision 0.4: 10/14/2026 Marko Trickovic
+;     Added read_tsc.
+;
+;   - Revision 0.5: 10/14/2026 Marko Trickovic
+;     Added wait_for_interrupt.
+;
+;   - Revision 0.6: 10/14/2026 Marko Trickovic
+;     Added cpu_relax.
+;
+;   - Revision 0.7: 10/14/2026 Marko Trickovic
+;     Added read_cr4 and write_cr4, load_cr3 accepts a PCID.
+;
+;   - Revision 0.8: 10/14/2026 Marko Trickovic
+;     Added read_pmc.
+;
+;   - Revision 0.9: 10/14/2026 Marko Trickovic
+;     Added read_cr0, write_cr0, read_xcr0, write_xcr0 and reset_fpu.
+;
+;   - Revision 1.0: 10/14/2026 Marko Trickovic
+;     Added clear_ts and the FXSAVE and XSAVE state routines.
+;
+;   - Revision 1.1: 10/14/2026 Marko Trickovic
+;     Added irq_enable and irq_disable.
+;
+;   - Revision 1.2: 10/14/2026 Marko Trickovic
+;     Added in_dword, out_dword, in_words and out_words.
+;
+;   - Revision 1.3: 10/14/2026 Marko Trickovic
+;     Added read_rflags.
+;
+; Part of the os-dev-udemy-wsl.
+;------------------------------------------------------------------------------
+
+section .text
+global read_cpuid
+global read_cr0
+global write_cr0
+global read_cr3
+global load_cr3
+global read_cr4
+global write_cr4
+global read_xcr0
+global write_xcr0
+global reset_fpu
+global clear_ts
+global fxsave_state
+global fxrstor_state
+global xsave_state
+global xsaveopt_state
+global xrstor_state
+global invalidate_tlb
+global in_byte
+global out_byte
+global in_dword
+global out_dword
+global in_words
+global out_words
+global read_msr
+global write_msr
+global irq_save
+global irq_restore
+global read_rflags
+global irq_enable
+global irq_disable
+global read_tsc
+global read_pmc
+global wait_for_interrupt
+global cpu_relax
+
+; @routine:   read_cpuid
+; @brief:     This function executes the cpuid instruction.
+; @param:     The leaf is passed in edi, the subleaf in esi and a pointer to
+;             the CpuidRegs structure that receives eax, ebx, ecx and edx is
+;             passed in rdx.
+; @return:    None.
+read_cpuid:
+    push rbx
+    mov r8,rdx
+    mov eax,edi
+    mov ecx,esi
+    cpuid
+    mov [r8],eax
+    mov [r8+4],ebx
+    mov [r8+8],ecx
+    mov [r8+12],edx
+    pop rbx
+    ret
+
+; @routine:   read_cr0
+; @brief:     This function reads control register 0.
+; @param:     No parameters are passed to this function.
+; @return:    The value of cr0 is stored in rax.
+read_cr0:
+    mov rax,cr0
+    ret
+
+; @routine:   write_cr0
+; @brief:     This function writes control register 0.
+; @param:     The new value is passed in rdi.
+; @return:    None.
+write_cr0:
+    mov cr0,rdi
+    ret
+
+; @routine:   read_cr3
+; @brief:     This function reads the page map level 4 base register.
+; @param:     No parameters are passed to this function.
+; @return:    The value of cr3 is stored in rax.
+read_cr3:
+    mov rax,cr3
+    ret
+
+; @routine:   load_cr3
+; @brief:     This function loads the page map level 4 base register, which
+;             also flushes all non-global TLB entries. With CR4.PCIDE set
+;             only the entries of the PCID in bits 0-11 are flushed, and none
+;             if bit 63 is set.
+; @param:     The physical address of the PML4 table is passed in rdi.
+; @return:    None.
+load_cr3:
+    mov cr3,rdi
+    ret
+
+; @routine:   read_cr4
+; @brief:     This function reads control register 4.
+; @param:     No parameters are passed to this function.
+; @return:    The value of cr4 is stored in rax.
+read_cr4:
+    mov rax,cr4
+    ret
+
+; @routine:   write_cr4
+; @brief:     This function writes control register 4.
+; @param:     The new value is passed in rdi.
+; @return:    None.
+write_cr4:
+    mov cr4,rdi
+    ret
+
+; @routine:   read_xcr0
+; @brief:     This function reads the extended control register XCR0, the
+;             state components enabled for XSAVE. CR4.OSXSAVE must be set.
+; @param:     No parameters are passed to this function.
+; @return:    The value of XCR0 is stored in rax.
+read_xcr0:
+    xor ecx,ecx
+    xgetbv
+    shl rdx,32
+    or rax,rdx
+    ret
+
+; @routine:   write_xcr0
+; @brief:     This function writes XCR0. CR4.OSXSAVE must be set.
+; @param:     The new value is passed in rdi.
+; @return:    None.
+write_xcr0:
+    xor ecx,ecx
+    mov eax,edi
+    mov rdx,rdi
+    shr rdx,32
+    xsetbv
+    ret
+
+; @routine:   reset_fpu
+; @brief:     This function resets the x87 unit and sets MXCSR to its power-on
+;             value, all exceptions masked and round to nearest.
+; @param:     No parameters are passed to this function.
+; @return:    None.
+reset_fpu:
+    fninit
+    push 0x1f80
+    ldmxcsr [rsp]
+    add rsp,8
+    ret
+
+; @routine:   clear_ts
+; @brief:     This function clears CR0.TS, so x87 and SIMD instructions no
+;             longer raise #NM.
+; @param:     No parameters are passed to this function.
+; @return:    None.
+clear_ts:
+    clts
+    ret
+
+; @routine:   fxsave_state
+; @brief:     This function saves the x87 and SSE state with fxsave64.
+; @param:     The 16-byte aligned 512-byte area is passed in rdi.
+; @return:    None.
+fxsave_state:
+    fxsave64 [rdi]
+    ret
+
+; @routine:   fxrstor_state
+; @brief:     This function loads the x87 and SSE state with fxrstor64.
+; @param:     The area written by fxsave_state is passed in rdi.
+; @return:    None.
+fxrstor_state:
+    fxrstor64 [rdi]
+    ret
+
+; @routine:   xsave_state
+; @brief:     This function saves the state components of a mask with
+;             xsave64.
+; @param:     The 64-byte aligned area is passed in rdi, the mask in rsi.
+; @return:    None.
+xsave_state:
+    mov eax,esi
+    mov rdx,rsi
+    shr rdx,32
+    xsave64 [rdi]
+    ret
+
+; @routine:   xsaveopt_state
+; @brief:     This function saves the state components of a mask with
+;             xsaveopt64, which skips the components that are in their
+;             initial state or unchanged since the last xrstor from the
+;             same area.
+; @param:     The 64-byte aligned area is passed in rdi, the mask in rsi.
+; @return:    None.
+xsaveopt_state:
+    mov eax,esi
+    mov rdx,rsi
+    shr rdx,32
+    xsaveopt64 [rdi]
+    ret
+
+; @routine:   xrstor_state
+; @brief:     This function loads the state components of a mask with
+;             xrstor64. Components missing from the header of the area are
+;             set to their initial state.
+; @param:     The 64-byte aligned area is passed in rdi, the mask in rsi.
+; @return:    None.
+xrstor_state:
+    mov eax,esi
+    mov rdx,rsi
+    shr rdx,32
+    xrstor64 [rdi]
+    ret
+
+; @routine:   invalidate_tlb
+; @brief:     This function invalidates the TLB entry of a single page.
+; @param:     The virtual address of the page is passed in rdi.
+; @return:    None.
+invalidate_tlb:
+    invlpg [rdi]
+    ret
+
+; @routine:   in_byte
+; @brief:     This function reads a byte from an I/O port.
+; @param:     The port number is passed in di.
+; @return:    The byte is stored in al.
+in_byte:
+    mov dx,di
+    in al,dx
+    ret
+
+; @routine:   out_byte
+; @brief:     This function writes a byte to an I/O port.
+; @param:     The port number is passed in di and the value in sil.
+; @return:    None.
+out_byte:
+    mov dx,di
+    mov al,sil
+    out dx,al
+    ret
+
+; @routine:   in_dword
+; @brief:     This function reads a dword from an I/O port.
+; @param:     The port number is passed in di.
+; @return:    The dword is stored in eax.
+in_dword:
+    mov dx,di
+    in eax,dx
+    ret
+
+; @routine:   out_dword
+; @brief:     This function writes a dword to an I/O port.
+; @param:     The port number is passed in di and the value in esi.
+; @return:    None.
+out_dword:
+    mov dx,di
+    mov eax,esi
+    out dx,eax
+    ret
+
+; @routine:   in_words
+; @brief:     This function reads words from an I/O port into memory.
+; @param:     The port number is passed in di, the buffer in rsi and the
+;             number of words in rdx.
+; @return:    None.
+in_words:
+    mov rcx,rdx
+    mov dx,di
+    mov rdi,rsi
+    cld
+    rep insw
+    ret
+
+; @routine:   out_words
+; @brief:     This function writes words from memory to an I/O port.
+; @param:     The port number is passed in di, the buffer in rsi and the
+;             number of words in rdx.
+; @return:    None.
+out_words:
+    mov rcx,rdx
+    mov dx,di
+    cld
+    rep outsw
+    ret
+
+; @routine:   read_msr
+; @brief:     This function reads a model specific register.
+; @param:     The register number is passed in edi.
+; @return:    The 64-bit value is stored in rax.
+read_msr:
+    mov ecx,edi
+    rdmsr
+    shl rdx,32
+    or rax,rdx
+    ret
+
+; @routine:   write_msr
+; @brief:     This function writes a model specific register.
+; @param:     The register number is passed in edi and the value in rsi.
+; @return:    None.
+write_msr:
+    mov ecx,edi
+    mov eax,esi
+    mov rdx,rsi
+    shr rdx,32
+    wrmsr
+    ret
+
+; @routine:   irq_save
+; @brief:     This function disables interrupts on the calling CPU.
+; @param:     No parameters are passed to this function.
+; @return:    The previous rflags value is stored in rax.
+irq_save:
+    pushfq
+    pop rax
+    cli
+    ret
+
+; @routine:   irq_restore
+; @brief:     This function restores the interrupt flag saved by irq_save.
+; @param:     The rflags value is passed in rdi.
+; @return:    None.
+irq_restore:
+    push rdi
+    popfq
+    ret
+
+; @routine:   read_rflags
+; @brief:     This function reads the flags register of the calling CPU.
+; @param:     No parameters are passed to this function.
+; @return:    The rflags value is stored in rax.
+read_rflags:
+    pushfq
+    pop rax
+    ret
+
+; @routine:   irq_enable
+; @brief:     This function enables interrupts on the calling CPU.
+; @param:     No parameters are passed to this function.
+; @return:    None.
+irq_enable:
+    sti
+    ret
+
+; @routine:   irq_disable
+; @brief:     This function disables interrupts on the calling CPU.
+; @param:     No parameters are passed to this function.
+; @return:    None.
+irq_disable:
+    cli
+    ret
+
+; @routine:   read_tsc
+; @brief:     This function reads the time stamp counter.
+; @param:     No parameters are passed to this function.
+; @return:    The 64-bit counter value is stored in rax.
+read_tsc:
+    rdtsc
+    shl rdx,32
+    or rax,rdx
+    ret
+
+; @routine:   read_pmc
+; @brief:     This function reads a performance counter with rdpmc, which
+;             is cheaper than rdmsr of its IA32_PMCx.
+; @param:     The counter number is passed in edi.
+; @return:    The counter value is stored in rax.
+read_pmc:
+    mov ecx,edi
+    rdpmc
+    shl rdx,32
+    or rax,rdx
+    ret
+
+; @routine:   wait_for_interrupt
+; @brief:     This function enables interrupts, halts until an interrupt has
+;             been handled and disables interrupts again. sti only takes
+;             effect after the next instruction, so an interrupt cannot slip
+;             in between sti and hlt.
+; @param:     No parameters are passed to this function.
+; @return:    None.
+wait_for_interrupt:
+    sti
+    hlt
+    cli
+    ret
+
+; @routine:   cpu_relax
+; @brief:     This function executes pause, the spin-wait hint that saves
+;             power and avoids the memory order flush when a spin loop ends.
+; @param:     No parameters are passed to this function.
+; @return:    None.
+cpu_relax:
+    pause
+    ret
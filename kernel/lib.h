@@ -0,0 +1,279 @@
+/* -----------------------------------------------------------------------------
+ * @file:        lib.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the assembly
+ *               routines in lib.asm that give the C code access to processor
+ *               instructions.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version with read_cpuid, read_cr3, load_cr3 and
+ *     invalidate_tlb.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Added in_byte, out_byte, read_msr and write_msr.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Added irq_save and irq_restore.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Added read_tsc.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     Added wait_for_interrupt.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     Added cpu_relax.
+ *
+ *   - Revision 0.7: 10/14/2026 Marko Trickovic
+ *     Added read_cr4 and write_cr4.
+ *
+ *   - Revision 0.8: 10/14/2026 Marko Trickovic
+ *     Added read_pmc.
+ *
+ *   - Revision 0.9: 10/14/2026 Marko Trickovic
+ *     Added read_cr0, write_cr0, read_xcr0, write_xcr0 and reset_fpu.
+ *
+ *   - Revision 1.0: 10/14/2026 Marko Trickovic
+ *     Added clear_ts and the FXSAVE and XSAVE state routines.
+ *
+ *   - Revision 1.1: 10/14/2026 Marko Trickovic
+ *     Added irq_enable and irq_disable.
+ *
+ *   - Revision 1.2: 10/14/2026 Marko Trickovic
+ *     Added in_dword, out_dword, in_words and out_words.
+ *
+ *   - Revision 1.3: 10/14/2026 Marko Trickovic
+ *     Added read_rflags.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _LIB_H_
+#define _LIB_H_
+
+#include "stdint.h"
+#include "stddef.h"
+
+/**
+ * @brief:                The registers returned by the cpuid instruction.
+ *
+ * @struct:               CpuidRegs
+ */
+struct CpuidRegs {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+};
+
+/**
+ * @fn:        read_cpuid(uint32_t leaf, uint32_t subleaf, struct CpuidRegs *regs)
+ *
+ * @brief:     Executes cpuid with eax=leaf and ecx=subleaf.
+ */
+void read_cpuid(uint32_t leaf, uint32_t subleaf, struct CpuidRegs *regs);
+/**
+ * @fn:        read_cr0(void)
+ *
+ * @brief:     Returns the value of cr0.
+ */
+uint64_t read_cr0(void);
+/**
+ * @fn:        write_cr0(uint64_t value)
+ *
+ * @brief:     Writes cr0.
+ */
+void write_cr0(uint64_t value);
+/**
+ * @fn:        read_cr3(void)
+ *
+ * @brief:     Returns the physical address of the active PML4 table.
+ */
+uint64_t read_cr3(void);
+/**
+ * @fn:        load_cr3(uint64_t pml4)
+ *
+ * @brief:     Switches to the PML4 table at the given physical address.
+ */
+void load_cr3(uint64_t pml4);
+/**
+ * @fn:        read_cr4(void)
+ *
+ * @brief:     Returns the value of cr4.
+ */
+uint64_t read_cr4(void);
+/**
+ * @fn:        write_cr4(uint64_t value)
+ *
+ * @brief:     Writes cr4.
+ */
+void write_cr4(uint64_t value);
+/**
+ * @fn:        read_xcr0(void)
+ *
+ * @brief:     Returns the value of XCR0. CR4.OSXSAVE must be set.
+ */
+uint64_t read_xcr0(void);
+/**
+ * @fn:        write_xcr0(uint64_t value)
+ *
+ * @brief:     Writes XCR0. CR4.OSXSAVE must be set.
+ */
+void write_xcr0(uint64_t value);
+/**
+ * @fn:        reset_fpu(void)
+ *
+ * @brief:     Resets the x87 unit and sets MXCSR to its power-on value.
+ */
+void reset_fpu(void);
+/**
+ * @fn:        clear_ts(void)
+ *
+ * @brief:     Clears CR0.TS.
+ */
+void clear_ts(void);
+/**
+ * @fn:        fxsave_state(void *area)
+ *
+ * @brief:     Saves the x87 and SSE state to a 512-byte area.
+ */
+void fxsave_state(void *area);
+/**
+ * @fn:        fxrstor_state(const void *area)
+ *
+ * @brief:     Loads the x87 and SSE state from a 512-byte area.
+ */
+void fxrstor_state(const void *area);
+/**
+ * @fn:        xsave_state(void *area, uint64_t mask)
+ *
+ * @brief:     Saves the state components in mask with XSAVE.
+ */
+void xsave_state(void *area, uint64_t mask);
+/**
+ * @fn:        xsaveopt_state(void *area, uint64_t mask)
+ *
+ * @brief:     Saves the modified state components in mask with XSAVEOPT.
+ */
+void xsaveopt_state(void *area, uint64_t mask);
+/**
+ * @fn:        xrstor_state(const void *area, uint64_t mask)
+ *
+ * @brief:     Loads the state components in mask with XRSTOR.
+ */
+void xrstor_state(const void *area, uint64_t mask);
+/**
+ * @fn:        invalidate_tlb(uint64_t va)
+ *
+ * @brief:     Invalidates the TLB entry of the page containing va.
+ */
+void invalidate_tlb(uint64_t va);
+/**
+ * @fn:        in_byte(uint16_t port)
+ *
+ * @brief:     Reads a byte from an I/O port.
+ */
+uint8_t in_byte(uint16_t port);
+/**
+ * @fn:        out_byte(uint16_t port, uint8_t value)
+ *
+ * @brief:     Writes a byte to an I/O port.
+ */
+void out_byte(uint16_t port, uint8_t value);
+/**
+ * @fn:        in_dword(uint16_t port)
+ *
+ * @brief:     Reads a dword from an I/O port.
+ */
+uint32_t in_dword(uint16_t port);
+/**
+ * @fn:        out_dword(uint16_t port, uint32_t value)
+ *
+ * @brief:     Writes a dword to an I/O port.
+ */
+void out_dword(uint16_t port, uint32_t value);
+/**
+ * @fn:        in_words(uint16_t port, void *buf, size_t count)
+ *
+ * @brief:     Reads count words from an I/O port into buf.
+ */
+void in_words(uint16_t port, void *buf, size_t count);
+/**
+ * @fn:        out_words(uint16_t port, const void *buf, size_t count)
+ *
+ * @brief:     Writes count words of buf to an I/O port.
+ */
+void out_words(uint16_t port, const void *buf, size_t count);
+/**
+ * @fn:        read_msr(uint32_t msr)
+ *
+ * @brief:     Reads a model specific register.
+ */
+uint64_t read_msr(uint32_t msr);
+/**
+ * @fn:        write_msr(uint32_t msr, uint64_t value)
+ *
+ * @brief:     Writes a model specific register.
+ */
+void write_msr(uint32_t msr, uint64_t value);
+/**
+ * @fn:        irq_save(void)
+ *
+ * @brief:     Disables interrupts and returns the previous rflags value.
+ */
+uint64_t irq_save(void);
+/**
+ * @fn:        irq_restore(uint64_t flags)
+ *
+ * @brief:     Restores the interrupt flag from a value returned by irq_save.
+ */
+void irq_restore(uint64_t flags);
+/**
+ * @fn:        read_rflags(void)
+ *
+ * @brief:     Returns the rflags value of the calling CPU.
+ */
+uint64_t read_rflags(void);
+/**
+ * @fn:        irq_enable(void)
+ *
+ * @brief:     Enables interrupts on the calling CPU.
+ */
+void irq_enable(void);
+/**
+ * @fn:        irq_disable(void)
+ *
+ * @brief:     Disables interrupts on the calling CPU.
+ */
+void irq_disable(void);
+/**
+ * @fn:        read_tsc(void)
+ *
+ * @brief:     Returns the time stamp counter.
+ */
+uint64_t read_tsc(void);
+/**
+ * @fn:        read_pmc(uint32_t counter)
+ *
+ * @brief:     Reads a general-purpose performance counter.
+ */
+uint64_t read_pmc(uint32_t counter);
+/**
+ * @fn:        wait_for_interrupt(void)
+ *
+ * @brief:     Enables interrupts, halts until one interrupt has been handled
+ *             and returns with interrupts disabled.
+ */
+void wait_for_interrupt(void);
+/**
+ * @fn:        cpu_relax(void)
+ *
+ * @brief:     Hints the CPU that the caller is spinning.
+ */
+void cpu_relax(void);
+
+#endif
@@ -20,10 +20,94 @@
  *   - Revision 0.3: 11/12/2023 Marko Trickovic
  *     Refactored the comments to improve readability.
  *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Initialize the physical memory manager from the E820 memory map.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     Rebuild the page tables with a large page direct map of all memory.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     Create the kmalloc caches of the slab allocator.
+ *
+ *   - Revision 0.7: 10/14/2026 Marko Trickovic
+ *     Switch interrupt delivery from the 8259 to the local APIC and IOAPIC.
+ *
+ *   - Revision 0.8: 10/14/2026 Marko Trickovic
+ *     Replace the periodic PIT tick with one-shot timer interrupts.
+ *
+ *   - Revision 0.9: 10/14/2026 Marko Trickovic
+ *     Calibrate the TSC clock before the timer.
+ *
+ *   - Revision 1.0: 10/14/2026 Marko Trickovic
+ *     Start the application processors.
+ *
+ *   - Revision 1.1: 10/14/2026 Marko Trickovic
+ *     Start the scheduler. The per-CPU data of the BSP is set up before the
+ *     timer, the APs are started last.
+ *
+ *   - Revision 1.2: 10/14/2026 Marko Trickovic
+ *     Set up the kernel log first and start its drain task.
+ *
+ *   - Revision 1.3: 10/14/2026 Marko Trickovic
+ *     Start the optional interrupt statistics dump.
+ *
+ *   - Revision 1.4: 10/14/2026 Marko Trickovic
+ *     Start the optional sampling profiler.
+ *
+ *   - Revision 1.5: 10/14/2026 Marko Trickovic
+ *     Set up the performance counters.
+ *
+ *   - Revision 1.6: 10/14/2026 Marko Trickovic
+ *     The benchmark kernel starts the benchmark task last.
+ *
+ *   - Revision 1.7: 10/14/2026 Marko Trickovic
+ *     Enable SSE and choose the string routines after the IDT is set up.
+ *
+ *   - Revision 1.8: 10/14/2026 Marko Trickovic
+ *     init_fpu runs after init_slab, which holds the FPU state areas.
+ *
+ *   - Revision 1.9: 10/14/2026 Marko Trickovic
+ *     Start the softirqs after the scheduler.
+ *
+ *   - Revision 2.0: 10/14/2026 Marko Trickovic
+ *     Start the keyboard and UART drivers.
+ *
+ *   - Revision 2.1: 10/14/2026 Marko Trickovic
+ *     Start the block layer and the AHCI and ATA disk drivers.
+ *
+ *   - Revision 2.2: 10/14/2026 Marko Trickovic
+ *     Start the buffer cache.
+ *
+ *   - Revision 2.3: 10/14/2026 Marko Trickovic
+ *     Stamp the end of init_idt and print the boot time stamps.
+ *
  * Part of the os-dev-udemy-wsl.
  *****************************************************************************/
 
 #include "trap.h"
+#include "memory.h"
+#include "paging.h"
+#include "slab.h"
+#include "acpi.h"
+#include "apic.h"
+#include "clock.h"
+#include "timer.h"
+#include "smp.h"
+#include "sched.h"
+#include "printk.h"
+#include "prof.h"
+#include "pmu.h"
+#include "bench.h"
+#include "fpu.h"
+#include "string.h"
+#include "softirq.h"
+#include "kbd.h"
+#include "uart.h"
+#include "blk.h"
+#include "ahci.h"
+#include "ata.h"
+#include "bcache.h"
+#include "boottime.h"
 
 /**
  * @brief:          The main function of the kernel.
@@ -33,14 +117,110 @@
  * @return:         None
  *
  * @description:    This function is the entry point of the kernel, which is the
- *                  core component of the operating system. The function calls
- *                  the init_idt function to initialize the interrupt descriptor
- *                  table, which is a data structure that maps each interrupt
- *                  vector to an interrupt handler function. The function then
- *                  enters an infinite loop, waiting for interrupts to occur and
- *                  handle them accordingly.
+ *                  core component of the operating system. The function
+ *                  initializes the kernel subsystems in dependency order:
+ *
+ *                      - init_printk clears the console and sets up
+ *                        COM1 for the kernel log.
+ *
+ *                      - init_idt sets up the interrupt descriptor table.
+ *                        Its end is the last boot time stamp, the stamps
+ *                        are printed once the other CPUs are started.
+ *
+ *                      - init_memory builds the free frame lists from the
+ *                        memory map collected by the loader.
+ *
+ *                      - init_paging maps all physical memory.
+ *
+ *                      - init_slab creates the kmalloc caches.
+ *
+ *                      - init_fpu enables SSE and, with XSAVE, AVX, and
+ *                        creates the cache of the task FPU state areas.
+ *
+ *                      - init_string chooses the memcpy and memset loops.
+ *
+ *                      - init_acpi reads the interrupt topology from the
+ *                        MADT.
+ *
+ *                      - init_apic enables the local APIC, routes the timer
+ *                        through the IOAPIC and masks the 8259.
+ *
+ *                      - init_clock calibrates the TSC against the PIT.
+ *
+ *                      - init_smp sets up the per-CPU data of the boot CPU.
+ *
+ *                      - init_pmu detects the performance counters and
+ *                        routes their overflow interrupt.
+ *
+ *                      - init_timer switches to one-shot timer interrupts
+ *                        of the local APIC.
+ *
+ *                      - init_sched creates the run queue of the boot CPU.
+ *
+ *                      - init_softirq starts the softirqd task of the boot
+ *                        CPU.
+ *
+ *                      - init_kbd and init_uart enable the interrupts of the
+ *                        keyboard and COM1.
+ *
+ *                      - init_blk creates the block request cache, then
+ *                        init_ahci and init_ata register the disks of the
+ *                        AHCI controller and the primary IDE channel.
+ *
+ *                      - init_bcache starts the writeback task of the
+ *                        buffer cache.
+ *
+ *                      - init_printk_task starts the task that writes the
+ *                        log to the console.
+ *
+ *                      - init_irq_stats_task starts the periodic dump of
+ *                        the interrupt statistics, if it is built in.
+ *
+ *                      - init_prof starts the sampling profiler, if it is
+ *                        built in.
+ *
+ *                      - start_aps starts the other CPUs.
+ *
+ *                      - init_bench starts the benchmarks, in the kernel of
+ *                        bench.img.
+ *
+ *                  When it returns, the caller enables interrupts and enters
+ *                  an infinite loop, which is the idle task of the boot CPU.
  */
 void KMain(void)
 {
+    init_printk();
     init_idt();
+    boot_time_stamp(BOOT_STAGE_IDT);
+    init_memory();
+    init_paging();
+    init_slab();
+    init_fpu();
+    init_string();
+    init_acpi();
+    init_apic();
+    init_clock();
+    init_smp();
+    init_pmu();
+    init_timer();
+    init_sched();
+    init_softirq();
+    init_kbd();
+    init_uart();
+    init_blk();
+    init_ahci();
+    init_ata();
+    init_bcache();
+    init_printk_task();
+    init_irq_stats_task();
+    init_prof();
+    start_aps();
+
+    print_boot_times();
+    printk("kernel: %u CPUs, %lu of %lu MiB free\n", get_cpu_count(),
+           get_free_memory()>>20, get_total_memory()>>20);
+
+#ifdef BENCH
+    init_bench();
+#endif
 }
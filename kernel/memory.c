@@ -0,0 +1,467 @@
+/******************************************************************************
+ * @file:        memory.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the physical memory manager of the kernel.
+ *
+ *               init_memory walks the E820 memory map that the loader stored
+ *               at 0x9000 exactly once. It places an array of Frame
+ *               descriptors, one per 4 KiB frame, in the first usable range
+ *               above the kernel and then splits every run of free frames into
+ *               the largest naturally aligned blocks it can.
+ *
+ *               The blocks are kept on per-order free lists (order 0 is 4 KiB,
+ *               order 9 is 2 MiB). A bitmap records which lists are non-empty,
+ *               so finding a block is a single bit scan. Allocation splits a
+ *               larger block when needed, and release merges a block with its
+ *               buddy for as long as the buddy is free.
+ *
+ *               The lists are protected by one MCS lock, taken with
+ *               interrupts disabled because frames are also freed from
+ *               interrupt context. Every CPU allocates kernel stacks and
+ *               slabs here, and the MCS queue keeps the waiters off the
+ *               cache line of the lock.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the buddy frame allocator.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Protect the free lists with a spinlock.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Use an MCS lock for the free lists.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "memory.h"
+#include "sync.h"
+
+/**
+ * @brief:       The end of the kernel image, defined in link.lds.
+ */
+extern char end[];
+
+/**
+ * @brief:       The head and the tail of the free list of one order.
+ *
+ * @struct:      FreeArea
+ *
+ * @param:       head   The first frame number on the list
+ * @param:       tail   The last frame number on the list
+ * @param:       count  The number of blocks on the list
+ */
+struct FreeArea {
+    uint32_t head;
+    uint32_t tail;
+    uint64_t count;
+};
+
+static struct FreeArea free_area[MAX_ORDER+1];
+static uint32_t free_bitmap;
+
+static struct Frame *frames;
+static uint64_t frame_count;
+static uint64_t total_frames;
+static uint64_t free_frame_count;
+static uint64_t memory_end;
+
+static struct McsLock zone_lock = MCS_LOCK_INIT;
+
+/**
+ * @brief:     Adds a block to the front of the free list of its order.
+ *
+ * @param[in]: pfn    the first frame number of the block
+ * @param[in]: order  the order of the block
+ *
+ * @return:    None
+ */
+static void push_head(uint32_t pfn, unsigned int order)
+{
+    struct FreeArea *area = &free_area[order];
+    struct Frame *frame = &frames[pfn];
+
+    frame->order = order;
+    frame->flags = FRAME_FREE;
+    frame->prev = FRAME_NONE;
+    frame->next = area->head;
+
+    if (area->head != FRAME_NONE) {
+        frames[area->head].prev = pfn;
+    }
+    else {
+        area->tail = pfn;
+    }
+
+    area->head = pfn;
+    area->count++;
+    free_bitmap |= (1U<<order);
+}
+
+/**
+ * @brief:     Adds a block to the back of the free list of its order. Used
+ *             while the lists are built so the lowest frames are handed out
+ *             first.
+ *
+ * @param[in]: pfn    the first frame number of the block
+ * @param[in]: order  the order of the block
+ *
+ * @return:    None
+ */
+static void push_tail(uint32_t pfn, unsigned int order)
+{
+    struct FreeArea *area = &free_area[order];
+    struct Frame *frame = &frames[pfn];
+
+    frame->order = order;
+    frame->flags = FRAME_FREE;
+    frame->next = FRAME_NONE;
+    frame->prev = area->tail;
+
+    if (area->tail != FRAME_NONE) {
+        frames[area->tail].next = pfn;
+    }
+    else {
+        area->head = pfn;
+    }
+
+    area->tail = pfn;
+    area->count++;
+    free_bitmap |= (1U<<order);
+}
+
+/**
+ * @brief:     Unlinks a block from the free list of its order.
+ *
+ * @param[in]: pfn    the first frame number of the block
+ * @param[in]: order  the order of the block
+ *
+ * @return:    None
+ */
+static void unlink(uint32_t pfn, unsigned int order)
+{
+    struct FreeArea *area = &free_area[order];
+    struct Frame *frame = &frames[pfn];
+
+    if (frame->prev != FRAME_NONE) {
+        frames[frame->prev].next = frame->next;
+    }
+    else {
+        area->head = frame->next;
+    }
+
+    if (frame->next != FRAME_NONE) {
+        frames[frame->next].prev = frame->prev;
+    }
+    else {
+        area->tail = frame->prev;
+    }
+
+    frame->flags &= ~FRAME_FREE;
+    frame->next = FRAME_NONE;
+    frame->prev = FRAME_NONE;
+
+    if (--area->count == 0) {
+        free_bitmap &= ~(1U<<order);
+    }
+}
+
+/**
+ * @brief:     Splits a run of free frames into the largest naturally aligned
+ *             blocks and queues them on the free lists.
+ *
+ * @param[in]: start  the first frame number of the run
+ * @param[in]: stop   the frame number after the run
+ *
+ * @return:    None
+ */
+static void free_range(uint64_t start, uint64_t stop)
+{
+    unsigned int order;
+
+    while (start < stop) {
+        order = MAX_ORDER;
+        while (order > 0 &&
+               ((start&((1UL<<order)-1)) != 0 || start+(1UL<<order) > stop)) {
+            order--;
+        }
+
+        push_tail((uint32_t)start, order);
+        start += (1UL<<order);
+    }
+}
+
+/**
+ * @brief:     Marks the frames overlapping [start, stop) with the given flags.
+ *
+ * @param[in]: start  the physical start address
+ * @param[in]: stop   the physical end address
+ * @param[in]: flags  the flags stored in each frame
+ *
+ * @return:    None
+ */
+static void mark_range(uint64_t start, uint64_t stop, uint8_t flags)
+{
+    uint64_t pfn = start>>PAGE_SHIFT;
+    uint64_t last = stop>>PAGE_SHIFT;
+
+    if (last > frame_count) {
+        last = frame_count;
+    }
+
+    for (; pfn < last; pfn++) {
+        frames[pfn].flags = flags;
+    }
+}
+
+/**
+ * @brief:          A function that initializes the physical memory manager.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    This function sizes the frame array from the highest usable
+ *                  E820 address, places it in the first usable range above the
+ *                  kernel image that is covered by the boot page tables, and
+ *                  builds the free lists. Usable ranges are applied first and
+ *                  every other range type is applied on top of them, so an
+ *                  overlapping reserved range always wins.
+ */
+void init_memory(void)
+{
+    struct E820Entry *map = (struct E820Entry *)P2V(E820_ADDR);
+    uint64_t kernel_end = PA_UP(V2P(end));
+    uint64_t array_start = 0;
+    uint64_t array_size;
+    uint64_t start, stop, pfn;
+    int count = 0;
+    int i;
+
+    while (count < E820_MAX_ENTRIES &&
+           (map[count].length != 0 || map[count].type != 0)) {
+        if (map[count].type == E820_USABLE &&
+            map[count].address+map[count].length > memory_end) {
+            memory_end = map[count].address+map[count].length;
+        }
+        count++;
+    }
+
+    frame_count = PA_DOWN(memory_end)>>PAGE_SHIFT;
+    array_size = PA_UP(frame_count*sizeof(struct Frame));
+
+    for (i = 0; i < count; i++) {
+        if (map[i].type != E820_USABLE) {
+            continue;
+        }
+
+        start = PA_UP(map[i].address);
+        stop = PA_DOWN(map[i].address+map[i].length);
+        if (start < kernel_end) {
+            start = kernel_end;
+        }
+        if (stop > BOOT_MAP_LIMIT) {
+            stop = BOOT_MAP_LIMIT;
+        }
+
+        if (start < stop && stop-start >= array_size) {
+            array_start = start;
+            break;
+        }
+    }
+
+    if (array_start == 0) {
+        while (1) { }
+    }
+
+    frames = (struct Frame *)P2V(array_start);
+    for (pfn = 0; pfn < frame_count; pfn++) {
+        frames[pfn].next = FRAME_NONE;
+        frames[pfn].prev = FRAME_NONE;
+        frames[pfn].order = 0;
+        frames[pfn].flags = FRAME_RESERVED;
+        frames[pfn].res0 = 0;
+        frames[pfn].private = 0;
+    }
+
+    for (i = 0; i < MAX_ORDER+1; i++) {
+        free_area[i].head = FRAME_NONE;
+        free_area[i].tail = FRAME_NONE;
+        free_area[i].count = 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (map[i].type == E820_USABLE) {
+            mark_range(PA_UP(map[i].address),
+                       PA_DOWN(map[i].address+map[i].length), 0);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        if (map[i].type != E820_USABLE) {
+            mark_range(PA_DOWN(map[i].address),
+                       PA_UP(map[i].address+map[i].length), FRAME_RESERVED);
+        }
+    }
+
+    mark_range(0, kernel_end, FRAME_RESERVED);
+    mark_range(array_start, array_start+array_size, FRAME_RESERVED);
+
+    pfn = 0;
+    while (pfn < frame_count) {
+        if (frames[pfn].flags & FRAME_RESERVED) {
+            pfn++;
+            continue;
+        }
+
+        start = pfn;
+        while (pfn < frame_count && !(frames[pfn].flags & FRAME_RESERVED)) {
+            pfn++;
+        }
+
+        free_range(start, pfn);
+        total_frames += pfn-start;
+    }
+
+    free_frame_count = total_frames;
+}
+
+/**
+ * @brief:          A function that allocates a block of 2^order frames.
+ *
+ * @param[in]:      order  the order of the block, at most MAX_ORDER
+ *
+ * @return:         The physical address of the block, or 0 if there is no free
+ *                  block of the requested order or larger.
+ *
+ * @description:    The smallest non-empty list of a sufficient order is found
+ *                  with a single bit scan of free_bitmap. If that list holds a
+ *                  larger block, the upper halves are returned to the lower
+ *                  order lists until the block has the requested size.
+ */
+uint64_t alloc_frames(unsigned int order)
+{
+    uint32_t mask;
+    uint32_t pfn;
+    unsigned int current;
+    struct McsNode node;
+    uint64_t flags;
+
+    if (order > MAX_ORDER) {
+        return 0;
+    }
+
+    flags = mcs_lock_irqsave(&zone_lock, &node);
+    mask = free_bitmap&~((1U<<order)-1);
+    if (mask == 0) {
+        mcs_unlock_irqrestore(&zone_lock, &node, flags);
+        return 0;
+    }
+
+    current = (unsigned int)__builtin_ctz(mask);
+    pfn = free_area[current].head;
+    unlink(pfn, current);
+
+    while (current > order) {
+        current--;
+        push_head(pfn+(1U<<current), current);
+    }
+
+    frames[pfn].order = order;
+    free_frame_count -= (1UL<<order);
+    mcs_unlock_irqrestore(&zone_lock, &node, flags);
+
+    return (uint64_t)pfn<<PAGE_SHIFT;
+}
+
+/**
+ * @brief:          A function that releases a block of 2^order frames.
+ *
+ * @param[in]:      addr   the physical address returned by alloc_frames
+ * @param[in]:      order  the order passed to alloc_frames
+ *
+ * @return:         None
+ *
+ * @description:    The block is merged with its buddy as long as the buddy is
+ *                  the head of a free block of the same order. Reserved frames
+ *                  never carry FRAME_FREE, so holes in the memory map stop the
+ *                  merging on their own.
+ */
+void free_frames(uint64_t addr, unsigned int order)
+{
+    uint32_t pfn = (uint32_t)(addr>>PAGE_SHIFT);
+    uint32_t buddy;
+    struct McsNode node;
+    uint64_t flags;
+
+    if (order > MAX_ORDER || pfn >= frame_count) {
+        return;
+    }
+
+    flags = mcs_lock_irqsave(&zone_lock, &node);
+    frames[pfn].private = 0;
+    free_frame_count += (1UL<<order);
+
+    while (order < MAX_ORDER) {
+        buddy = pfn^(1U<<order);
+        if (buddy >= frame_count ||
+            !(frames[buddy].flags & FRAME_FREE) ||
+            frames[buddy].order != order) {
+            break;
+        }
+
+        unlink(buddy, order);
+        pfn &= ~(1U<<order);
+        order++;
+    }
+
+    push_head(pfn, order);
+    mcs_unlock_irqrestore(&zone_lock, &node, flags);
+}
+
+/**
+ * @brief:     Returns the descriptor of the frame containing addr.
+ *
+ * @param[in]: addr  a physical address
+ *
+ * @return:    The frame descriptor, or 0 if addr is not managed.
+ */
+struct Frame *addr_to_frame(uint64_t addr)
+{
+    uint64_t pfn = addr>>PAGE_SHIFT;
+
+    if (pfn >= frame_count) {
+        return 0;
+    }
+
+    return &frames[pfn];
+}
+
+/**
+ * @brief:     Returns the end of the highest usable E820 range.
+ */
+uint64_t get_memory_end(void)
+{
+    return memory_end;
+}
+
+/**
+ * @brief:     Returns the number of bytes managed by the allocator.
+ */
+uint64_t get_total_memory(void)
+{
+    return total_frames<<PAGE_SHIFT;
+}
+
+/**
+ * @brief:     Returns the number of bytes currently free.
+ */
+uint64_t get_free_memory(void)
+{
+    return free_frame_count<<PAGE_SHIFT;
+}
@@ -0,0 +1,178 @@
+/* -----------------------------------------------------------------------------
+ * @file:        memory.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the data
+ *               structures and functions of the physical memory manager.
+ *
+ *               The loader collects the BIOS E820 memory map at 0x9000. The
+ *               physical memory manager reads that map once in KMain and hands
+ *               out page frames with a buddy allocator.
+ *
+ *                  - Every 4 KiB frame has a small Frame descriptor in a flat
+ *                    array that is indexed by the page frame number.
+ *
+ *                  - Free blocks of 2^order frames are kept on per-order free
+ *                    lists that are linked through the Frame descriptors, so
+ *                    the free memory itself is never touched.
+ *
+ *               Allocation and release cost at most MAX_ORDER list operations,
+ *               independent of the amount of memory in the machine.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the buddy frame allocator.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Access physical memory through the direct map at KERNEL_BASE.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     The kernel image is linked at KERNEL_VMA.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include "stdint.h"
+
+#define PAGE_SHIFT          12
+#define PAGE_SIZE           (1UL<<PAGE_SHIFT)
+#define LARGE_PAGE_ORDER    9
+#define LARGE_PAGE_SIZE     (PAGE_SIZE<<LARGE_PAGE_ORDER)
+#define MAX_ORDER           LARGE_PAGE_ORDER
+
+#define PA_UP(a)            ((((uint64_t)(a))+PAGE_SIZE-1)&~(PAGE_SIZE-1))
+#define PA_DOWN(a)          (((uint64_t)(a))&~(PAGE_SIZE-1))
+
+/*
+ * All physical memory is mapped at KERNEL_BASE. The kernel image is linked in
+ * the top 2 GiB at KERNEL_VMA, which maps the first 1 GiB of physical memory,
+ * so V2P accepts addresses of both windows.
+ */
+#define KERNEL_BASE         0xffff800000000000UL
+#define KERNEL_VMA          0xffffffff80000000UL
+#define P2V(p)              (((uint64_t)(p))+KERNEL_BASE)
+#define V2P(v)              (((uint64_t)(v)) >= KERNEL_VMA ? \
+                             ((uint64_t)(v))-KERNEL_VMA : \
+                             ((uint64_t)(v))-KERNEL_BASE)
+
+#define E820_ADDR           0x9000
+#define E820_MAX_ENTRIES    128
+#define E820_USABLE         1
+
+#define BOOT_MAP_LIMIT      (1UL<<30)
+
+#define FRAME_NONE          0xffffffffU
+
+#define FRAME_RESERVED      (1<<0)
+#define FRAME_FREE          (1<<1)
+#define FRAME_SLAB          (1<<2)
+
+/**
+ * @brief:                The structure of a BIOS E820 memory map entry.
+ *
+ * @struct:               E820Entry
+ *
+ * @param[in]: address   The physical base address of the range
+ * @param[in]: length    The length of the range in bytes
+ * @param[in]: type      The type of the range, 1 means usable RAM
+ */
+struct E820Entry {
+    uint64_t address;
+    uint64_t length;
+    uint32_t type;
+} __attribute__((packed));
+
+/**
+ * @brief:                The descriptor of a physical page frame.
+ *
+ * @struct:               Frame
+ *
+ * @param:     next      The next frame number on the free list
+ * @param:     prev      The previous frame number on the free list
+ * @param:     order     The order of the block that starts at this frame
+ * @param:     flags     FRAME_RESERVED, FRAME_FREE or FRAME_SLAB
+ * @param:     res0      Reserved, set to zero
+ * @param:     private   Owner specific value of an allocated frame
+ */
+struct Frame {
+    uint32_t next;
+    uint32_t prev;
+    uint8_t order;
+    uint8_t flags;
+    uint16_t res0;
+    uint32_t private;
+};
+
+/**
+ * @fn:        init_memory(void)
+ *
+ * @brief:     Builds the free frame lists from the E820 memory map.
+ */
+void init_memory(void);
+/**
+ * @fn:        alloc_frames(unsigned int order)
+ *
+ * @brief:     Allocates 2^order physically contiguous frames.
+ *
+ * @return:    The physical address of the block, aligned to its size, or 0
+ *             if no block is available.
+ */
+uint64_t alloc_frames(unsigned int order);
+/**
+ * @fn:        free_frames(uint64_t addr, unsigned int order)
+ *
+ * @brief:     Returns a block allocated by alloc_frames to the allocator.
+ */
+void free_frames(uint64_t addr, unsigned int order);
+/**
+ * @fn:        addr_to_frame(uint64_t addr)
+ *
+ * @brief:     Returns the descriptor of the frame containing addr, or 0 if
+ *             the address is outside the managed memory.
+ */
+struct Frame *addr_to_frame(uint64_t addr);
+/**
+ * @fn:        get_memory_end(void)
+ *
+ * @brief:     Returns the end of the highest usable E820 range.
+ */
+uint64_t get_memory_end(void);
+/**
+ * @fn:        get_total_memory(void)
+ *
+ * @brief:     Returns the number of bytes managed by the allocator.
+ */
+uint64_t get_total_memory(void);
+/**
+ * @fn:        get_free_memory(void)
+ *
+ * @brief:     Returns the number of bytes currently free.
+ */
+uint64_t get_free_memory(void);
+
+static inline uint64_t alloc_frame(void)
+{
+    return alloc_frames(0);
+}
+
+static inline void free_frame(uint64_t addr)
+{
+    free_frames(addr, 0);
+}
+
+static inline uint64_t alloc_large_frame(void)
+{
+    return alloc_frames(LARGE_PAGE_ORDER);
+}
+
+static inline void free_large_frame(uint64_t addr)
+{
+    free_frames(addr, LARGE_PAGE_ORDER);
+}
+
+#endif
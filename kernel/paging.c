@@ -0,0 +1,705 @@
+/******************************************************************************
+ * @file:        paging.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the kernel page table manager.
+ *
+ *               The loader only maps the first 1 GiB. init_paging builds a new
+ *               PML4 from frames of the physical memory manager that maps all
+ *               physical memory, and at least the 4 GiB that hold the APIC and
+ *               other MMIO ranges, at KERNEL_BASE. Each 1 GiB of the direct map
+ *               is a single PDPT entry when the CPU reports 1G page support
+ *               (CPUID 0x80000001, EDX bit 26), or a page directory of 2 MiB
+ *               entries otherwise. The kernel image window at KERNEL_VMA
+ *               reuses the entry of the first 1 GiB. All these entries are
+ *               global. The PDPT of the MMIO window is allocated up front, so
+ *               that no upper half PML4 entry is added later.
+ *
+ *               The 4 KiB map_page and unmap_page functions walk the tables
+ *               and allocate the missing levels on demand.
+ *
+ *               Device registers are not accessed through the write-back
+ *               direct map. map_mmio maps them uncached into a separate
+ *               window at MMIO_BASE.
+ *
+ *               Address spaces copy the upper half of the kernel PML4. The
+ *               per-CPU TlbState keeps the current address space and the
+ *               TLB_SLOTS PCID slots of the CPU. Loading an address space
+ *               finds its slot by id and keeps the TLB entries of the slot
+ *               only if the slot has seen the current tlb_gen. A CPU sets its
+ *               bit in cpus before it reads tlb_gen. address_space_flush
+ *               increments tlb_gen before it reads cpus, so every CPU either
+ *               sees the new generation or is found in cpus and sent
+ *               TLB_VECTOR, and the caller waits for those to flush.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the page table manager.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Added map_mmio for uncached device register mappings.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Removed the identity map, map the kernel image at KERNEL_VMA with
+ *     global pages. Added address spaces with PCID based TLB slots.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Clear new page tables with memset.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     map_page refuses user pages at USER_TOP and above.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "paging.h"
+#include "memory.h"
+#include "slab.h"
+#include "smp.h"
+#include "apic.h"
+#include "trap.h"
+#include "sched.h"
+#include "string.h"
+#include "lib.h"
+
+/**
+ * @brief:       The address space that owns a PCID of a CPU.
+ *
+ * @struct:      TlbSlot
+ *
+ * @param:       id     The id of the address space, 0 if the slot is free
+ * @param:       gen    The tlb_gen of the address space at its last flush
+ */
+struct TlbSlot {
+    uint64_t id;
+    uint64_t gen;
+};
+
+/**
+ * @brief:       The TLB state of a CPU.
+ *
+ * @struct:      TlbState
+ *
+ * @param:       current  The loaded address space, 0 for the kernel PML4
+ * @param:       slots    The PCID slots, slot i uses PCID i+1
+ * @param:       next     The slot to reuse next
+ * @param:       flushes  Counts the TLB_VECTOR requests handled
+ */
+struct TlbState {
+    struct AddressSpace *current;
+    struct TlbSlot slots[TLB_SLOTS];
+    uint32_t next;
+    struct Atomic flushes;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * @brief:       The kernel PML4 table, accessed through the direct map.
+ */
+static uint64_t *kernel_pml4;
+
+/**
+ * @brief:       The next free address of the MMIO window.
+ */
+static uint64_t mmio_next = MMIO_BASE;
+
+static struct TlbState tlb_states[MAX_CPUS];
+static struct Atomic next_space_id = ATOMIC_INIT(0);
+static bool pcid_enabled;
+
+/**
+ * @brief:     Allocates and clears a page table frame.
+ *
+ * @return:    The direct map address of the table, or 0 if no frame is free.
+ */
+static uint64_t *alloc_table(void)
+{
+    uint64_t addr = alloc_frame();
+    uint64_t *table;
+
+    if (addr == 0) {
+        return 0;
+    }
+
+    table = (uint64_t *)P2V(addr);
+    memset(table, 0, PAGE_SIZE);
+
+    return table;
+}
+
+/**
+ * @brief:     Returns the table referenced by an entry, allocating it when the
+ *             entry is not present.
+ *
+ * @param:     table  the table holding the entry
+ * @param[in]: index  the index of the entry
+ * @param[in]: alloc  whether a missing table is allocated
+ * @param[in]: flags  the flags of the final mapping, PTE_U is propagated
+ *
+ * @return:    The next level table, or 0 if it is missing or the entry maps a
+ *             large page.
+ */
+static uint64_t *next_table(uint64_t *table, uint64_t index, bool alloc,
+                            uint64_t flags)
+{
+    uint64_t entry = table[index];
+    uint64_t *next;
+
+    if (entry & PTE_P) {
+        if (entry & PTE_PS) {
+            return 0;
+        }
+
+        table[index] = entry|(flags&PTE_U);
+        return (uint64_t *)P2V(PTE_ADDR(entry));
+    }
+
+    if (!alloc) {
+        return 0;
+    }
+
+    next = alloc_table();
+    if (next == 0) {
+        return 0;
+    }
+
+    table[index] = V2P(next)|PTE_P|PTE_W|(flags&PTE_U);
+    return next;
+}
+
+/**
+ * @brief:     Loads an address space on the calling CPU.
+ *
+ * @param:     state  the TLB state of the CPU
+ * @param:     as     the address space
+ * @param:     flush  whether the TLB entries of the slot must be dropped
+ *
+ * @description: Without PCIDs every load flushes. Otherwise the slot of the
+ *               address space is reused without a flush as long as it has
+ *               seen the current generation, and a missing address space
+ *               takes over the next slot in turn.
+ */
+static void load_space(struct TlbState *state, struct AddressSpace *as,
+                       bool flush)
+{
+    uint64_t gen = __atomic_load_n(&as->tlb_gen.value, __ATOMIC_SEQ_CST);
+    uint64_t cr3 = V2P(as->pml4);
+    uint32_t i;
+
+    if (!pcid_enabled) {
+        load_cr3(cr3);
+        return;
+    }
+
+    for (i = 0; i < TLB_SLOTS; i++) {
+        if (state->slots[i].id == as->id) {
+            break;
+        }
+    }
+
+    if (i < TLB_SLOTS && !flush && state->slots[i].gen == gen) {
+        load_cr3(cr3|(i+1)|CR3_NOFLUSH);
+        return;
+    }
+
+    if (i == TLB_SLOTS) {
+        i = state->next;
+        state->next = (i+1)%TLB_SLOTS;
+    }
+
+    state->slots[i].id = as->id;
+    state->slots[i].gen = gen;
+    load_cr3(cr3|(i+1));
+}
+
+/**
+ * @brief:     The handler of TLB_VECTOR, sent by address_space_flush.
+ */
+static void tlb_handler(struct TrapFrame *tf, void *ctx)
+{
+    struct TlbState *state = &tlb_states[this_cpu()->id];
+
+    if (state->current != 0) {
+        load_space(state, state->current, true);
+    }
+
+    atomic_inc(&state->flushes);
+    eoi();
+}
+
+/**
+ * @brief:     Frees a page table and the tables below it. Only the lower
+ *             half of a PML4 is walked.
+ *
+ * @param:     table  the table
+ * @param[in]: level  4 for a PML4, 1 for a page table
+ */
+static void free_table(uint64_t *table, int level)
+{
+    uint64_t entry;
+    int count = level == 4 ? USER_PML4_ENTRIES : 512;
+    int i;
+
+    for (i = 0; level > 1 && i < count; i++) {
+        entry = table[i];
+        if ((entry & PTE_P) && !(entry & PTE_PS)) {
+            free_table((uint64_t *)P2V(PTE_ADDR(entry)), level-1);
+        }
+    }
+
+    free_frame(V2P(table));
+}
+
+/**
+ * @brief:          A function that builds the kernel page tables.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    This function maps [0, max(memory end, 4 GiB)) at
+ *                  KERNEL_BASE with the largest page size the CPU supports,
+ *                  maps the first 1 GiB at KERNEL_VMA with the same entry,
+ *                  and loads cr3 with init_paging_cpu. It must run after
+ *                  init_memory and init_idt, and it relies on the loader's
+ *                  direct map alias until cr3 is loaded. PCIDs are used when
+ *                  CPUID 1 reports them (ECX bit 17).
+ */
+void init_paging(void)
+{
+    struct CpuidRegs regs;
+    uint64_t map_end = get_memory_end();
+    uint64_t addr, va;
+    uint64_t *pdpt, *pd, *image;
+    bool huge;
+    int i;
+
+    read_cpuid(0x80000000, 0, &regs);
+    huge = false;
+    if (regs.eax >= 0x80000001) {
+        read_cpuid(0x80000001, 0, &regs);
+        huge = (regs.edx&(1<<26)) != 0;
+    }
+
+    read_cpuid(1, 0, &regs);
+    pcid_enabled = (regs.ecx&(1<<17)) != 0;
+
+    if (map_end < (4UL<<30)) {
+        map_end = 4UL<<30;
+    }
+    map_end = (map_end+HUGE_PAGE_SIZE-1)&~(HUGE_PAGE_SIZE-1);
+
+    kernel_pml4 = alloc_table();
+    if (kernel_pml4 == 0) {
+        while (1) { }
+    }
+
+    for (addr = 0; addr < map_end; addr += HUGE_PAGE_SIZE) {
+        va = P2V(addr);
+        pdpt = next_table(kernel_pml4, PML4_INDEX(va), true, 0);
+        if (pdpt == 0) {
+            while (1) { }
+        }
+
+        if (huge) {
+            pdpt[PDPT_INDEX(va)] = addr|PTE_P|PTE_W|PTE_PS|PTE_G;
+            continue;
+        }
+
+        pd = next_table(pdpt, PDPT_INDEX(va), true, 0);
+        if (pd == 0) {
+            while (1) { }
+        }
+
+        for (i = 0; i < 512; i++) {
+            pd[i] = (addr+(uint64_t)i*LARGE_PAGE_SIZE)|PTE_P|PTE_W|PTE_PS|
+                    PTE_G;
+        }
+    }
+
+    pdpt = (uint64_t *)P2V(PTE_ADDR(kernel_pml4[PML4_INDEX(KERNEL_BASE)]));
+    image = next_table(kernel_pml4, PML4_INDEX(KERNEL_VMA), true, 0);
+    if (image == 0 ||
+        next_table(kernel_pml4, PML4_INDEX(MMIO_BASE), true, 0) == 0) {
+        while (1) { }
+    }
+    image[PDPT_INDEX(KERNEL_VMA)] = pdpt[PDPT_INDEX(KERNEL_BASE)];
+
+    register_irq_handler(TLB_VECTOR, tlb_handler, 0);
+    init_paging_cpu();
+}
+
+/**
+ * @brief:          A function that switches the calling CPU to the kernel
+ *                  page tables.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    cr3 is loaded with PCID 0 before CR4.PCIDE is set, which
+ *                  the CPU requires. Setting CR4.PGE flushes the whole TLB,
+ *                  so no entry of the loader's or the trampoline's tables
+ *                  survives as a global one.
+ */
+void init_paging_cpu(void)
+{
+    uint64_t cr4;
+
+    load_cr3(V2P(kernel_pml4));
+
+    cr4 = read_cr4()|CR4_PGE;
+    if (pcid_enabled) {
+        cr4 |= CR4_PCIDE;
+    }
+    write_cr4(cr4);
+}
+
+/**
+ * @brief:      Returns a copy of the kernel PML4 that also maps the first
+ *              512 GiB at address 0 through the PDPT of the direct map.
+ */
+uint64_t *alloc_boot_pml4(void)
+{
+    uint64_t *pml4 = alloc_table();
+    int i;
+
+    if (pml4 == 0) {
+        return 0;
+    }
+
+    for (i = USER_PML4_ENTRIES; i < 512; i++) {
+        pml4[i] = kernel_pml4[i];
+    }
+    pml4[0] = kernel_pml4[PML4_INDEX(KERNEL_BASE)];
+
+    return pml4;
+}
+
+/**
+ * @brief:     Returns the kernel PML4 table.
+ */
+uint64_t *get_kernel_pml4(void)
+{
+    return kernel_pml4;
+}
+
+/**
+ * @brief:          A function that maps a 4 KiB page.
+ *
+ * @param:          pml4   the PML4 table of the address space
+ * @param[in]:      va     the page aligned virtual address
+ * @param[in]:      pa     the page aligned physical address
+ * @param[in]:      flags  the PTE_* flags of the mapping, PTE_P is implied
+ *
+ * @return:         true on success, false otherwise.
+ *
+ * @description:    Missing intermediate tables are allocated. The function
+ *                  refuses to split a large page of the direct map. If the
+ *                  page was already mapped, its stale TLB entry is flushed.
+ *                  User pages end at USER_TOP, which keeps the rip that
+ *                  sysret returns to canonical.
+ */
+bool map_page(uint64_t *pml4, uint64_t va, uint64_t pa, uint64_t flags)
+{
+    uint64_t *pdpt, *pd, *pt;
+    uint64_t old;
+
+    if ((flags & PTE_U) && va >= USER_TOP) {
+        return false;
+    }
+
+    pdpt = next_table(pml4, PML4_INDEX(va), true, flags);
+    if (pdpt == 0) {
+        return false;
+    }
+
+    pd = next_table(pdpt, PDPT_INDEX(va), true, flags);
+    if (pd == 0) {
+        return false;
+    }
+
+    pt = next_table(pd, PD_INDEX(va), true, flags);
+    if (pt == 0) {
+        return false;
+    }
+
+    old = pt[PT_INDEX(va)];
+    pt[PT_INDEX(va)] = PTE_ADDR(pa)|flags|PTE_P;
+    if (old & PTE_P) {
+        invalidate_tlb(va);
+    }
+
+    return true;
+}
+
+/**
+ * @brief:          A function that removes a 4 KiB mapping.
+ *
+ * @param:          pml4  the PML4 table of the address space
+ * @param[in]:      va    the page aligned virtual address
+ *
+ * @return:         The physical address that was mapped at va, or 0. The
+ *                  frame is not freed, that is left to the owner.
+ */
+uint64_t unmap_page(uint64_t *pml4, uint64_t va)
+{
+    uint64_t *pdpt, *pd, *pt;
+    uint64_t old;
+
+    pdpt = next_table(pml4, PML4_INDEX(va), false, 0);
+    if (pdpt == 0) {
+        return 0;
+    }
+
+    pd = next_table(pdpt, PDPT_INDEX(va), false, 0);
+    if (pd == 0) {
+        return 0;
+    }
+
+    pt = next_table(pd, PD_INDEX(va), false, 0);
+    if (pt == 0) {
+        return 0;
+    }
+
+    old = pt[PT_INDEX(va)];
+    if (!(old & PTE_P)) {
+        return 0;
+    }
+
+    pt[PT_INDEX(va)] = 0;
+    invalidate_tlb(va);
+
+    return PTE_ADDR(old);
+}
+
+/**
+ * @brief:          A function that maps device registers.
+ *
+ * @param[in]:      pa    the physical address of the registers
+ * @param[in]:      size  the size of the register range in bytes
+ *
+ * @return:         The virtual address of pa, or 0 if a table could not be
+ *                  allocated.
+ *
+ * @description:    The pages are mapped with PCD and PWT, which selects the
+ *                  uncacheable memory type with the default PAT, at the next
+ *                  free address of the MMIO window. They are global like the
+ *                  rest of the kernel half. Mappings are never removed.
+ */
+uint64_t map_mmio(uint64_t pa, uint64_t size)
+{
+    uint64_t start = PA_DOWN(pa);
+    uint64_t stop = PA_UP(pa+size);
+    uint64_t va = mmio_next;
+    uint64_t addr;
+
+    for (addr = start; addr < stop; addr += PAGE_SIZE) {
+        if (!map_page(kernel_pml4, va+(addr-start), addr,
+                      PTE_W|PTE_PWT|PTE_PCD|PTE_G)) {
+            return 0;
+        }
+    }
+
+    mmio_next += stop-start;
+    return va+(pa-start);
+}
+
+/**
+ * @brief:          A function that translates a virtual address.
+ *
+ * @param:          pml4  the PML4 table of the address space
+ * @param[in]:      va    the virtual address
+ *
+ * @return:         The physical address of va, or 0 if it is not mapped.
+ */
+uint64_t translate(uint64_t *pml4, uint64_t va)
+{
+    uint64_t entry;
+    uint64_t *table;
+
+    entry = pml4[PML4_INDEX(va)];
+    if (!(entry & PTE_P)) {
+        return 0;
+    }
+
+    table = (uint64_t *)P2V(PTE_ADDR(entry));
+    entry = table[PDPT_INDEX(va)];
+    if (!(entry & PTE_P)) {
+        return 0;
+    }
+    if (entry & PTE_PS) {
+        return (entry&0x000fffffc0000000UL)|(va&(HUGE_PAGE_SIZE-1));
+    }
+
+    table = (uint64_t *)P2V(PTE_ADDR(entry));
+    entry = table[PD_INDEX(va)];
+    if (!(entry & PTE_P)) {
+        return 0;
+    }
+    if (entry & PTE_PS) {
+        return (entry&0x000fffffffe00000UL)|(va&(LARGE_PAGE_SIZE-1));
+    }
+
+    table = (uint64_t *)P2V(PTE_ADDR(entry));
+    entry = table[PT_INDEX(va)];
+    if (!(entry & PTE_P)) {
+        return 0;
+    }
+
+    return PTE_ADDR(entry)|(va&(PAGE_SIZE-1));
+}
+
+/**
+ * @brief:          A function that creates an address space.
+ *
+ * @param:          None
+ *
+ * @return:         The address space, or 0 if no memory is available.
+ */
+struct AddressSpace *address_space_create(void)
+{
+    struct AddressSpace *as = kmalloc(sizeof(struct AddressSpace));
+    int i;
+
+    if (as == 0) {
+        return 0;
+    }
+
+    as->pml4 = alloc_table();
+    if (as->pml4 == 0) {
+        kfree(as);
+        return 0;
+    }
+
+    for (i = USER_PML4_ENTRIES; i < 512; i++) {
+        as->pml4[i] = kernel_pml4[i];
+    }
+
+    as->id = atomic_add_return(&next_space_id, 1);
+    atomic_set(&as->refs, 1);
+    atomic_set(&as->tlb_gen, 0);
+    as->cpus = 0;
+
+    return as;
+}
+
+/**
+ * @brief:      Takes another reference to an address space.
+ */
+void address_space_get(struct AddressSpace *as)
+{
+    atomic_inc(&as->refs);
+}
+
+/**
+ * @brief:          A function that drops a reference to an address space.
+ *
+ * @param:          as  the address space
+ *
+ * @return:         None
+ *
+ * @description:    The last reference is dropped after the last task of
+ *                  the address space has been switched away from, so no CPU
+ *                  has it loaded. TLB slots that still carry its id never
+ *                  match again, ids are not reused.
+ */
+void address_space_put(struct AddressSpace *as)
+{
+    if (!atomic_dec_and_test(&as->refs)) {
+        return;
+    }
+
+    free_table(as->pml4, 4);
+    kfree(as);
+}
+
+/**
+ * @brief:          A function that loads an address space.
+ *
+ * @param:          as  the address space, 0 for the kernel PML4
+ *
+ * @return:         None
+ *
+ * @description:    The kernel PML4 has no lower half mappings, and its upper
+ *                  half is global, so PCID 0 never needs a flush.
+ */
+void address_space_switch(struct AddressSpace *as)
+{
+    uint32_t cpu = this_cpu()->id;
+    struct TlbState *state = &tlb_states[cpu];
+    struct AddressSpace *prev = state->current;
+
+    if (prev == as) {
+        return;
+    }
+
+    if (prev != 0) {
+        __atomic_fetch_and(&prev->cpus, ~(1U<<cpu), __ATOMIC_RELEASE);
+    }
+    state->current = as;
+
+    if (as == 0) {
+        load_cr3(V2P(kernel_pml4)|(pcid_enabled ? CR3_NOFLUSH : 0));
+        return;
+    }
+
+    __atomic_fetch_or(&as->cpus, 1U<<cpu, __ATOMIC_SEQ_CST);
+    load_space(state, as, false);
+}
+
+/**
+ * @brief:          A function that flushes an address space on all CPUs.
+ *
+ * @param:          as  the address space
+ *
+ * @return:         None
+ *
+ * @description:    The caller stays on its CPU while it flushes its own TLB
+ *                  and waits for the others. A CPU that leaves the address
+ *                  space meanwhile is not waited for, it flushes when it
+ *                  loads the address space again.
+ */
+void address_space_flush(struct AddressSpace *as)
+{
+    int64_t snap[MAX_CPUS];
+    struct TlbState *state;
+    uint32_t self, mask, i;
+    uint64_t flags;
+
+    preempt_disable();
+    atomic_add_return(&as->tlb_gen, 1);
+    mask = __atomic_load_n(&as->cpus, __ATOMIC_SEQ_CST);
+
+    flags = irq_save();
+    self = this_cpu()->id;
+    if (tlb_states[self].current == as) {
+        load_space(&tlb_states[self], as, true);
+    }
+    irq_restore(flags);
+    mask &= ~(1U<<self);
+
+    for (i = 0; i < MAX_CPUS; i++) {
+        if (mask & (1U<<i)) {
+            snap[i] = atomic_read(&tlb_states[i].flushes);
+            lapic_send_ipi(get_cpu(i)->apic_id, TLB_VECTOR);
+        }
+    }
+
+    for (i = 0; i < MAX_CPUS; i++) {
+        if (!(mask & (1U<<i))) {
+            continue;
+        }
+
+        state = &tlb_states[i];
+        while (atomic_read(&state->flushes) == snap[i] &&
+               (__atomic_load_n(&as->cpus, __ATOMIC_ACQUIRE) & (1U<<i))) {
+            cpu_relax();
+        }
+    }
+
+    preempt_enable();
+}
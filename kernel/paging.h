@@ -0,0 +1,211 @@
+/* -----------------------------------------------------------------------------
+ * @file:        paging.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the kernel page
+ *               table manager.
+ *
+ *               After boot the kernel replaces the loader's tables at 0x70000
+ *               with its own PML4, which maps all physical memory at
+ *               KERNEL_BASE with 1 GiB pages when the CPU supports them and
+ *               2 MiB pages otherwise, and the first 1 GiB again at
+ *               KERNEL_VMA, where the kernel image is linked. The lower half
+ *               of the address space, PML4 entries 0-255, is left to user
+ *               address spaces.
+ *
+ *               An AddressSpace has its own PML4 whose upper half is a copy
+ *               of the kernel PML4. The kernel never adds upper half PML4
+ *               entries after init_paging, so the kernel mappings below them
+ *               stay shared by all address spaces. Kernel mappings are
+ *               global and survive every cr3 load.
+ *
+ *               With PCID support every CPU keeps the last TLB_SLOTS address
+ *               spaces it ran in slots, PCIDs 1 to TLB_SLOTS, and the kernel
+ *               PML4 uses PCID 0. Switching to an address space that still
+ *               owns a slot does not flush the TLB. Each address space counts
+ *               changes to its mappings in tlb_gen: a slot that has seen an
+ *               older generation is flushed when it is loaded, and CPUs that
+ *               run the address space at the time of a change are sent
+ *               TLB_VECTOR.
+ *
+ *               map_page and unmap_page manage 4 KiB pages outside the large
+ *               page direct map. Device registers are mapped uncached by
+ *               map_mmio in a window at MMIO_BASE.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the page table manager.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Added map_mmio.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     The identity map is gone, added address spaces with PCID support.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Added USER_TOP, map_page refuses user pages above it.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _PAGING_H_
+#define _PAGING_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "sync.h"
+
+#define PTE_P               (1UL<<0)
+#define PTE_W               (1UL<<1)
+#define PTE_U               (1UL<<2)
+#define PTE_PWT             (1UL<<3)
+#define PTE_PCD             (1UL<<4)
+#define PTE_A               (1UL<<5)
+#define PTE_D               (1UL<<6)
+#define PTE_PS              (1UL<<7)
+#define PTE_G               (1UL<<8)
+#define PTE_NX              (1UL<<63)
+
+#define PTE_ADDR(e)         ((e)&0x000ffffffffff000UL)
+
+#define PML4_INDEX(va)      (((va)>>39)&0x1ff)
+#define PDPT_INDEX(va)      (((va)>>30)&0x1ff)
+#define PD_INDEX(va)        (((va)>>21)&0x1ff)
+#define PT_INDEX(va)        (((va)>>12)&0x1ff)
+
+#define HUGE_PAGE_SIZE      (1UL<<30)
+
+#define MMIO_BASE           0xffffff0000000000UL
+
+#define CR3_NOFLUSH         (1UL<<63)
+#define CR4_PGE             (1UL<<7)
+#define CR4_PCIDE           (1UL<<17)
+
+#define USER_PML4_ENTRIES   256
+/* The last user page stays unmapped, a syscall at its end would return
+   to the non-canonical 0x800000000000 with sysret */
+#define USER_TOP            0x00007ffffffff000UL
+#define TLB_SLOTS           6
+
+/**
+ * @brief:                A user address space.
+ *
+ * @struct:               AddressSpace
+ *
+ * @param:     pml4       The PML4 table, direct map address
+ * @param:     id         A number that is never reused, tags the TLB slots
+ * @param:     refs       The number of references, one per task
+ * @param:     tlb_gen    Incremented by every address_space_flush
+ * @param:     cpus       The mask of the CPUs that have the space loaded
+ */
+struct AddressSpace {
+    uint64_t *pml4;
+    uint64_t id;
+    struct Atomic refs;
+    struct Atomic tlb_gen;
+    volatile uint32_t cpus;
+};
+
+/**
+ * @fn:        init_paging(void)
+ *
+ * @brief:     Builds the kernel page tables and switches to them.
+ */
+void init_paging(void);
+/**
+ * @fn:        init_paging_cpu(void)
+ *
+ * @brief:     Loads the kernel PML4 on the calling CPU and enables global
+ *             pages and PCIDs.
+ */
+void init_paging_cpu(void);
+/**
+ * @fn:        alloc_boot_pml4(void)
+ *
+ * @brief:     Returns a copy of the kernel PML4 that also maps the first
+ *             512 GiB at address 0, for the AP trampoline. The caller frees
+ *             it with free_frame.
+ */
+uint64_t *alloc_boot_pml4(void);
+/**
+ * @fn:        get_kernel_pml4(void)
+ *
+ * @brief:     Returns the kernel PML4 table (direct map address).
+ */
+uint64_t *get_kernel_pml4(void);
+/**
+ * @fn:        map_page(uint64_t *pml4, uint64_t va, uint64_t pa,
+ *                      uint64_t flags)
+ *
+ * @brief:     Maps the 4 KiB page at va to the frame at pa.
+ *
+ * @return:    true on success, false if a table could not be allocated, va
+ *             lies inside a large page or a user page lies at USER_TOP or
+ *             above.
+ */
+bool map_page(uint64_t *pml4, uint64_t va, uint64_t pa, uint64_t flags);
+/**
+ * @fn:        unmap_page(uint64_t *pml4, uint64_t va)
+ *
+ * @brief:     Removes the 4 KiB mapping of va and flushes its TLB entry.
+ *
+ * @return:    The physical address that was mapped, or 0 if none was.
+ */
+uint64_t unmap_page(uint64_t *pml4, uint64_t va);
+/**
+ * @fn:        map_mmio(uint64_t pa, uint64_t size)
+ *
+ * @brief:     Maps size bytes of device registers at pa uncached.
+ *
+ * @return:    The virtual address of pa, or 0 on failure.
+ */
+uint64_t map_mmio(uint64_t pa, uint64_t size);
+/**
+ * @fn:        translate(uint64_t *pml4, uint64_t va)
+ *
+ * @brief:     Walks the tables and returns the physical address of va, or 0
+ *             if va is not mapped. Large pages are handled.
+ */
+uint64_t translate(uint64_t *pml4, uint64_t va);
+
+/**
+ * @fn:        address_space_create(void)
+ *
+ * @brief:     Creates an address space with an empty lower half and one
+ *             reference.
+ *
+ * @return:    The address space, or 0 if no memory is available.
+ */
+struct AddressSpace *address_space_create(void);
+/**
+ * @fn:        address_space_get(struct AddressSpace *as)
+ *
+ * @brief:     Takes another reference to an address space.
+ */
+void address_space_get(struct AddressSpace *as);
+/**
+ * @fn:        address_space_put(struct AddressSpace *as)
+ *
+ * @brief:     Drops a reference. The last one frees the page tables of the
+ *             lower half, the frames they map are left to their owner.
+ */
+void address_space_put(struct AddressSpace *as);
+/**
+ * @fn:        address_space_switch(struct AddressSpace *as)
+ *
+ * @brief:     Loads an address space on the calling CPU, 0 selects the kernel
+ *             PML4. Interrupts must be disabled.
+ */
+void address_space_switch(struct AddressSpace *as);
+/**
+ * @fn:        address_space_flush(struct AddressSpace *as)
+ *
+ * @brief:     Removes stale TLB entries of an address space from all CPUs
+ *             after its mappings were changed or removed. Must be called
+ *             with interrupts enabled.
+ */
+void address_space_flush(struct AddressSpace *as);
+
+#endif
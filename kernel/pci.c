@@ -0,0 +1,197 @@
+/******************************************************************************
+ * @file:        pci.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the PCI configuration space access.
+ *
+ *               The address written to 0xcf8 selects a dword of one
+ *               function, which 0xcfc then reads or writes. The pair is one
+ *               shared register, so every access holds pci_lock with
+ *               interrupts disabled.
+ *
+ *               A message signalled interrupt is a memory write of the data
+ *               register to the address register of the MSI capability. An
+ *               address in the 0xfee00000 window with the APIC ID in bits
+ *               19:12 reaches the local APIC of that CPU, and data holds
+ *               the vector with fixed delivery and edge trigger.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the PCI configuration space access.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "pci.h"
+#include "sync.h"
+#include "lib.h"
+
+#define PCI_CONFIG_ADDR     0xcf8
+#define PCI_CONFIG_DATA     0xcfc
+#define PCI_CONFIG_ENABLE   (1U<<31)
+
+#define PCI_STATUS_CAPS     (1U<<20)
+#define PCI_MULTIFUNCTION   (1U<<23)
+#define PCI_CAP_MSI         0x05
+
+#define MSI_CTRL_ENABLE     (1U<<16)
+#define MSI_CTRL_64BIT      (1U<<23)
+#define MSI_CTRL_MME        (7U<<20)
+#define MSI_ADDR_BASE       0xfee00000U
+
+static struct Spinlock pci_lock = SPINLOCK_INIT;
+
+/**
+ * @brief:      Reads a dword of the configuration space.
+ */
+uint32_t pci_read(uint32_t addr, uint8_t reg)
+{
+    uint64_t flags = spin_lock_irqsave(&pci_lock);
+    uint32_t value;
+
+    out_dword(PCI_CONFIG_ADDR, PCI_CONFIG_ENABLE|addr|(reg&0xfc));
+    value = in_dword(PCI_CONFIG_DATA);
+
+    spin_unlock_irqrestore(&pci_lock, flags);
+    return value;
+}
+
+/**
+ * @brief:      Writes a dword of the configuration space.
+ */
+void pci_write(uint32_t addr, uint8_t reg, uint32_t value)
+{
+    uint64_t flags = spin_lock_irqsave(&pci_lock);
+
+    out_dword(PCI_CONFIG_ADDR, PCI_CONFIG_ENABLE|addr|(reg&0xfc));
+    out_dword(PCI_CONFIG_DATA, value);
+
+    spin_unlock_irqrestore(&pci_lock, flags);
+}
+
+/**
+ * @brief:          A function that finds a function by its class code.
+ *
+ * @param:          cls     the base class
+ * @param:          sub     the subclass
+ * @param:          progif  the programming interface
+ * @param:          index   the number of matches to skip
+ *
+ * @return:         The address of the function, or PCI_NONE.
+ *
+ * @description:    Every bus is scanned by brute force, which needs no
+ *                  bridge setup. Functions 1 - 7 are only probed on
+ *                  multifunction devices, a single-function device may
+ *                  answer on all eight.
+ */
+uint32_t pci_find_class(uint8_t cls, uint8_t sub, uint8_t progif,
+                        uint32_t index)
+{
+    uint32_t want = ((uint32_t)cls<<24)|((uint32_t)sub<<16)|
+                    ((uint32_t)progif<<8);
+    uint32_t bus, dev, fn, addr, functions;
+
+    for (bus = 0; bus < 256; bus++) {
+        for (dev = 0; dev < 32; dev++) {
+            if ((pci_read(PCI_ADDR(bus, dev, 0), PCI_VENDOR)&0xffff) ==
+                0xffff) {
+                continue;
+            }
+
+            functions = 1;
+            if ((pci_read(PCI_ADDR(bus, dev, 0), PCI_HEADER)&
+                 PCI_MULTIFUNCTION) != 0) {
+                functions = 8;
+            }
+
+            for (fn = 0; fn < functions; fn++) {
+                addr = PCI_ADDR(bus, dev, fn);
+                if ((pci_read(addr, PCI_VENDOR)&0xffff) == 0xffff) {
+                    continue;
+                }
+                if ((pci_read(addr, PCI_CLASS)&0xffffff00) != want) {
+                    continue;
+                }
+                if (index-- == 0) {
+                    return addr;
+                }
+            }
+        }
+    }
+
+    return PCI_NONE;
+}
+
+/**
+ * @brief:      Returns the base address of a BAR.
+ */
+uint64_t pci_bar(uint32_t addr, uint32_t bar)
+{
+    uint8_t reg = (uint8_t)(PCI_BAR0+4*bar);
+    uint32_t low = pci_read(addr, reg);
+
+    if ((low&1) != 0) {
+        return low&~3U;
+    }
+
+    if ((low&6) == 4) {
+        return ((uint64_t)pci_read(addr, (uint8_t)(reg+4))<<32)|(low&~0xfU);
+    }
+
+    return low&~0xfU;
+}
+
+/**
+ * @brief:          A function that enables the MSI of a function.
+ *
+ * @param:          addr     the address of the function
+ * @param:          vector   the interrupt vector
+ * @param:          apic_id  the APIC ID of the CPU
+ *
+ * @return:         0 on success, -1 if the function has no MSI capability.
+ *
+ * @description:    The capability list starts at PCI_CAP_PTR if the status
+ *                  register says there is one. A single message is enabled,
+ *                  the device may not use the low bits of data for more.
+ */
+int pci_enable_msi(uint32_t addr, uint8_t vector, uint32_t apic_id)
+{
+    uint32_t cap, ctrl;
+    uint8_t ptr;
+
+    if ((pci_read(addr, PCI_COMMAND)&PCI_STATUS_CAPS) == 0) {
+        return -1;
+    }
+
+    ptr = (uint8_t)(pci_read(addr, PCI_CAP_PTR)&0xfc);
+    while (ptr != 0) {
+        cap = pci_read(addr, ptr);
+        if ((cap&0xff) == PCI_CAP_MSI) {
+            break;
+        }
+        ptr = (uint8_t)((cap>>8)&0xfc);
+    }
+    if (ptr == 0) {
+        return -1;
+    }
+
+    ctrl = pci_read(addr, ptr);
+    pci_write(addr, (uint8_t)(ptr+4), MSI_ADDR_BASE|((apic_id&0xff)<<12));
+    if ((ctrl&MSI_CTRL_64BIT) != 0) {
+        pci_write(addr, (uint8_t)(ptr+8), 0);
+        pci_write(addr, (uint8_t)(ptr+12), vector);
+    }
+    else {
+        pci_write(addr, (uint8_t)(ptr+8), vector);
+    }
+    pci_write(addr, ptr, (ctrl&~MSI_CTRL_MME)|MSI_CTRL_ENABLE);
+
+    pci_write(addr, PCI_COMMAND,
+              pci_read(addr, PCI_COMMAND)|PCI_CMD_INTX_OFF);
+
+    return 0;
+}
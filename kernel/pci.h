@@ -0,0 +1,82 @@
+/* -----------------------------------------------------------------------------
+ * @file:        pci.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the PCI
+ *               configuration space access.
+ *
+ *               The configuration space is reached through the legacy ports
+ *               0xcf8 and 0xcfc, which every PC chipset decodes. A function
+ *               is named by its address PCI_ADDR(bus, device, function).
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the PCI configuration space access.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _PCI_H_
+#define _PCI_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define PCI_ADDR(b, d, f)   (((uint32_t)(b)<<16)|((uint32_t)(d)<<11)| \
+                             ((uint32_t)(f)<<8))
+#define PCI_NONE            0xffffffffU
+
+#define PCI_VENDOR          0x00
+#define PCI_COMMAND         0x04
+#define PCI_CLASS           0x08
+#define PCI_HEADER          0x0c
+#define PCI_BAR0            0x10
+#define PCI_CAP_PTR         0x34
+
+#define PCI_CMD_IO          (1<<0)
+#define PCI_CMD_MEMORY      (1<<1)
+#define PCI_CMD_MASTER      (1<<2)
+#define PCI_CMD_INTX_OFF    (1<<10)
+
+/**
+ * @fn:        pci_read(uint32_t addr, uint8_t reg)
+ *
+ * @brief:     Reads the dword at reg, a multiple of 4, of a function.
+ */
+uint32_t pci_read(uint32_t addr, uint8_t reg);
+/**
+ * @fn:        pci_write(uint32_t addr, uint8_t reg, uint32_t value)
+ *
+ * @brief:     Writes the dword at reg, a multiple of 4, of a function.
+ */
+void pci_write(uint32_t addr, uint8_t reg, uint32_t value);
+/**
+ * @fn:        pci_find_class(uint8_t cls, uint8_t sub, uint8_t progif,
+ *                            uint32_t index)
+ *
+ * @brief:     Finds a function by its class code.
+ *
+ * @return:    The address of the index-th matching function, or PCI_NONE.
+ */
+uint32_t pci_find_class(uint8_t cls, uint8_t sub, uint8_t progif,
+                        uint32_t index);
+/**
+ * @fn:        pci_bar(uint32_t addr, uint32_t bar)
+ *
+ * @brief:     Returns the base address in BAR bar of a function, 64-bit
+ *             memory BARs included, without the flag bits.
+ */
+uint64_t pci_bar(uint32_t addr, uint32_t bar);
+/**
+ * @fn:        pci_enable_msi(uint32_t addr, uint8_t vector, uint32_t apic_id)
+ *
+ * @brief:     Makes a function signal its interrupt as an edge-triggered
+ *             message with vector to a CPU, and disables its INTx line.
+ *
+ * @return:    0 on success, -1 if the function has no MSI capability.
+ */
+int pci_enable_msi(uint32_t addr, uint8_t vector, uint32_t apic_id);
+
+#endif
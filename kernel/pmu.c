@@ -0,0 +1,403 @@
+/******************************************************************************
+ * @file:        pmu.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the driver of the architectural
+ *               performance monitoring unit.
+ *
+ *               CPUID leaf 0xA reports the version of the PMU, the number and
+ *               width of the general-purpose counters and, in EBX, which of
+ *               the architectural events are missing. A counter i is
+ *               programmed through IA32_PERFEVTSELi and counts in IA32_PMCi.
+ *               From version 2 on, IA32_PERF_GLOBAL_CTRL must also enable it
+ *               and IA32_PERF_GLOBAL_STATUS tells which counters overflowed.
+ *               There is no architectural TLB miss event, the DTLB load miss
+ *               walk event of the Intel family 6 cores stands in for it.
+ *
+ *               The overflow interrupt is delivered through LAPIC_LVT_PERF as
+ *               the maskable PMU_VECTOR rather than as an NMI, so it goes
+ *               through the common dispatch and statistics of trap.c and its
+ *               callbacks may use spinlocks like any other handler. Code that
+ *               runs with interrupts disabled is not sampled by it. The local
+ *               APIC masks the LVT entry on every delivery, the handler
+ *               unmasks it again.
+ *
+ *               Writes to IA32_PMCi set only bits 31:0 and sign-extend them,
+ *               which is why an overflow period is below 2^31: the counter is
+ *               preloaded with -period and interrupts when it wraps to 0.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the PMU driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "pmu.h"
+#include "apic.h"
+#include "smp.h"
+#include "printk.h"
+#include "lib.h"
+
+#define IA32_PMC0               0x0c1
+#define IA32_PERFEVTSEL0        0x186
+#define IA32_PERF_GLOBAL_STATUS 0x38e
+#define IA32_PERF_GLOBAL_CTRL   0x38f
+#define IA32_PERF_GLOBAL_OVF    0x390
+
+#define EVTSEL_USR              (1UL<<16)
+#define EVTSEL_OS               (1UL<<17)
+#define EVTSEL_INT              (1UL<<20)
+#define EVTSEL_EN               (1UL<<22)
+
+#define CPUID_INTEL_EBX         0x756e6547
+#define NO_EBX_BIT              -1
+
+/**
+ * @brief:                The encoding of an event.
+ *
+ * @struct:               PmuEvent
+ *
+ * @param:     event      The event select
+ * @param:     umask      The unit mask
+ * @param:     ebx_bit    The bit of CPUID 0xA EBX that marks the event as
+ *                        missing, NO_EBX_BIT for a model-specific event
+ */
+struct PmuEvent {
+    uint8_t event;
+    uint8_t umask;
+    int ebx_bit;
+};
+
+/**
+ * @brief:                The counters of one CPU.
+ *
+ * @struct:               PmuCpu
+ *
+ * @param:     used       A bit for every started counter
+ * @param:     period     The overflow period, 0 if the counter does not
+ *                        interrupt
+ * @param:     fn         The overflow callbacks
+ * @param:     ctx        The values passed to the callbacks
+ */
+struct PmuCpu {
+    uint32_t used;
+    uint64_t period[PMU_MAX_COUNTERS];
+    pmu_overflow_t fn[PMU_MAX_COUNTERS];
+    void *ctx[PMU_MAX_COUNTERS];
+};
+
+static const struct PmuEvent pmu_events[PMU_EVENTS] = {
+    [PMU_CYCLES]       = { 0x3c, 0x00, 0 },
+    [PMU_INSTRUCTIONS] = { 0xc0, 0x00, 1 },
+    [PMU_LLC_MISSES]   = { 0x2e, 0x41, 4 },
+    [PMU_TLB_MISSES]   = { 0x08, 0x01, NO_EBX_BIT },
+};
+
+static struct PmuCpu pmu_cpus[MAX_CPUS];
+static uint32_t pmu_version;
+static uint32_t pmu_counters;
+static uint64_t pmu_mask;
+static uint32_t pmu_supported;
+
+/**
+ * @brief:      Returns the raw value of a counter, cut to its width.
+ */
+static uint64_t read_counter(int counter)
+{
+    return read_pmc((uint32_t)counter)&pmu_mask;
+}
+
+/**
+ * @brief:      Returns true if counter is a started counter of the calling
+ *              CPU.
+ */
+static bool counter_in_use(struct PmuCpu *pmu, int counter)
+{
+    return counter >= 0 && (uint32_t)counter < pmu_counters &&
+           (pmu->used&(1U<<counter)) != 0;
+}
+
+/**
+ * @brief:      Returns the event select value of an event.
+ */
+static uint64_t event_select(uint32_t event)
+{
+    return pmu_events[event].event|
+           ((uint64_t)pmu_events[event].umask<<8)|EVTSEL_USR|EVTSEL_OS;
+}
+
+/**
+ * @brief:          The handler of the overflow interrupt.
+ *
+ * @param:          tf   the trap frame of the interrupted code
+ * @param:          ctx  unused
+ *
+ * @return:         None
+ *
+ * @description:    Version 1 has no overflow status, there a counter with a
+ *                  period has overflowed once its top bit is clear again.
+ *                  Every overflowed counter is rearmed before its callback
+ *                  runs, so the callback may stop it.
+ */
+static void pmu_irq(struct TrapFrame *tf, void *ctx)
+{
+    struct PmuCpu *pmu = &pmu_cpus[this_cpu()->id];
+    uint64_t status = 0;
+    uint32_t i;
+
+    if (pmu_version >= 2) {
+        status = read_msr(IA32_PERF_GLOBAL_STATUS);
+        write_msr(IA32_PERF_GLOBAL_OVF, status);
+    }
+    else {
+        for (i = 0; i < pmu_counters; i++) {
+            if (pmu->period[i] != 0 &&
+                (read_counter(i)&((pmu_mask>>1)+1)) == 0) {
+                status |= 1UL<<i;
+            }
+        }
+    }
+
+    for (i = 0; i < pmu_counters; i++) {
+        if ((status&(1UL<<i)) == 0 || pmu->period[i] == 0) {
+            continue;
+        }
+
+        write_msr(IA32_PMC0+i, -pmu->period[i]);
+        pmu->fn[i](tf, i, pmu->ctx[i]);
+    }
+
+    lapic_write(LAPIC_LVT_PERF, PMU_VECTOR);
+    eoi();
+}
+
+/**
+ * @brief:      Stops all counters of the calling CPU and routes its overflow
+ *              interrupt to PMU_VECTOR.
+ */
+void init_pmu_cpu(void)
+{
+    uint32_t i;
+
+    if (pmu_counters == 0) {
+        return;
+    }
+
+    for (i = 0; i < pmu_counters; i++) {
+        write_msr(IA32_PERFEVTSEL0+i, 0);
+    }
+    if (pmu_version >= 2) {
+        write_msr(IA32_PERF_GLOBAL_CTRL, 0);
+        write_msr(IA32_PERF_GLOBAL_OVF, read_msr(IA32_PERF_GLOBAL_STATUS));
+    }
+
+    if (get_apic_mode() != APIC_MODE_PIC) {
+        lapic_write(LAPIC_LVT_PERF, PMU_VECTOR);
+    }
+}
+
+/**
+ * @brief:          A function that detects the PMU.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    Without leaf 0xA or without general-purpose counters, as
+ *                  on AMD CPUs and most emulators, no event is available and
+ *                  every pmu_start fails.
+ */
+void init_pmu(void)
+{
+    struct CpuidRegs regs;
+    bool intel;
+    uint32_t family;
+    uint32_t width;
+    uint32_t event;
+
+    read_cpuid(0, 0, &regs);
+    intel = regs.ebx == CPUID_INTEL_EBX;
+    if (regs.eax < 0xa) {
+        printk("pmu: not available\n");
+        return;
+    }
+
+    read_cpuid(1, 0, &regs);
+    family = (regs.eax>>8)&0xf;
+
+    read_cpuid(0xa, 0, &regs);
+    pmu_version = regs.eax&0xff;
+    pmu_counters = (regs.eax>>8)&0xff;
+    width = (regs.eax>>16)&0xff;
+    if (pmu_version == 0 || pmu_counters == 0 || width < 32 || width > 64) {
+        pmu_counters = 0;
+        printk("pmu: not available\n");
+        return;
+    }
+    if (pmu_counters > PMU_MAX_COUNTERS) {
+        pmu_counters = PMU_MAX_COUNTERS;
+    }
+    pmu_mask = width == 64 ? ~0UL : (1UL<<width)-1;
+
+    for (event = 0; event < PMU_EVENTS; event++) {
+        if (pmu_events[event].ebx_bit == NO_EBX_BIT) {
+            if (intel && family == 6) {
+                pmu_supported |= 1U<<event;
+            }
+        }
+        else if (pmu_events[event].ebx_bit < (int)((regs.eax>>24)&0xff) &&
+                 (regs.ebx&(1U<<pmu_events[event].ebx_bit)) == 0) {
+            pmu_supported |= 1U<<event;
+        }
+    }
+
+    register_irq_handler(PMU_VECTOR, pmu_irq, 0);
+    init_pmu_cpu();
+
+    printk("pmu: version %u, %u counters of %u bits, events %x\n",
+           pmu_version, pmu_counters, width, pmu_supported);
+}
+
+/**
+ * @brief:      Returns true if the CPU can count event.
+ */
+bool pmu_available(uint32_t event)
+{
+    return event < PMU_EVENTS && (pmu_supported&(1U<<event)) != 0;
+}
+
+/**
+ * @brief:      Starts the lowest free counter of the calling CPU.
+ */
+int pmu_start(uint32_t event)
+{
+    struct PmuCpu *pmu;
+    uint64_t flags;
+    uint32_t i;
+
+    if (!pmu_available(event)) {
+        return -1;
+    }
+
+    flags = irq_save();
+    pmu = &pmu_cpus[this_cpu()->id];
+    for (i = 0; i < pmu_counters && (pmu->used&(1U<<i)) != 0; i++) {
+    }
+    if (i == pmu_counters) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    pmu->used |= 1U<<i;
+    pmu->period[i] = 0;
+    write_msr(IA32_PERFEVTSEL0+i, 0);
+    write_msr(IA32_PMC0+i, 0);
+    write_msr(IA32_PERFEVTSEL0+i, event_select(event)|EVTSEL_EN);
+    if (pmu_version >= 2) {
+        write_msr(IA32_PERF_GLOBAL_CTRL,
+                  read_msr(IA32_PERF_GLOBAL_CTRL)|(1UL<<i));
+    }
+    irq_restore(flags);
+
+    return (int)i;
+}
+
+/**
+ * @brief:      Returns the events counted so far, since the last overflow
+ *              for a counter with a period.
+ */
+uint64_t pmu_read(int counter)
+{
+    struct PmuCpu *pmu;
+    uint64_t flags;
+    uint64_t value = 0;
+
+    flags = irq_save();
+    pmu = &pmu_cpus[this_cpu()->id];
+    if (counter_in_use(pmu, counter)) {
+        value = (read_counter(counter)+pmu->period[counter])&pmu_mask;
+    }
+    irq_restore(flags);
+
+    return value;
+}
+
+/**
+ * @brief:      Stops and frees a counter.
+ */
+uint64_t pmu_stop(int counter)
+{
+    struct PmuCpu *pmu;
+    uint64_t flags;
+    uint64_t value;
+
+    flags = irq_save();
+    pmu = &pmu_cpus[this_cpu()->id];
+    if (!counter_in_use(pmu, counter)) {
+        irq_restore(flags);
+        return 0;
+    }
+
+    value = (read_counter(counter)+pmu->period[counter])&pmu_mask;
+    write_msr(IA32_PERFEVTSEL0+counter, 0);
+    if (pmu_version >= 2) {
+        write_msr(IA32_PERF_GLOBAL_CTRL,
+                  read_msr(IA32_PERF_GLOBAL_CTRL)&~(1UL<<counter));
+    }
+    pmu->used &= ~(1U<<counter);
+    pmu->period[counter] = 0;
+    pmu->fn[counter] = 0;
+    pmu->ctx[counter] = 0;
+    irq_restore(flags);
+
+    return value;
+}
+
+/**
+ * @brief:          A function that makes a counter interrupt periodically.
+ *
+ * @param:          counter  a started counter of the calling CPU
+ * @param:          period   the events between two interrupts
+ * @param:          fn       the callback, called from the interrupt
+ * @param:          ctx      the value passed to fn
+ *
+ * @return:         0 on success, -1 otherwise
+ *
+ * @description:    The counter is stopped while it is reloaded, the events
+ *                  counted before are lost.
+ */
+int pmu_set_overflow(int counter, uint64_t period, pmu_overflow_t fn,
+                     void *ctx)
+{
+    struct PmuCpu *pmu;
+    uint64_t flags;
+    uint64_t select;
+
+    if (period == 0 || period > PMU_MAX_PERIOD || fn == 0 ||
+        get_apic_mode() == APIC_MODE_PIC) {
+        return -1;
+    }
+
+    flags = irq_save();
+    pmu = &pmu_cpus[this_cpu()->id];
+    if (!counter_in_use(pmu, counter)) {
+        irq_restore(flags);
+        return -1;
+    }
+
+    select = read_msr(IA32_PERFEVTSEL0+counter);
+    write_msr(IA32_PERFEVTSEL0+counter, 0);
+    pmu->period[counter] = period;
+    pmu->fn[counter] = fn;
+    pmu->ctx[counter] = ctx;
+    write_msr(IA32_PMC0+counter, -period);
+    write_msr(IA32_PERFEVTSEL0+counter, select|EVTSEL_INT);
+    irq_restore(flags);
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+/* -----------------------------------------------------------------------------
+ * @file:        pmu.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the
+ *               performance monitoring unit (PMU) interface.
+ *
+ *               The general-purpose counters of the architectural PMU,
+ *               found through CPUID leaf 0xA, count one event each. The
+ *               counters belong to the CPU that started them, so a task keeps
+ *               itself on the CPU with preempt_disable between pmu_start and
+ *               pmu_stop. A typical measurement is
+ *
+ *                   preempt_disable();
+ *                   c = pmu_start(PMU_CYCLES);
+ *                   ...
+ *                   cycles = pmu_stop(c);
+ *                   preempt_enable();
+ *
+ *               A counter can also interrupt after a number of events, the
+ *               overflow interrupt PMU_VECTOR is dispatched through
+ *               register_irq_handler and calls a callback with the trap frame
+ *               of the interrupted code, which prof_sample accepts.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the PMU interface.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _PMU_H_
+#define _PMU_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "trap.h"
+
+#define PMU_CYCLES          0
+#define PMU_INSTRUCTIONS    1
+#define PMU_LLC_MISSES      2
+#define PMU_TLB_MISSES      3
+#define PMU_EVENTS          4
+
+#define PMU_MAX_COUNTERS    8
+#define PMU_MAX_PERIOD      0x7fffffffUL
+
+/**
+ * @brief:     The type of an overflow callback.
+ *
+ * @param:     tf       The trap frame of the interrupted code
+ * @param:     counter  The counter that overflowed
+ * @param:     ctx      The value passed to pmu_set_overflow
+ */
+typedef void (*pmu_overflow_t)(struct TrapFrame *tf, int counter, void *ctx);
+
+/**
+ * @fn:        init_pmu(void)
+ *
+ * @brief:     Detects the PMU and sets it up on the BSP. Must run after
+ *             init_smp.
+ */
+void init_pmu(void);
+/**
+ * @fn:        init_pmu_cpu(void)
+ *
+ * @brief:     Sets up the PMU of an AP after init_lapic.
+ */
+void init_pmu_cpu(void);
+/**
+ * @fn:        pmu_available(uint32_t event)
+ *
+ * @brief:     Returns true if the CPU can count event.
+ */
+bool pmu_available(uint32_t event);
+/**
+ * @fn:        pmu_start(uint32_t event)
+ *
+ * @brief:     Starts a free counter of the calling CPU at 0, counting event
+ *             in ring 0 and ring 3.
+ *
+ * @return:    The counter, or -1 if the event is not available or all
+ *             counters are in use.
+ */
+int pmu_start(uint32_t event);
+/**
+ * @fn:        pmu_read(int counter)
+ *
+ * @brief:     Returns the events counted so far.
+ */
+uint64_t pmu_read(int counter);
+/**
+ * @fn:        pmu_stop(int counter)
+ *
+ * @brief:     Stops and frees a counter.
+ *
+ * @return:    The events counted.
+ */
+uint64_t pmu_stop(int counter);
+/**
+ * @fn:        pmu_set_overflow(int counter, uint64_t period,
+ *                              pmu_overflow_t fn, void *ctx)
+ *
+ * @brief:     Makes a counter call fn from the overflow interrupt every
+ *             period events, 1 to PMU_MAX_PERIOD. pmu_read then returns the
+ *             events since the last overflow.
+ *
+ * @return:    0 on success, -1 for a bad period or without a local APIC.
+ */
+int pmu_set_overflow(int counter, uint64_t period, pmu_overflow_t fn,
+                     void *ctx);
+
+#endif
@@ -0,0 +1,544 @@
+/******************************************************************************
+ * @file:        printk.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the kernel log and its output devices.
+ *
+ *               Every CPU owns one LogRing of fixed-size records. The CPU is
+ *               the only writer of the head index and the drain, under
+ *               drain_lock, the only writer of the tail index, so neither
+ *               side needs an atomic read-modify-write:
+ *
+ *                  - printk disables interrupts, which keeps a nested
+ *                    printk of the same CPU out of the slot, formats into
+ *                    the slot at head and publishes it with a release store
+ *                    of head + 1.
+ *
+ *                  - The drain picks the ring whose record at tail has the
+ *                    oldest TSC, writes it out and frees the slot with a
+ *                    release store of tail + 1.
+ *
+ *               The head and the tail sit on separate cache lines, a record
+ *               costs the writing CPU no cache line of the drain. The time
+ *               with interrupts disabled is bounded by LOG_LINE_SIZE.
+ *
+ *               The devices are only touched by the drain: the 80x25 text
+ *               mode of SetVideoMode, which scrolls, and COM1 through
+ *               uart_write, which only queues the text once init_uart has
+ *               enabled the transmitter interrupt.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the per-CPU log rings.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     COM1 is written through the UART driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "printk.h"
+#include "stdbool.h"
+#include "sync.h"
+#include "smp.h"
+#include "sched.h"
+#include "clock.h"
+#include "memory.h"
+#include "uart.h"
+#include "lib.h"
+
+#define VGA_TEXT            0xb8000
+#define VGA_COLS            80
+#define VGA_ROWS            25
+#define VGA_ATTR            0x0700
+#define VGA_CRTC_INDEX      0x3d4
+#define VGA_CRTC_DATA       0x3d5
+
+#define KLOG_POLL_NS        (20*NSEC_PER_MSEC)
+#define KLOG_PRIO           SCHED_DEFAULT_PRIO
+
+/**
+ * @brief:                One line of the log.
+ *
+ * @struct:               LogRecord
+ *
+ * @param:     tsc        The time stamp counter when the record was written
+ * @param:     cpu        The CPU that wrote it
+ * @param:     len        The length of text, without the zero byte
+ * @param:     text       The formatted line
+ */
+struct LogRecord {
+    uint64_t tsc;
+    uint32_t cpu;
+    uint32_t len;
+    char text[LOG_LINE_SIZE];
+};
+
+/**
+ * @brief:                The log ring of one CPU.
+ *
+ * @struct:               LogRing
+ *
+ * @param:     head       The number of records written, by the CPU
+ * @param:     drops      The number of records dropped on a full ring
+ * @param:     tail       The number of records written out, by the drain
+ * @param:     reported   The value of drops last reported by the drain
+ * @param:     records    The record slots, record n is at n % LOG_RING_RECORDS
+ */
+struct LogRing {
+    volatile uint32_t head;
+    volatile uint32_t drops;
+    volatile uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint32_t reported;
+    struct LogRecord records[LOG_RING_RECORDS]
+        __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+static struct LogRing log_rings[MAX_CPUS];
+static struct Spinlock drain_lock = SPINLOCK_INIT;
+static uint32_t vga_row;
+static uint32_t vga_col;
+
+/**
+ * @brief:     Stores one output character of vsnprintf if it fits, the
+ *             position counts on regardless.
+ */
+static void put_char(char *buf, size_t size, size_t *pos, char c)
+{
+    if (*pos+1 < size) {
+        buf[*pos] = c;
+    }
+    (*pos)++;
+}
+
+/**
+ * @brief:     Writes the digits of value in base right-aligned before end.
+ *
+ * @return:    The first digit.
+ */
+static char *format_number(char *end, uint64_t value, unsigned int base,
+                           bool upper)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+    do {
+        *--end = digits[value%base];
+        value /= base;
+    } while (value != 0);
+
+    return end;
+}
+
+/**
+ * @brief:          A function that formats a string.
+ *
+ * @param:          buf   the output buffer
+ * @param:          size  the size of buf
+ * @param:          fmt   the format string
+ * @param:          ap    the arguments
+ *
+ * @return:         The length of the untruncated output.
+ *
+ * @description:    Every output character goes through put_char, so the
+ *                  counting continues past the end of buf. A %% or an unknown
+ *                  directive prints its character.
+ */
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list ap)
+{
+    char tmp[24];
+    size_t pos = 0;
+    char *start;
+    const char *str;
+    size_t len, i;
+    uint64_t value;
+    unsigned int width, base, longs;
+    bool left, zero, negative;
+
+    for (; *fmt != 0; fmt++) {
+        if (*fmt != '%') {
+            put_char(buf, size, &pos, *fmt);
+            continue;
+        }
+
+        left = false;
+        zero = false;
+        for (fmt++; *fmt == '-' || *fmt == '0'; fmt++) {
+            left |= *fmt == '-';
+            zero |= *fmt == '0';
+        }
+
+        width = 0;
+        for (; *fmt >= '0' && *fmt <= '9'; fmt++) {
+            width = width*10+(*fmt-'0');
+        }
+
+        longs = 0;
+        for (; *fmt == 'l' || *fmt == 'z' || *fmt == 'h'; fmt++) {
+            if (*fmt != 'h') {
+                longs++;
+            }
+        }
+
+        base = 10;
+        negative = false;
+        start = tmp+1;
+        len = 0;
+
+        switch (*fmt) {
+        case 'd':
+        case 'i':
+            value = longs != 0 ? (uint64_t)va_arg(ap, int64_t) :
+                                 (uint64_t)(int64_t)va_arg(ap, int);
+            negative = (int64_t)value < 0;
+            if (negative) {
+                value = -value;
+            }
+            start = format_number(tmp+sizeof(tmp), value, 10, false);
+            len = tmp+sizeof(tmp)-start;
+            break;
+        case 'p':
+            longs = 1;
+            base = 16;
+            if (width == 0) {
+                width = 16;
+                zero = true;
+            }
+            /* fall through */
+        case 'u':
+        case 'x':
+        case 'X':
+            if (*fmt == 'x' || *fmt == 'X') {
+                base = 16;
+            }
+            value = longs != 0 ? va_arg(ap, uint64_t) :
+                                 va_arg(ap, unsigned int);
+            start = format_number(tmp+sizeof(tmp), value, base, *fmt == 'X');
+            len = tmp+sizeof(tmp)-start;
+            break;
+        case 'c':
+            tmp[1] = (char)va_arg(ap, int);
+            len = 1;
+            break;
+        case 's':
+            str = va_arg(ap, const char *);
+            if (str == 0) {
+                str = "(null)";
+            }
+            while (str[len] != 0) {
+                len++;
+            }
+            for (i = len; !left && i < width; i++) {
+                put_char(buf, size, &pos, ' ');
+            }
+            for (i = 0; i < len; i++) {
+                put_char(buf, size, &pos, str[i]);
+            }
+            for (i = len; left && i < width; i++) {
+                put_char(buf, size, &pos, ' ');
+            }
+            continue;
+        case 0:
+            fmt--;
+            continue;
+        default:
+            tmp[1] = *fmt;
+            len = 1;
+            break;
+        }
+
+        if (negative && zero && !left) {
+            put_char(buf, size, &pos, '-');
+            width = width > 0 ? width-1 : 0;
+        }
+        else if (negative) {
+            *--start = '-';
+            len++;
+        }
+
+        for (i = len; !left && i < width; i++) {
+            put_char(buf, size, &pos, zero ? '0' : ' ');
+        }
+        for (i = 0; i < len; i++) {
+            put_char(buf, size, &pos, start[i]);
+        }
+        for (i = len; left && i < width; i++) {
+            put_char(buf, size, &pos, ' ');
+        }
+    }
+
+    if (size != 0) {
+        buf[pos < size ? pos : size-1] = 0;
+    }
+
+    return (int)pos;
+}
+
+/**
+ * @brief:      Formats into buf like vsnprintf.
+ */
+int snprintf(char *buf, size_t size, const char *fmt, ...)
+{
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(buf, size, fmt, ap);
+    va_end(ap);
+
+    return len;
+}
+
+/**
+ * @brief:     Moves the hardware cursor to the current position.
+ */
+static void vga_update_cursor(void)
+{
+    uint16_t pos = vga_row*VGA_COLS+vga_col;
+
+    out_byte(VGA_CRTC_INDEX, 0x0f);
+    out_byte(VGA_CRTC_DATA, pos&0xff);
+    out_byte(VGA_CRTC_INDEX, 0x0e);
+    out_byte(VGA_CRTC_DATA, pos>>8);
+}
+
+/**
+ * @brief:     Writes one character to the text console, scrolling up by one
+ *             line when the cursor leaves the last line.
+ */
+static void vga_putc(char c)
+{
+    volatile uint16_t *text = (volatile uint16_t *)P2V(VGA_TEXT);
+    uint32_t i;
+
+    if (c == '\n') {
+        vga_col = VGA_COLS;
+    }
+    else {
+        text[vga_row*VGA_COLS+vga_col] = VGA_ATTR|(uint8_t)c;
+        vga_col++;
+    }
+
+    if (vga_col < VGA_COLS) {
+        return;
+    }
+
+    vga_col = 0;
+    if (++vga_row < VGA_ROWS) {
+        return;
+    }
+
+    for (i = 0; i < (VGA_ROWS-1)*VGA_COLS; i++) {
+        text[i] = text[i+VGA_COLS];
+    }
+    for (; i < VGA_ROWS*VGA_COLS; i++) {
+        text[i] = VGA_ATTR|' ';
+    }
+    vga_row = VGA_ROWS-1;
+}
+
+/**
+ * @brief:     Writes len characters to both devices.
+ */
+static void console_write(const char *s, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        vga_putc(s[i]);
+    }
+    uart_write(s, len);
+}
+
+/**
+ * @brief:     Formats a line straight to the devices, for the drain itself.
+ */
+static void console_printf(const char *fmt, ...)
+{
+    char line[32+LOG_LINE_SIZE];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    console_write(line, len < (int)sizeof(line) ? (size_t)len : sizeof(line)-1);
+}
+
+/**
+ * @brief:     Returns the ring whose next record is the oldest, or 0 if all
+ *             rings are empty.
+ */
+static struct LogRing *oldest_ring(void)
+{
+    struct LogRing *oldest = 0;
+    struct LogRing *ring;
+    struct LogRecord *rec;
+    uint64_t tsc = 0;
+    uint32_t i;
+
+    for (i = 0; i < MAX_CPUS; i++) {
+        ring = &log_rings[i];
+        if (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        rec = &ring->records[ring->tail%LOG_RING_RECORDS];
+        if (oldest == 0 || rec->tsc < tsc) {
+            oldest = ring;
+            tsc = rec->tsc;
+        }
+    }
+
+    return oldest;
+}
+
+/**
+ * @brief:          A function that writes out all pending records.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The caller holds drain_lock. A record written before
+ *                  init_clock has time 0.
+ */
+static void drain_rings(void)
+{
+    struct LogRing *ring;
+    struct LogRecord *rec;
+    uint64_t ns;
+    uint32_t drops, i;
+
+    while ((ring = oldest_ring()) != 0) {
+        rec = &ring->records[ring->tail%LOG_RING_RECORDS];
+        ns = rec->tsc >= ns_to_tsc(0) ? tsc_to_ns(rec->tsc) : 0;
+
+        console_printf("[%5lu.%06lu] %u: ", ns/NSEC_PER_SEC,
+                       (ns%NSEC_PER_SEC)/NSEC_PER_USEC, rec->cpu);
+        console_write(rec->text, rec->len);
+        if (rec->len == 0 || rec->text[rec->len-1] != '\n') {
+            console_write("\n", 1);
+        }
+
+        __atomic_store_n(&ring->tail, ring->tail+1, __ATOMIC_RELEASE);
+    }
+
+    for (i = 0; i < MAX_CPUS; i++) {
+        ring = &log_rings[i];
+        drops = ring->drops;
+        if (drops != ring->reported) {
+            console_printf("klog: %u records of CPU %u dropped\n",
+                           drops-ring->reported, i);
+            ring->reported = drops;
+        }
+    }
+
+    vga_update_cursor();
+}
+
+/**
+ * @brief:     The klog task, drains the rings every KLOG_POLL_NS.
+ */
+static void klog_task(void *arg)
+{
+    while (1) {
+        printk_flush();
+        task_sleep(KLOG_POLL_NS);
+    }
+}
+
+/**
+ * @brief:          A function that sets up the log devices.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The loader output is cleared. COM1 is polled until
+ *                  init_uart enables its interrupts.
+ */
+void init_printk(void)
+{
+    volatile uint16_t *text = (volatile uint16_t *)P2V(VGA_TEXT);
+    uint32_t i;
+
+    for (i = 0; i < VGA_ROWS*VGA_COLS; i++) {
+        text[i] = VGA_ATTR|' ';
+    }
+    vga_row = 0;
+    vga_col = 0;
+    vga_update_cursor();
+
+    uart_setup();
+}
+
+/**
+ * @brief:      Starts the klog task.
+ */
+void init_printk_task(void)
+{
+    if (task_create("klog", klog_task, 0, KLOG_PRIO) == 0) {
+        while (1) { }
+    }
+}
+
+/**
+ * @brief:          A function that adds a record to the log.
+ *
+ * @param:          fmt  the format string
+ *
+ * @return:         None
+ *
+ * @description:    With interrupts disabled the calling CPU cannot change, so
+ *                  the ring stays the one of this CPU. Before init_smp only
+ *                  the BSP runs and ring 0 is used.
+ */
+void printk(const char *fmt, ...)
+{
+    uint64_t flags = irq_save();
+    struct LogRing *ring;
+    struct LogRecord *rec;
+    uint32_t cpu, head;
+    va_list ap;
+    int len;
+
+    cpu = get_cpu_count() != 0 ? this_cpu()->id : 0;
+    ring = &log_rings[cpu];
+    head = ring->head;
+
+    if (head-__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >=
+        LOG_RING_RECORDS) {
+        ring->drops++;
+        irq_restore(flags);
+        return;
+    }
+
+    rec = &ring->records[head%LOG_RING_RECORDS];
+    va_start(ap, fmt);
+    len = vsnprintf(rec->text, LOG_LINE_SIZE, fmt, ap);
+    va_end(ap);
+    rec->len = len < LOG_LINE_SIZE ? len : LOG_LINE_SIZE-1;
+    rec->cpu = cpu;
+    rec->tsc = read_tsc();
+
+    __atomic_store_n(&ring->head, head+1, __ATOMIC_RELEASE);
+    irq_restore(flags);
+}
+
+/**
+ * @brief:      Writes out all records unless another context is at it.
+ */
+void printk_flush(void)
+{
+    if (!spin_trylock(&drain_lock)) {
+        return;
+    }
+
+    drain_rings();
+    spin_unlock(&drain_lock);
+}
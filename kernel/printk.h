@@ -0,0 +1,88 @@
+/* -----------------------------------------------------------------------------
+ * @file:        printk.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the kernel
+ *               log.
+ *
+ *               printk formats one record into the log ring of the calling
+ *               CPU and returns, it never touches a device and never waits
+ *               for a lock, so it may be called from any context except an
+ *               NMI handler. A record is one line, a missing newline is
+ *               added on output, and it is stamped with the TSC. When the
+ *               ring is full the record is dropped and counted.
+ *
+ *               The klog task drains the rings to the VGA text console set
+ *               up by the loader and to the serial port COM1, oldest TSC
+ *               first, so the lines of all CPUs come out in time order.
+ *               Until the task runs, and on fatal paths, printk_flush does
+ *               the same from the calling context.
+ *
+ *               The format directives are %d, %i, %u, %x, %X, %p, %s, %c and
+ *               %% with the flags 0 and -, a field width and the length
+ *               modifiers h, l, ll and z.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the per-CPU log rings.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _PRINTK_H_
+#define _PRINTK_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "stdarg.h"
+
+#define LOG_LINE_SIZE       112
+#define LOG_RING_RECORDS    64
+
+/**
+ * @fn:        init_printk(void)
+ *
+ * @brief:     Clears the console and sets up COM1. printk works before, its
+ *             records wait in the ring.
+ */
+void init_printk(void);
+/**
+ * @fn:        init_printk_task(void)
+ *
+ * @brief:     Starts the klog task. Must run after init_sched.
+ */
+void init_printk_task(void);
+/**
+ * @fn:        printk(const char *fmt, ...)
+ *
+ * @brief:     Adds a formatted record to the log ring of the calling CPU.
+ *             Must not be used on an AP before init_cpu.
+ */
+void printk(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+/**
+ * @fn:        printk_flush(void)
+ *
+ * @brief:     Writes out all records from the calling context. Returns at
+ *             once if another context is writing them.
+ */
+void printk_flush(void);
+/**
+ * @fn:        vsnprintf(char *buf, size_t size, const char *fmt, va_list ap)
+ *
+ * @brief:     Formats into buf, which always ends with a zero byte if size
+ *             is not 0.
+ *
+ * @return:    The length of the untruncated output.
+ */
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list ap);
+/**
+ * @fn:        snprintf(char *buf, size_t size, const char *fmt, ...)
+ *
+ * @brief:     Formats into buf like vsnprintf.
+ */
+int snprintf(char *buf, size_t size, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif
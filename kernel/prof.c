@@ -0,0 +1,314 @@
+/******************************************************************************
+ * @file:        prof.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the sampling profiler.
+ *
+ *               A sample is recorded from the trap frame of the interrupt,
+ *               so the code under test needs no changes. The frame pointer
+ *               chain is only followed inside the kernel stack of the
+ *               interrupted task, [rsp0 - KSTACK_SIZE, rsp0) of the TSS, and
+ *               only upwards, so a corrupt or missing frame ends the walk
+ *               instead of faulting. The kernel is built with frame pointers
+ *               for this. Code that was interrupted before it pushed rbp
+ *               loses its caller in the sample.
+ *
+ *               Only the CPU itself writes to its buffer, with interrupts
+ *               disabled, and publishes a sample by advancing count. The dump
+ *               stops recording and waits for an RCU grace period, after
+ *               which no CPU is still inside prof_sample, as interrupt
+ *               handlers are RCU readers.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the sampling profiler.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "prof.h"
+#include "smp.h"
+#include "sched.h"
+#include "timer.h"
+#include "slab.h"
+#include "memory.h"
+#include "sync.h"
+#include "printk.h"
+#include "lib.h"
+
+#define PROF_HASH_SIZE      (2*PROF_SAMPLES)
+
+/**
+ * @brief:                One sample, unused entries are 0.
+ *
+ * @struct:               ProfSample
+ *
+ * @param:     pc         The rip, then the return addresses of the callers
+ */
+struct ProfSample {
+    uint64_t pc[PROF_DEPTH];
+};
+
+/**
+ * @brief:                The sample buffer of one CPU.
+ *
+ * @struct:               ProfBuffer
+ *
+ * @param:     samples    PROF_SAMPLES samples, 0 if the CPU does not sample
+ * @param:     count      The number of recorded samples
+ * @param:     lost       The samples dropped on a full buffer
+ * @param:     user       The samples taken in ring 3
+ * @param:     timer      The sampling timer
+ */
+struct ProfBuffer {
+    struct ProfSample *samples;
+    volatile uint32_t count;
+    uint32_t lost;
+    uint32_t user;
+    struct Timer timer;
+};
+
+/**
+ * @brief:                One distinct stack in the dump.
+ *
+ * @struct:               ProfSlot
+ *
+ * @param:     sample     The first sample with this stack, 0 if unused
+ * @param:     count      The number of samples with this stack
+ */
+struct ProfSlot {
+    const struct ProfSample *sample;
+    uint32_t count;
+};
+
+static struct ProfBuffer prof_buffers[MAX_CPUS];
+static volatile bool prof_on;
+
+/**
+ * @brief:          A function that records a sample of the interrupted code.
+ *
+ * @param:          tf  the trap frame of the interrupt
+ *
+ * @return:         None
+ *
+ * @description:    A frame is the saved rbp of the caller followed by the
+ *                  return address. Each frame must lie above the previous
+ *                  one and inside the kernel stack.
+ */
+void prof_sample(const struct TrapFrame *tf)
+{
+    struct ProfBuffer *buf = &prof_buffers[this_cpu()->id];
+    uint64_t top = this_cpu()->tss.rsp0;
+    uint64_t bottom = top-KSTACK_SIZE;
+    uint64_t fp = (uint64_t)tf->rbp;
+    struct ProfSample *sample;
+    uint64_t *frame;
+    uint32_t depth = 1;
+
+    if (!prof_on || buf->samples == 0) {
+        return;
+    }
+    if ((tf->cs&3) != 0) {
+        buf->user++;
+        return;
+    }
+    if (buf->count == PROF_SAMPLES) {
+        buf->lost++;
+        return;
+    }
+
+    sample = &buf->samples[buf->count];
+    sample->pc[0] = (uint64_t)tf->rip;
+    while (depth < PROF_DEPTH && fp >= bottom && fp+16 <= top &&
+           (fp&7) == 0) {
+        frame = (uint64_t *)fp;
+        sample->pc[depth++] = frame[1];
+        if (frame[0] <= fp) {
+            break;
+        }
+        fp = frame[0];
+    }
+    for (; depth < PROF_DEPTH; depth++) {
+        sample->pc[depth] = 0;
+    }
+
+    __atomic_store_n(&buf->count, buf->count+1, __ATOMIC_RELEASE);
+}
+
+#ifdef PROF_PERIOD_US
+/**
+ * @brief:      The sampling timer, samples the code its interrupt
+ *              interrupted and rearms itself.
+ */
+static void prof_timer(struct Timer *timer, void *ctx)
+{
+    struct TrapFrame *tf = timer_irq_frame();
+
+    if (tf != 0) {
+        prof_sample(tf);
+    }
+
+    timer_start_after(timer, PROF_PERIOD_US*NSEC_PER_USEC);
+}
+
+/**
+ * @brief:      The dump task, logs the samples every PROF_DUMP_SEC.
+ */
+static void prof_task(void *arg)
+{
+    while (1) {
+        task_sleep(PROF_DUMP_SEC*NSEC_PER_SEC);
+        prof_dump();
+    }
+}
+#endif
+
+/**
+ * @brief:      Allocates the sample buffer of the calling CPU and starts its
+ *              sampling timer. Without memory the CPU does not sample.
+ */
+void init_prof_cpu(void)
+{
+#ifdef PROF_PERIOD_US
+    struct ProfBuffer *buf = &prof_buffers[this_cpu()->id];
+
+    buf->samples = kmalloc(PROF_SAMPLES*sizeof(struct ProfSample));
+    if (buf->samples == 0) {
+        return;
+    }
+
+    timer_setup(&buf->timer, prof_timer, 0);
+    timer_start_after(&buf->timer, PROF_PERIOD_US*NSEC_PER_USEC);
+#endif
+}
+
+/**
+ * @brief:      Starts sampling on the BSP and the dump task.
+ */
+void init_prof(void)
+{
+#ifdef PROF_PERIOD_US
+    init_prof_cpu();
+    prof_enable(true);
+    task_create("prof", prof_task, 0, SCHED_DEFAULT_PRIO);
+#endif
+}
+
+/**
+ * @brief:      Starts or stops recording on all CPUs.
+ */
+void prof_enable(bool on)
+{
+    __atomic_store_n(&prof_on, on, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief:      Returns the slot of the stack of a sample in the dump table.
+ */
+static struct ProfSlot *find_slot(struct ProfSlot *table,
+                                  const struct ProfSample *sample)
+{
+    uint64_t hash = 14695981039346656037UL;
+    uint32_t i, d;
+
+    for (d = 0; d < PROF_DEPTH; d++) {
+        hash = (hash^sample->pc[d])*1099511628211UL;
+    }
+
+    for (i = hash%PROF_HASH_SIZE; table[i].sample != 0;
+         i = (i+1)%PROF_HASH_SIZE) {
+        for (d = 0; d < PROF_DEPTH; d++) {
+            if (table[i].sample->pc[d] != sample->pc[d]) {
+                break;
+            }
+        }
+        if (d == PROF_DEPTH) {
+            break;
+        }
+    }
+
+    return &table[i];
+}
+
+/**
+ * @brief:          A function that logs and empties the sample buffers.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The samples of a CPU are folded in a hash table with
+ *                  twice as many slots as a buffer has samples, so probing
+ *                  always ends at a free slot. printk_flush after every line
+ *                  keeps the log ring from overflowing. If no table can be
+ *                  allocated the samples are discarded.
+ */
+void prof_dump(void)
+{
+    bool was_on = prof_on;
+    struct ProfSlot *table;
+    struct ProfSlot *slot;
+    struct ProfBuffer *buf;
+    char line[LOG_LINE_SIZE];
+    uint32_t cpu, i, d;
+    int len;
+
+    prof_enable(false);
+    synchronize_rcu();
+
+    table = kmalloc(PROF_HASH_SIZE*sizeof(struct ProfSlot));
+
+    for (cpu = 0; cpu < get_cpu_count(); cpu++) {
+        buf = &prof_buffers[cpu];
+        if (buf->samples == 0) {
+            continue;
+        }
+
+        if (table != 0) {
+            for (i = 0; i < PROF_HASH_SIZE; i++) {
+                table[i].sample = 0;
+                table[i].count = 0;
+            }
+
+            for (i = 0; i < buf->count; i++) {
+                slot = find_slot(table, &buf->samples[i]);
+                if (slot->sample == 0) {
+                    slot->sample = &buf->samples[i];
+                }
+                slot->count++;
+            }
+
+            for (i = 0; i < PROF_HASH_SIZE; i++) {
+                if (table[i].sample == 0) {
+                    continue;
+                }
+
+                len = snprintf(line, sizeof(line), "prof: %u",
+                               table[i].count);
+                for (d = 0; d < PROF_DEPTH && table[i].sample->pc[d] != 0 &&
+                     len < (int)sizeof(line); d++) {
+                    len += snprintf(line+len, sizeof(line)-len, " %lx",
+                                    table[i].sample->pc[d]-KERNEL_VMA);
+                }
+                printk("%s\n", line);
+                printk_flush();
+            }
+        }
+
+        printk("prof cpu %u: %u samples, %u lost, %u in ring 3\n", cpu,
+               buf->count, buf->lost, buf->user);
+        buf->count = 0;
+        buf->lost = 0;
+        buf->user = 0;
+    }
+
+    if (table != 0) {
+        kfree(table);
+    }
+
+    prof_enable(was_on);
+}
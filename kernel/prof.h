@@ -0,0 +1,83 @@
+/* -----------------------------------------------------------------------------
+ * @file:        prof.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the sampling
+ *               profiler.
+ *
+ *               A sample is the rip of the interrupted kernel code followed
+ *               by the return addresses found by walking its frame pointers,
+ *               at most PROF_DEPTH addresses in all. Every CPU keeps its
+ *               samples in its own buffer of PROF_SAMPLES entries, no lock
+ *               is taken when one is recorded. Samples taken in ring 3 are
+ *               only counted.
+ *
+ *               The profiler is built in with "make PROFILE=<us>". Every CPU
+ *               then samples itself from a timer every <us> microseconds,
+ *               and a task logs the samples every PROF_DUMP_SEC seconds. The
+ *               dump folds identical stacks into one line of the form
+ *
+ *                   prof: <count> <pc> <return address> ...
+ *
+ *               with the addresses in hexadecimal as offsets from
+ *               KERNEL_VMA. tools/profsym.py turns these lines of the serial
+ *               log into folded stacks for flame graphs.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the sampling profiler.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _PROF_H_
+#define _PROF_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "trap.h"
+
+#define PROF_DEPTH          12
+#define PROF_SAMPLES        2048
+#define PROF_DUMP_SEC       10
+
+/**
+ * @fn:        init_prof(void)
+ *
+ * @brief:     Sets up the profiler of the BSP and starts the dump task. Must
+ *             run after init_sched. Does nothing unless the profiler is
+ *             built in.
+ */
+void init_prof(void);
+/**
+ * @fn:        init_prof_cpu(void)
+ *
+ * @brief:     Sets up the sample buffer and the sampling timer of an AP.
+ *             Does nothing unless the profiler is built in.
+ */
+void init_prof_cpu(void);
+/**
+ * @fn:        prof_sample(const struct TrapFrame *tf)
+ *
+ * @brief:     Records a sample of the interrupted code. Called with
+ *             interrupts disabled on the CPU that took the interrupt.
+ */
+void prof_sample(const struct TrapFrame *tf);
+/**
+ * @fn:        prof_enable(bool on)
+ *
+ * @brief:     Starts or stops recording on all CPUs.
+ */
+void prof_enable(bool on);
+/**
+ * @fn:        prof_dump(void)
+ *
+ * @brief:     Logs the recorded samples of all CPUs with printk and empties
+ *             the buffers. Recording is stopped for the duration of the
+ *             dump. Must be called from task context.
+ */
+void prof_dump(void);
+
+#endif
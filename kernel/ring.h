@@ -0,0 +1,86 @@
+/* -----------------------------------------------------------------------------
+ * @file:        ring.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the byte ring of the character
+ *               device drivers.
+ *
+ *               A ByteRing has a single producer and a single consumer,
+ *               typically an interrupt handler and a task, which may run on
+ *               different CPUs at the same time without a lock. Only the
+ *               producer writes head and only the consumer writes tail. The
+ *               byte is stored before head is published with a release
+ *               store, and read before tail is published, so neither side
+ *               sees a slot the other is still using. Head and tail are free
+ *               running counters on separate cache lines, their difference
+ *               is the number of bytes in the ring.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the byte ring.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "sync.h"
+
+#define BYTE_RING_SIZE      1024
+
+/**
+ * @brief:                A single-producer single-consumer byte ring.
+ *
+ * @struct:               ByteRing
+ *
+ * @param:     head       The number of bytes put, written by the producer
+ * @param:     tail       The number of bytes taken, written by the consumer
+ * @param:     data       The bytes, byte n is at n % BYTE_RING_SIZE
+ */
+struct ByteRing {
+    volatile uint32_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile uint32_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint8_t data[BYTE_RING_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+static inline bool ring_put(struct ByteRing *ring, uint8_t c)
+{
+    uint32_t head = ring->head;
+
+    if (head-__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >=
+        BYTE_RING_SIZE) {
+        return false;
+    }
+
+    ring->data[head%BYTE_RING_SIZE] = c;
+    __atomic_store_n(&ring->head, head+1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static inline bool ring_get(struct ByteRing *ring, uint8_t *c)
+{
+    uint32_t tail = ring->tail;
+
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+        return false;
+    }
+
+    *c = ring->data[tail%BYTE_RING_SIZE];
+    __atomic_store_n(&ring->tail, tail+1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static inline bool ring_empty(struct ByteRing *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) ==
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+#endif
@@ -0,0 +1,894 @@
+/******************************************************************************
+ * @file:        sched.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the kernel tasks and the scheduler.
+ *
+ *               Tasks are switched in one place, schedule, which runs on the
+ *               way out of a trap with interrupts disabled:
+ *
+ *                  - The trap frame of the interrupted task is saved in its
+ *                    Task and the task goes to the tail of its priority list,
+ *                    unless it is blocked or has exited.
+ *
+ *                  - The next task is the head of the lowest non-empty list,
+ *                    found with one bit scan of the run queue bitmap, or the
+ *                    idle task.
+ *
+ *                  - The rsp0 of the TSS and the system call stack are set
+ *                    to the stack of the next task, the time slice is
+ *                    restarted and its trap frame is returned to
+ *                    TrapReturn.
+ *
+ *               A voluntary switch raises YIELD_VECTOR, so a yielding task is
+ *               saved in exactly the same frame as a preempted one. The
+ *               kernel stack of an exited task cannot be freed while schedule
+ *               still runs on it, so exited tasks are kept on a list and
+ *               freed by the next switch on the same CPU.
+ *
+ *               Each run queue has a spinlock. It is taken by schedule on
+ *               its own CPU and by sched_wakeup from any CPU, so the state of
+ *               a task and its place on the run queue always change
+ *               together. There is no global lock:
+ *
+ *                  - A CPU whose run queue is empty steals a task from the
+ *                    run queue with the most queued tasks. It only tries the
+ *                    lock of the victim while it holds its own, so two CPUs
+ *                    stealing from each other cannot deadlock. The thief
+ *                    takes the newest task of a list, the owner the oldest.
+ *
+ *                  - A task that was just switched out may still have the
+ *                    handler frames of its old CPU on its stack, so on_cpu
+ *                    stays set until Trap has moved to the next stack and
+ *                    called sched_switch_done.
+ *
+ *                  - CPUs running their idle task are kept in idle_mask.
+ *                    Whenever tasks are left waiting on a run queue, one idle
+ *                    CPU is taken out of the mask and sent RESCHED_VECTOR, so
+ *                    it leaves hlt and steals.
+ *
+ *               A task created with task_create_in holds a reference to its
+ *               address space, schedule loads it with address_space_switch
+ *               and the reference is dropped when the stack of the task is
+ *               freed. Tasks without one run on the kernel PML4.
+ *
+ *               A task created with task_create_pinned is never stolen and
+ *               runs on the CPU that created it. Each run queue counts its
+ *               queued pinned tasks, so neither a thief nor kick_idle looks
+ *               at a queue that holds nothing else.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the preemptive scheduler.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Work stealing between the run queues and reschedule IPIs.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Report RCU quiescent states, added sched_kick_cpu.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Tasks may run in an address space, which schedule loads.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     schedule also sets the system call stack of the CPU.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     Added pinned tasks, which are never stolen.
+ *
+ *   - Revision 0.7: 10/14/2026 Marko Trickovic
+ *     Clear the initial trap frame with memset.
+ *
+ *   - Revision 0.8: 10/14/2026 Marko Trickovic
+ *     Save the FPU state of the previous task on a switch.
+ *
+ *   - Revision 0.9: 10/14/2026 Marko Trickovic
+ *     Added preempt_enable_no_resched.
+ *
+ *   - Revision 1.0: 10/14/2026 Marko Trickovic
+ *     send_resched skips a CPU that get_cpu does not know.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "sched.h"
+#include "smp.h"
+#include "apic.h"
+#include "sync.h"
+#include "slab.h"
+#include "memory.h"
+#include "string.h"
+#include "lib.h"
+
+#define RFLAGS_IF           0x200
+#define RFLAGS_DEFAULT      0x202
+
+/**
+ * @brief:       The run queue of one CPU.
+ *
+ * @struct:      RunQueue
+ *
+ * @param:       lock           Protects the lists and the task states
+ * @param:       cpu            The CPU of the run queue
+ * @param:       bitmap         Bit n is set while list n is not empty
+ * @param:       nr_running     The number of queued tasks
+ * @param:       nr_pinned      The number of queued pinned tasks
+ * @param:       head           The first task of each priority list
+ * @param:       tail           The last task of each priority list
+ * @param:       current        The running task
+ * @param:       idle           The idle task of the CPU
+ * @param:       zombies        Exited tasks whose stacks are still to free
+ * @param:       switched       The task to release in sched_switch_done
+ * @param:       need_resched   Set when schedule should run at the next
+ *                              trap return
+ * @param:       preempt_count  The nesting of preempt_disable
+ * @param:       slice          The time slice timer
+ */
+struct RunQueue {
+    struct Spinlock lock;
+    uint32_t cpu;
+    uint32_t bitmap;
+    uint32_t nr_running;
+    uint32_t nr_pinned;
+    struct Task *head[SCHED_PRIOS];
+    struct Task *tail[SCHED_PRIOS];
+    struct Task *current;
+    struct Task *idle;
+    struct Task *zombies;
+    struct Task *switched;
+    volatile uint32_t need_resched;
+    uint32_t preempt_count;
+    struct Timer slice;
+};
+
+static struct RunQueue runqueues[MAX_CPUS];
+static struct KmemCache *task_cache;
+static uint32_t next_task_id;
+static uint32_t idle_mask;
+static bool sched_ready;
+
+/**
+ * @brief:     Returns the run queue of the calling CPU. Interrupts must be
+ *             disabled, or preemption.
+ */
+static struct RunQueue *this_rq(void)
+{
+    return &runqueues[this_cpu()->id];
+}
+
+/**
+ * @brief:     Appends a task to its priority list. The run queue lock must be
+ *             held.
+ */
+static void enqueue(struct RunQueue *rq, struct Task *task)
+{
+    uint32_t prio = task->prio;
+
+    task->next = 0;
+    task->prev = rq->tail[prio];
+    if (rq->tail[prio] == 0) {
+        rq->head[prio] = task;
+        rq->bitmap |= 1U<<prio;
+    }
+    else {
+        rq->tail[prio]->next = task;
+    }
+    rq->tail[prio] = task;
+    rq->nr_running++;
+    rq->nr_pinned += task->pinned;
+}
+
+/**
+ * @brief:     Removes a queued task from its priority list. The run queue
+ *             lock must be held.
+ */
+static void unlink_task(struct RunQueue *rq, struct Task *task)
+{
+    uint32_t prio = task->prio;
+
+    if (task->prev != 0) {
+        task->prev->next = task->next;
+    }
+    else {
+        rq->head[prio] = task->next;
+    }
+
+    if (task->next != 0) {
+        task->next->prev = task->prev;
+    }
+    else {
+        rq->tail[prio] = task->prev;
+    }
+
+    if (rq->head[prio] == 0) {
+        rq->bitmap &= ~(1U<<prio);
+    }
+    rq->nr_running--;
+    rq->nr_pinned -= task->pinned;
+}
+
+/**
+ * @brief:     Removes the task with the highest priority from the run queue.
+ *             The run queue lock must be held.
+ *
+ * @return:    The task, or 0 if the run queue is empty.
+ */
+static struct Task *dequeue(struct RunQueue *rq)
+{
+    struct Task *task;
+
+    if (rq->bitmap == 0) {
+        return 0;
+    }
+
+    task = rq->head[__builtin_ctz(rq->bitmap)];
+    unlink_task(rq, task);
+
+    return task;
+}
+
+/**
+ * @brief:          A function that steals a task for an empty run queue.
+ *
+ * @param:          rq  the run queue of the calling CPU, locked
+ *
+ * @return:         The task, now owned by rq, or 0.
+ *
+ * @description:    The queue lengths are read without locks to find the
+ *                  victim. The newest task of the highest priority that is
+ *                  neither pinned nor still on its old stack is taken.
+ */
+static struct Task *steal_task(struct RunQueue *rq)
+{
+    struct RunQueue *victim = 0;
+    struct Task *task = 0;
+    uint32_t count = get_cpu_count();
+    uint32_t most = 0;
+    uint32_t bits, i, n;
+
+    for (i = 0; i < count; i++) {
+        n = runqueues[i].nr_running-runqueues[i].nr_pinned;
+        if (i != rq->cpu && n > most) {
+            most = n;
+            victim = &runqueues[i];
+        }
+    }
+
+    if (victim == 0 || !spin_trylock(&victim->lock)) {
+        return 0;
+    }
+
+    bits = victim->bitmap;
+    while (bits != 0 && task == 0) {
+        task = victim->tail[__builtin_ctz(bits)];
+        while (task != 0 && (task->on_cpu || task->pinned)) {
+            task = task->prev;
+        }
+        bits &= bits-1;
+    }
+
+    if (task != 0) {
+        unlink_task(victim, task);
+        task->cpu = rq->cpu;
+    }
+
+    spin_unlock(&victim->lock);
+    return task;
+}
+
+/**
+ * @brief:     Sends RESCHED_VECTOR to a CPU. Interrupts must be disabled, the
+ *             xAPIC ICR is written in two halves. start_aps registers an AP
+ *             before its run queue can join idle_mask, a CPU that get_cpu
+ *             does not know is skipped all the same.
+ */
+static void send_resched(uint32_t cpu)
+{
+    struct Cpu *c = get_cpu(cpu);
+
+    if (c != 0) {
+        lapic_send_ipi(c->apic_id, RESCHED_VECTOR);
+    }
+}
+
+/**
+ * @brief:     Wakes up one idle CPU other than the one of rq to steal from
+ *             the waiting tasks. The CPU leaves idle_mask, so several tasks
+ *             queued in a row wake several CPUs. Nothing is done while only
+ *             pinned tasks wait. Interrupts must be disabled.
+ */
+static void kick_idle(struct RunQueue *rq)
+{
+    uint32_t mask = __atomic_load_n(&idle_mask, __ATOMIC_RELAXED);
+    uint32_t cpu;
+
+    mask &= ~(1U<<rq->cpu);
+    if (mask == 0 || rq->nr_running == rq->nr_pinned) {
+        return;
+    }
+
+    cpu = (uint32_t)__builtin_ctz(mask);
+    if (__atomic_fetch_and(&idle_mask, ~(1U<<cpu), __ATOMIC_RELAXED) &
+        (1U<<cpu)) {
+        send_resched(cpu);
+    }
+}
+
+/**
+ * @brief:     The callback of the time slice timer. The running task is only
+ *             preempted when another task is waiting, otherwise it gets a
+ *             new slice.
+ */
+static void slice_expired(struct Timer *timer, void *ctx)
+{
+    struct RunQueue *rq = ctx;
+
+    if (rq->nr_running > 0) {
+        rq->need_resched = 1;
+    }
+    else {
+        timer_start_after(timer, SCHED_SLICE_NS);
+    }
+}
+
+/**
+ * @brief:     The callback of the task_sleep timer.
+ */
+static void sleep_expired(struct Timer *timer, void *ctx)
+{
+    sched_wakeup(ctx);
+}
+
+/**
+ * @brief:     The handler of YIELD_VECTOR, the switch itself happens in
+ *             sched_trap_return.
+ */
+static void yield_handler(struct TrapFrame *tf, void *ctx)
+{
+    this_rq()->need_resched = 1;
+}
+
+/**
+ * @brief:     The handler of RESCHED_VECTOR, sent by another CPU that queued
+ *             a task for this one or for an idle CPU to steal.
+ */
+static void resched_handler(struct TrapFrame *tf, void *ctx)
+{
+    this_rq()->need_resched = 1;
+    eoi();
+}
+
+/**
+ * @brief:          A function that switches to the next task.
+ *
+ * @param:          rq  the run queue of the calling CPU
+ * @param:          tf  the trap frame of the running task
+ *
+ * @return:         The trap frame of the next task.
+ *
+ * @description:    The zombies of earlier switches are taken off the list
+ *                  under the lock and freed after it, none of them is the
+ *                  task whose stack is in use. The previous task keeps
+ *                  on_cpu until sched_switch_done, so its FPU state is saved
+ *                  before another CPU can steal it.
+ */
+static struct TrapFrame *schedule(struct RunQueue *rq, struct TrapFrame *tf)
+{
+    struct Task *prev = rq->current;
+    struct Task *next, *dead, *task;
+
+    spin_lock(&rq->lock);
+    rq->need_resched = 0;
+    dead = rq->zombies;
+    rq->zombies = 0;
+
+    prev->tf = tf;
+    if (prev != rq->idle) {
+        if (prev->state == TASK_RUNNING) {
+            enqueue(rq, prev);
+        }
+        else if (prev->state == TASK_ZOMBIE) {
+            prev->next = rq->zombies;
+            rq->zombies = prev;
+        }
+    }
+
+    next = dequeue(rq);
+    if (next == 0) {
+        next = steal_task(rq);
+    }
+    if (next == 0) {
+        next = rq->idle;
+    }
+    if (next != prev) {
+        next->on_cpu = 1;
+        rq->switched = prev;
+    }
+    rq->current = next;
+    spin_unlock(&rq->lock);
+
+    if (next != prev) {
+        fpu_switch(prev);
+    }
+
+    this_cpu()->tss.rsp0 = next->stack_top;
+    this_cpu()->sys_rsp = next->stack_top;
+    address_space_switch(next->as);
+    if (next != rq->idle) {
+        __atomic_fetch_and(&idle_mask, ~(1U<<rq->cpu), __ATOMIC_RELAXED);
+        timer_start_after(&rq->slice, SCHED_SLICE_NS);
+    }
+    else {
+        __atomic_fetch_or(&idle_mask, 1U<<rq->cpu, __ATOMIC_RELAXED);
+        timer_cancel(&rq->slice);
+    }
+
+    if (rq->nr_running > 0) {
+        kick_idle(rq);
+    }
+
+    while (dead != 0) {
+        task = dead;
+        dead = dead->next;
+        free_frames(V2P(task->stack), KSTACK_ORDER);
+        if (task->as != 0) {
+            address_space_put(task->as);
+        }
+        fpu_release(task);
+        kmem_cache_free(task_cache, task);
+    }
+
+    return next->tf;
+}
+
+/**
+ * @brief:          A function that decides which trap frame a trap returns
+ *                  to.
+ *
+ * @param:          tf  the trap frame pushed by the trap
+ *
+ * @return:         tf, or the trap frame of the next task.
+ *
+ * @description:    Tasks are only switched when a switch was requested and
+ *                  preemption is enabled. A trap that interrupted code with
+ *                  interrupts disabled returns to it, that code may hold a
+ *                  lock taken with spin_lock_irqsave. YIELD_VECTOR is the
+ *                  exception, as it is raised on purpose.
+ *
+ *                  Returning to code with interrupts and preemption enabled
+ *                  is also an RCU quiescent state of the CPU.
+ */
+struct TrapFrame *sched_trap_return(struct TrapFrame *tf)
+{
+    struct RunQueue *rq;
+
+    if (!sched_ready) {
+        return tf;
+    }
+
+    rq = this_rq();
+    if (rq->preempt_count == 0 && (tf->rflags & RFLAGS_IF)) {
+        rcu_quiescent(rq->cpu);
+    }
+
+    if (!rq->need_resched || rq->preempt_count != 0) {
+        return tf;
+    }
+
+    if (!(tf->rflags & RFLAGS_IF) && tf->trapno != YIELD_VECTOR) {
+        return tf;
+    }
+
+    return schedule(rq, tf);
+}
+
+/**
+ * @brief:      Releases the task that the calling CPU switched away from, it
+ *              may now be stolen. Trap calls it after loading the stack
+ *              pointer of the next task.
+ */
+void sched_switch_done(void)
+{
+    struct RunQueue *rq = this_rq();
+    struct Task *prev = rq->switched;
+
+    rq->switched = 0;
+    if (prev != 0) {
+        __atomic_store_n(&prev->on_cpu, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief:          A function that sets up the run queue of the calling CPU.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The calling context becomes the idle task. It has no
+ *                  stack of its own, it keeps running on the boot stack of
+ *                  the CPU, and its trap frame is saved by its first switch.
+ */
+void init_sched_cpu(void)
+{
+    struct Cpu *cpu = this_cpu();
+    struct RunQueue *rq = &runqueues[cpu->id];
+    struct Task *idle = kmem_cache_alloc(task_cache);
+
+    if (idle == 0) {
+        while (1) { }
+    }
+
+    idle->tf = 0;
+    idle->stack = 0;
+    idle->stack_top = cpu->stack_top;
+    idle->id = __atomic_fetch_add(&next_task_id, 1, __ATOMIC_RELAXED);
+    idle->state = TASK_RUNNING;
+    idle->prio = SCHED_PRIOS;
+    idle->cpu = cpu->id;
+    idle->on_cpu = 1;
+    idle->next = 0;
+    idle->prev = 0;
+    idle->woken = 0;
+    idle->pinned = 1;
+    idle->as = 0;
+    idle->name = "idle";
+    idle->fpu = 0;
+    idle->fpu_cpu = FPU_NO_CPU;
+    timer_setup(&idle->timer, sleep_expired, idle);
+
+    spin_init(&rq->lock);
+    rq->cpu = cpu->id;
+    rq->current = idle;
+    rq->idle = idle;
+    timer_setup(&rq->slice, slice_expired, rq);
+
+    __atomic_fetch_or(&idle_mask, 1U<<cpu->id, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief:          A function that initializes the scheduler.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The function must run on the BSP after init_slab,
+ *                  init_smp and init_timer, and before the APs are started.
+ */
+void init_sched(void)
+{
+    task_cache = kmem_cache_create("task", sizeof(struct Task), 0, 0);
+    if (task_cache == 0) {
+        while (1) { }
+    }
+
+    register_irq_handler(YIELD_VECTOR, yield_handler, 0);
+    register_irq_handler(RESCHED_VECTOR, resched_handler, 0);
+    init_sched_cpu();
+    sched_ready = true;
+}
+
+/**
+ * @brief:          A function that creates a task.
+ *
+ * @param:          as      the address space, 0 for the kernel PML4
+ * @param[in]:      name    the name of the task
+ * @param[in]:      fn      the function the task runs
+ * @param[in]:      arg     the argument of fn
+ * @param[in]:      prio    the priority, 0 is the highest
+ * @param:          pinned  keep the task on the calling CPU
+ *
+ * @return:         The task, or 0 if no memory is available.
+ *
+ * @description:    The initial trap frame sits at the top of the new stack,
+ *                  above it the address of task_exit, so fn returns into
+ *                  task_exit. The task is queued on the calling CPU and
+ *                  preempts the caller if it has a higher priority,
+ *                  otherwise an idle CPU is woken up to steal it.
+ */
+static struct Task *create_task(struct AddressSpace *as, const char *name,
+                                task_fn_t fn, void *arg, uint32_t prio,
+                                bool pinned)
+{
+    struct Task *task = kmem_cache_alloc(task_cache);
+    struct TrapFrame *tf;
+    struct RunQueue *rq;
+    uint64_t stack, top, flags;
+
+    if (task == 0) {
+        return 0;
+    }
+
+    stack = alloc_frames(KSTACK_ORDER);
+    if (stack == 0) {
+        kmem_cache_free(task_cache, task);
+        return 0;
+    }
+
+    if (prio >= SCHED_PRIOS) {
+        prio = SCHED_PRIOS-1;
+    }
+
+    task->stack = P2V(stack);
+    task->stack_top = task->stack+KSTACK_SIZE;
+
+    top = task->stack_top-8;
+    *(uint64_t *)top = (uint64_t)task_exit;
+
+    tf = (struct TrapFrame *)(task->stack_top-16-sizeof(struct TrapFrame));
+    memset(tf, 0, sizeof(struct TrapFrame));
+    tf->rip = (int64_t)fn;
+    tf->rdi = (int64_t)arg;
+    tf->cs = KERNEL_CS;
+    tf->rflags = RFLAGS_DEFAULT;
+    tf->rsp = (int64_t)top;
+
+    task->tf = tf;
+    task->id = __atomic_fetch_add(&next_task_id, 1, __ATOMIC_RELAXED);
+    task->state = TASK_RUNNING;
+    task->prio = prio;
+    task->on_cpu = 0;
+    task->woken = 0;
+    task->pinned = pinned;
+    task->as = as;
+    task->name = name;
+    task->fpu = 0;
+    task->fpu_cpu = FPU_NO_CPU;
+    timer_setup(&task->timer, sleep_expired, task);
+    if (as != 0) {
+        address_space_get(as);
+    }
+
+    flags = irq_save();
+    rq = this_rq();
+    task->cpu = this_cpu()->id;
+    spin_lock(&rq->lock);
+    enqueue(rq, task);
+    if (prio < rq->current->prio) {
+        rq->need_resched = 1;
+    }
+    else {
+        kick_idle(rq);
+    }
+    spin_unlock(&rq->lock);
+    irq_restore(flags);
+
+    return task;
+}
+
+/**
+ * @brief:      Creates a task that runs in an address space.
+ */
+struct Task *task_create_in(struct AddressSpace *as, const char *name,
+                            task_fn_t fn, void *arg, uint32_t prio)
+{
+    return create_task(as, name, fn, arg, prio, false);
+}
+
+/**
+ * @brief:      Creates a task that runs on the kernel PML4.
+ */
+struct Task *task_create(const char *name, task_fn_t fn, void *arg,
+                         uint32_t prio)
+{
+    return task_create_in(0, name, fn, arg, prio);
+}
+
+/**
+ * @brief:      Creates a task that never leaves the calling CPU.
+ */
+struct Task *task_create_pinned(const char *name, task_fn_t fn, void *arg,
+                                uint32_t prio)
+{
+    return create_task(0, name, fn, arg, prio, true);
+}
+
+/**
+ * @brief:      Ends the calling task.
+ */
+void task_exit(void)
+{
+    uint64_t flags = irq_save();
+
+    this_rq()->current->state = TASK_ZOMBIE;
+    irq_restore(flags);
+
+    sched_yield();
+
+    while (1) { }
+}
+
+/**
+ * @brief:      Returns the task running on the calling CPU.
+ */
+struct Task *current_task(void)
+{
+    uint64_t flags = irq_save();
+    struct Task *task = this_rq()->current;
+
+    irq_restore(flags);
+    return task;
+}
+
+/**
+ * @brief:      Gives up the CPU to the next task.
+ */
+void sched_yield(void)
+{
+    if (sched_ready) {
+        yield_trap();
+    }
+}
+
+/**
+ * @brief:          A function that blocks the calling task.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The woken flag and the state are checked and changed under
+ *                  the run queue lock, like in sched_wakeup. A task that is
+ *                  preempted after it marked itself blocked is simply not
+ *                  queued again, which is what the yield would have done.
+ */
+void sched_block(void)
+{
+    uint64_t flags = irq_save();
+    struct RunQueue *rq = this_rq();
+    struct Task *task = rq->current;
+
+    spin_lock(&rq->lock);
+    if (task->woken) {
+        task->woken = 0;
+        spin_unlock(&rq->lock);
+        irq_restore(flags);
+        return;
+    }
+    task->state = TASK_BLOCKED;
+    spin_unlock(&rq->lock);
+    irq_restore(flags);
+
+    sched_yield();
+}
+
+/**
+ * @brief:          A function that wakes up a task.
+ *
+ * @param:          task  the task
+ *
+ * @return:         None
+ *
+ * @description:    A blocked task that is still the current task of its CPU
+ *                  has not been switched out yet, schedule queues it as soon
+ *                  as it sees the new state. A running task keeps the wakeup
+ *                  for its next sched_block.
+ *
+ *                  task->cpu only changes under the lock of the run queue
+ *                  the task leaves, so it is read again once the lock is
+ *                  held. The CPU of the task is sent RESCHED_VECTOR when the
+ *                  task preempts its current task, otherwise an idle CPU is
+ *                  woken up to steal it.
+ */
+void sched_wakeup(struct Task *task)
+{
+    uint64_t flags = irq_save();
+    struct RunQueue *rq;
+
+    while (1) {
+        rq = &runqueues[task->cpu];
+        spin_lock(&rq->lock);
+        if (task->cpu == rq->cpu) {
+            break;
+        }
+        spin_unlock(&rq->lock);
+    }
+
+    if (task->state == TASK_BLOCKED) {
+        task->state = TASK_RUNNING;
+        if (task != rq->current) {
+            enqueue(rq, task);
+            if (task->prio < rq->current->prio) {
+                rq->need_resched = 1;
+                if (rq != this_rq()) {
+                    send_resched(rq->cpu);
+                }
+            }
+            else {
+                kick_idle(rq);
+            }
+        }
+    }
+    else if (task->state == TASK_RUNNING) {
+        task->woken = 1;
+    }
+
+    spin_unlock(&rq->lock);
+    irq_restore(flags);
+}
+
+/**
+ * @brief:      Blocks the calling task for at least ns nanoseconds.
+ */
+void task_sleep(uint64_t ns)
+{
+    struct Task *task = current_task();
+
+    timer_start_after(&task->timer, ns);
+    sched_block();
+    timer_cancel(&task->timer);
+}
+
+/**
+ * @brief:      Sends RESCHED_VECTOR to another CPU.
+ */
+void sched_kick_cpu(uint32_t cpu)
+{
+    uint64_t flags = irq_save();
+
+    send_resched(cpu);
+    irq_restore(flags);
+}
+
+/**
+ * @brief:      Disables preemption on the calling CPU. Before init_sched
+ *              there is nothing to preempt and the call does nothing.
+ */
+void preempt_disable(void)
+{
+    uint64_t flags;
+
+    if (!sched_ready) {
+        return;
+    }
+
+    flags = irq_save();
+    this_rq()->preempt_count++;
+    irq_restore(flags);
+}
+
+/**
+ * @brief:      Enables preemption on the calling CPU again.
+ */
+void preempt_enable(void)
+{
+    uint64_t flags;
+    struct RunQueue *rq;
+    bool resched;
+
+    if (!sched_ready) {
+        return;
+    }
+
+    flags = irq_save();
+    rq = this_rq();
+    rq->preempt_count--;
+    resched = rq->preempt_count == 0 && rq->need_resched;
+    irq_restore(flags);
+
+    if (resched) {
+        sched_yield();
+    }
+}
+
+/**
+ * @brief:      Enables preemption on the calling CPU again, a requested
+ *              switch waits for the next trap return or preempt_enable.
+ */
+void preempt_enable_no_resched(void)
+{
+    uint64_t flags;
+
+    if (!sched_ready) {
+        return;
+    }
+
+    flags = irq_save();
+    this_rq()->preempt_count--;
+    irq_restore(flags);
+}
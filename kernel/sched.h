@@ -0,0 +1,259 @@
+/* -----------------------------------------------------------------------------
+ * @file:        sched.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the kernel
+ *               tasks and the scheduler.
+ *
+ *               A task is a kernel thread with its own KSTACK_SIZE stack.
+ *               Its state while it does not run is the TrapFrame that the
+ *               trap entry path pushed on that stack, so a task switch is
+ *               nothing more than handler returning the frame of another
+ *               task to TrapReturn. A new task starts from a frame built at
+ *               the top of its stack.
+ *
+ *               Every CPU has a run queue with one FIFO list per priority
+ *               and a bitmap of the non-empty lists, so picking the next task
+ *               is a single bit scan. Priority 0 is the highest. Tasks of the
+ *               same priority share the CPU in SCHED_SLICE_NS time slices,
+ *               measured by a per-CPU timer, and a task that wakes up with a
+ *               higher priority preempts the running one. The context that
+ *               initializes the scheduler on a CPU becomes its idle task,
+ *               which runs when the run queue is empty.
+ *
+ *               A CPU that runs out of tasks steals one from the busiest
+ *               other run queue, taking it from the tail of a priority list
+ *               while the owner takes from the head. Queuing a task sends a
+ *               reschedule IPI to an idle CPU, which wakes it up to steal.
+ *
+ *               Preemption happens on the way out of any trap that
+ *               interrupted code with interrupts enabled. Code that uses a
+ *               plain spin_lock from task context must disable preemption
+ *               with preempt_disable, or take the lock with
+ *               spin_lock_irqsave.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the preemptive scheduler.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Work stealing between the run queues and reschedule IPIs.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Declared sched_kick_cpu.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Added the address space of a task and task_create_in.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     Added pinned tasks and task_create_pinned.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     Added the FPU state area of a task.
+ *
+ *   - Revision 0.7: 10/14/2026 Marko Trickovic
+ *     Declared preempt_enable_no_resched.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "trap.h"
+#include "timer.h"
+#include "paging.h"
+#include "fpu.h"
+
+#define SCHED_PRIOS         32
+#define SCHED_DEFAULT_PRIO  16
+#define SCHED_SLICE_NS      (10*NSEC_PER_MSEC)
+
+#define TASK_RUNNING        0
+#define TASK_BLOCKED        1
+#define TASK_ZOMBIE         2
+
+/**
+ * @brief:                A kernel task.
+ *
+ * @struct:               Task
+ *
+ * @param:     tf         The saved trap frame while the task does not run
+ * @param:     stack      The base of the kernel stack, 0 for an idle task
+ * @param:     stack_top  The top of the kernel stack, the rsp0 of the TSS
+ *                        while the task runs
+ * @param:     id         The task number
+ * @param:     state      TASK_RUNNING, TASK_BLOCKED or TASK_ZOMBIE
+ * @param:     prio       The priority, 0 is the highest
+ * @param:     cpu        The CPU whose run queue holds the task
+ * @param:     on_cpu     Set while a CPU runs on the stack of the task,
+ *                        a task is not stolen before it is cleared
+ * @param:     next       The next task on the same run queue list
+ * @param:     prev       The previous task on the same run queue list
+ * @param:     woken      Set by a wakeup that found the task running
+ * @param:     pinned     1 if the task is never stolen by another CPU
+ * @param:     timer      The timer of task_sleep
+ * @param:     as         The address space, 0 for the kernel PML4
+ * @param:     name       The name of the task
+ * @param:     fpu        The x87 and SIMD state area, 0 until the task
+ *                        first uses the registers
+ * @param:     fpu_cpu    The CPU the state was last loaded on, FPU_NO_CPU
+ *                        if none
+ */
+struct Task {
+    struct TrapFrame *tf;
+    uint64_t stack;
+    uint64_t stack_top;
+    uint32_t id;
+    volatile uint32_t state;
+    uint32_t prio;
+    uint32_t cpu;
+    volatile uint32_t on_cpu;
+    struct Task *next;
+    struct Task *prev;
+    uint32_t woken;
+    uint32_t pinned;
+    struct Timer timer;
+    struct AddressSpace *as;
+    const char *name;
+    void *fpu;
+    uint32_t fpu_cpu;
+};
+
+typedef void (*task_fn_t)(void *arg);
+
+/**
+ * @fn:        init_sched(void)
+ *
+ * @brief:     Creates the task cache and the run queue of the BSP.
+ */
+void init_sched(void);
+/**
+ * @fn:        init_sched_cpu(void)
+ *
+ * @brief:     Creates the run queue and the idle task of the calling CPU.
+ */
+void init_sched_cpu(void);
+/**
+ * @fn:        task_create(const char *name, task_fn_t fn, void *arg,
+ *                         uint32_t prio)
+ *
+ * @brief:     Creates a task that runs fn(arg) on the calling CPU. The task
+ *             exits when fn returns.
+ *
+ * @return:    The task, or 0 if no memory is available.
+ */
+struct Task *task_create(const char *name, task_fn_t fn, void *arg,
+                         uint32_t prio);
+/**
+ * @fn:        task_create_in(struct AddressSpace *as, const char *name,
+ *                            task_fn_t fn, void *arg, uint32_t prio)
+ *
+ * @brief:     Creates a task like task_create that runs in the address space
+ *             as and holds a reference to it.
+ *
+ * @return:    The task, or 0 if no memory is available.
+ */
+struct Task *task_create_in(struct AddressSpace *as, const char *name,
+                            task_fn_t fn, void *arg, uint32_t prio);
+/**
+ * @fn:        task_create_pinned(const char *name, task_fn_t fn, void *arg,
+ *                                uint32_t prio)
+ *
+ * @brief:     Creates a task like task_create that always runs on the
+ *             calling CPU, where no other CPU steals it from.
+ *
+ * @return:    The task, or 0 if no memory is available.
+ */
+struct Task *task_create_pinned(const char *name, task_fn_t fn, void *arg,
+                                uint32_t prio);
+/**
+ * @fn:        task_exit(void)
+ *
+ * @brief:     Ends the calling task. Its stack is freed by a later task
+ *             switch.
+ */
+void task_exit(void);
+/**
+ * @fn:        task_sleep(uint64_t ns)
+ *
+ * @brief:     Blocks the calling task for at least ns nanoseconds, or until
+ *             a sched_wakeup.
+ */
+void task_sleep(uint64_t ns);
+/**
+ * @fn:        current_task(void)
+ *
+ * @brief:     Returns the task running on the calling CPU.
+ */
+struct Task *current_task(void);
+/**
+ * @fn:        sched_yield(void)
+ *
+ * @brief:     Gives up the CPU to the next task. A blocked task stays off the
+ *             run queue until it is woken.
+ */
+void sched_yield(void);
+/**
+ * @fn:        sched_block(void)
+ *
+ * @brief:     Blocks the calling task until sched_wakeup. A wakeup that
+ *             arrives before the call is remembered, sched_block then
+ *             returns at once.
+ */
+void sched_block(void);
+/**
+ * @fn:        sched_wakeup(struct Task *task)
+ *
+ * @brief:     Makes a blocked task runnable, or makes the next sched_block
+ *             of a running task return at once.
+ */
+void sched_wakeup(struct Task *task);
+/**
+ * @fn:        sched_kick_cpu(uint32_t cpu)
+ *
+ * @brief:     Sends a reschedule IPI to another CPU.
+ */
+void sched_kick_cpu(uint32_t cpu);
+/**
+ * @fn:        preempt_disable(void)
+ *
+ * @brief:     Keeps the calling task on the CPU until preempt_enable.
+ *             Calls nest.
+ */
+void preempt_disable(void);
+/**
+ * @fn:        preempt_enable(void)
+ *
+ * @brief:     Undoes preempt_disable and switches tasks if a switch was
+ *             requested in between.
+ */
+void preempt_enable(void);
+/**
+ * @fn:        preempt_enable_no_resched(void)
+ *
+ * @brief:     Undoes preempt_disable without switching tasks, for interrupt
+ *             handlers, whose trap return switches instead.
+ */
+void preempt_enable_no_resched(void);
+/**
+ * @fn:        sched_trap_return(struct TrapFrame *tf)
+ *
+ * @brief:     Called by handler on the way out of every trap.
+ *
+ * @return:    tf, or the trap frame of the next task.
+ */
+struct TrapFrame *sched_trap_return(struct TrapFrame *tf);
+/**
+ * @fn:        sched_switch_done(void)
+ *
+ * @brief:     Called by Trap on the stack of the next task after a switch,
+ *             releases the previous task to other CPUs.
+ */
+void sched_switch_done(void);
+
+#endif
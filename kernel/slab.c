@@ -0,0 +1,479 @@
+/******************************************************************************
+ * @file:        slab.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the slab allocator of the kernel.
+ *
+ *               A slab is a block of 2^order frames. The frames are tagged
+ *               with FRAME_SLAB and the slab order in their Frame descriptors,
+ *               and because buddy blocks are naturally aligned the Slab header
+ *               of any object is found by rounding its address down to the
+ *               slab size.
+ *
+ *               Each cache keeps its slabs on three lists: partial, full and
+ *               empty. Allocation takes an object from the first partial slab
+ *               and falls back to an empty slab or a new one. A few empty
+ *               slabs are kept with their constructed objects, surplus empty
+ *               slabs go back to the frame allocator.
+ *
+ *               The leftover space at the end of a slab is used to shift the
+ *               first object of successive slabs by whole cache lines, so the
+ *               same object index in different slabs does not always map to
+ *               the same cache set.
+ *
+ *               The cache lock is taken with interrupts disabled, as kfree
+ *               may run in interrupt context. new_slab and destroy_slab run
+ *               under it and take the frame allocator lock inside.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the slab allocator.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Take the cache lock in kmem_cache_alloc and kmem_cache_free.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "slab.h"
+#include "memory.h"
+
+#define SLAB_MAX_ORDER      3
+#define SLAB_MIN_OBJECTS    8
+#define SLAB_MAX_EMPTY      2
+#define SLAB_END            0xffff
+
+#define ALIGN_UP(v, a)      ((((uint64_t)(v))+(a)-1)&~((uint64_t)(a)-1))
+
+/**
+ * @brief:                The header at the start of every slab.
+ *
+ * @struct:               Slab
+ *
+ * @param:     cache      The cache that owns the slab
+ * @param:     next       The next slab on the same list
+ * @param:     prev       The previous slab on the same list
+ * @param:     mem        The address of the first object
+ * @param:     inuse      The number of allocated objects
+ * @param:     free       The index of the first free object, or SLAB_END
+ * @param:     res0       Reserved, set to zero
+ * @param:     index      The free list, index[i] is the free object after i
+ */
+struct Slab {
+    struct KmemCache *cache;
+    struct Slab *next;
+    struct Slab *prev;
+    uint8_t *mem;
+    uint32_t inuse;
+    uint16_t free;
+    uint16_t res0;
+    uint16_t index[];
+};
+
+static struct KmemCache caches[KMEM_MAX_CACHES];
+static uint32_t cache_count;
+static struct Spinlock cache_table_lock = SPINLOCK_INIT;
+
+static struct KmemCache *kmalloc_caches[KMALLOC_MAX_SHIFT-KMALLOC_MIN_SHIFT+1];
+
+static const char *kmalloc_names[KMALLOC_MAX_SHIFT-KMALLOC_MIN_SHIFT+1] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128", "kmalloc-256",
+    "kmalloc-512", "kmalloc-1024", "kmalloc-2048", "kmalloc-4096"
+};
+
+/**
+ * @brief:     Adds a slab to the front of a list.
+ */
+static void slab_list_add(struct Slab **head, struct Slab *slab)
+{
+    slab->prev = 0;
+    slab->next = *head;
+    if (*head != 0) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
+
+/**
+ * @brief:     Removes a slab from a list.
+ */
+static void slab_list_del(struct Slab **head, struct Slab *slab)
+{
+    if (slab->prev != 0) {
+        slab->prev->next = slab->next;
+    }
+    else {
+        *head = slab->next;
+    }
+
+    if (slab->next != 0) {
+        slab->next->prev = slab->prev;
+    }
+
+    slab->next = 0;
+    slab->prev = 0;
+}
+
+/**
+ * @brief:     Returns the number of objects that fit in a slab of the given
+ *             order together with the header and its index array.
+ */
+static uint32_t slab_capacity(uint32_t order, uint32_t stride, uint32_t align)
+{
+    uint64_t bytes = PAGE_SIZE<<order;
+    uint64_t count = bytes/stride;
+    uint64_t header;
+
+    if (count > SLAB_END-1) {
+        count = SLAB_END-1;
+    }
+
+    while (count > 0) {
+        header = ALIGN_UP(sizeof(struct Slab)+count*sizeof(uint16_t), align);
+        if (header+count*stride <= bytes) {
+            break;
+        }
+        count--;
+    }
+
+    return (uint32_t)count;
+}
+
+/**
+ * @brief:          A function that creates an object cache.
+ *
+ * @param[in]:      name   the name of the cache
+ * @param[in]:      size   the size of an object
+ * @param[in]:      align  the minimum alignment of an object, or 0
+ * @param[in]:      ctor   the constructor of an object, or 0
+ *
+ * @return:         The cache, or 0 on failure.
+ *
+ * @description:    Objects of a cache line or more are aligned to a cache
+ *                  line. The slab order is the smallest one that holds at least
+ *                  SLAB_MIN_OBJECTS objects, up to SLAB_MAX_ORDER.
+ */
+struct KmemCache *kmem_cache_create(const char *name, size_t size, size_t align,
+                                    void (*ctor)(void *obj))
+{
+    struct KmemCache *cache;
+    uint32_t order, objects, stride;
+    uint32_t header_align;
+    uint64_t flags;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    if (align < sizeof(void *)) {
+        align = sizeof(void *);
+    }
+    if (size >= CACHE_LINE_SIZE && align < CACHE_LINE_SIZE) {
+        align = CACHE_LINE_SIZE;
+    }
+
+    stride = (uint32_t)ALIGN_UP(size, align);
+    header_align = align > CACHE_LINE_SIZE ? (uint32_t)align : CACHE_LINE_SIZE;
+
+    objects = 0;
+    for (order = 0; order <= SLAB_MAX_ORDER; order++) {
+        objects = slab_capacity(order, stride, header_align);
+        if (objects >= SLAB_MIN_OBJECTS) {
+            break;
+        }
+    }
+
+    if (order > SLAB_MAX_ORDER) {
+        order = SLAB_MAX_ORDER;
+    }
+    if (objects == 0) {
+        return 0;
+    }
+
+    flags = spin_lock_irqsave(&cache_table_lock);
+    if (cache_count == KMEM_MAX_CACHES) {
+        spin_unlock_irqrestore(&cache_table_lock, flags);
+        return 0;
+    }
+    cache = &caches[cache_count++];
+    spin_unlock_irqrestore(&cache_table_lock, flags);
+
+    cache->name = name;
+    cache->size = (uint32_t)size;
+    cache->stride = stride;
+    cache->objects = objects;
+    cache->order = order;
+    cache->offset = (uint32_t)ALIGN_UP(sizeof(struct Slab)+
+                                       objects*sizeof(uint16_t), header_align);
+    cache->colors = 0;
+    if (header_align == CACHE_LINE_SIZE) {
+        cache->colors = (uint32_t)(((PAGE_SIZE<<order)-cache->offset-
+                                    (uint64_t)objects*stride)/CACHE_LINE_SIZE);
+    }
+    cache->color = 0;
+    cache->ctor = ctor;
+    cache->partial = 0;
+    cache->full = 0;
+    cache->empty = 0;
+    cache->nr_empty = 0;
+    cache->inuse = 0;
+    spin_init(&cache->lock);
+
+    return cache;
+}
+
+/**
+ * @brief:     Allocates a new slab for the cache and constructs its objects.
+ *
+ * @return:    The slab, or 0 if the frame allocator is out of memory.
+ */
+static struct Slab *new_slab(struct KmemCache *cache)
+{
+    struct Slab *slab;
+    struct Frame *frame;
+    uint64_t addr;
+    uint32_t i;
+
+    addr = alloc_frames(cache->order);
+    if (addr == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < (1U<<cache->order); i++) {
+        frame = addr_to_frame(addr+(uint64_t)i*PAGE_SIZE);
+        frame->flags |= FRAME_SLAB;
+        frame->order = (uint8_t)cache->order;
+    }
+
+    slab = (struct Slab *)P2V(addr);
+    slab->cache = cache;
+    slab->next = 0;
+    slab->prev = 0;
+    slab->mem = (uint8_t *)slab+cache->offset+cache->color*CACHE_LINE_SIZE;
+    slab->inuse = 0;
+    slab->free = 0;
+    slab->res0 = 0;
+
+    for (i = 0; i < cache->objects; i++) {
+        slab->index[i] = (uint16_t)(i+1);
+    }
+    slab->index[cache->objects-1] = SLAB_END;
+
+    if (cache->colors != 0) {
+        cache->color = (cache->color+1)%(cache->colors+1);
+    }
+
+    if (cache->ctor != 0) {
+        for (i = 0; i < cache->objects; i++) {
+            cache->ctor(slab->mem+(uint64_t)i*cache->stride);
+        }
+    }
+
+    return slab;
+}
+
+/**
+ * @brief:     Returns the frames of an empty slab to the frame allocator.
+ */
+static void destroy_slab(struct KmemCache *cache, struct Slab *slab)
+{
+    uint64_t addr = V2P(slab);
+    uint32_t i;
+
+    for (i = 0; i < (1U<<cache->order); i++) {
+        addr_to_frame(addr+(uint64_t)i*PAGE_SIZE)->flags &= ~FRAME_SLAB;
+    }
+
+    free_frames(addr, cache->order);
+}
+
+/**
+ * @brief:          A function that allocates an object from a cache.
+ *
+ * @param:          cache  the cache
+ *
+ * @return:         The object, or 0 if no memory is available.
+ */
+void *kmem_cache_alloc(struct KmemCache *cache)
+{
+    struct Slab *slab;
+    uint16_t index;
+    uint64_t flags;
+
+    flags = spin_lock_irqsave(&cache->lock);
+    slab = cache->partial;
+    if (slab == 0) {
+        slab = cache->empty;
+        if (slab != 0) {
+            slab_list_del(&cache->empty, slab);
+            cache->nr_empty--;
+        }
+        else {
+            slab = new_slab(cache);
+            if (slab == 0) {
+                spin_unlock_irqrestore(&cache->lock, flags);
+                return 0;
+            }
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    index = slab->free;
+    slab->free = slab->index[index];
+    slab->inuse++;
+    cache->inuse++;
+
+    if (slab->free == SLAB_END) {
+        slab_list_del(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+
+    return slab->mem+(uint64_t)index*cache->stride;
+}
+
+/**
+ * @brief:     Returns the slab header of an object.
+ */
+static struct Slab *obj_to_slab(void *obj)
+{
+    struct Frame *frame = addr_to_frame(V2P(obj));
+
+    return (struct Slab *)((uint64_t)obj&~((PAGE_SIZE<<frame->order)-1));
+}
+
+/**
+ * @brief:          A function that returns an object to its cache.
+ *
+ * @param:          cache  the cache the object was allocated from
+ * @param:          obj    the object
+ *
+ * @return:         None
+ *
+ * @description:    The object is pushed on the free list of its slab. A slab
+ *                  that becomes empty is kept on the empty list, unless the
+ *                  cache already keeps SLAB_MAX_EMPTY of them.
+ */
+void kmem_cache_free(struct KmemCache *cache, void *obj)
+{
+    struct Slab *slab = obj_to_slab(obj);
+    uint16_t index;
+    uint64_t flags;
+
+    index = (uint16_t)(((uint8_t *)obj-slab->mem)/cache->stride);
+
+    flags = spin_lock_irqsave(&cache->lock);
+    if (slab->free == SLAB_END) {
+        slab_list_del(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    slab->index[index] = slab->free;
+    slab->free = index;
+    slab->inuse--;
+    cache->inuse--;
+
+    if (slab->inuse == 0) {
+        slab_list_del(&cache->partial, slab);
+        if (cache->nr_empty < SLAB_MAX_EMPTY) {
+            slab_list_add(&cache->empty, slab);
+            cache->nr_empty++;
+        }
+        else {
+            destroy_slab(cache, slab);
+        }
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+/**
+ * @brief:          A function that creates the kmalloc caches.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ */
+void init_slab(void)
+{
+    int i;
+
+    for (i = 0; i <= KMALLOC_MAX_SHIFT-KMALLOC_MIN_SHIFT; i++) {
+        kmalloc_caches[i] = kmem_cache_create(kmalloc_names[i],
+                                              1UL<<(i+KMALLOC_MIN_SHIFT),
+                                              0, 0);
+    }
+}
+
+/**
+ * @brief:          A function that allocates memory.
+ *
+ * @param[in]:      size  the number of bytes
+ *
+ * @return:         The memory, or 0 on failure.
+ *
+ * @description:    The size is rounded up to a power of two. Up to
+ *                  KMALLOC_MAX_SIZE the object comes from the matching
+ *                  kmalloc cache, above it from the frame allocator.
+ */
+void *kmalloc(size_t size)
+{
+    uint32_t shift = KMALLOC_MIN_SHIFT;
+    uint64_t addr;
+
+    if (size == 0) {
+        return 0;
+    }
+
+    if (size > (1UL<<KMALLOC_MIN_SHIFT)) {
+        shift = 64-(uint32_t)__builtin_clzl(size-1);
+    }
+
+    if (shift <= KMALLOC_MAX_SHIFT) {
+        return kmem_cache_alloc(kmalloc_caches[shift-KMALLOC_MIN_SHIFT]);
+    }
+
+    if (shift-PAGE_SHIFT > MAX_ORDER) {
+        return 0;
+    }
+
+    addr = alloc_frames(shift-PAGE_SHIFT);
+    if (addr == 0) {
+        return 0;
+    }
+
+    return (void *)P2V(addr);
+}
+
+/**
+ * @brief:          A function that releases memory returned by kmalloc.
+ *
+ * @param:          ptr  the memory, or 0
+ *
+ * @return:         None
+ */
+void kfree(void *ptr)
+{
+    struct Frame *frame;
+    struct Slab *slab;
+
+    if (ptr == 0) {
+        return;
+    }
+
+    frame = addr_to_frame(V2P(ptr));
+    if (frame == 0) {
+        return;
+    }
+
+    if (frame->flags & FRAME_SLAB) {
+        slab = obj_to_slab(ptr);
+        kmem_cache_free(slab->cache, ptr);
+        return;
+    }
+
+    free_frames(V2P(ptr), frame->order);
+}
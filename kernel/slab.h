@@ -0,0 +1,140 @@
+/* -----------------------------------------------------------------------------
+ * @file:        slab.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the slab
+ *               allocator and the kmalloc/kfree front end.
+ *
+ *               A cache hands out objects of one size. Its memory comes in
+ *               slabs, which are naturally aligned blocks of the frame
+ *               allocator. Every slab starts with a cache-line aligned Slab
+ *               header followed by the objects. The free list of a slab is an
+ *               array of 16-bit indices inside the header, so a freed object
+ *               keeps the state its constructor gave it and a cache with a
+ *               constructor only runs it once per object, when the slab is
+ *               created.
+ *
+ *               kmalloc serves requests from 16 B to 4 KiB out of nine
+ *               power-of-two caches and larger requests straight from the
+ *               frame allocator.
+ *
+ *               Every cache has its own spinlock, so CPUs allocating from
+ *               different caches do not contend.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the slab allocator.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Added a spinlock to every cache.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     CACHE_LINE_SIZE moved to sync.h.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "sync.h"
+
+#define KMALLOC_MIN_SHIFT   4
+#define KMALLOC_MAX_SHIFT   12
+#define KMALLOC_MAX_SIZE    (1UL<<KMALLOC_MAX_SHIFT)
+#define KMEM_MAX_CACHES     32
+
+struct Slab;
+
+/**
+ * @brief:                The descriptor of an object cache.
+ *
+ * @struct:               KmemCache
+ *
+ * @param:     name       The name of the cache
+ * @param:     size       The size requested by the creator
+ * @param:     stride     The distance between two objects in a slab
+ * @param:     objects    The number of objects in a slab
+ * @param:     offset     The offset of the first object in a slab
+ * @param:     order      The frame order of a slab
+ * @param:     colors     The number of cache line offsets a slab can use
+ * @param:     color      The color of the next slab
+ * @param:     ctor       The constructor run once per object, or 0
+ * @param:     partial    Slabs with both free and used objects
+ * @param:     full       Slabs without free objects
+ * @param:     empty      Slabs without used objects
+ * @param:     nr_empty   The number of slabs on the empty list
+ * @param:     inuse      The number of allocated objects
+ * @param:     lock       Protects the slab lists and the counters
+ */
+struct KmemCache {
+    const char *name;
+    uint32_t size;
+    uint32_t stride;
+    uint32_t objects;
+    uint32_t offset;
+    uint32_t order;
+    uint32_t colors;
+    uint32_t color;
+    void (*ctor)(void *obj);
+    struct Slab *partial;
+    struct Slab *full;
+    struct Slab *empty;
+    uint32_t nr_empty;
+    uint64_t inuse;
+    struct Spinlock lock;
+};
+
+/**
+ * @fn:        init_slab(void)
+ *
+ * @brief:     Creates the kmalloc caches.
+ */
+void init_slab(void);
+/**
+ * @fn:        kmem_cache_create(const char *name, size_t size, size_t align,
+ *                               void (*ctor)(void *obj))
+ *
+ * @brief:     Creates a cache of objects of the given size and alignment.
+ *
+ * @return:    The cache, or 0 if the object does not fit in a slab or the
+ *             cache table is full.
+ */
+struct KmemCache *kmem_cache_create(const char *name, size_t size, size_t align,
+                                    void (*ctor)(void *obj));
+/**
+ * @fn:        kmem_cache_alloc(struct KmemCache *cache)
+ *
+ * @brief:     Allocates an object from the cache.
+ *
+ * @return:    The object, or 0 if no memory is available.
+ */
+void *kmem_cache_alloc(struct KmemCache *cache);
+/**
+ * @fn:        kmem_cache_free(struct KmemCache *cache, void *obj)
+ *
+ * @brief:     Returns an object to its cache. The object must be left in its
+ *             constructed state.
+ */
+void kmem_cache_free(struct KmemCache *cache, void *obj);
+/**
+ * @fn:        kmalloc(size_t size)
+ *
+ * @brief:     Allocates size bytes.
+ *
+ * @return:    The memory, aligned to the size rounded up to a power of two
+ *             for sizes up to 64 B and to a cache line above, or 0.
+ */
+void *kmalloc(size_t size);
+/**
+ * @fn:        kfree(void *ptr)
+ *
+ * @brief:     Releases memory returned by kmalloc. kfree(0) does nothing.
+ */
+void kfree(void *ptr);
+
+#endif
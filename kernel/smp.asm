@@ -0,0 +1,168 @@
+;------------------------------------------------------------------------------
+; @file:        smp.asm
+; @author:      Marko Trickovic (contact@markotrickovic.com)
+; @date:        10/14/2026 09:00 AM
+; @license:     MIT
+; @language:    Assembly
+; @platform:    x86_64
+; @description: This file contains the startup trampoline of the application
+;               processors and the per-CPU descriptor table routines.
+;
+;               The code between trampoline_start and trampoline_end is not
+;               run where it is linked. init_smp copies it to TRAMPOLINE_ADDR
+;               (0x8000), the start address given by the startup IPI, and
+;               fills in the TrampolineData block at trampoline_data. Every
+;               address used by the trampoline is therefore computed with the
+;               TR macro relative to its copy.
+;
+;               The AP runs through the same stages as the loader: real mode,
+;               protected mode with a flat GDT, then long mode on the
+;               trampoline PML4 of start_aps, whose physical address must be
+;               below 4 GiB because it is loaded into cr3 from 32-bit code.
+;               That PML4 maps the trampoline page at its physical address
+;               next to the kernel half, ap_main then switches to the kernel
+;               PML4.
+;
+; Revision History:
+;
+;   - Revision 0.1: 10/14/2026 Marko Trickovic
+;     Initial version of the AP trampoline.
+;
+;   - Revision 0.2: 10/14/2026 Marko Trickovic
+;     Runs on the trampoline PML4 instead of the kernel PML4.
+;
+; Part of the os-dev-udemy-wsl.
+;------------------------------------------------------------------------------
+
+%define TRAMPOLINE_ADDR 0x8000
+%define TR(x) ((x)-trampoline_start+TRAMPOLINE_ADDR)
+
+section .text
+global trampoline_start
+global trampoline_end
+global trampoline_data
+global this_cpu
+global load_gdt
+global load_tr
+
+[BITS 16]
+
+; @routine:   trampoline_start
+; @brief:     The real mode entry point of an AP, reached at 0x0800:0000.
+trampoline_start:
+    cli
+    cld
+    xor ax,ax                   ; Address everything from segment 0
+    mov ds,ax
+
+    lgdt [TR(TrampGdtPtr)]      ; Load the flat GDT of the trampoline
+
+    mov eax,cr0
+    or eax,1                    ; Enable protected mode
+    mov cr0,eax
+
+    jmp dword 0x08:TR(TrampPMEntry)
+
+[BITS 32]
+
+; @routine:   TrampPMEntry
+; @brief:     Switches from protected mode to long mode on the trampoline PML4.
+TrampPMEntry:
+    mov ax,0x10
+    mov ds,ax
+    mov es,ax
+    mov ss,ax
+
+    mov eax,cr4
+    or eax,(1<<5)               ; Enable PAE
+    mov cr4,eax
+
+    mov eax,[TR(trampoline_data)]
+    mov cr3,eax                 ; Trampoline PML4
+
+    mov ecx,0xc0000080          ; EFER MSR
+    rdmsr
+    or eax,(1<<8)               ; Enable long mode
+    wrmsr
+
+    mov eax,cr0
+    or eax,(1<<31)              ; Enable paging
+    mov cr0,eax
+
+    jmp 0x18:TR(TrampLMEntry)
+
+[BITS 64]
+
+; @routine:   TrampLMEntry
+; @brief:     Loads the stack of the AP and calls ap_main with the address of
+;             its Cpu structure.
+TrampLMEntry:
+    mov rsp,[TR(trampoline_data)+8]
+    mov rdi,[TR(trampoline_data)+16]
+    mov rax,[TR(trampoline_data)+24]
+    call rax                    ; ap_main does not return
+
+TrampHalt:
+    hlt
+    jmp TrampHalt
+
+align 16
+TrampGdt:
+    dq 0                        ; Null entry
+    dq 0x00cf9a000000ffff       ; 32-bit code segment, selector 0x08
+    dq 0x00cf92000000ffff       ; 32-bit data segment, selector 0x10
+    dq 0x0020980000000000       ; 64-bit code segment, selector 0x18
+TrampGdtLen: equ $-TrampGdt
+
+TrampGdtPtr:
+    dw TrampGdtLen-1
+    dd TR(TrampGdt)
+
+; @var:       trampoline_data
+; @brief:     The TrampolineData block of smp.c: the trampoline PML4 (dd + pad),
+;             the stack top, the Cpu structure and the entry point (dq each).
+align 8
+trampoline_data:
+    dd 0
+    dd 0
+    dq 0
+    dq 0
+    dq 0
+trampoline_end:
+
+; @routine:   this_cpu
+; @brief:     This function returns the Cpu structure of the calling CPU.
+; @param:     No parameters are passed to this function.
+; @return:    The first field of the Cpu structure at the GS base is its own
+;             address, which is stored in rax.
+this_cpu:
+    mov rax,[gs:0]
+    ret
+
+; @routine:   load_gdt
+; @brief:     This function loads a GDT and reloads the segment registers.
+; @param:     The address of the GdtPtr is passed in rdi.
+; @return:    None.
+; @note:      FS and GS are left alone, loading a selector into GS would
+;             clear the GS base on some processors.
+load_gdt:
+    lgdt [rdi]
+    push 0x08                   ; Kernel code segment
+    mov rax,LoadGdtReload
+    push rax
+    db 0x48                     ; REX.W prefix for a 64-bit far return
+    retf
+LoadGdtReload:
+    xor ax,ax
+    mov ds,ax
+    mov es,ax
+    mov ss,ax
+    ret
+
+; @routine:   load_tr
+; @brief:     This function loads the task register.
+; @param:     The TSS selector is passed in di.
+; @return:    None.
+load_tr:
+    ltr di
+    ret
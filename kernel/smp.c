@@ -0,0 +1,470 @@
+/******************************************************************************
+ * @file:        smp.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the per-CPU data and the startup of the
+ *               application processors.
+ *
+ *               init_smp gives the BSP its own Cpu structure, GDT and TSS in
+ *               place of boot_gdt and Tss of kernel.asm. Once the timer and the
+ *               scheduler are up, start_aps starts every other enabled CPU
+ *               of the MADT:
+ *
+ *                  - The trampoline of smp.asm is copied to TRAMPOLINE_ADDR
+ *                    once, and its data block is pointed at the stack and
+ *                    the Cpu structure of the next AP.
+ *
+ *                  - The BSP sends INIT, waits 10 ms, sends a startup IPI
+ *                    with vector TRAMPOLINE_ADDR >> 12 and, if the AP has not
+ *                    reported within 200 us, a second one.
+ *
+ *                  - The trampoline runs on a copy of the kernel PML4 that
+ *                    also maps the low memory at its physical address, the
+ *                    kernel PML4 itself has no identity map.
+ *
+ *                  - The Cpu structure is stored in cpus before the IPIs,
+ *                    so get_cpu finds the AP as soon as its run queue
+ *                    joins the idle CPUs. The AP is only counted by
+ *                    get_cpu_count once it has started.
+ *
+ *                  - The AP loads its GDT, TSS, GS base and the shared IDT,
+ *                    switches to the kernel PML4, enables its local APIC and
+ *                    timer, sets up its run queue and sets started, after
+ *                    which the BSP reuses the trampoline for the next AP.
+ *
+ *                  - An AP that does not enter ap_main in time is
+ *                    abandoned and halts if it runs late. Its id, stacks and
+ *                    the trampoline data it would read are never reused, so
+ *                    no further AP is started after it.
+ *
+ *               Each Cpu structure has a KSTACK_SIZE kernel stack, which is
+ *               the boot stack of an AP, the rsp0 of its TSS and its system
+ *               call stack until the first task switch, and an
+ *               IRQ_STACK_SIZE stack that the entry paths of trap.asm switch
+ *               to for the handlers of vectors 32 and above, so handler work
+ *               neither needs room on every task stack nor evicts its cache
+ *               lines. Double faults, NMIs and machine checks get an
+ *               IST_STACK_SIZE stack each in the TSS: a kernel stack overflow
+ *               still reaches the double fault handler, and an NMI or
+ *               machine check that hits the entry path before it has
+ *               switched stacks does not run on a stack in an unknown state.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the SMP startup.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Split the AP startup into start_aps, the APs start their timer and
+ *     run queue.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     The trampoline uses its own PML4 with an identity map.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     New GDT layout for SYSCALL and SYSRET, init_cpu sets up the kernel GS
+ *     base and the system call MSRs.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     The APs set up their profiler.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     The APs set up their performance counters.
+ *
+ *   - Revision 0.7: 10/14/2026 Marko Trickovic
+ *     The APs enable SSE first, copies and clears use the string routines.
+ *
+ *   - Revision 0.8: 10/14/2026 Marko Trickovic
+ *     IST stacks for NMIs and machine checks, and a per-CPU IRQ stack.
+ *
+ *   - Revision 0.9: 10/14/2026 Marko Trickovic
+ *     The APs start their softirqd task.
+ *
+ *   - Revision 1.0: 10/14/2026 Marko Trickovic
+ *     Copy the segment descriptors from the generated boot_gdt.
+ *
+ *   - Revision 1.1: 10/14/2026 Marko Trickovic
+ *     Register an AP before its startup IPI, abandon an AP that does not
+ *     start and start none after it.
+ *
+ *   - Revision 1.2: 10/14/2026 Marko Trickovic
+ *     Pass the CPU id to init_fpu_cpu, the GS base is not set yet.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "smp.h"
+#include "apic.h"
+#include "clock.h"
+#include "timer.h"
+#include "sched.h"
+#include "memory.h"
+#include "paging.h"
+#include "slab.h"
+#include "trap.h"
+#include "syscall.h"
+#include "prof.h"
+#include "pmu.h"
+#include "fpu.h"
+#include "string.h"
+#include "softirq.h"
+#include "lib.h"
+
+#define IA32_GS_BASE        0xc0000101
+#define IA32_KERNEL_GS_BASE 0xc0000102
+
+#define INIT_DELAY          (10*NSEC_PER_MSEC)
+#define SIPI_DELAY          (200*NSEC_PER_USEC)
+#define START_TIMEOUT       (100*NSEC_PER_MSEC)
+
+/**
+ * @brief:       The parameters of the trampoline, at trampoline_data.
+ *
+ * @struct:      TrampolineData
+ *
+ * @param:       cr3    The physical address of the trampoline PML4
+ * @param:       stack  The initial stack pointer of the AP
+ * @param:       cpu    The Cpu structure passed to ap_main
+ * @param:       entry  The address of ap_main
+ */
+struct TrampolineData {
+    uint32_t cr3;
+    uint32_t res0;
+    uint64_t stack;
+    uint64_t cpu;
+    uint64_t entry;
+};
+
+extern char trampoline_start[];
+extern char trampoline_end[];
+extern char trampoline_data[];
+
+extern const uint64_t boot_gdt[];
+
+static struct Cpu *cpus[MAX_CPUS];
+static uint32_t cpu_count;
+
+/**
+ * @brief:     Fills the GDT of a CPU. The segment descriptors are copied from
+ *             boot_gdt, which tools/mkdesc.py generates, and the TSS
+ *             descriptor points at the TSS of the CPU, which is only known
+ *             once the Cpu structure is allocated. Kernel code and data and
+ *             then user data and code must stay adjacent, see init_syscall.
+ */
+static void init_gdt(struct Cpu *cpu)
+{
+    uint64_t base = (uint64_t)&cpu->tss;
+    uint64_t limit = sizeof(struct Tss)-1;
+
+    memcpy(cpu->gdt, boot_gdt, 5*sizeof(uint64_t));
+    cpu->gdt[5] = limit|((base&0xffffff)<<16)|(0x89UL<<40)|
+                  (((base>>24)&0xff)<<56);
+    cpu->gdt[6] = base>>32;
+}
+
+/**
+ * @brief:     Allocates and fills the Cpu structure and the stacks of a CPU.
+ *
+ * @return:    The Cpu structure, or 0 if no memory is available.
+ */
+static struct Cpu *alloc_cpu(uint32_t id, uint32_t apic_id)
+{
+    struct Cpu *cpu = kmalloc(sizeof(struct Cpu));
+    uint64_t stack, irq_stack, ist[IST_STACKS];
+    bool ok;
+    int i;
+
+    if (cpu == 0) {
+        return 0;
+    }
+
+    stack = alloc_frames(KSTACK_ORDER);
+    irq_stack = alloc_frames(IRQ_STACK_ORDER);
+    ok = stack != 0 && irq_stack != 0;
+    for (i = 0; i < IST_STACKS; i++) {
+        ist[i] = alloc_frame();
+        ok = ok && ist[i] != 0;
+    }
+
+    if (!ok) {
+        if (stack != 0) {
+            free_frames(stack, KSTACK_ORDER);
+        }
+        if (irq_stack != 0) {
+            free_frames(irq_stack, IRQ_STACK_ORDER);
+        }
+        for (i = 0; i < IST_STACKS; i++) {
+            if (ist[i] != 0) {
+                free_frame(ist[i]);
+            }
+        }
+        kfree(cpu);
+        return 0;
+    }
+
+    memset(cpu, 0, sizeof(struct Cpu));
+
+    cpu->self = cpu;
+    cpu->id = id;
+    cpu->apic_id = apic_id;
+    cpu->stack_top = P2V(stack)+KSTACK_SIZE;
+    cpu->sys_rsp = cpu->stack_top;
+    cpu->irq_rsp = P2V(irq_stack)+IRQ_STACK_SIZE;
+    cpu->irq_nest = -1;
+    init_gdt(cpu);
+    cpu->tss.rsp0 = cpu->stack_top;
+    for (i = 0; i < IST_STACKS; i++) {
+        cpu->tss.ist[i] = P2V(ist[i])+IST_STACK_SIZE;
+    }
+    cpu->tss.iomap = sizeof(struct Tss);
+
+    return cpu;
+}
+
+/**
+ * @brief:     Loads the GDT, the TSS, the GS base and the IDT of the calling
+ *             CPU and enables SYSCALL. The user GS base starts out as 0.
+ */
+static void init_cpu(struct Cpu *cpu)
+{
+    struct GdtPtr ptr;
+
+    ptr.limit = sizeof(cpu->gdt)-1;
+    ptr.addr = (uint64_t)cpu->gdt;
+    load_gdt(&ptr);
+    load_tr(TSS_SELECTOR);
+    write_msr(IA32_GS_BASE, (uint64_t)cpu);
+    write_msr(IA32_KERNEL_GS_BASE, 0);
+    init_idt_cpu();
+    init_syscall();
+}
+
+/**
+ * @brief:          The C entry point of an AP, called by the trampoline on
+ *                  the kernel stack of the AP.
+ *
+ * @param:          cpu  the Cpu structure of the AP
+ *
+ * @return:         None, the function does not return.
+ *
+ * @description:    The loop at the end is the idle task of the AP.
+ */
+static void ap_main(struct Cpu *cpu)
+{
+    uint32_t state = CPU_WAITING;
+
+    if (!__atomic_compare_exchange_n(&cpu->started, &state, CPU_BOOTING,
+                                     false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+        while (1) { }
+    }
+
+    init_fpu_cpu(cpu->id);
+    init_cpu(cpu);
+    init_paging_cpu();
+    init_lapic();
+    init_pmu_cpu();
+    init_timer_cpu();
+    init_sched_cpu();
+    init_softirq_cpu();
+    init_prof_cpu();
+    __atomic_store_n(&cpu->started, CPU_STARTED, __ATOMIC_RELEASE);
+
+    while (1) {
+        wait_for_interrupt();
+    }
+}
+
+/**
+ * @brief:     Waits until an AP enters ap_main or the timeout passes.
+ */
+static bool wait_entered(struct Cpu *cpu, uint64_t timeout)
+{
+    uint64_t stop = ktime_ns()+timeout;
+
+    while (cpu->started == CPU_WAITING) {
+        if (ktime_ns() >= stop) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief:          A function that starts an AP.
+ *
+ * @param:          cpu  the Cpu structure of the AP
+ *
+ * @return:         true if the AP is running.
+ *
+ * @description:    A startup IPI is ignored by a CPU that has already left
+ *                  the wait-for-SIPI state, so the second one is harmless
+ *                  when the AP was merely slow. Once the AP has entered
+ *                  ap_main it cannot be abandoned any more, and its own
+ *                  initialization is waited for without a timeout.
+ */
+static bool start_ap(struct Cpu *cpu)
+{
+    struct TrampolineData *data = (struct TrampolineData *)
+        P2V(TRAMPOLINE_ADDR+(trampoline_data-trampoline_start));
+    uint32_t state = CPU_WAITING;
+
+    data->stack = cpu->stack_top;
+    data->cpu = (uint64_t)cpu;
+    data->entry = (uint64_t)ap_main;
+
+    lapic_send_ipi(cpu->apic_id, ICR_INIT|ICR_LEVEL|ICR_ASSERT);
+    ndelay(INIT_DELAY);
+
+    lapic_send_ipi(cpu->apic_id, ICR_STARTUP|(TRAMPOLINE_ADDR>>12));
+    if (!wait_entered(cpu, SIPI_DELAY)) {
+        lapic_send_ipi(cpu->apic_id, ICR_STARTUP|(TRAMPOLINE_ADDR>>12));
+        if (!wait_entered(cpu, START_TIMEOUT) &&
+            __atomic_compare_exchange_n(&cpu->started, &state,
+                                        CPU_ABANDONED, false,
+                                        __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+            return false;
+        }
+    }
+
+    while (__atomic_load_n(&cpu->started, __ATOMIC_ACQUIRE) != CPU_STARTED) {
+        cpu_relax();
+    }
+
+    return true;
+}
+
+/**
+ * @brief:          A function that sets up the per-CPU data of the BSP.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The function must run after init_slab and init_apic, with
+ *                  interrupts disabled. this_cpu works once it returns.
+ */
+void init_smp(void)
+{
+    struct Cpu *cpu;
+    uint32_t bsp_id = 0;
+
+    if (get_apic_mode() != APIC_MODE_PIC) {
+        bsp_id = lapic_id();
+    }
+
+    cpu = alloc_cpu(0, bsp_id);
+    if (cpu == 0) {
+        while (1) { }
+    }
+
+    init_cpu(cpu);
+    set_idt_ist(2, IST_NMI);
+    set_idt_ist(8, IST_DOUBLE_FAULT);
+    set_idt_ist(18, IST_MACHINE_CHECK);
+    cpu->started = CPU_STARTED;
+    cpus[0] = cpu;
+    cpu_count = 1;
+}
+
+/**
+ * @brief:          A function that starts the APs.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The function must run after init_smp, init_clock,
+ *                  init_timer and init_sched, with interrupts disabled. The
+ *                  APs stay down when there is no local APIC or the
+ *                  trampoline PML4 lies above 4 GiB, where the 32-bit part of
+ *                  the trampoline cannot load it. The Cpu structure of an AP
+ *                  that does not start is not freed, as the AP might still run
+ *                  late, and neither is the trampoline PML4 then. The APs
+ *                  after it stay down, the trampoline data is the one the
+ *                  late AP would read.
+ */
+void start_aps(void)
+{
+    const struct MadtInfo *madt = get_madt_info();
+    struct TrampolineData *data;
+    struct Cpu *cpu;
+    uint64_t *pml4;
+    uint64_t cr3;
+    uint32_t bsp_id = cpus[0]->apic_id;
+    uint64_t size = trampoline_end-trampoline_start;
+    uint8_t *dst = (uint8_t *)P2V(TRAMPOLINE_ADDR);
+    bool failed = false;
+    uint32_t i;
+
+    if (get_apic_mode() == APIC_MODE_PIC) {
+        return;
+    }
+
+    pml4 = alloc_boot_pml4();
+    if (pml4 == 0) {
+        return;
+    }
+
+    cr3 = V2P(pml4);
+    if (cr3 >= (4UL<<30)) {
+        free_frame(cr3);
+        return;
+    }
+
+    memcpy(dst, trampoline_start, size);
+
+    data = (struct TrampolineData *)
+        P2V(TRAMPOLINE_ADDR+(trampoline_data-trampoline_start));
+    data->cr3 = (uint32_t)cr3;
+
+    for (i = 0; i < madt->cpu_count && cpu_count < MAX_CPUS; i++) {
+        if (madt->apic_ids[i] == bsp_id) {
+            continue;
+        }
+
+        cpu = alloc_cpu(cpu_count, madt->apic_ids[i]);
+        if (cpu == 0) {
+            break;
+        }
+
+        __atomic_store_n(&cpus[cpu->id], cpu, __ATOMIC_RELEASE);
+        if (!start_ap(cpu)) {
+            failed = true;
+            break;
+        }
+
+        __atomic_store_n(&cpu_count, cpu_count+1, __ATOMIC_RELEASE);
+    }
+
+    if (!failed) {
+        free_frame(cr3);
+    }
+}
+
+/**
+ * @brief:      Returns the Cpu structure of a logical CPU, or 0. An AP is
+ *              found from the startup IPI on, before get_cpu_count counts
+ *              it, as its run queue may join the idle CPUs first.
+ */
+struct Cpu *get_cpu(uint32_t id)
+{
+    if (id >= MAX_CPUS) {
+        return 0;
+    }
+
+    return __atomic_load_n(&cpus[id], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief:      Returns the number of running CPUs.
+ */
+uint32_t get_cpu_count(void)
+{
+    return __atomic_load_n(&cpu_count, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,205 @@
+/* -----------------------------------------------------------------------------
+ * @file:        smp.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the per-CPU
+ *               data and the startup of the application processors (APs).
+ *
+ *               Every CPU owns a Cpu structure with its own GDT, TSS, kernel
+ *               stack and interrupt stacks. The GS base MSR of a CPU points at
+ *               its Cpu structure, whose first field points back at itself, so
+ *               this_cpu is a single gs-relative load.
+ *
+ *               The boot CPU (BSP) starts the other CPUs listed in the MADT one
+ *               after the other, once its timer and scheduler are running,
+ *               with the INIT-SIPI-SIPI sequence. An AP starts in real mode at
+ *               the trampoline that init_smp copies to TRAMPOLINE_ADDR,
+ *               switches to long mode on the kernel page tables and calls
+ *               ap_main.
+ *
+ *               The GDT holds the null descriptor, the kernel code and data
+ *               segments, the user data and code segments and the TSS, in the
+ *               order that SYSCALL and SYSRET derive their selectors from.
+ *               While a CPU runs in ring 3 its GS base belongs to user code
+ *               and the Cpu structure sits in IA32_KERNEL_GS_BASE, every
+ *               entry from ring 3 swaps the two.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the SMP startup.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Declared start_aps.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Reordered the GDT for SYSCALL and SYSRET, added the user segments and
+ *     the system call stack fields.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Added the interrupt statistics of the CPU.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     Added the IST stacks of NMIs and machine checks and the IRQ stack.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     The startup states of a CPU.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _SMP_H_
+#define _SMP_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "acpi.h"
+
+#define TRAMPOLINE_ADDR     0x8000
+
+#define KSTACK_ORDER        2
+#define KSTACK_SIZE         (4096UL<<KSTACK_ORDER)
+#define IST_STACK_SIZE      4096UL
+#define IRQ_STACK_ORDER     2
+#define IRQ_STACK_SIZE      (4096UL<<IRQ_STACK_ORDER)
+
+#define GDT_ENTRIES         7
+#define KERNEL_CS           0x08
+#define KERNEL_DS           0x10
+#define USER_DS             0x1b
+#define USER_CS             0x23
+#define TSS_SELECTOR        0x28
+
+#define CPU_USER_RSP        32
+#define CPU_SYS_RSP         40
+#define CPU_IRQ_RSP         48
+#define CPU_IRQ_NEST        56
+
+#define IST_DOUBLE_FAULT    1
+#define IST_NMI             2
+#define IST_MACHINE_CHECK   3
+#define IST_STACKS          3
+
+#define CPU_WAITING         0
+#define CPU_BOOTING         1
+#define CPU_STARTED         2
+#define CPU_ABANDONED       3
+
+/**
+ * @brief:                The 64-bit task state segment.
+ *
+ * @struct:               Tss
+ *
+ * @param:     rsp0       The stack loaded on a switch to ring 0
+ * @param:     ist        The interrupt stack table, entry n - 1 holds IST n
+ * @param:     iomap      The offset of the I/O permission bitmap, set to the
+ *                        size of the TSS for no bitmap
+ */
+struct Tss {
+    uint32_t res0;
+    uint64_t rsp0;
+    uint64_t rsp1;
+    uint64_t rsp2;
+    uint64_t res1;
+    uint64_t ist[7];
+    uint64_t res2;
+    uint16_t res3;
+    uint16_t iomap;
+} __attribute__((packed));
+
+/**
+ * @brief:                The operand of lgdt.
+ *
+ * @struct:               GdtPtr
+ */
+struct GdtPtr {
+    uint16_t limit;
+    uint64_t addr;
+} __attribute__((packed));
+
+/**
+ * @brief:                The per-CPU data.
+ *
+ * @struct:               Cpu
+ *
+ * @param:     self       The address of this structure, read by this_cpu
+ * @param:     id         The logical CPU number, 0 is the BSP
+ * @param:     apic_id    The local APIC ID
+ * @param:     started    CPU_WAITING until the AP enters ap_main, then
+ *                        CPU_BOOTING, and CPU_STARTED once the CPU runs on
+ *                        its own tables, or CPU_ABANDONED if the BSP gave up
+ *                        on the AP before it entered ap_main
+ * @param:     stack_top  The top of the kernel stack, also the rsp0 of the TSS
+ * @param:     user_rsp   The user stack pointer while syscall_entry switches
+ *                        stacks, at CPU_USER_RSP
+ * @param:     sys_rsp    The kernel stack of system calls, a copy of the rsp0
+ *                        of the TSS at CPU_SYS_RSP
+ * @param:     irq_rsp    The top of the IRQ stack, at CPU_IRQ_RSP
+ * @param:     irq_nest   The number of interrupts running on the IRQ stack
+ *                        minus one, at CPU_IRQ_NEST
+ * @param:     irq_stats  The handler statistics, indexed by vector
+ * @param:     gdt        The global descriptor table
+ * @param:     tss        The task state segment
+ */
+struct Cpu {
+    struct Cpu *self;
+    uint32_t id;
+    uint32_t apic_id;
+    volatile uint32_t started;
+    uint64_t stack_top;
+    uint64_t user_rsp;
+    uint64_t sys_rsp;
+    uint64_t irq_rsp;
+    int64_t irq_nest;
+    struct IrqStat *irq_stats;
+    uint64_t gdt[GDT_ENTRIES] __attribute__((aligned(16)));
+    struct Tss tss __attribute__((aligned(16)));
+};
+
+/**
+ * @fn:        init_smp(void)
+ *
+ * @brief:     Moves the BSP to its own Cpu structure.
+ */
+void init_smp(void);
+/**
+ * @fn:        start_aps(void)
+ *
+ * @brief:     Starts the APs listed in the MADT.
+ */
+void start_aps(void);
+/**
+ * @fn:        this_cpu(void)
+ *
+ * @brief:     Returns the Cpu structure of the calling CPU. Defined in
+ *             smp.asm.
+ */
+struct Cpu *this_cpu(void);
+/**
+ * @fn:        get_cpu(uint32_t id)
+ *
+ * @brief:     Returns the Cpu structure of a logical CPU, or 0.
+ */
+struct Cpu *get_cpu(uint32_t id);
+/**
+ * @fn:        get_cpu_count(void)
+ *
+ * @brief:     Returns the number of running CPUs.
+ */
+uint32_t get_cpu_count(void);
+/**
+ * @fn:        load_gdt(struct GdtPtr *ptr)
+ *
+ * @brief:     Loads the GDT and reloads CS, DS, ES and SS. Defined in
+ *             smp.asm.
+ */
+void load_gdt(struct GdtPtr *ptr);
+/**
+ * @fn:        load_tr(uint16_t selector)
+ *
+ * @brief:     Loads the task register. Defined in smp.asm.
+ */
+void load_tr(uint16_t selector);
+
+#endif
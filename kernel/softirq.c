@@ -0,0 +1,331 @@
+/******************************************************************************
+ * @file:        softirq.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the softirqs and tasklets.
+ *
+ *               Every CPU keeps a bitmap of its pending softirqs and a list
+ *               of its queued tasklets, which only that CPU touches, with
+ *               interrupts disabled. A pass over the pending softirqs:
+ *
+ *                  - takes the bitmap and clears it with interrupts disabled,
+ *                    then runs the handlers in bit order with interrupts
+ *                    enabled, so a device interrupt is only held off for the
+ *                    length of its hard handler.
+ *
+ *                  - starts over while softirqs were raised meanwhile, at
+ *                    most SOFTIRQ_RESTARTS times and no longer than
+ *                    SOFTIRQ_BUDGET_NS, and leaves the rest to the softirqd
+ *                    task of the CPU. A device that keeps raising work then
+ *                    competes with the other tasks instead of starving them
+ *                    from interrupt context.
+ *
+ *               The exit path of the outermost interrupt handler runs a pass
+ *               on the IRQ stack. Interrupts that arrive during the pass
+ *               nest on that stack and leave their softirqs to it. The pass
+ *               holds preemption off, so such an interrupt does not switch
+ *               tasks in the middle of it, the switch is taken when the
+ *               outermost handler returns.
+ *
+ *               Tasklets run from SOFTIRQ_TASKLET, in the order they were
+ *               scheduled. A tasklet that is still running on another CPU
+ *               is queued again rather than run twice at the same time.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the softirqs and tasklets.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "softirq.h"
+#include "smp.h"
+#include "sched.h"
+#include "clock.h"
+#include "lib.h"
+
+#define SOFTIRQ_PRIO        SCHED_DEFAULT_PRIO
+
+/**
+ * @brief:                The softirq state of one CPU.
+ *
+ * @struct:               SoftirqCpu
+ *
+ * @param:     pending    The bitmap of the raised softirqs
+ * @param:     active     Set while a pass runs
+ * @param:     head       The first queued tasklet
+ * @param:     tail       The last queued tasklet
+ * @param:     task       The softirqd task
+ */
+struct SoftirqCpu {
+    uint32_t pending;
+    uint32_t active;
+    struct Tasklet *head;
+    struct Tasklet *tail;
+    struct Task *task;
+};
+
+static struct SoftirqCpu softirq_cpus[MAX_CPUS];
+static softirq_fn_t softirq_handlers[SOFTIRQ_MAX];
+
+/**
+ * @brief:      Returns the softirq state of the calling CPU.
+ */
+static struct SoftirqCpu *this_softirq(void)
+{
+    return &softirq_cpus[this_cpu()->id];
+}
+
+/**
+ * @brief:      Wakes the softirqd task of a CPU, once it exists.
+ */
+static void wake_softirqd(struct SoftirqCpu *sc)
+{
+    if (sc->task != 0) {
+        sched_wakeup(sc->task);
+    }
+}
+
+/**
+ * @brief:          A function that runs the pending softirqs of a CPU.
+ *
+ * @param:          sc  the softirq state of the calling CPU
+ *
+ * @return:         true if softirqs are still pending.
+ *
+ * @description:    Called with interrupts and preemption disabled, returns
+ *                  with interrupts disabled.
+ */
+static bool run_softirqs(struct SoftirqCpu *sc)
+{
+    uint64_t stop = ktime_ns()+SOFTIRQ_BUDGET_NS;
+    uint32_t restarts = SOFTIRQ_RESTARTS;
+    uint32_t pending, nr;
+
+    sc->active = 1;
+
+    while (1) {
+        pending = sc->pending;
+        sc->pending = 0;
+        irq_enable();
+
+        while (pending != 0) {
+            nr = (uint32_t)__builtin_ctz(pending);
+            pending &= pending-1;
+            if (softirq_handlers[nr] != 0) {
+                softirq_handlers[nr]();
+            }
+        }
+
+        irq_disable();
+        if (sc->pending == 0 || --restarts == 0 || ktime_ns() >= stop) {
+            break;
+        }
+    }
+
+    sc->active = 0;
+
+    return sc->pending != 0;
+}
+
+/**
+ * @brief:          The softirqd task of a CPU.
+ *
+ * @param:          arg  the softirq state of the CPU
+ *
+ * @return:         None, the task does not return.
+ *
+ * @description:    The task blocks while nothing is pending. A wakeup that
+ *                  arrives between the check and sched_block makes
+ *                  sched_block return at once.
+ */
+static void softirq_task(void *arg)
+{
+    struct SoftirqCpu *sc = arg;
+    uint64_t flags;
+    bool more;
+
+    while (1) {
+        preempt_disable();
+        flags = irq_save();
+        more = sc->pending != 0 && run_softirqs(sc);
+        irq_restore(flags);
+        preempt_enable();
+
+        if (!more) {
+            sched_block();
+        }
+    }
+}
+
+/**
+ * @brief:      Appends a tasklet to the list of a CPU, with interrupts
+ *              disabled.
+ */
+static void queue_tasklet(struct SoftirqCpu *sc, struct Tasklet *t)
+{
+    t->next = 0;
+    if (sc->head == 0) {
+        sc->head = t;
+    }
+    else {
+        sc->tail->next = t;
+    }
+    sc->tail = t;
+    sc->pending |= 1U<<SOFTIRQ_TASKLET;
+}
+
+/**
+ * @brief:          The handler of SOFTIRQ_TASKLET.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The list is taken whole, tasklets scheduled while it runs
+ *                  go to a new list and raise the softirq again. SCHEDULED
+ *                  is cleared before a tasklet runs, so it can be scheduled
+ *                  again from its own function.
+ */
+static void tasklet_action(void)
+{
+    uint64_t flags = irq_save();
+    struct SoftirqCpu *sc = this_softirq();
+    struct Tasklet *list = sc->head;
+    struct Tasklet *t;
+
+    sc->head = 0;
+    sc->tail = 0;
+    irq_restore(flags);
+
+    while (list != 0) {
+        t = list;
+        list = list->next;
+
+        if ((__atomic_fetch_or(&t->state, TASKLET_RUNNING, __ATOMIC_ACQUIRE)&
+             TASKLET_RUNNING) != 0) {
+            flags = irq_save();
+            queue_tasklet(sc, t);
+            irq_restore(flags);
+            continue;
+        }
+
+        __atomic_fetch_and(&t->state, ~TASKLET_SCHEDULED, __ATOMIC_RELAXED);
+        t->fn(t->ctx);
+        __atomic_fetch_and(&t->state, ~TASKLET_RUNNING, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief:      Starts the softirqd task of the calling CPU.
+ */
+void init_softirq_cpu(void)
+{
+    struct SoftirqCpu *sc = this_softirq();
+
+    sc->task = task_create_pinned("softirqd", softirq_task, sc, SOFTIRQ_PRIO);
+    if (sc->task == 0) {
+        while (1) { }
+    }
+}
+
+/**
+ * @brief:      Opens the tasklet softirq and starts the softirqd task of the
+ *              BSP.
+ */
+void init_softirq(void)
+{
+    open_softirq(SOFTIRQ_TASKLET, tasklet_action);
+    init_softirq_cpu();
+}
+
+/**
+ * @brief:      Installs the handler of a softirq.
+ */
+void open_softirq(uint32_t nr, softirq_fn_t fn)
+{
+    if (nr < SOFTIRQ_MAX) {
+        softirq_handlers[nr] = fn;
+    }
+}
+
+/**
+ * @brief:          A function that marks a softirq pending.
+ *
+ * @param:          nr  the softirq number
+ *
+ * @return:         None
+ *
+ * @description:    Inside an interrupt handler or a pass the softirq runs in
+ *                  the current or the next pass. From task context no pass
+ *                  may come soon, so softirqd is woken.
+ */
+void raise_softirq(uint32_t nr)
+{
+    uint64_t flags = irq_save();
+    struct SoftirqCpu *sc = this_softirq();
+
+    sc->pending |= 1U<<nr;
+    if (this_cpu()->irq_nest < 0 && !sc->active) {
+        wake_softirqd(sc);
+    }
+
+    irq_restore(flags);
+}
+
+/**
+ * @brief:      Runs a pass at the exit of the outermost interrupt handler,
+ *              and wakes softirqd if the budget did not suffice.
+ */
+void softirq_irq_exit(void)
+{
+    struct SoftirqCpu *sc;
+
+    if (this_cpu()->irq_nest != 0) {
+        return;
+    }
+
+    sc = this_softirq();
+    if (sc->pending == 0 || sc->active) {
+        return;
+    }
+
+    preempt_disable();
+    if (run_softirqs(sc)) {
+        wake_softirqd(sc);
+    }
+    preempt_enable_no_resched();
+}
+
+/**
+ * @brief:      Sets up a tasklet.
+ */
+void tasklet_init(struct Tasklet *t, tasklet_fn_t fn, void *ctx)
+{
+    t->next = 0;
+    t->fn = fn;
+    t->ctx = ctx;
+    t->state = 0;
+}
+
+/**
+ * @brief:      Queues a tasklet on the calling CPU.
+ */
+void tasklet_schedule(struct Tasklet *t)
+{
+    uint64_t flags;
+
+    if ((__atomic_fetch_or(&t->state, TASKLET_SCHEDULED, __ATOMIC_ACQ_REL)&
+         TASKLET_SCHEDULED) != 0) {
+        return;
+    }
+
+    flags = irq_save();
+    queue_tasklet(this_softirq(), t);
+    raise_softirq(SOFTIRQ_TASKLET);
+    irq_restore(flags);
+}
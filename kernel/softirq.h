@@ -0,0 +1,116 @@
+/* -----------------------------------------------------------------------------
+ * @file:        softirq.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the softirqs
+ *               and tasklets, the deferred halves of interrupt handlers.
+ *
+ *               An interrupt handler runs with interrupts disabled and should
+ *               only do what cannot wait, such as acknowledging the device,
+ *               and hand the rest to a softirq with raise_softirq or to a
+ *               tasklet with tasklet_schedule. The pending softirqs of a CPU
+ *               run on that CPU with interrupts enabled, when the outermost
+ *               handler of vector 32 or above returns, or in the softirqd
+ *               task of the CPU once a pass has used up its budget.
+ *
+ *               Softirq handlers and tasklets run with preemption disabled
+ *               and must not block. A softirq handler may run on several
+ *               CPUs at once, a tasklet never does. Data that task context
+ *               shares with them is locked with spin_lock_irqsave.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the softirqs and tasklets.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _SOFTIRQ_H_
+#define _SOFTIRQ_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "clock.h"
+
+#define SOFTIRQ_MAX         32
+#define SOFTIRQ_TASKLET     0
+
+#define SOFTIRQ_RESTARTS    10
+#define SOFTIRQ_BUDGET_NS   (2*NSEC_PER_MSEC)
+
+#define TASKLET_SCHEDULED   (1U<<0)
+#define TASKLET_RUNNING     (1U<<1)
+
+typedef void (*softirq_fn_t)(void);
+typedef void (*tasklet_fn_t)(void *ctx);
+
+/**
+ * @brief:                A deferred function that runs on one CPU at a time.
+ *
+ * @struct:               Tasklet
+ *
+ * @param:     next       The next tasklet on the list of a CPU
+ * @param:     fn         The function
+ * @param:     ctx        The value passed to the function
+ * @param:     state      TASKLET_SCHEDULED while it is on a list,
+ *                        TASKLET_RUNNING while fn runs
+ */
+struct Tasklet {
+    struct Tasklet *next;
+    tasklet_fn_t fn;
+    void *ctx;
+    volatile uint32_t state;
+};
+
+/**
+ * @fn:        init_softirq(void)
+ *
+ * @brief:     Opens SOFTIRQ_TASKLET and starts the softirqd task of the BSP.
+ *             Must run after init_sched.
+ */
+void init_softirq(void);
+/**
+ * @fn:        init_softirq_cpu(void)
+ *
+ * @brief:     Starts the softirqd task of an AP. Must run after
+ *             init_sched_cpu.
+ */
+void init_softirq_cpu(void);
+/**
+ * @fn:        open_softirq(uint32_t nr, softirq_fn_t fn)
+ *
+ * @brief:     Installs the handler of softirq nr, below SOFTIRQ_MAX.
+ */
+void open_softirq(uint32_t nr, softirq_fn_t fn);
+/**
+ * @fn:        raise_softirq(uint32_t nr)
+ *
+ * @brief:     Marks softirq nr pending on the calling CPU. Called from task
+ *             context, it wakes the softirqd task of the CPU.
+ */
+void raise_softirq(uint32_t nr);
+/**
+ * @fn:        softirq_irq_exit(void)
+ *
+ * @brief:     Runs the pending softirqs of the calling CPU if it returns
+ *             from its outermost interrupt handler. Called by handler and
+ *             fast_handler with interrupts disabled.
+ */
+void softirq_irq_exit(void);
+/**
+ * @fn:        tasklet_init(struct Tasklet *t, tasklet_fn_t fn, void *ctx)
+ *
+ * @brief:     Sets up a tasklet that runs fn(ctx).
+ */
+void tasklet_init(struct Tasklet *t, tasklet_fn_t fn, void *ctx);
+/**
+ * @fn:        tasklet_schedule(struct Tasklet *t)
+ *
+ * @brief:     Queues a tasklet on the calling CPU unless it is queued
+ *             already. A tasklet scheduled while it runs runs again.
+ */
+void tasklet_schedule(struct Tasklet *t);
+
+#endif
@@ -0,0 +1,268 @@
+;------------------------------------------------------------------------------
+; @file:        string.asm
+; @author:      Marko Trickovic (contact@markotrickovic.com)
+; @date:        10/14/2026 09:00 AM
+; @license:     MIT
+; @language:    Assembly
+; @platform:    x86_64
+; @description: This file contains the copy and fill loops behind memcpy,
+;               memmove and memset, and memcmp.
+;
+;               Every copy variant takes the destination in rdi, the source
+;               in rsi and the size in rdx, every fill variant the
+;               destination in rdi, the byte in sil and the size in rdx, and
+;               all of them return the destination in rax. string.c chooses
+;               one variant of each at boot. The SSE2 and AVX2 loops move 64
+;               bytes per iteration with unaligned loads and stores and
+;               finish the remainder with rep movsb or rep stosb. They may
+;               only run between kernel_fpu_begin and kernel_fpu_end, and the
+;               AVX2 loops clear the upper halves of the ymm registers
+;               before they return, so later SSE code pays no transition
+;               penalty.
+;
+; Revision History:
+;
+;   - Revision 0.1: 10/14/2026 Marko Trickovic
+;     Initial version of the string routines.
+;
+; Part of the os-dev-udemy-wsl.
+;------------------------------------------------------------------------------
+
+section .text
+global memcpy_movsb
+global memcpy_movsq
+global memcpy_sse2
+global memcpy_avx2
+global memmove_back
+global memset_stosb
+global memset_stosq
+global memset_sse2
+global memset_avx2
+global memcmp
+
+; @routine:   memcpy_movsb
+; @brief:     This function copies with a single rep movsb, the fastest copy
+;             of any size on CPUs with enhanced rep movsb (ERMS).
+; @param:     The destination in rdi, the source in rsi, the size in rdx.
+; @return:    The destination is stored in rax.
+memcpy_movsb:
+    mov rax,rdi
+    mov rcx,rdx
+    rep movsb
+    ret
+
+; @routine:   memcpy_movsq
+; @brief:     This function copies 8 bytes per step with rep movsq and the
+;             remainder with rep movsb.
+; @param:     The destination in rdi, the source in rsi, the size in rdx.
+; @return:    The destination is stored in rax.
+memcpy_movsq:
+    mov rax,rdi
+    mov rcx,rdx
+    shr rcx,3
+    rep movsq
+    mov rcx,rdx
+    and rcx,7
+    rep movsb
+    ret
+
+; @routine:   memcpy_sse2
+; @brief:     This function copies 64 bytes per iteration through xmm0-xmm3.
+; @param:     The destination in rdi, the source in rsi, the size in rdx.
+; @return:    The destination is stored in rax.
+memcpy_sse2:
+    mov rax,rdi
+    mov rcx,rdx
+    shr rcx,6
+    jz .tail
+.loop:
+    movdqu xmm0,[rsi]
+    movdqu xmm1,[rsi+16]
+    movdqu xmm2,[rsi+32]
+    movdqu xmm3,[rsi+48]
+    movdqu [rdi],xmm0
+    movdqu [rdi+16],xmm1
+    movdqu [rdi+32],xmm2
+    movdqu [rdi+48],xmm3
+    add rsi,64
+    add rdi,64
+    dec rcx
+    jnz .loop
+.tail:
+    mov rcx,rdx
+    and rcx,63
+    rep movsb
+    ret
+
+; @routine:   memcpy_avx2
+; @brief:     This function copies 64 bytes per iteration through ymm0-ymm1.
+; @param:     The destination in rdi, the source in rsi, the size in rdx.
+; @return:    The destination is stored in rax.
+memcpy_avx2:
+    mov rax,rdi
+    mov rcx,rdx
+    shr rcx,6
+    jz .tail
+.loop:
+    vmovdqu ymm0,[rsi]
+    vmovdqu ymm1,[rsi+32]
+    vmovdqu [rdi],ymm0
+    vmovdqu [rdi+32],ymm1
+    add rsi,64
+    add rdi,64
+    dec rcx
+    jnz .loop
+    vzeroupper
+.tail:
+    mov rcx,rdx
+    and rcx,63
+    rep movsb
+    ret
+
+; @routine:   memmove_back
+; @brief:     This function copies from the last byte to the first, for a
+;             destination that overlaps the source from above. The trap
+;             entry paths clear the direction flag, so the copy may be
+;             interrupted.
+; @param:     The destination in rdi, the source in rsi, the size in rdx.
+; @return:    The destination is stored in rax.
+memmove_back:
+    mov rax,rdi
+    lea rsi,[rsi+rdx-1]
+    lea rdi,[rdi+rdx-1]
+    mov rcx,rdx
+    std
+    rep movsb
+    cld
+    ret
+
+; @routine:   memset_stosb
+; @brief:     This function fills with a single rep stosb, for CPUs with
+;             ERMS.
+; @param:     The destination in rdi, the byte in sil, the size in rdx.
+; @return:    The destination is stored in rax.
+memset_stosb:
+    mov r8,rdi
+    mov eax,esi
+    mov rcx,rdx
+    rep stosb
+    mov rax,r8
+    ret
+
+; @routine:   memset_stosq
+; @brief:     This function fills 8 bytes per step with rep stosq and the
+;             remainder with rep stosb.
+; @param:     The destination in rdi, the byte in sil, the size in rdx.
+; @return:    The destination is stored in rax.
+memset_stosq:
+    mov r8,rdi
+    movzx eax,sil
+    mov rcx,0x0101010101010101
+    imul rax,rcx
+    mov rcx,rdx
+    shr rcx,3
+    rep stosq
+    mov rcx,rdx
+    and rcx,7
+    rep stosb
+    mov rax,r8
+    ret
+
+; @routine:   memset_sse2
+; @brief:     This function fills 64 bytes per iteration from xmm0, which
+;             holds the byte 16 times.
+; @param:     The destination in rdi, the byte in sil, the size in rdx.
+; @return:    The destination is stored in rax.
+memset_sse2:
+    mov r8,rdi
+    movzx eax,sil
+    movd xmm0,eax
+    punpcklbw xmm0,xmm0
+    punpcklwd xmm0,xmm0
+    pshufd xmm0,xmm0,0
+    mov rcx,rdx
+    shr rcx,6
+    jz .tail
+.loop:
+    movdqu [rdi],xmm0
+    movdqu [rdi+16],xmm0
+    movdqu [rdi+32],xmm0
+    movdqu [rdi+48],xmm0
+    add rdi,64
+    dec rcx
+    jnz .loop
+.tail:
+    mov rcx,rdx
+    and rcx,63
+    rep stosb
+    mov rax,r8
+    ret
+
+; @routine:   memset_avx2
+; @brief:     This function fills 64 bytes per iteration from ymm0, which
+;             holds the byte 32 times.
+; @param:     The destination in rdi, the byte in sil, the size in rdx.
+; @return:    The destination is stored in rax.
+memset_avx2:
+    mov r8,rdi
+    movzx eax,sil
+    vmovd xmm0,eax
+    vpbroadcastb ymm0,xmm0
+    mov rcx,rdx
+    shr rcx,6
+    jz .tail
+.loop:
+    vmovdqu [rdi],ymm0
+    vmovdqu [rdi+32],ymm0
+    add rdi,64
+    dec rcx
+    jnz .loop
+.tail:
+    vzeroupper
+    mov rcx,rdx
+    and rcx,63
+    rep stosb
+    mov rax,r8
+    ret
+
+; @routine:   memcmp
+; @brief:     This function compares two buffers 8 bytes at a time. At the
+;             first differing quadword both are byte swapped, so comparing
+;             them as numbers compares their first differing bytes.
+; @param:     The first buffer in rdi, the second in rsi, the size in rdx.
+; @return:    The result is stored in eax, negative, zero or positive as the
+;             first differing byte of the first buffer is below, equal to or
+;             above that of the second.
+memcmp:
+    xor eax,eax
+.quad:
+    cmp rdx,8
+    jb .byte
+    mov r8,[rdi]
+    mov r9,[rsi]
+    cmp r8,r9
+    jne .differ
+    add rdi,8
+    add rsi,8
+    sub rdx,8
+    jmp .quad
+.differ:
+    bswap r8
+    bswap r9
+    cmp r8,r9
+    sbb eax,eax
+    or eax,1
+    ret
+.byte:
+    test rdx,rdx
+    jz .done
+    movzx eax,byte[rdi]
+    movzx ecx,byte[rsi]
+    sub eax,ecx
+    jnz .done
+    inc rdi
+    inc rsi
+    dec rdx
+    jmp .byte
+.done:
+    ret
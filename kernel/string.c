@@ -0,0 +1,149 @@
+/******************************************************************************
+ * @file:        string.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the choice of the copy and fill
+ *               variants of string.asm.
+ *
+ *               With enhanced rep movsb (ERMS, CPUID leaf 7 EBX bit 9) the
+ *               microcode copies and fills in whole cache lines and a plain
+ *               rep movsb or rep stosb is the best choice at any size,
+ *               without touching the SIMD registers. Otherwise buffers of
+ *               STRING_SIMD_MIN bytes and more go through the AVX2 loops if
+ *               the CPU has AVX2 and init_fpu enabled the AVX state, or
+ *               through the SSE2 loops, and smaller ones through rep movsq
+ *               or rep stosq, which is not worth a SIMD section. Until
+ *               init_string has run every call takes the rep movsq path.
+ *
+ *               memmove copies forwards unless the destination starts
+ *               inside the source. A forward copy to a lower address is
+ *               safe for every variant, as each loop reads a block before it
+ *               writes the bytes below it.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the string routines.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "string.h"
+#include "fpu.h"
+#include "printk.h"
+#include "lib.h"
+#include "stdbool.h"
+
+#define CPUID_7_EBX_AVX2    (1U<<5)
+#define CPUID_7_EBX_ERMS    (1U<<9)
+
+typedef void *(*copy_fn_t)(void *dst, const void *src, size_t n);
+typedef void *(*fill_fn_t)(void *dst, int c, size_t n);
+
+void *memcpy_movsb(void *dst, const void *src, size_t n);
+void *memcpy_movsq(void *dst, const void *src, size_t n);
+void *memcpy_sse2(void *dst, const void *src, size_t n);
+void *memcpy_avx2(void *dst, const void *src, size_t n);
+void *memmove_back(void *dst, const void *src, size_t n);
+void *memset_stosb(void *dst, int c, size_t n);
+void *memset_stosq(void *dst, int c, size_t n);
+void *memset_sse2(void *dst, int c, size_t n);
+void *memset_avx2(void *dst, int c, size_t n);
+
+static copy_fn_t copy_small = memcpy_movsq;
+static copy_fn_t copy_large = 0;
+static fill_fn_t fill_small = memset_stosq;
+static fill_fn_t fill_large = 0;
+
+/**
+ * @brief:          A function that chooses the variants.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    A zero copy_large or fill_large means the small variant
+ *                  handles every size.
+ */
+void init_string(void)
+{
+    struct CpuidRegs regs;
+    uint32_t ebx = 0;
+    const char *name;
+
+    read_cpuid(0, 0, &regs);
+    if (regs.eax >= 7) {
+        read_cpuid(7, 0, &regs);
+        ebx = regs.ebx;
+    }
+
+    if ((ebx&CPUID_7_EBX_ERMS) != 0) {
+        copy_small = memcpy_movsb;
+        fill_small = memset_stosb;
+        name = "erms";
+    }
+    else if ((ebx&CPUID_7_EBX_AVX2) != 0 &&
+             (fpu_xfeatures()&XFEATURE_AVX) != 0) {
+        copy_large = memcpy_avx2;
+        fill_large = memset_avx2;
+        name = "avx2";
+    }
+    else {
+        copy_large = memcpy_sse2;
+        fill_large = memset_sse2;
+        name = "sse2";
+    }
+
+    printk("string: %s copies\n", name);
+}
+
+/**
+ * @brief:      Copies n bytes between buffers that do not overlap.
+ */
+void *memcpy(void *dst, const void *src, size_t n)
+{
+    uint64_t flags;
+
+    if (copy_large == 0 || n < STRING_SIMD_MIN) {
+        return copy_small(dst, src, n);
+    }
+
+    flags = kernel_fpu_begin();
+    copy_large(dst, src, n);
+    kernel_fpu_end(flags);
+
+    return dst;
+}
+
+/**
+ * @brief:      Copies n bytes between buffers that may overlap.
+ */
+void *memmove(void *dst, const void *src, size_t n)
+{
+    if ((uintptr_t)dst-(uintptr_t)src >= n) {
+        return memcpy(dst, src, n);
+    }
+
+    return memmove_back(dst, src, n);
+}
+
+/**
+ * @brief:      Fills n bytes with the byte c.
+ */
+void *memset(void *dst, int c, size_t n)
+{
+    uint64_t flags;
+
+    if (fill_large == 0 || n < STRING_SIMD_MIN) {
+        return fill_small(dst, c, n);
+    }
+
+    flags = kernel_fpu_begin();
+    fill_large(dst, c, n);
+    kernel_fpu_end(flags);
+
+    return dst;
+}
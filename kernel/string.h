@@ -0,0 +1,71 @@
+/* -----------------------------------------------------------------------------
+ * @file:        string.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the kernel
+ *               string routines.
+ *
+ *               memcpy, memmove, memset and memcmp behave as in the C
+ *               library, and GCC emits calls to the first three for large
+ *               structure copies and initializers even in a freestanding
+ *               build. They work from the first instruction of KMain and
+ *               switch to the fastest variant for the CPU in init_string.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the string routines.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _STRING_H_
+#define _STRING_H_
+
+#include "stdint.h"
+#include "stddef.h"
+
+#define STRING_SIMD_MIN     256
+
+/**
+ * @fn:        init_string(void)
+ *
+ * @brief:     Chooses the copy and fill variants. Must run after init_fpu.
+ */
+void init_string(void);
+/**
+ * @fn:        memcpy(void *dst, const void *src, size_t n)
+ *
+ * @brief:     Copies n bytes between buffers that do not overlap.
+ *
+ * @return:    dst
+ */
+void *memcpy(void *dst, const void *src, size_t n);
+/**
+ * @fn:        memmove(void *dst, const void *src, size_t n)
+ *
+ * @brief:     Copies n bytes between buffers that may overlap.
+ *
+ * @return:    dst
+ */
+void *memmove(void *dst, const void *src, size_t n);
+/**
+ * @fn:        memset(void *dst, int c, size_t n)
+ *
+ * @brief:     Fills n bytes with the byte c.
+ *
+ * @return:    dst
+ */
+void *memset(void *dst, int c, size_t n);
+/**
+ * @fn:        memcmp(const void *a, const void *b, size_t n)
+ *
+ * @brief:     Compares n bytes. Defined in string.asm.
+ *
+ * @return:    A negative, zero or positive value as the first differing
+ *             byte of a is below, equal to or above that of b.
+ */
+int memcmp(const void *a, const void *b, size_t n);
+
+#endif
@@ -0,0 +1,309 @@
+/******************************************************************************
+ * @file:        sync.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the kernel synchronization primitives.
+ *
+ *               The atomic operations are the GCC __atomic builtins, which
+ *               compile to lock-prefixed instructions without any library
+ *               support. On x86_64 an aligned store already has release
+ *               semantics, so releasing a ticket lock is a plain increment of
+ *               the owner field by its holder.
+ *
+ *               RCU keeps one quiescent state count per CPU in a
+ *               PercpuCounter. synchronize_rcu takes a snapshot of the
+ *               counts and waits until every other CPU has moved on. CPUs
+ *               that stay behind are sent a reschedule IPI every
+ *               RCU_KICK_NS, an idle CPU reports a quiescent state as soon
+ *               as the IPI returns to its idle loop.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version with the ticket spinlock.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Added spin_trylock.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Added MCS locks, per-CPU counters and RCU.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "sync.h"
+#include "smp.h"
+#include "sched.h"
+#include "clock.h"
+#include "lib.h"
+
+#define RCU_KICK_NS         NSEC_PER_MSEC
+
+static struct PercpuCounter rcu_qs;
+
+/**
+ * @brief:      Initializes an unlocked spinlock.
+ */
+void spin_init(struct Spinlock *lock)
+{
+    lock->next = 0;
+    lock->owner = 0;
+}
+
+/**
+ * @brief:      Acquires a spinlock.
+ *
+ * @param:      lock  the lock
+ *
+ * @return:     None
+ */
+void spin_lock(struct Spinlock *lock)
+{
+    uint32_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        cpu_relax();
+    }
+}
+
+/**
+ * @brief:      Acquires a spinlock if no CPU holds or waits for it.
+ *
+ * @param:      lock  the lock
+ *
+ * @return:     true if the lock was acquired.
+ *
+ * @description: The next ticket is only taken if it is the one the owner
+ *               field is serving, so a failed attempt leaves no ticket
+ *               behind.
+ */
+bool spin_trylock(struct Spinlock *lock)
+{
+    uint32_t owner = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+    uint32_t ticket = owner;
+
+    return __atomic_compare_exchange_n(&lock->next, &ticket, owner+1, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief:      Releases a spinlock.
+ *
+ * @param:      lock  the lock, held by the caller
+ *
+ * @return:     None
+ */
+void spin_unlock(struct Spinlock *lock)
+{
+    __atomic_store_n(&lock->owner, lock->owner+1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief:      Disables interrupts and acquires a spinlock.
+ */
+uint64_t spin_lock_irqsave(struct Spinlock *lock)
+{
+    uint64_t flags = irq_save();
+
+    spin_lock(lock);
+    return flags;
+}
+
+/**
+ * @brief:      Releases a spinlock and restores the interrupt flag.
+ */
+void spin_unlock_irqrestore(struct Spinlock *lock, uint64_t flags)
+{
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+/**
+ * @brief:      Acquires an MCS lock.
+ *
+ * @param:      lock  the lock
+ * @param:      node  the queue node of the caller
+ *
+ * @return:     None
+ *
+ * @description: The caller appends its node to the queue with one exchange.
+ *               If there was a previous waiter, the node is linked behind it
+ *               and the caller spins on its own locked field.
+ */
+void mcs_lock(struct McsLock *lock, struct McsNode *node)
+{
+    struct McsNode *prev;
+
+    node->next = 0;
+    node->locked = 1;
+
+    prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (prev == 0) {
+        return;
+    }
+
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+}
+
+/**
+ * @brief:      Releases an MCS lock.
+ *
+ * @param:      lock  the lock
+ * @param:      node  the queue node passed to mcs_lock
+ *
+ * @return:     None
+ *
+ * @description: Without a known successor the lock is freed by resetting
+ *               the tail. If that fails a new waiter has swapped the tail
+ *               but not linked its node yet, so the holder waits for the
+ *               link before handing the lock over.
+ */
+void mcs_unlock(struct McsLock *lock, struct McsNode *node)
+{
+    struct McsNode *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    struct McsNode *self = node;
+
+    if (next == 0) {
+        if (__atomic_compare_exchange_n(&lock->tail, &self, 0, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == 0) {
+            cpu_relax();
+        }
+    }
+
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief:      Disables interrupts and acquires an MCS lock.
+ */
+uint64_t mcs_lock_irqsave(struct McsLock *lock, struct McsNode *node)
+{
+    uint64_t flags = irq_save();
+
+    mcs_lock(lock, node);
+    return flags;
+}
+
+/**
+ * @brief:      Releases an MCS lock and restores the interrupt flag.
+ */
+void mcs_unlock_irqrestore(struct McsLock *lock, struct McsNode *node,
+                           uint64_t flags)
+{
+    mcs_unlock(lock, node);
+    irq_restore(flags);
+}
+
+/**
+ * @brief:      Adds delta to the slot of the calling CPU.
+ *
+ * @description: The add is atomic, so a task that moves to another CPU
+ *               between reading its CPU number and the add still counts
+ *               correctly. The slot is normally only written by its own
+ *               CPU, so the locked add never waits for another cache.
+ */
+void percpu_counter_add(struct PercpuCounter *counter, int64_t delta)
+{
+    __atomic_fetch_add(&counter->slots[this_cpu()->id].value, delta,
+                       __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief:      Returns the sum of all slots. The sum is not a snapshot, other
+ *              CPUs may update their slots while it is taken.
+ */
+int64_t percpu_counter_sum(const struct PercpuCounter *counter)
+{
+    int64_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < MAX_CPUS; i++) {
+        sum += percpu_counter_read(counter, i);
+    }
+
+    return sum;
+}
+
+/**
+ * @brief:      Starts an RCU read-side critical section.
+ */
+void rcu_read_lock(void)
+{
+    preempt_disable();
+}
+
+/**
+ * @brief:      Ends an RCU read-side critical section.
+ */
+void rcu_read_unlock(void)
+{
+    preempt_enable();
+}
+
+/**
+ * @brief:      Reports a quiescent state of a CPU, only the CPU itself
+ *              writes its count.
+ */
+void rcu_quiescent(uint32_t cpu)
+{
+    __atomic_store_n(&rcu_qs.slots[cpu].value, rcu_qs.slots[cpu].value+1,
+                     __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief:          A function that waits for an RCU grace period.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The fence orders the pointer update of the caller before
+ *                  the snapshot. The calling CPU is not waited for, the
+ *                  caller is not a reader. On one CPU there is nothing to
+ *                  wait for, which also covers the calls before init_smp.
+ */
+void synchronize_rcu(void)
+{
+    int64_t snap[MAX_CPUS];
+    uint32_t count = get_cpu_count();
+    uint64_t flags, kick, now;
+    uint32_t self, i;
+
+    if (count <= 1) {
+        return;
+    }
+
+    flags = irq_save();
+    self = this_cpu()->id;
+    irq_restore(flags);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (i = 0; i < count; i++) {
+        snap[i] = percpu_counter_read(&rcu_qs, i);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (i == self) {
+            continue;
+        }
+
+        kick = 0;
+        while (percpu_counter_read(&rcu_qs, i) == snap[i]) {
+            now = ktime_ns();
+            if (now >= kick) {
+                sched_kick_cpu(i);
+                kick = now+RCU_KICK_NS;
+            }
+            cpu_relax();
+        }
+    }
+}
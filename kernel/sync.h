@@ -0,0 +1,331 @@
+/* -----------------------------------------------------------------------------
+ * @file:        sync.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the kernel
+ *               synchronization primitives.
+ *
+ *               A Spinlock is a ticket lock. A CPU takes the next ticket
+ *               with one atomic increment and spins, reading only, until the
+ *               owner field reaches its ticket, so waiters are served in
+ *               arrival order.
+ *
+ *               An McsLock also serves waiters in order, but every waiter
+ *               spins on its own McsNode, usually on the caller's stack, and
+ *               the holder hands the lock over by writing to the node of the
+ *               next waiter. A release touches one remote cache line instead
+ *               of invalidating the line of the lock in every waiting CPU,
+ *               which makes it the better choice for locks under contention.
+ *
+ *               Locks that are also taken in interrupt handlers must be held
+ *               with the irqsave variants, otherwise an interrupt on the
+ *               holding CPU would spin on the lock forever.
+ *
+ *               A PercpuCounter has one cache line per CPU. Updates only
+ *               touch the line of the calling CPU, reading the total sums
+ *               all of them.
+ *
+ *               Read-mostly data can be published RCU style: readers load a
+ *               pointer with rcu_dereference inside rcu_read_lock and
+ *               rcu_read_unlock, which only disable preemption, and take no
+ *               lock. A writer publishes a new copy with rcu_assign_pointer
+ *               and may reuse the old one once synchronize_rcu returns,
+ *               after every CPU has passed a quiescent state. A CPU is
+ *               quiescent whenever a trap returns to code that runs with
+ *               interrupts and preemption enabled. Interrupt handlers run
+ *               with interrupts disabled and are readers without further
+ *               marking.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version with the ticket spinlock.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Added spin_trylock.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Added MCS locks, atomic helpers, per-CPU counters and RCU.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "acpi.h"
+
+#define CACHE_LINE_SIZE     64
+
+/**
+ * @brief:                A ticket spinlock.
+ *
+ * @struct:               Spinlock
+ *
+ * @param:     next       The next ticket to hand out
+ * @param:     owner      The ticket that holds the lock
+ */
+struct Spinlock {
+    volatile uint32_t next;
+    volatile uint32_t owner;
+};
+
+#define SPINLOCK_INIT       { 0, 0 }
+
+/**
+ * @brief:                The queue node of one waiter of an McsLock.
+ *
+ * @struct:               McsNode
+ *
+ * @param:     next       The next waiter
+ * @param:     locked     Cleared by the previous holder to pass the lock on
+ */
+struct McsNode {
+    struct McsNode *volatile next;
+    volatile uint32_t locked;
+};
+
+/**
+ * @brief:                An MCS queue lock.
+ *
+ * @struct:               McsLock
+ *
+ * @param:     tail       The last waiter, 0 while the lock is free
+ */
+struct McsLock {
+    struct McsNode *volatile tail;
+};
+
+#define MCS_LOCK_INIT       { 0 }
+
+/**
+ * @brief:                An atomic 64-bit integer.
+ *
+ * @struct:               Atomic
+ */
+struct Atomic {
+    volatile int64_t value;
+};
+
+#define ATOMIC_INIT(v)      { (v) }
+
+/**
+ * @brief:                The slot of one CPU in a PercpuCounter.
+ *
+ * @struct:               PercpuSlot
+ */
+struct PercpuSlot {
+    volatile int64_t value;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * @brief:                A counter split into per-CPU slots.
+ *
+ * @struct:               PercpuCounter
+ */
+struct PercpuCounter {
+    struct PercpuSlot slots[MAX_CPUS];
+};
+
+#define rcu_dereference(p)          __atomic_load_n(&(p), __ATOMIC_CONSUME)
+#define rcu_assign_pointer(p, v)    __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/**
+ * @fn:        spin_init(struct Spinlock *lock)
+ *
+ * @brief:     Initializes an unlocked spinlock.
+ */
+void spin_init(struct Spinlock *lock);
+/**
+ * @fn:        spin_lock(struct Spinlock *lock)
+ *
+ * @brief:     Acquires a spinlock.
+ */
+void spin_lock(struct Spinlock *lock);
+/**
+ * @fn:        spin_trylock(struct Spinlock *lock)
+ *
+ * @brief:     Acquires a spinlock if it is free.
+ *
+ * @return:    true if the lock was acquired.
+ */
+bool spin_trylock(struct Spinlock *lock);
+/**
+ * @fn:        spin_unlock(struct Spinlock *lock)
+ *
+ * @brief:     Releases a spinlock.
+ */
+void spin_unlock(struct Spinlock *lock);
+/**
+ * @fn:        spin_lock_irqsave(struct Spinlock *lock)
+ *
+ * @brief:     Disables interrupts and acquires a spinlock.
+ *
+ * @return:    The rflags value to pass to spin_unlock_irqrestore.
+ */
+uint64_t spin_lock_irqsave(struct Spinlock *lock);
+/**
+ * @fn:        spin_unlock_irqrestore(struct Spinlock *lock, uint64_t flags)
+ *
+ * @brief:     Releases a spinlock and restores the interrupt flag.
+ */
+void spin_unlock_irqrestore(struct Spinlock *lock, uint64_t flags);
+/**
+ * @fn:        mcs_lock(struct McsLock *lock, struct McsNode *node)
+ *
+ * @brief:     Acquires an MCS lock. node must stay valid until mcs_unlock.
+ */
+void mcs_lock(struct McsLock *lock, struct McsNode *node);
+/**
+ * @fn:        mcs_unlock(struct McsLock *lock, struct McsNode *node)
+ *
+ * @brief:     Releases an MCS lock acquired with node.
+ */
+void mcs_unlock(struct McsLock *lock, struct McsNode *node);
+/**
+ * @fn:        mcs_lock_irqsave(struct McsLock *lock, struct McsNode *node)
+ *
+ * @brief:     Disables interrupts and acquires an MCS lock.
+ *
+ * @return:    The rflags value to pass to mcs_unlock_irqrestore.
+ */
+uint64_t mcs_lock_irqsave(struct McsLock *lock, struct McsNode *node);
+/**
+ * @fn:        mcs_unlock_irqrestore(struct McsLock *lock,
+ *                                   struct McsNode *node, uint64_t flags)
+ *
+ * @brief:     Releases an MCS lock and restores the interrupt flag.
+ */
+void mcs_unlock_irqrestore(struct McsLock *lock, struct McsNode *node,
+                           uint64_t flags);
+/**
+ * @fn:        percpu_counter_add(struct PercpuCounter *counter,
+ *                                int64_t delta)
+ *
+ * @brief:     Adds delta to the slot of the calling CPU. Must not be used
+ *             before init_smp.
+ */
+void percpu_counter_add(struct PercpuCounter *counter, int64_t delta);
+/**
+ * @fn:        percpu_counter_sum(const struct PercpuCounter *counter)
+ *
+ * @brief:     Returns the sum of all slots.
+ */
+int64_t percpu_counter_sum(const struct PercpuCounter *counter);
+/**
+ * @fn:        percpu_counter_read(const struct PercpuCounter *counter,
+ *                                 uint32_t cpu)
+ *
+ * @brief:     Returns the slot of one CPU.
+ */
+static inline int64_t percpu_counter_read(const struct PercpuCounter *counter,
+                                          uint32_t cpu)
+{
+    return __atomic_load_n(&counter->slots[cpu].value, __ATOMIC_RELAXED);
+}
+/**
+ * @fn:        rcu_read_lock(void)
+ *
+ * @brief:     Starts an RCU read-side critical section.
+ */
+void rcu_read_lock(void);
+/**
+ * @fn:        rcu_read_unlock(void)
+ *
+ * @brief:     Ends an RCU read-side critical section.
+ */
+void rcu_read_unlock(void);
+/**
+ * @fn:        synchronize_rcu(void)
+ *
+ * @brief:     Waits until every read-side critical section that started
+ *             before the call has ended. Must be called outside of one, and
+ *             not while holding a lock that a reader or another caller of
+ *             synchronize_rcu spins on.
+ */
+void synchronize_rcu(void);
+/**
+ * @fn:        rcu_quiescent(uint32_t cpu)
+ *
+ * @brief:     Reports a quiescent state of the calling CPU. Called by the
+ *             scheduler on the way out of a trap.
+ */
+void rcu_quiescent(uint32_t cpu);
+
+/**
+ * @fn:        atomic_read(const struct Atomic *v)
+ *
+ * @brief:     Returns the value of v.
+ */
+static inline int64_t atomic_read(const struct Atomic *v)
+{
+    return __atomic_load_n(&v->value, __ATOMIC_RELAXED);
+}
+/**
+ * @fn:        atomic_set(struct Atomic *v, int64_t i)
+ *
+ * @brief:     Sets v to i.
+ */
+static inline void atomic_set(struct Atomic *v, int64_t i)
+{
+    __atomic_store_n(&v->value, i, __ATOMIC_RELAXED);
+}
+/**
+ * @fn:        atomic_add_return(struct Atomic *v, int64_t i)
+ *
+ * @brief:     Adds i to v with a full barrier.
+ *
+ * @return:    The new value.
+ */
+static inline int64_t atomic_add_return(struct Atomic *v, int64_t i)
+{
+    return __atomic_add_fetch(&v->value, i, __ATOMIC_SEQ_CST);
+}
+/**
+ * @fn:        atomic_inc(struct Atomic *v)
+ *
+ * @brief:     Adds one to v.
+ */
+static inline void atomic_inc(struct Atomic *v)
+{
+    __atomic_fetch_add(&v->value, 1, __ATOMIC_RELAXED);
+}
+/**
+ * @fn:        atomic_dec_and_test(struct Atomic *v)
+ *
+ * @brief:     Subtracts one from v with a full barrier.
+ *
+ * @return:    true if v reached zero.
+ */
+static inline bool atomic_dec_and_test(struct Atomic *v)
+{
+    return __atomic_sub_fetch(&v->value, 1, __ATOMIC_SEQ_CST) == 0;
+}
+/**
+ * @fn:        atomic_xchg(struct Atomic *v, int64_t i)
+ *
+ * @brief:     Sets v to i.
+ *
+ * @return:    The old value.
+ */
+static inline int64_t atomic_xchg(struct Atomic *v, int64_t i)
+{
+    return __atomic_exchange_n(&v->value, i, __ATOMIC_SEQ_CST);
+}
+/**
+ * @fn:        atomic_cmpxchg(struct Atomic *v, int64_t old, int64_t i)
+ *
+ * @brief:     Sets v to i if it holds old.
+ *
+ * @return:    true if v was changed.
+ */
+static inline bool atomic_cmpxchg(struct Atomic *v, int64_t old, int64_t i)
+{
+    return __atomic_compare_exchange_n(&v->value, &old, i, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,94 @@
+;------------------------------------------------------------------------------
+; @file:        syscall.asm
+; @author:      Marko Trickovic (contact@markotrickovic.com)
+; @date:        10/14/2026 09:00 AM
+; @license:     MIT
+; @language:    Assembly
+; @platform:    x86_64
+; @description: This file contains the SYSCALL entry point of the kernel.
+;
+;               The processor leaves rsp at the user stack, so the entry
+;               swaps in the kernel GS base and parks the user rsp in the Cpu
+;               structure just long enough to load the system call stack of
+;               the running task. From there the user rsp lives on the kernel
+;               stack, where a task switch during the call cannot overwrite
+;               it, and interrupts are enabled again.
+;
+; Revision History:
+;
+;   - Revision 0.1: 10/14/2026 Marko Trickovic
+;     Initial version of the SYSCALL entry.
+;
+;   - Revision 0.2: 10/14/2026 Marko Trickovic
+;     Refuse to sysret to a non-canonical rip.
+;
+; Part of the os-dev-udemy-wsl.
+;------------------------------------------------------------------------------
+
+%define CPU_USER_RSP 32         ; struct Cpu of smp.h
+%define CPU_SYS_RSP 40
+
+section .text
+extern syscall_dispatch
+global syscall_entry
+
+; @routine:  syscall_entry
+; @brief:    This function is the target of the syscall instruction. It
+;            calls syscall_dispatch with the six arguments in the registers
+;            of the C calling convention and the number in rax as seventh
+;            argument on the stack, then returns to user code with sysret.
+;
+; @param:    rax   The system call number.
+; @param:    rdi   The first argument.
+; @param:    rsi   The second argument.
+; @param:    rdx   The third argument.
+; @param:    r10   The fourth argument, rcx holds the user rip.
+; @param:    r8    The fifth argument.
+; @param:    r9    The sixth argument.
+;
+; @return          The result of the call in rax.
+;
+; @note:           The system call stack is the top of the task's kernel
+;                  stack, 16-byte aligned. Four pushes keep it aligned for
+;                  the call. Interrupts are disabled again before the user
+;                  rsp is restored.
+;
+;                  rcx holds the rip after the syscall instruction. For a
+;                  syscall in the last user page that is 0x800000000000,
+;                  which is not canonical, and sysret would raise #GP in
+;                  ring 0 on the user stack and the user GS base. map_page
+;                  keeps that page unmapped (USER_TOP), and the check below
+;                  stops on a bad rip while the kernel stack and GS base are
+;                  still in place, where the #UD is reported.
+;
+;                  An NMI or machine check between the swapgs and sysret,
+;                  or before the swapgs at the entry, arrives in ring 0 on
+;                  the user GS base. Trap handles it by looking at the GS
+;                  base itself for those two vectors.
+;
+syscall_entry:
+    swapgs
+    mov [gs:CPU_USER_RSP],rsp
+    mov rsp,[gs:CPU_SYS_RSP]
+    push qword [gs:CPU_USER_RSP]
+    push r11                    ; User rflags
+    push rcx                    ; User rip
+    push rax                    ; Seventh argument of syscall_dispatch
+    sti
+
+    mov rcx,r10
+    call syscall_dispatch
+
+    cli
+    add rsp,8
+    pop rcx
+    pop r11
+    mov r10,rcx                 ; Clobbered by the call anyway
+    shr r10,47                  ; Above the canonical user half?
+    jnz SyscallBadRip
+    pop rsp
+    swapgs
+    o64 sysret
+
+SyscallBadRip:
+    ud2
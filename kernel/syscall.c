@@ -0,0 +1,148 @@
+/******************************************************************************
+ * @file:        syscall.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the system call table and the setup of
+ *               the SYSCALL and SYSRET instructions.
+ *
+ *               SYSCALL takes its CS from bits 47:32 of IA32_STAR and uses
+ *               the next GDT entry as SS. SYSRET to 64-bit code takes bits
+ *               63:48 plus 16 as CS and plus 8 as SS, both with RPL 3. With
+ *               the GDT of smp.h this is KERNEL_CS and KERNEL_DS on the way
+ *               in and USER_CS and USER_DS on the way out. IA32_FMASK clears
+ *               IF, TF, DF and AC on entry, so syscall_entry runs with
+ *               interrupts disabled until it is on the kernel stack.
+ *
+ *               The fast path saves only the user rip, rflags and rsp,
+ *               against the 15 registers and the trap frame of an int 0x80
+ *               through Trap. The callee-saved registers are preserved by
+ *               the C code, the others are free to change by the ABI in
+ *               syscall.h.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the SYSCALL entry and the dispatch table.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "syscall.h"
+#include "smp.h"
+#include "sched.h"
+#include "clock.h"
+#include "lib.h"
+
+#define IA32_EFER           0xc0000080
+#define IA32_STAR           0xc0000081
+#define IA32_LSTAR          0xc0000082
+#define IA32_FMASK          0xc0000084
+
+#define EFER_SCE            (1UL<<0)
+
+#define RFLAGS_TF           (1UL<<8)
+#define RFLAGS_IF           (1UL<<9)
+#define RFLAGS_DF           (1UL<<10)
+#define RFLAGS_AC           (1UL<<18)
+
+/*
+ * syscall.asm addresses these fields by number, a mismatch fails the build.
+ */
+typedef char cpu_offset_check[
+    (__builtin_offsetof(struct Cpu, user_rsp) == CPU_USER_RSP &&
+     __builtin_offsetof(struct Cpu, sys_rsp) == CPU_SYS_RSP) ? 1 : -1];
+
+/**
+ * @brief:      Ends the calling task.
+ */
+static int64_t sys_exit(int64_t a0, int64_t a1, int64_t a2, int64_t a3,
+                        int64_t a4, int64_t a5)
+{
+    task_exit();
+    return 0;
+}
+
+/**
+ * @brief:      Gives up the CPU to the next task.
+ */
+static int64_t sys_yield(int64_t a0, int64_t a1, int64_t a2, int64_t a3,
+                         int64_t a4, int64_t a5)
+{
+    sched_yield();
+    return 0;
+}
+
+/**
+ * @brief:      Returns the number of the calling task.
+ */
+static int64_t sys_gettid(int64_t a0, int64_t a1, int64_t a2, int64_t a3,
+                          int64_t a4, int64_t a5)
+{
+    return current_task()->id;
+}
+
+/**
+ * @brief:      Returns the nanoseconds since boot.
+ */
+static int64_t sys_clock(int64_t a0, int64_t a1, int64_t a2, int64_t a3,
+                         int64_t a4, int64_t a5)
+{
+    return (int64_t)ktime_ns();
+}
+
+/**
+ * @brief:      Sleeps for a0 nanoseconds.
+ */
+static int64_t sys_sleep(int64_t a0, int64_t a1, int64_t a2, int64_t a3,
+                         int64_t a4, int64_t a5)
+{
+    if (a0 < 0) {
+        return -1;
+    }
+
+    task_sleep((uint64_t)a0);
+    return 0;
+}
+
+static const syscall_fn_t syscall_table[SYSCALL_COUNT] = {
+    [SYS_EXIT]   = sys_exit,
+    [SYS_YIELD]  = sys_yield,
+    [SYS_GETTID] = sys_gettid,
+    [SYS_CLOCK]  = sys_clock,
+    [SYS_SLEEP]  = sys_sleep,
+};
+
+/**
+ * @brief:          A function that enables SYSCALL on the calling CPU.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    IA32_STAR holds the selector base of SYSRET with RPL 3,
+ *                  USER_DS-8, which gives USER_DS and USER_CS.
+ */
+void init_syscall(void)
+{
+    write_msr(IA32_STAR, ((uint64_t)(USER_DS-8)<<48)|
+                         ((uint64_t)KERNEL_CS<<32));
+    write_msr(IA32_LSTAR, (uint64_t)syscall_entry);
+    write_msr(IA32_FMASK, RFLAGS_TF|RFLAGS_IF|RFLAGS_DF|RFLAGS_AC);
+    write_msr(IA32_EFER, read_msr(IA32_EFER)|EFER_SCE);
+}
+
+/**
+ * @brief:      Calls the entry nr of the system call table.
+ */
+int64_t syscall_dispatch(int64_t a0, int64_t a1, int64_t a2, int64_t a3,
+                         int64_t a4, int64_t a5, uint64_t nr)
+{
+    if (nr >= SYSCALL_COUNT || syscall_table[nr] == 0) {
+        return -1;
+    }
+
+    return syscall_table[nr](a0, a1, a2, a3, a4, a5);
+}
@@ -0,0 +1,68 @@
+/* -----------------------------------------------------------------------------
+ * @file:        syscall.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the system
+ *               call interface.
+ *
+ *               User code enters the kernel with the syscall instruction
+ *               rather than a software interrupt. The number of the call is
+ *               passed in rax and up to six arguments in rdi, rsi, rdx, r10,
+ *               r8 and r9, the result comes back in rax. Like a C call, a
+ *               system call preserves rbx, rbp, rsp and r12 to r15 and may
+ *               change every other register, rcx and r11 included, which
+ *               the processor uses for the return address and rflags. An
+ *               unknown number returns -1.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the SYSCALL entry and the dispatch table.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _SYSCALL_H_
+#define _SYSCALL_H_
+
+#include "stdint.h"
+
+#define SYS_EXIT            0
+#define SYS_YIELD           1
+#define SYS_GETTID          2
+#define SYS_CLOCK           3
+#define SYS_SLEEP           4
+#define SYSCALL_COUNT       5
+
+typedef int64_t (*syscall_fn_t)(int64_t a0, int64_t a1, int64_t a2,
+                                int64_t a3, int64_t a4, int64_t a5);
+
+/**
+ * @fn:        init_syscall(void)
+ *
+ * @brief:     Enables SYSCALL on the calling CPU. Called by init_cpu once
+ *             the GDT of the CPU is loaded.
+ */
+void init_syscall(void);
+/**
+ * @fn:        syscall_dispatch(int64_t a0, int64_t a1, int64_t a2,
+ *                              int64_t a3, int64_t a4, int64_t a5,
+ *                              uint64_t nr)
+ *
+ * @brief:     Calls the entry nr of the system call table. Called by
+ *             syscall_entry with interrupts enabled.
+ *
+ * @return:    The result of the call, or -1 for an unknown number.
+ */
+int64_t syscall_dispatch(int64_t a0, int64_t a1, int64_t a2, int64_t a3,
+                         int64_t a4, int64_t a5, uint64_t nr);
+/**
+ * @fn:        syscall_entry(void)
+ *
+ * @brief:     The target of the syscall instruction, in IA32_LSTAR. Defined
+ *             in syscall.asm.
+ */
+void syscall_entry(void);
+
+#endif
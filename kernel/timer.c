@@ -0,0 +1,469 @@
+/******************************************************************************
+ * @file:        timer.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the timer subsystem of the kernel.
+ *
+ *               Expiry times are nanoseconds of ktime_ns. The local APIC
+ *               timer is always armed for the earliest pending timer, so the
+ *               hlt in the idle loop lasts until the next deadline and no
+ *               interrupt fires while no timer is pending:
+ *
+ *                  - In TSC-deadline mode (CPUID leaf 1, ECX bit 24) the
+ *                    deadline is written to IA32_TSC_DEADLINE as a TSC value.
+ *
+ *                  - Otherwise the timer runs in one-shot mode. Its frequency
+ *                    is measured against the TSC, and deadlines more than
+ *                    10 s or one 32-bit count away wake the CPU early to
+ *                    rearm the timer.
+ *
+ *               Without a local APIC the 100 Hz PIT tick is kept and expires
+ *               the timers.
+ *
+ *               The pending timers of each CPU form a binary min-heap, so
+ *               starting, cancelling and expiring a timer costs O(log n),
+ *               and finding the next deadline is O(1). A timer expires on
+ *               the CPU that started it, and each heap has its own lock.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the one-shot timer subsystem.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Use ktime_ns as the time base and TSC-deadline mode when available.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Per-CPU timer heaps, and the timer interrupt takes the full entry path
+ *     so the scheduler can preempt the interrupted task.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Added timer_irq_frame for callbacks that sample the interrupted code.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "timer.h"
+#include "clock.h"
+#include "apic.h"
+#include "trap.h"
+#include "smp.h"
+#include "sync.h"
+#include "lib.h"
+
+#define IA32_TSC_DEADLINE   0x6e0
+
+#define TIMER_MODE_PIT      0
+#define TIMER_MODE_ONESHOT  1
+#define TIMER_MODE_DEADLINE 2
+
+#define LAPIC_COUNT_MAX     0xffffffffUL
+#define CALIBRATE_NS        (10*NSEC_PER_MSEC)
+#define ONESHOT_MAX_NS      (10*NSEC_PER_SEC)
+
+/**
+ * @brief:       The pending timers of one CPU.
+ *
+ * @struct:      TimerBase
+ *
+ * @param:       heap      The min-heap of pending timers
+ * @param:       count     The number of pending timers
+ * @param:       expiring  Set while the timer interrupt runs callbacks
+ * @param:       frame     The trap frame of the timer interrupt while it runs
+ *                         callbacks
+ * @param:       lock      Protects the heap
+ */
+struct TimerBase {
+    struct Timer *heap[TIMER_MAX];
+    uint32_t count;
+    bool expiring;
+    struct TrapFrame *frame;
+    struct Spinlock lock;
+};
+
+static struct TimerBase bases[MAX_CPUS];
+
+static int timer_mode = TIMER_MODE_PIT;
+static uint64_t lapic_hz;
+
+/**
+ * @brief:      Returns the nanoseconds since init_clock.
+ */
+uint64_t timer_now(void)
+{
+    return ktime_ns();
+}
+
+static void heap_swap(struct TimerBase *base, uint32_t a, uint32_t b)
+{
+    struct Timer *timer = base->heap[a];
+
+    base->heap[a] = base->heap[b];
+    base->heap[b] = timer;
+    base->heap[a]->index = a;
+    base->heap[b]->index = b;
+}
+
+static void sift_up(struct TimerBase *base, uint32_t i)
+{
+    uint32_t parent;
+
+    while (i > 0) {
+        parent = (i-1)/2;
+        if (base->heap[parent]->expires <= base->heap[i]->expires) {
+            break;
+        }
+        heap_swap(base, i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(struct TimerBase *base, uint32_t i)
+{
+    struct Timer **heap = base->heap;
+    uint32_t child;
+
+    while ((child = 2*i+1) < base->count) {
+        if (child+1 < base->count &&
+            heap[child+1]->expires < heap[child]->expires) {
+            child++;
+        }
+        if (heap[i]->expires <= heap[child]->expires) {
+            break;
+        }
+        heap_swap(base, i, child);
+        i = child;
+    }
+}
+
+/**
+ * @brief:     Removes the timer at position i of the heap.
+ */
+static void heap_remove(struct TimerBase *base, uint32_t i)
+{
+    struct Timer *timer = base->heap[i];
+    struct Timer *moved;
+
+    base->count--;
+    if (i != base->count) {
+        moved = base->heap[base->count];
+        base->heap[i] = moved;
+        moved->index = i;
+        sift_up(base, i);
+        sift_down(base, moved->index);
+    }
+
+    timer->index = TIMER_IDLE;
+}
+
+/**
+ * @brief:     Arms the local APIC timer for the earliest pending timer of the
+ *             calling CPU, or stops it when no timer is pending. The base
+ *             lock must be held.
+ */
+static void program_timer(struct TimerBase *base)
+{
+    uint64_t now, delta;
+
+    if (timer_mode == TIMER_MODE_DEADLINE) {
+        write_msr(IA32_TSC_DEADLINE,
+                  base->count > 0 ? ns_to_tsc(base->heap[0]->expires) : 0);
+        return;
+    }
+
+    if (base->count == 0) {
+        lapic_write(LAPIC_TIMER_INIT, 0);
+        return;
+    }
+
+    now = ktime_ns();
+    delta = 0;
+    if (base->heap[0]->expires > now) {
+        delta = base->heap[0]->expires-now;
+    }
+    if (delta > ONESHOT_MAX_NS) {
+        delta = ONESHOT_MAX_NS;
+    }
+
+    delta = delta*lapic_hz/NSEC_PER_SEC+1;
+    if (delta > LAPIC_COUNT_MAX) {
+        delta = LAPIC_COUNT_MAX;
+    }
+
+    lapic_write(LAPIC_TIMER_INIT, (uint32_t)delta);
+}
+
+/**
+ * @brief:     The handler of the timer interrupt. Every expired timer is
+ *             removed from the heap before its callback runs, with the base
+ *             lock released, then the next deadline is programmed. The
+ *             interrupt is acknowledged before the handler returns, so a
+ *             task switch on the way out of the trap keeps the timer running.
+ */
+static void timer_interrupt(struct TrapFrame *tf, void *ctx)
+{
+    struct TimerBase *base = &bases[this_cpu()->id];
+    struct Timer *timer;
+    uint64_t now;
+
+    spin_lock(&base->lock);
+    base->expiring = true;
+    base->frame = tf;
+    now = timer_now();
+    while (base->count > 0 && base->heap[0]->expires <= now) {
+        timer = base->heap[0];
+        heap_remove(base, 0);
+        spin_unlock(&base->lock);
+        timer->fn(timer, timer->ctx);
+        spin_lock(&base->lock);
+    }
+    base->expiring = false;
+    base->frame = 0;
+
+    if (timer_mode != TIMER_MODE_PIT) {
+        program_timer(base);
+    }
+    spin_unlock(&base->lock);
+    eoi();
+}
+
+/**
+ * @brief:     Measures the frequency of the local APIC timer against the
+ *             TSC.
+ *
+ * @return:    The number of timer ticks per second at divide by 16.
+ */
+static uint64_t calibrate_lapic(void)
+{
+    uint64_t start, stop;
+    uint32_t ticks;
+
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+
+    start = ktime_ns();
+    lapic_write(LAPIC_TIMER_INIT, LAPIC_COUNT_MAX);
+    ndelay(CALIBRATE_NS);
+    ticks = LAPIC_COUNT_MAX-lapic_read(LAPIC_TIMER_COUNT);
+    stop = ktime_ns();
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    return (uint64_t)ticks*NSEC_PER_SEC/(stop-start);
+}
+
+/**
+ * @brief:          A function that programs the timer interrupt of the
+ *                  calling CPU.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The LVT timer entry is written before the first deadline.
+ *                  In TSC-deadline mode the LVT write must be ordered before
+ *                  the IA32_TSC_DEADLINE write, which the uncached or
+ *                  serializing read of the entry takes care of.
+ */
+static void init_lapic_timer(void)
+{
+    struct TimerBase *base;
+    uint64_t flags;
+
+    if (timer_mode == TIMER_MODE_DEADLINE) {
+        lapic_write(LAPIC_LVT_TIMER, TIMER_VECTOR|LVT_TSC_DEADLINE);
+    }
+    else {
+        lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+        lapic_write(LAPIC_LVT_TIMER, TIMER_VECTOR|LVT_ONESHOT);
+    }
+    lapic_read(LAPIC_LVT_TIMER);
+
+    base = &bases[this_cpu()->id];
+    flags = spin_lock_irqsave(&base->lock);
+    program_timer(base);
+    spin_unlock_irqrestore(&base->lock, flags);
+}
+
+/**
+ * @brief:          A function that initializes the timer subsystem.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The function must run on the BSP after init_apic,
+ *                  init_clock and init_smp and before interrupts are
+ *                  enabled. Without a local APIC the timer keeps the PIT
+ *                  interrupt on vector 32. Otherwise the PIT interrupt is
+ *                  masked, the PIT counter keeps running.
+ *
+ *                  The timer interrupt takes the full entry path, because
+ *                  the scheduler may switch to another task when it returns.
+ */
+void init_timer(void)
+{
+    struct CpuidRegs regs;
+
+    if (get_apic_mode() == APIC_MODE_PIC) {
+        register_irq_handler(IRQ_BASE, timer_interrupt, 0);
+        return;
+    }
+
+    ioapic_set_masked(irq_to_gsi(0), true);
+    unregister_irq_handler(IRQ_BASE);
+
+    read_cpuid(1, 0, &regs);
+    if (regs.ecx & (1<<24)) {
+        timer_mode = TIMER_MODE_DEADLINE;
+    }
+    else {
+        lapic_hz = calibrate_lapic();
+        timer_mode = TIMER_MODE_ONESHOT;
+    }
+
+    register_irq_handler(TIMER_VECTOR, timer_interrupt, 0);
+    init_lapic_timer();
+}
+
+/**
+ * @brief:          A function that starts the local APIC timer of an AP.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The mode and the frequency measured by init_timer on the
+ *                  BSP are reused, all CPUs of a system share them.
+ */
+void init_timer_cpu(void)
+{
+    if (timer_mode != TIMER_MODE_PIT) {
+        init_lapic_timer();
+    }
+}
+
+/**
+ * @brief:      Returns the trap frame of the timer interrupt that runs the
+ *              calling callback, or 0 outside of a timer callback.
+ */
+struct TrapFrame *timer_irq_frame(void)
+{
+    return bases[this_cpu()->id].frame;
+}
+
+/**
+ * @brief:      Initializes a timer that is not pending.
+ *
+ * @param:      timer  the timer
+ * @param[in]:  fn     the callback
+ * @param[in]:  ctx    the value passed to the callback
+ *
+ * @return:     None
+ */
+void timer_setup(struct Timer *timer, timer_fn_t fn, void *ctx)
+{
+    timer->expires = 0;
+    timer->fn = fn;
+    timer->ctx = ctx;
+    timer->index = TIMER_IDLE;
+    timer->cpu = 0;
+}
+
+/**
+ * @brief:          A function that starts a timer on the calling CPU.
+ *
+ * @param:          timer    the timer
+ * @param[in]:      expires  the expiry time in nanoseconds of timer_now
+ *
+ * @return:         true on success, false if the heap is full.
+ *
+ * @description:    A timer pending on the calling CPU is moved to its new
+ *                  position, a timer pending on another CPU is cancelled
+ *                  there first, as only the local APIC timer of the calling
+ *                  CPU can be reprogrammed. When the timer becomes the
+ *                  earliest one, the local APIC timer is reprogrammed,
+ *                  unless the timer interrupt is running and will do that
+ *                  itself after the callbacks.
+ */
+bool timer_start(struct Timer *timer, uint64_t expires)
+{
+    uint64_t flags = irq_save();
+    uint32_t cpu = this_cpu()->id;
+    struct TimerBase *base = &bases[cpu];
+    uint64_t old;
+
+    if (timer->index != TIMER_IDLE && timer->cpu != cpu) {
+        timer_cancel(timer);
+    }
+
+    spin_lock(&base->lock);
+    if (timer->index == TIMER_IDLE) {
+        if (base->count == TIMER_MAX) {
+            spin_unlock(&base->lock);
+            irq_restore(flags);
+            return false;
+        }
+
+        timer->expires = expires;
+        timer->cpu = cpu;
+        timer->index = base->count;
+        base->heap[base->count++] = timer;
+        sift_up(base, timer->index);
+    }
+    else {
+        old = timer->expires;
+        timer->expires = expires;
+        if (expires < old) {
+            sift_up(base, timer->index);
+        }
+        else {
+            sift_down(base, timer->index);
+        }
+    }
+
+    if (timer_mode != TIMER_MODE_PIT && !base->expiring &&
+        base->heap[0] == timer) {
+        program_timer(base);
+    }
+
+    spin_unlock(&base->lock);
+    irq_restore(flags);
+    return true;
+}
+
+/**
+ * @brief:      Starts a timer that expires delay nanoseconds from now.
+ */
+bool timer_start_after(struct Timer *timer, uint64_t delay)
+{
+    return timer_start(timer, timer_now()+delay);
+}
+
+/**
+ * @brief:          A function that cancels a timer.
+ *
+ * @param:          timer  the timer
+ *
+ * @return:         true if the timer was pending.
+ *
+ * @description:    The local APIC timer is not reprogrammed. If the timer was
+ *                  the earliest one, the next interrupt finds nothing to
+ *                  expire and arms the following deadline. A callback that
+ *                  is already running on another CPU is not waited for.
+ */
+bool timer_cancel(struct Timer *timer)
+{
+    struct TimerBase *base = &bases[timer->cpu];
+    uint64_t flags = spin_lock_irqsave(&base->lock);
+    bool pending = timer->index != TIMER_IDLE;
+
+    if (pending) {
+        heap_remove(base, timer->index);
+    }
+
+    spin_unlock_irqrestore(&base->lock, flags);
+    return pending;
+}
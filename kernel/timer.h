@@ -0,0 +1,141 @@
+/* -----------------------------------------------------------------------------
+ * @file:        timer.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the timer
+ *               subsystem.
+ *
+ *               Pending timers are kept in a binary min-heap ordered by
+ *               their expiry time in nanoseconds of ktime_ns. The local APIC
+ *               timer, in TSC-deadline mode when the CPU supports it and in
+ *               one-shot mode otherwise, is always armed for the earliest
+ *               expiry, so an idle CPU is only woken when a timer is due
+ *               instead of on every tick. Without a local APIC the 100 Hz PIT
+ *               tick is kept and timers expire with 10 ms resolution.
+ *
+ *               Every CPU has its own heap and local APIC timer. A timer is
+ *               queued on the CPU that starts it and its callback runs there.
+ *
+ *               Timer callbacks run in interrupt context with interrupts
+ *               disabled. A callback may restart its own timer.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the one-shot timer subsystem.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     Expiry times are nanoseconds of ktime_ns.
+ *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Per-CPU timer heaps, added init_timer_cpu.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Declared timer_irq_frame.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "clock.h"
+
+#define TIMER_MAX           256
+#define TIMER_IDLE          0xffffffffU
+
+struct Timer;
+struct TrapFrame;
+
+typedef void (*timer_fn_t)(struct Timer *timer, void *ctx);
+
+/**
+ * @brief:                A timer.
+ *
+ * @struct:               Timer
+ *
+ * @param:     expires    The expiry time in nanoseconds of ktime_ns
+ * @param:     fn         The callback
+ * @param:     ctx        The value passed to the callback
+ * @param:     index      The position in the heap, TIMER_IDLE when the timer
+ *                        is not pending
+ * @param:     cpu        The CPU whose heap holds the timer while it is
+ *                        pending
+ */
+struct Timer {
+    uint64_t expires;
+    timer_fn_t fn;
+    void *ctx;
+    uint32_t index;
+    uint32_t cpu;
+};
+
+/**
+ * @fn:        init_timer(void)
+ *
+ * @brief:     Switches the timer interrupt to the local APIC timer.
+ */
+void init_timer(void);
+/**
+ * @fn:        init_timer_cpu(void)
+ *
+ * @brief:     Starts the local APIC timer of an AP.
+ */
+void init_timer_cpu(void);
+/**
+ * @fn:        timer_now(void)
+ *
+ * @brief:     Returns the current time, which is ktime_ns.
+ */
+uint64_t timer_now(void);
+/**
+ * @fn:        timer_irq_frame(void)
+ *
+ * @brief:     Returns the trap frame of the interrupted code while a timer
+ *             callback runs, or 0 outside of a callback.
+ */
+struct TrapFrame *timer_irq_frame(void);
+/**
+ * @fn:        timer_setup(struct Timer *timer, timer_fn_t fn, void *ctx)
+ *
+ * @brief:     Initializes a timer that is not pending.
+ */
+void timer_setup(struct Timer *timer, timer_fn_t fn, void *ctx);
+/**
+ * @fn:        timer_start(struct Timer *timer, uint64_t expires)
+ *
+ * @brief:     Starts or restarts a timer that expires at the given time.
+ *
+ * @return:    true on success, false if TIMER_MAX timers are pending.
+ */
+bool timer_start(struct Timer *timer, uint64_t expires);
+/**
+ * @fn:        timer_start_after(struct Timer *timer, uint64_t delay)
+ *
+ * @brief:     Starts or restarts a timer that expires delay nanoseconds from
+ *             now.
+ */
+bool timer_start_after(struct Timer *timer, uint64_t delay);
+/**
+ * @fn:        timer_cancel(struct Timer *timer)
+ *
+ * @brief:     Stops a pending timer.
+ *
+ * @return:    true if the timer was pending.
+ */
+bool timer_cancel(struct Timer *timer);
+/**
+ * @fn:        timer_pending(const struct Timer *timer)
+ *
+ * @brief:     Returns true if the timer has been started and not yet expired
+ *             or been cancelled.
+ */
+static inline bool timer_pending(const struct Timer *timer)
+{
+    return timer->index != TIMER_IDLE;
+}
+
+#endif
@@ -6,7 +6,7 @@
 ; @language:    Assembly
 ; @platform:    x86_64
 ; @description: This file contains the assembly code for trap handling. It
-;               defines the global symbols for the interrupt vectors and the
+;               defines the entry points of all interrupt vectors and the
 ;               functions to send end of interrupt service register, and load
 ;               the interrupt descriptor table pointer.
 ;
@@ -14,7 +14,8 @@
 ;               restore the CPU registers and call the handler function in C.
 ;
 ;               The handler function is defined in trap.c and takes a pointer to
-;               the trap frame.
+;               the trap frame. It returns the trap frame to restore, which is
+;               the frame of another task after a task switch.
 ;
 ;               The trap frame is a data structure that stores the state of the
 ;               CPU registers when a trap (an exception or an interrupt) occurs.
@@ -27,34 +28,69 @@
 ;   - Revision 0.2: 11/12/2023 Marko Trickovic
 ;     Refactored (added) the comments to improve readability.
 ;
+;   - Revision 0.3: 10/14/2026 Marko Trickovic
+;     Generate the entry points of all 256 vectors with %rep and export them
+;     in vector_table.
+;
+;   - Revision 0.4: 10/14/2026 Marko Trickovic
+;     Added the FastTrap entry path for fast handlers, which only saves the
+;     caller-saved registers. The VGA debug counter is only built with
+;     TRAP_DEBUG_VGA defined.
+;
+;   - Revision 0.5: 10/14/2026 Marko Trickovic
+;     Renamed eoi to pic_eoi, eoi() now selects the interrupt controller.
+;
+;   - Revision 0.6: 10/14/2026 Marko Trickovic
+;     TrapReturn restores the frame returned by handler, which is how the
+;     scheduler switches tasks. Added yield_trap.
+;
+;   - Revision 0.7: 10/14/2026 Marko Trickovic
+;     Call sched_switch_done after a switch to another task's stack.
+;
+;   - Revision 0.8: 10/14/2026 Marko Trickovic
+;     The TRAP_DEBUG_VGA counters write text memory through the direct map.
+;
+;   - Revision 0.9: 10/14/2026 Marko Trickovic
+;     Traps from and returns to ring 3 swap the GS base with swapgs.
+;
+;   - Revision 1.0: 10/14/2026 Marko Trickovic
+;     Added bench_trap.
+;
+;   - Revision 1.1: 10/14/2026 Marko Trickovic
+;     Clear the direction flag on entry, the interrupted code may copy
+;     backwards.
+;
+;   - Revision 1.2: 10/14/2026 Marko Trickovic
+;     The handlers of vectors 32 and above run on the IRQ stack of the CPU.
+;
+;   - Revision 1.3: 10/14/2026 Marko Trickovic
+;     The stubs are 16 bytes apart, for the IDT generated at link time.
+;
+;   - Revision 1.4: 10/14/2026 Marko Trickovic
+;     An NMI or machine check in ring 0 checks the GS base itself, it may
+;     arrive between the swapgs and sysret of syscall_entry.
+;
 ; Part of the os-dev-udemy-wsl.
 ;------------------------------------------------------------------------------
 
+%define CPU_IRQ_RSP 48          ; struct Cpu of smp.h
+%define CPU_IRQ_NEST 56
+
 section .text
 extern handler
-global vector0
-global vector1
-global vector2
-global vector3
-global vector4
-global vector5
-global vector6
-global vector7
-global vector8
-global vector10
-global vector11
-global vector12
-global vector13
-global vector14
-global vector16
-global vector17
-global vector18
-global vector19
-global vector32
-global vector39
-global eoi
+extern fast_handler
+extern sched_switch_done
+global vector_table
+global fast_vector_table
+global vector_stubs
+global vector_stubs_end
+global fast_stubs
+global fast_stubs_end
+global pic_eoi
 global read_isr
 global load_idt
+global yield_trap
+global bench_trap
 
 ; @routine:  Trap
 ; @brief:    This function handles the interrupts and exceptions by saving the
@@ -78,6 +114,34 @@ global load_idt
 ;
 ; @return          None
 ;
+; @note:           handler returns the trap frame that TrapReturn restores.
+;                  It is the frame just pushed unless the scheduler switched
+;                  to another task, whose frame lies on its own kernel stack.
+;                  Only once rsp points there is the stack of the previous
+;                  task free, which sched_switch_done reports.
+;
+;                  A trap from ring 3 swaps in the kernel GS base, the return
+;                  to ring 3 swaps it out again. The CS in the frame tells
+;                  which, and on the way out it is the CS of the frame that
+;                  is actually restored.
+;
+;                  An NMI or machine check can also arrive in ring 0 with
+;                  the user GS base, right at the entry of syscall_entry or
+;                  between its swapgs and sysret. For those two vectors a
+;                  trap from ring 0 reads IA32_GS_BASE, the kernel GS base
+;                  is the Cpu structure in the upper half, and swaps if it
+;                  is not loaded. The error code slot, a zero pushed by the
+;                  stub for both, is set to -1 to swap back on the way out.
+;
+;                  The frame stays on the stack the trap arrived on, where
+;                  the scheduler saves it, but the handlers of vectors 32 and
+;                  above are called on the IRQ stack of the CPU. irq_nest is
+;                  -1 while no handler runs there, so only the outermost of
+;                  nested interrupts switches. Exceptions run on the stack
+;                  they hit, or on their IST stack, and from ring 0 only
+;                  the NMI and machine check swap the GS base, which is not
+;                  set up before init_smp. Both bases are zero until then.
+;
 Trap:
     push rax
     push rbx  
@@ -95,11 +159,49 @@ Trap:
     push r14
     push r15
 
-    inc byte[0xb8010]
-    mov byte[0xb8011],0xe
+    test byte[rsp+144],3        ; CS of the frame, ring 3 if RPL is set
+    jnz TrapUser
+    cmp qword[rsp+120],2        ; NMI
+    je TrapCheckGs
+    cmp qword[rsp+120],18       ; Machine check
+    jne TrapKernel
+TrapCheckGs:
+    mov ecx,0xc0000101          ; IA32_GS_BASE
+    rdmsr
+    test edx,edx                ; Upper half, the kernel GS base is loaded
+    js TrapKernel
+    mov qword[rsp+128],-1       ; Swap back in TrapReturn
+TrapUser:
+    swapgs
+TrapKernel:
+    cld                         ; The C calling convention requires DF clear
+
+%ifdef TRAP_DEBUG_VGA
+    mov rax,0xffff8000000b8010  ; Text memory in the direct map
+    inc byte[rax]
+    mov byte[rax+1],0xe
+%endif
 
     mov rdi,rsp
+    cmp qword[rsp+120],32       ; Exceptions stay on their stack
+    jb TrapCall
+    inc qword[gs:CPU_IRQ_NEST]
+    jnz TrapIrqCall             ; Already on the IRQ stack
+    mov rsp,[gs:CPU_IRQ_RSP]
+TrapIrqCall:
+    push rdi                    ; The frame, twice to keep the alignment
+    push rdi
+    call handler
+    pop rsp                     ; Back to the stack of the frame
+    dec qword[gs:CPU_IRQ_NEST]
+    jmp TrapSwitch
+TrapCall:
     call handler
+TrapSwitch:
+    cmp rax,rsp
+    je TrapReturn
+    mov rsp,rax                 ; Continue on the stack of the next task
+    call sched_switch_done
 
 TrapReturn:
     pop	r15
@@ -118,180 +220,136 @@ TrapReturn:
     pop	rbx
     pop	rax       
 
+    cmp qword[rsp+8],-1         ; GS base swapped in ring 0?
+    je TrapSwapIret
     add rsp,16
+    test byte[rsp+8],3          ; Returning to ring 3?
+    jz TrapIret
+    swapgs
+TrapIret:
+    iretq
+TrapSwapIret:
+    add rsp,16
+    swapgs
     iretq
 
-; @routine:   vector0
-; @brief:     This routine is the entry point for the divide by zero exception.
-; @param:     No parameters are passed to this function.
-vector0:
-    push 0
-    push 0
-    jmp Trap
-
-; @routine:   vector1
-; @brief:     This routine is the entry point for the debug exception.
-; @param:     No parameters are passed to this function.
-vector1:
-    push 0
-    push 1
-    jmp Trap
-
-; @routine:   vector2
-; @brief:     This routine is the entry point for the non-maskable interrupt.
-; @param:     No parameters are passed to this function.
-vector2:
-    push 0
-    push 2
-    jmp Trap
-
-; @routine:   vector3
-; @brief:     This routine is the entry point for the breakpoint exception.
-; @param:     No parameters are passed to this function.
-vector3:
-    push 0
-    push 3	
-    jmp Trap
-
-; @routine:   vector4
-; @brief:     This routine is the entry point for the overflow exception.
-; @param:     No parameters are passed to this function.
-vector4:
-    push 0
-    push 4	
-    jmp Trap   
-
-; @routine:   vector5
-; @brief:     This routine is the entry point for the bound range exceeded
-;             exception.
-; @param:     No parameters are passed to this function.
-vector5:
-    push 0
-    push 5
-    jmp Trap
-
-; @routine:   vector6
-; @brief:     This routine is the entry point for the invalid opcode exception.
-; @param:     No parameters are passed to this function.
-vector6:
-    push 0
-    push 6	
-    jmp Trap      
-
-; @routine:   vector7
-; @brief:     This routine is the entry point for the device not available
-;             exception.
-; @param:     No parameters are passed to this function.
-vector7:
-    push 0
-    push 7	
-    jmp Trap  
-
-; @routine:   vector8
-; @brief:     This routine is the entry point for the double fault exception.
-; @param:     The error code is pushed on the stack before calling this
-;             function.
-vector8:
-    push 8
-    jmp Trap  
-
-; @routine:   vector10
-; @brief:     This routine is the entry point for the invalid TSS exception.
-; @param:     The error code is pushed on the stack before calling this
-;             function.
-vector10:
-    push 10	
-    jmp Trap 
-
-; @routine:   vector11
-; @brief:     This routine is the entry point for the segment not present
-;             exception.
-; @param:     The error code is pushed on the stack before calling this
-;             function.
-vector11:
-    push 11	
-    jmp Trap
-
-; @routine:   vector12
-; @brief:     This routine is the entry point for the stack-segment fault
-;             exception.
-; @param:     The error code is pushed on the stack before calling this
-;             function.
-vector12:
-    push 12	
-    jmp Trap          
-
-; @routine:   vector13
-; @brief:     This routine is the entry point for the general protection fault
-;             exception.
-; @param:     The error code is pushed on the stack before calling this
-;             function.
-vector13:
-    push 13
-    jmp Trap
+; @routine:  FastTrap
+; @brief:    This function is the entry path of vectors with a fast handler.
+;            Only the registers that a C function may clobber are saved, the
+;            callee-saved registers are preserved by the handler itself. The
+;            stack is aligned to 16 bytes and fast_handler is called with the
+;            vector number on the IRQ stack. The GS base is swapped and the
+;            stack switched like in Trap.
+;
+; @param:    The vector number is pushed on the stack by the fast stub.
+;
+; @return    None
+;
+FastTrap:
+    push rax
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push r8
+    push r9
+    push r10
+    push r11
 
-; @routine:   vector14
-; @brief:     This routine is the entry point for the page fault exception.
-; @param:     The error code is pushed on the stack before calling this
-;             function.
-vector14:
-    push 14	
-    jmp Trap 
+    test byte[rsp+88],3
+    jz FastTrapKernel
+    swapgs
+FastTrapKernel:
+    cld
 
-; @routine:   vector16
-; @brief:     This routine is the entry point for the x87 FPU floating-point
-;             error exception.
-; @param:     No parameters are passed to this function.
-vector16:
-    push 0
-    push 16
-    jmp Trap
+%ifdef TRAP_DEBUG_VGA
+    mov rax,0xffff8000000b8010  ; Text memory in the direct map
+    inc byte[rax]
+    mov byte[rax+1],0xe
+%endif
 
-; @routine:   vector17
-; @brief:     This routine is the entry point for the alignment check exception.
-; @param:     The error code is pushed on the stack before calling this function.
-vector17:
-    push 17	
-    jmp Trap                         
+    mov rdi,[rsp+72]
+    mov rax,rsp
+    inc qword[gs:CPU_IRQ_NEST]
+    jnz FastTrapCall
+    mov rsp,[gs:CPU_IRQ_RSP]
+    sub rsp,8
+FastTrapCall:
+    push rax                    ; Aligns the stack to 16 bytes
+    call fast_handler
+    pop rsp
+    dec qword[gs:CPU_IRQ_NEST]
 
-; @routine:   vector18
-; @brief:     This function is the entry point for the machine check exception.
-; @param:     No parameters are passed to this function.
-vector18:
-    push 0
-    push 18	
-    jmp Trap 
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rdi
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rax
 
-; @routine:   vector19
-; @brief:     This function is the entry point for the SIMD floating-point
-;             exception.
-; @param:     No parameters are passed to this function.
-vector19:
-    push 0
-    push 19	
-    jmp Trap
+    add rsp,8
+    test byte[rsp+8],3
+    jz FastTrapIret
+    swapgs
+FastTrapIret:
+    iretq
 
-; @routine:   vector32
-; @brief:     This function is the entry point for the timer interrupt.
-; @param:     No parameters are passed to this function.
-vector32:
+; @routine:   vector0 - vector255
+; @brief:     These routines are the entry points of all 256 interrupt vectors.
+;             They are generated with %rep. The CPU pushes an error code for
+;             vectors 8, 10-14, 17, 21, 29 and 30, every other stub pushes a
+;             zero in its place so that all trap frames have the same layout.
+;             The stub then pushes the vector number and jumps to Trap.
+;             The stubs are aligned to 16 bytes from vector_stubs on, so
+;             the IDT that tools/mkdesc.py generates finds the stub of a
+;             vector at vector_stubs + 16*vector.
+; @param:     The error code, if any, is pushed on the stack by the CPU.
+align 16
+vector_stubs:
+%assign vec 0
+%rep 256
+align 16
+vector %+ vec:
+%if vec == 8 || (vec >= 10 && vec <= 14) || vec == 17 || vec == 21 || vec == 29 || vec == 30
+%else
     push 0
-    push 32
+%endif
+    push vec
     jmp Trap
+%assign vec vec+1
+%endrep
+align 16
+vector_stubs_end:
 
-; @routine:   vector39
-; @brief:     This function is the entry point for the keyboard interrupt.
-; @param:     No parameters are passed to this function.
-vector39:
-    push 0
-    push 39
-    jmp Trap
+; @routine:   fast_vector32 - fast_vector255
+; @brief:     These routines are the fast entry points of the external
+;             interrupt vectors. register_fast_irq_handler points the IDT entry
+;             of a vector at its fast stub, which pushes the vector number and
+;             jumps to FastTrap. They are 16 bytes apart from fast_stubs on,
+;             like the stubs of Trap.
+; @param:     No parameters are passed to these functions.
+align 16
+fast_stubs:
+%assign vec 32
+%rep 224
+align 16
+fast_vector %+ vec:
+    push vec
+    jmp FastTrap
+%assign vec vec+1
+%endrep
+align 16
+fast_stubs_end:
 
-; @routine:   eoi
+; @routine:   pic_eoi
 ; @brief:     This function sends an end-of-interrupt signal to the PIC.
+;             eoi() in apic.c calls it while the 8259 is in use.
 ; @param:     No parameters are passed to this function.
 ; @return:    None.
-eoi:
+pic_eoi:
     mov al,0x20
     out 0x20,al
     ret
@@ -306,6 +364,25 @@ read_isr:
     in al,0x20
     ret
 
+; @routine:   yield_trap
+; @brief:     This function enters the scheduler through the yield vector, so
+;             the calling task is saved in a trap frame like a preempted one.
+; @param:     No parameters are passed to this function.
+; @return:    None, when the calling task runs again.
+yield_trap:
+    int 0x81
+    ret
+
+; @routine:   bench_trap
+; @brief:     This function raises the benchmark vector, which goes through
+;             the full Trap entry and exit path to a handler that does
+;             nothing.
+; @param:     No parameters are passed to this function.
+; @return:    None.
+bench_trap:
+    int 0x82
+    ret
+
 ; @routine:   load_idt
 ; @brief:     This function loads the IDT from a given address.
 ; @param:     The address of the IDT is passed in rdi.
@@ -313,3 +390,26 @@ read_isr:
 load_idt:
     lidt [rdi]
     ret
+
+section .data
+
+; @var:       vector_table
+; @brief:     The addresses of the 256 vector entry points, indexed by vector
+;             number. init_idt builds the IDT from this table.
+vector_table:
+%assign vec 0
+%rep 256
+    dq vector %+ vec
+%assign vec vec+1
+%endrep
+
+; @var:       fast_vector_table
+; @brief:     The addresses of the fast entry points, indexed by vector number.
+;             The exception vectors 0-31 have no fast entry point.
+fast_vector_table:
+    times 32 dq 0
+%assign vec 32
+%rep 224
+    dq fast_vector %+ vec
+%assign vec vec+1
+%endrep
@@ -34,12 +34,19 @@
  *               the prototypes of the handler, read_isr, and load_idt
  *               functions.
  *
+ *               The IDT itself, idt_table, and the IDT pointer, idt_ptr, are
+ *               generated at link time by tools/mkdesc.py into desc.lds, with
+ *               a gate to the stub of trap.asm for every vector.
+ *
  *               The file defines a static function named init_idt_entry, which
- *               initializes an IDT entry with the given address and attribute.
+ *               rewrites an IDT entry at runtime with the given address and
+ *               attribute, when a vector switches between the stubs of Trap
+ *               and FastTrap.
  *
- *               The file defines a function named init_idt, which initializes
- *               the IDT with the default handler for each vector, sets up the
- *               IDT pointer, and loads the IDT to the CPU.
+ *               The file defines a function named init_idt, which sets up the
+ *               handler tables and loads the IDTR. The entries are only
+ *               patched at runtime afterwards, by the handler registration
+ *               functions and set_idt_ist.
  *
  *               The file defines a function named handler, which handles traps.
  *
@@ -54,26 +61,51 @@
  *               interrupt handler function, which is specified by the IDT entry
  *               for the trap number.
  *
- *               The handler function takes a pointer to the TrapFrame as a
- *               parameter, and checks the trap number to perform different
- *               actions accordingly.
- * 
- *               For the timer interrupt (trap number 32), the handler function
- *               sends end of interrupt (EOI) signal to the interrupt
- *               controller, which is a device that manages the interrupts and
- *               signals the CPU when an interrupts occurs.
- *
- *               For the keyboard interrupt (trap number 39), the handler
- *               function reads the interrupt service register (ISR) from the
- *               interrupt controller, which is a byte that indicates which keys
- *               are pressed on the keyboard. The handler function sends an EOI
- *               signal only if the highest bit of the ISR is set, which means
- *               that a key has been released.
- *
- *               For other traps, the handler function enters an infinite loop,
- *               which means that the program is halted and cannot resume. This
- *               is a simple way of handling exceptions that are not expected or
- *               handled by the program.
+ *               The handler function takes a pointer to the TrapFrame and
+ *               calls the function that was registered for the trap number
+ *               with register_irq_handler.
+ *
+ *               Vectors that only need to acknowledge the interrupt can
+ *               register a fast handler instead. Their IDT entry points at a
+ *               FastTrap stub, which saves only the caller-saved registers and
+ *               calls fast_handler with the vector number.
+ *
+ *               The timer interrupt is owned by timer.c, which registers a
+ *               handler for the PIT vector (trap number 32) or the local
+ *               APIC timer vector. It takes the full entry path, as the
+ *               scheduler switches tasks by returning another trap frame
+ *               from handler.
+ *
+ *               For the spurious interrupt of the PIC (trap number 39),
+ *               the fast handler reads the in-service register (ISR) of the
+ *               PIC and sends an EOI only if IRQ7 is really in service. Once
+ *               init_apic has masked the 8259 the vector is released, the
+ *               local APIC reports spurious interrupts on vector 255.
+ *
+ *               Vectors without a registered handler are counted by a default
+ *               handler. Stray interrupts are acknowledged and the interrupted
+ *               code continues, exceptions are logged and stop the CPU.
+ *
+ *               Handlers can be changed while other CPUs take interrupts.
+ *               Each vector has two slots per table and the table entry
+ *               points at one of them. A new handler is written to the other
+ *               slot and published with rcu_assign_pointer, so the trap path
+ *               reads a consistent function and context pair without a lock.
+ *               Before a slot is written again, the writer waits for an RCU
+ *               grace period after the last update of the vector, which ends
+ *               the reads of it. Writers are serialized by vector_lock. The
+ *               IDT gate is switched with a single 64-bit store, both entry
+ *               paths lie in the same 4 GiB and only the low half of a gate
+ *               changes.
+ *
+ *               Both entry paths time the handler with the TSC and add the
+ *               run to the IrqStat of the vector on the calling CPU: the
+ *               count, the total and the longest run and a log2 histogram.
+ *               The statistics are per CPU, handlers run with interrupts
+ *               disabled, so the update needs neither a lock nor an atomic
+ *               instruction. The time counted is that of the handler function
+ *               alone, without the register save of the entry path and the
+ *               task switch of the scheduler.
  *
  * Revision History:
  *
@@ -84,21 +116,80 @@
  *   - Revision 0.2: 11/12/2023 Marko Trickovic
  *     Refactored the comments to improve readability.
  *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Build the IDT from vector_table and dispatch through a handler table
+ *     filled by register_irq_handler.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Added fast handlers for interrupts that do not need a trap frame.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     The PIC spurious handler acknowledges the PIC directly.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     The timer interrupt moved to timer.c.
+ *
+ *   - Revision 0.7: 10/14/2026 Marko Trickovic
+ *     Added init_idt_cpu and set_idt_ist for the per-CPU startup.
+ *
+ *   - Revision 0.8: 10/14/2026 Marko Trickovic
+ *     handler returns the frame chosen by the scheduler.
+ *
+ *   - Revision 0.9: 10/14/2026 Marko Trickovic
+ *     Publish the handler tables RCU style and update IDT gates atomically.
+ *
+ *   - Revision 1.0: 10/14/2026 Marko Trickovic
+ *     Unhandled exceptions are reported through printk.
+ *
+ *   - Revision 1.1: 10/14/2026 Marko Trickovic
+ *     Per-CPU handler time statistics of every vector.
+ *
+ *   - Revision 1.2: 10/14/2026 Marko Trickovic
+ *     Clear the statistics with memset.
+ *
+ *   - Revision 1.3: 10/14/2026 Marko Trickovic
+ *     Run the pending softirqs on the way out of external interrupts.
+ *
+ *   - Revision 1.4: 10/14/2026 Marko Trickovic
+ *     The IDT is generated at link time by tools/mkdesc.py.
+ *
+ *   - Revision 1.5: 10/14/2026 Marko Trickovic
+ *     Describe the generated IDT in the file and init_idt comments.
+ *
+ *   - Revision 1.6: 10/14/2026 Marko Trickovic
+ *     init_idt_entry builds the gate with shifts instead of reading the
+ *     struct through a uint64_t pointer.
+ *
+ *   - Revision 1.7: 10/14/2026 Marko Trickovic
+ *     default_handler acknowledges every stray vector from 32 on with the
+ *     local APIC, except the spurious vector.
+ *
  * Part of the os-dev-udemy-wsl.
  *****************************************************************************/
 
 #include "trap.h"
+#include "softirq.h"
+#include "sched.h"
+#include "sync.h"
+#include "smp.h"
+#include "apic.h"
+#include "slab.h"
+#include "clock.h"
+#include "printk.h"
+#include "string.h"
+#include "lib.h"
 
 /**
  * @brief:       A pointer to the interrupt descriptor table (IDT).
  *
  * @type:        struct IdtPtr
- * @size:        6 bytes
+ * @size:        10 bytes
  * @description: This variable holds the base address and the size of the IDT,
  *               which is a data structure that maps each interrupt vector to an
- *               interrupt handler function.
+ *               interrupt handler function. It is generated by
+ *               tools/mkdesc.py into the linker script.
  */
-static struct IdtPtr idt_pointer;
+extern struct IdtPtr idt_ptr;
 
 /**
  * @brief:       An array of interrupt descriptor table entries.
@@ -109,8 +200,12 @@ static struct IdtPtr idt_pointer;
  *               that represents an IDT entry. An IDT entry contains the address
  *               and attributes of an interrupt handler function, which is
  *               executed when the corresponding interrupt occurs.
+ *
+ *               The linker script fills every entry with an interrupt gate of
+ *               the stub of trap.asm, and the entry of vector 39 with the
+ *               gate of its fast stub, so the table is complete in the image.
  */
-static struct IdtEntry vectors[256];
+extern struct IdtEntry idt_table[256];
 
 /**
  * @brief:     Initializes the idt entry.
@@ -120,14 +215,173 @@ static struct IdtEntry vectors[256];
  * @param[in]: attribute  the type and attributes of the entry
  * 
  * @return:    None
+ *
+ * @description: The first 8 bytes of the gate are built with shifts, the
+ *               way tools/mkdesc.py encodes them, and stored at once so a
+ *               CPU taking the vector never sees half of an address. Only
+ *               the IST index is read back from the entry, as a byte.
  */
 static void init_idt_entry(struct IdtEntry *entry, uint64_t addr, uint8_t attribute)
 {
-    entry->low = (uint16_t)addr;
-    entry->selector = 8;
-    entry->attr = attribute;
-    entry->mid = (uint16_t)(addr>>16);
+    uint64_t low = (addr&0xffff)|(8UL<<16)|((uint64_t)entry->res0<<32)|
+                   ((uint64_t)attribute<<40)|(((addr>>16)&0xffff)<<48);
+
     entry->high = (uint32_t)(addr>>32);
+    __atomic_store_n((uint64_t *)entry, low, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief:       The entry of the handler table of one vector.
+ *
+ * @struct:      IrqHandler
+ *
+ * @param:       fn   The handler function
+ * @param:       ctx  The value passed to the handler function
+ */
+struct IrqHandler {
+    irq_handler_t fn;
+    void *ctx;
+};
+
+/**
+ * @brief:       The handler table, indexed by trap number. Every entry points
+ *               at default_entry or at one of the two slots of its vector.
+ *
+ * @type:        struct IrqHandler *
+ * @size:        256 * 8 bytes
+ */
+static struct IrqHandler *irq_handlers[256];
+static struct IrqHandler irq_slots[256][2];
+
+/**
+ * @brief:       The entry of the fast handler table of one vector.
+ *
+ * @struct:      FastIrqHandler
+ *
+ * @param:       fn   The fast handler function
+ * @param:       ctx  The value passed to the fast handler function
+ */
+struct FastIrqHandler {
+    fast_irq_handler_t fn;
+    void *ctx;
+};
+
+/**
+ * @brief:       The fast handler table, indexed by vector number, and the
+ *               slots its entries point at.
+ */
+static struct FastIrqHandler *fast_handlers[256];
+static struct FastIrqHandler fast_slots[256][2];
+
+/**
+ * @brief:       The lock of the handler updates, the update count and the
+ *               count at the last update of each vector.
+ */
+static struct Spinlock vector_lock = SPINLOCK_INIT;
+static uint64_t vector_seq;
+static uint64_t vector_updated[256];
+
+/**
+ * @brief:       The number of interrupts per vector that reached the default
+ *               handler.
+ */
+static uint64_t unhandled_count[256];
+
+/**
+ * @brief:     The handler of every vector without a registered handler.
+ *
+ * @param[in]: tf   the trap frame
+ * @param:     ctx  unused
+ *
+ * @return:    None
+ *
+ * @description: The interrupt is counted. An exception cannot be resumed, so
+ *               the CPU logs it, flushes the log itself and stops here. A
+ *               stray interrupt is acknowledged and the interrupted code
+ *               continues. With the 8259 only the PIC range 32 - 47 takes
+ *               an EOI. With the local APIC every vector from 32 on does,
+ *               or its ISR bit would block its priority class for good,
+ *               except SPURIOUS_VECTOR, which the local APIC does not set
+ *               in service.
+ */
+static void default_handler(struct TrapFrame *tf, void *ctx)
+{
+    __atomic_fetch_add(&unhandled_count[tf->trapno], 1, __ATOMIC_RELAXED);
+
+    if (tf->trapno < 32) {
+        printk("exception %ld error %lx at %lx:%lx rsp %lx\n", tf->trapno,
+               tf->errorcode, tf->cs, tf->rip, tf->rsp);
+        printk_flush();
+        while (1) { }
+    }
+
+    if (get_apic_mode() != APIC_MODE_PIC) {
+        if (tf->trapno != SPURIOUS_VECTOR) {
+            eoi();
+        }
+    }
+    else if (tf->trapno < 48) {
+        eoi();
+    }
+}
+
+/**
+ * @brief:     The fast handler of the spurious interrupt of the PIC (vector
+ *             39). The EOI is only sent if IRQ7 is really in service.
+ */
+static void spurious_handler(void *ctx)
+{
+    unsigned char isr_value = read_isr();
+
+    if ((isr_value&(1<<7)) != 0) {
+        pic_eoi();
+    }
+}
+
+/**
+ * @brief:       The entry of the vectors without a handler, and the entry of
+ *               the PIC spurious interrupt, which init_idt installs before
+ *               any other CPU runs.
+ */
+static struct IrqHandler default_entry = { default_handler, 0 };
+static struct FastIrqHandler spurious_entry = { spurious_handler, 0 };
+
+/**
+ * @brief:       Takes vector_lock once no CPU can still read the unused
+ *               slot of a vector.
+ *
+ * @param[in]:   vector  the vector number
+ *
+ * @return:      The rflags value to restore after the update.
+ *
+ * @description: The grace period must start after the last update of the
+ *               vector. If another writer updates the vector meanwhile, the
+ *               wait is repeated. synchronize_rcu runs without the lock, so
+ *               writers never wait for each other to be quiescent.
+ */
+static uint64_t lock_vector(uint8_t vector)
+{
+    uint64_t flags, seq;
+
+    while (1) {
+        seq = __atomic_load_n(&vector_seq, __ATOMIC_ACQUIRE);
+        synchronize_rcu();
+
+        flags = spin_lock_irqsave(&vector_lock);
+        if (vector_updated[vector] <= seq) {
+            return flags;
+        }
+        spin_unlock_irqrestore(&vector_lock, flags);
+    }
+}
+
+/**
+ * @brief:       Records an update of a vector and releases vector_lock.
+ */
+static void unlock_vector(uint8_t vector, uint64_t flags)
+{
+    vector_updated[vector] = ++vector_seq;
+    spin_unlock_irqrestore(&vector_lock, flags);
 }
 
 /**
@@ -138,41 +392,290 @@ static void init_idt_entry(struct IdtEntry *entry, uint64_t addr, uint8_t attrib
  * 
  * @return:         None
  * 
- * @description:    This function initializes the IDT by calling the
- *                  init_idt_entry function for each interrupt vector and
- *                  setting the corresponding interrupt handler function, type,
- *                  and attributes.
+ * @description:    The gates of idt_table are generated at link time, so the
+ *                  function does not write any entry. It points every vector
+ *                  at the default handler and registers the spurious
+ *                  interrupt handler of the PIC, which only acknowledges the
+ *                  interrupt, so its generated gate points at the fast entry
+ *                  path already.
  *
- *                  The function also sets the IDT pointer to point to the base
- *                  address and the size of the IDT, and loads the IDT into the
- *                  CPU using the load_idt function.
+ *                  The function then loads the IDTR with idt_ptr using the
+ *                  load_idt function. Later changes patch single entries at
+ *                  runtime: register_irq_handler and related functions point a
+ *                  gate at the other stub with init_idt_entry, and
+ *                  set_idt_ist selects an IST stack.
  */
 void init_idt(void)
 {
-    init_idt_entry(&vectors[0],(uint64_t)vector0,0x8e);
-    init_idt_entry(&vectors[1],(uint64_t)vector1,0x8e);
-    init_idt_entry(&vectors[2],(uint64_t)vector2,0x8e);
-    init_idt_entry(&vectors[3],(uint64_t)vector3,0x8e);
-    init_idt_entry(&vectors[4],(uint64_t)vector4,0x8e);
-    init_idt_entry(&vectors[5],(uint64_t)vector5,0x8e);
-    init_idt_entry(&vectors[6],(uint64_t)vector6,0x8e);
-    init_idt_entry(&vectors[7],(uint64_t)vector7,0x8e);
-    init_idt_entry(&vectors[8],(uint64_t)vector8,0x8e);
-    init_idt_entry(&vectors[10],(uint64_t)vector10,0x8e);
-    init_idt_entry(&vectors[11],(uint64_t)vector11,0x8e);
-    init_idt_entry(&vectors[12],(uint64_t)vector12,0x8e);
-    init_idt_entry(&vectors[13],(uint64_t)vector13,0x8e);
-    init_idt_entry(&vectors[14],(uint64_t)vector14,0x8e);
-    init_idt_entry(&vectors[16],(uint64_t)vector16,0x8e);
-    init_idt_entry(&vectors[17],(uint64_t)vector17,0x8e);
-    init_idt_entry(&vectors[18],(uint64_t)vector18,0x8e);
-    init_idt_entry(&vectors[19],(uint64_t)vector19,0x8e);
-    init_idt_entry(&vectors[32],(uint64_t)vector32,0x8e);
-    init_idt_entry(&vectors[39],(uint64_t)vector39,0x8e);
-
-    idt_pointer.limit = sizeof(vectors)-1;
-    idt_pointer.addr = (uint64_t)vectors;
-    load_idt(&idt_pointer);
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        irq_handlers[i] = &default_entry;
+    }
+
+    fast_handlers[39] = &spurious_entry;
+    load_idt(&idt_ptr);
+}
+
+/**
+ * @brief:      Loads the shared IDT on the calling CPU and allocates its
+ *              handler statistics. init_cpu calls it on every CPU once the
+ *              GS base is set. Without memory the CPU keeps no statistics.
+ */
+void init_idt_cpu(void)
+{
+    struct IrqStat *stats = kmalloc(256*sizeof(struct IrqStat));
+
+    if (stats != 0) {
+        memset(stats, 0, 256*sizeof(struct IrqStat));
+    }
+
+    this_cpu()->irq_stats = stats;
+    load_idt(&idt_ptr);
+}
+
+/**
+ * @brief:      Makes a vector switch to a stack of the interrupt stack table.
+ *
+ * @param[in]:  vector  the vector number
+ * @param[in]:  ist     the IST index 1 - 7, or 0 to stay on the current stack
+ *
+ * @return:     None
+ *
+ * @description: The TSS of every CPU must provide the stack before the
+ *               vector can be taken.
+ */
+void set_idt_ist(uint8_t vector, uint8_t ist)
+{
+    idt_table[vector].res0 = ist&7;
+}
+
+/**
+ * @brief:      Installs the handler of a vector.
+ *
+ * @param[in]:  vector  the vector number
+ * @param[in]:  fn      the handler function
+ * @param[in]:  ctx     the value passed to the handler function
+ *
+ * @return:     None
+ *
+ * @description: The new entry is published before the IDT gate is switched
+ *               to the full entry path, so the vector never reaches a stale
+ *               entry.
+ */
+void register_irq_handler(uint8_t vector, irq_handler_t fn, void *ctx)
+{
+    uint64_t flags = lock_vector(vector);
+    struct IrqHandler *entry = &irq_slots[vector][0];
+
+    if (irq_handlers[vector] == entry) {
+        entry = &irq_slots[vector][1];
+    }
+
+    entry->fn = fn;
+    entry->ctx = ctx;
+    rcu_assign_pointer(irq_handlers[vector], entry);
+    init_idt_entry(&idt_table[vector],vector_table[vector],0x8e);
+
+    unlock_vector(vector, flags);
+}
+
+/**
+ * @brief:      Installs the fast handler of an external interrupt vector.
+ *
+ * @param[in]:  vector  the vector number, 32 or above
+ * @param[in]:  fn      the fast handler function
+ * @param[in]:  ctx     the value passed to the fast handler function
+ *
+ * @return:     0 on success, -1 for an exception vector.
+ *
+ * @description: The handler is stored before the IDT entry is switched to the
+ *               fast stub, so the vector never reaches an empty entry.
+ */
+int register_fast_irq_handler(uint8_t vector, fast_irq_handler_t fn, void *ctx)
+{
+    struct FastIrqHandler *entry;
+    uint64_t flags;
+
+    if (vector < 32) {
+        return -1;
+    }
+
+    flags = lock_vector(vector);
+    entry = &fast_slots[vector][0];
+    if (fast_handlers[vector] == entry) {
+        entry = &fast_slots[vector][1];
+    }
+
+    entry->fn = fn;
+    entry->ctx = ctx;
+    rcu_assign_pointer(fast_handlers[vector], entry);
+    init_idt_entry(&idt_table[vector],fast_vector_table[vector],0x8e);
+
+    unlock_vector(vector, flags);
+    return 0;
+}
+
+/**
+ * @brief:      Restores the default handler and the full entry path of a
+ *              vector.
+ *
+ * @param[in]:  vector  the vector number
+ *
+ * @return:     None
+ */
+void unregister_irq_handler(uint8_t vector)
+{
+    uint64_t flags = spin_lock_irqsave(&vector_lock);
+
+    rcu_assign_pointer(irq_handlers[vector], &default_entry);
+    init_idt_entry(&idt_table[vector],vector_table[vector],0x8e);
+
+    unlock_vector(vector, flags);
+}
+
+/**
+ * @brief:      Returns the handler statistics of a vector on a CPU, or 0.
+ */
+const struct IrqStat *get_irq_stat(uint32_t cpu, uint8_t vector)
+{
+    struct Cpu *c = get_cpu(cpu);
+
+    if (c == 0 || c->irq_stats == 0) {
+        return 0;
+    }
+
+    return &c->irq_stats[vector];
+}
+
+/**
+ * @brief:          A function that logs the handler statistics.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    Each vector that was handled gets two lines: the totals
+ *                  with its busiest CPU, which shows an interrupt storm on
+ *                  one CPU, and the non-empty histogram buckets as
+ *                  log2(cycles):runs.
+ */
+void dump_irq_stats(void)
+{
+    char line[LOG_LINE_SIZE];
+    const struct IrqStat *stat;
+    uint64_t count, cycles, max, busiest;
+    uint64_t hist[IRQ_HIST_BUCKETS];
+    uint32_t cpus = get_cpu_count();
+    uint32_t vector, cpu, top, b;
+    int len;
+
+    for (vector = 0; vector < 256; vector++) {
+        count = 0;
+        cycles = 0;
+        max = 0;
+        busiest = 0;
+        top = 0;
+        for (b = 0; b < IRQ_HIST_BUCKETS; b++) {
+            hist[b] = 0;
+        }
+
+        for (cpu = 0; cpu < cpus; cpu++) {
+            stat = get_irq_stat(cpu, vector);
+            if (stat == 0 || stat->count == 0) {
+                continue;
+            }
+
+            count += stat->count;
+            cycles += stat->cycles;
+            if (stat->max > max) {
+                max = stat->max;
+            }
+            if (stat->count > busiest) {
+                busiest = stat->count;
+                top = cpu;
+            }
+            for (b = 0; b < IRQ_HIST_BUCKETS; b++) {
+                hist[b] += stat->hist[b];
+            }
+        }
+
+        if (count == 0) {
+            continue;
+        }
+
+        printk("irq %3u: %lu runs, %lu on CPU %u, avg %lu max %lu cycles\n",
+               vector, count, busiest, top, cycles/count, max);
+
+        len = snprintf(line, sizeof(line), "irq %3u:", vector);
+        for (b = 0; b < IRQ_HIST_BUCKETS; b++) {
+            if (hist[b] != 0 && len < (int)sizeof(line)) {
+                len += snprintf(line+len, sizeof(line)-len, " %u:%lu", b,
+                                hist[b]);
+            }
+        }
+        printk("%s\n", line);
+    }
+}
+
+#ifdef IRQ_STATS_PERIOD_SEC
+/**
+ * @brief:      Logs the handler statistics every IRQ_STATS_PERIOD_SEC.
+ */
+static void irq_stats_task(void *arg)
+{
+    while (1) {
+        task_sleep(IRQ_STATS_PERIOD_SEC*NSEC_PER_SEC);
+        dump_irq_stats();
+    }
+}
+#endif
+
+/**
+ * @brief:      Starts the periodic dump of the handler statistics, if it is
+ *              built in.
+ */
+void init_irq_stats_task(void)
+{
+#ifdef IRQ_STATS_PERIOD_SEC
+    task_create("irqstat", irq_stats_task, 0, SCHED_DEFAULT_PRIO);
+#endif
+}
+
+/**
+ * @brief:      Returns how often a vector reached the default handler.
+ */
+uint64_t get_unhandled_count(uint8_t vector)
+{
+    return __atomic_load_n(&unhandled_count[vector], __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief:      Adds a handler run that started at TSC start to the statistics
+ *              of the calling CPU. Before init_smp there are none.
+ */
+static void account_irq(uint64_t vector, uint64_t start)
+{
+    uint64_t cycles = read_tsc()-start;
+    struct IrqStat *stat;
+    uint32_t bucket;
+
+    if (get_cpu_count() == 0 || this_cpu()->irq_stats == 0) {
+        return;
+    }
+
+    stat = &this_cpu()->irq_stats[vector];
+    stat->count++;
+    stat->cycles += cycles;
+    if (cycles > stat->max) {
+        stat->max = cycles;
+    }
+
+    bucket = 63-__builtin_clzll(cycles|1);
+    if (bucket >= IRQ_HIST_BUCKETS) {
+        bucket = IRQ_HIST_BUCKETS-1;
+    }
+    stat->hist[bucket]++;
 }
 
 /**
@@ -183,35 +686,41 @@ void init_idt(void)
  *                                    contains the registers and flags that are
  *                                    saved and restored during a trap.
  *
- * @return:      None
+ * @return:      The trap frame that TrapReturn restores.
  *
- * @description: This function handles the traps according to the trap number,
- *               which is stored in the trap frame.
- *               The function uses the eoi and read_isr functions to send an
- *               end-of-interrupt signal and read the in-service register value,
- *               respectively.
- *               The function handles two specific cases: when the trap number
- *               is 32, which means a timer interrupt, and when the trap number
- *               is 39, which means a spurious interrupt. For other cases, the
- *               function enters an infinite loop.
+ * @description: This function dispatches the trap with a single indirect call
+ *               through the handler table entry of its trap number. On the
+ *               way out of vectors 32 and above the pending softirqs run,
+ *               after the handler time is accounted, and the scheduler may
+ *               replace the frame with the one of the next task.
  */
-void handler(struct TrapFrame *tf)
+struct TrapFrame *handler(struct TrapFrame *tf)
 {
-    unsigned char isr_value;
+    struct IrqHandler *entry = rcu_dereference(irq_handlers[tf->trapno]);
+    uint64_t start = read_tsc();
 
-    switch (tf->trapno) {
-        case 32:
-            eoi();
-            break;
+    entry->fn(tf, entry->ctx);
+    account_irq(tf->trapno, start);
+    if (tf->trapno >= 32) {
+        softirq_irq_exit();
+    }
 
-        case 39:
-            isr_value = read_isr();
-            if ((isr_value&(1<<7)) != 0) {
-                eoi();
-            }
-            break;
+    return sched_trap_return(tf);
+}
 
-        default:
-            while (1) { }
-    }
+/**
+ * @brief:      A function that dispatches a vector taken through FastTrap.
+ *
+ * @param[in]:  vector  the vector number pushed by the fast stub
+ *
+ * @return:     None
+ */
+void fast_handler(uint64_t vector)
+{
+    struct FastIrqHandler *entry = rcu_dereference(fast_handlers[vector]);
+    uint64_t start = read_tsc();
+
+    entry->fn(entry->ctx);
+    account_irq(vector, start);
+    softirq_irq_exit();
 }
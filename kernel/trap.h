@@ -51,8 +51,9 @@
  *              special registers, such as RIP and RFLAGS.
  *
  *              The header file declares the functions related to trap handling.
- *              Each function corresponds to an interrupt vector that handles a
- *              specific trap.
+ *              The entry points of all 256 vectors are generated in trap.asm
+ *              and every vector is dispatched through a handler table that is
+ *              filled with register_irq_handler.
  *
  *              The functions are defined in trap.asm and trap.c.
  *
@@ -69,6 +70,28 @@
  *   - Revision 0.2: 11/12/2023 Marko Trickovic
  *     Refactored the comments to improve readability.
  *
+ *   - Revision 0.3: 10/14/2026 Marko Trickovic
+ *     Replaced the per-vector declarations with vector_table and added the
+ *     handler registration API.
+ *
+ *   - Revision 0.4: 10/14/2026 Marko Trickovic
+ *     Added fast handlers that bypass the full trap frame.
+ *
+ *   - Revision 0.5: 10/14/2026 Marko Trickovic
+ *     Declared pic_eoi, eoi selects the interrupt controller.
+ *
+ *   - Revision 0.6: 10/14/2026 Marko Trickovic
+ *     Declared init_idt_cpu and set_idt_ist.
+ *
+ *   - Revision 0.7: 10/14/2026 Marko Trickovic
+ *     handler returns the trap frame to restore. Declared yield_trap.
+ *
+ *   - Revision 0.8: 10/14/2026 Marko Trickovic
+ *     Added the per-CPU handler statistics of every vector.
+ *
+ *   - Revision 0.9: 10/14/2026 Marko Trickovic
+ *     Added BENCH_VECTOR and bench_trap.
+ *
  * Part of the os-dev-udemy-wsl.
  */
 
@@ -77,6 +100,9 @@
 
 #include "stdint.h"
 
+#define YIELD_VECTOR        0x81
+#define BENCH_VECTOR        0x82
+
 /**
  * @brief:                The structure of an interrupt descriptor table entry.
  *
@@ -188,143 +214,145 @@ struct TrapFrame {
 };
 
 /**
- * @defgroup:  vector Vector functions
- * @name:      vector
- * @brief:     This group contains the functions that handle various exceptions
- *             and interrupts. @{
- */
-/**
- * @fn:        vector0(void)
+ * @brief:     The type of an interrupt handler function.
  *
- * @brief:     Handles divide by zero exception.
+ * @param:     tf    The trap frame of the interrupted context
+ * @param:     ctx   The value passed to register_irq_handler
  */
-void vector0(void);
-/**
- * @fn:        vector1(void)
- *
- * @brief:     Handles debug exception.
- */
-void vector1(void);
-/**
- * @fn:        vector2(void)
- *
- * @brief:     Handles non-maskable interrupt.
- */
-void vector2(void);
+typedef void (*irq_handler_t)(struct TrapFrame *tf, void *ctx);
+
 /**
- * @fn:        vector3(void)
+ * @brief:     The type of a fast interrupt handler function. Fast handlers
+ *             get no trap frame, the entry path only saves the registers a C
+ *             function may clobber.
  *
- * @brief:     Handles breakpoint exception.
+ * @param:     ctx   The value passed to register_fast_irq_handler
  */
-void vector3(void);
+typedef void (*fast_irq_handler_t)(void *ctx);
+
+#define IRQ_HIST_BUCKETS    26
+
 /**
- * @fn:        vector4(void)
+ * @brief:                The handler statistics of one vector on one CPU.
  *
- * @brief:     Handles overflow exception.
- */
-void vector4(void);
-/**
- * @fn:        vector5(void)
+ * @struct:               IrqStat
  *
- * @brief:     Handles bound range exceeded exception.
+ * @param:     count      The number of times the vector was handled
+ * @param:     cycles     The TSC cycles spent in its handler
+ * @param:     max        The longest handler run in TSC cycles
+ * @param:     hist       hist[n] counts the runs of 2^n to 2^(n+1)-1 cycles,
+ *                        the last bucket also all longer ones
  */
-void vector5(void);
+struct IrqStat {
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t max;
+    uint32_t hist[IRQ_HIST_BUCKETS];
+};
+
 /**
- * @fn:        vector6(void)
- *
- * @brief:     Handles invalid opcode exception.
+ * @brief:     The addresses of the 256 vector entry points in trap.asm,
+ *             indexed by vector number.
  */
-void vector6(void);
+extern uint64_t vector_table[256];
+
 /**
- * @fn:        vector7(void)
- *
- * @brief:     Handles device not available exception.
+ * @brief:     The addresses of the fast entry points in trap.asm, indexed by
+ *             vector number. Entries 0-31 are zero.
  */
-void vector7(void);
+extern uint64_t fast_vector_table[256];
+
 /**
- * @fn:        vector8(void)
- *
- * @brief:     Handles double fault exception.
+ * @defgroup:  vector Vector functions
+ * @name:      vector
+ * @brief:     This group contains the functions that set up and dispatch
+ *             the interrupt vectors. @{
  */
-void vector8(void);
 /**
- * @fn:        vector10(void)
+ * @fn:        register_irq_handler(uint8_t vector, irq_handler_t fn,
+ *                                  void *ctx)
  *
- * @brief:     Handles invalid TSS exception.
+ * @brief:     Installs fn as the handler of vector. fn is called with the trap
+ *             frame and ctx every time the vector fires.
  */
-void vector10(void);
+void register_irq_handler(uint8_t vector, irq_handler_t fn, void *ctx);
 /**
- * @fn:        vector11(void)
+ * @fn:        register_fast_irq_handler(uint8_t vector, fast_irq_handler_t fn,
+ *                                       void *ctx)
  *
- * @brief:     Handles segment not present exception.
- */
-void vector11(void);
-/**
- * @fn:        vector12(void)
+ * @brief:     Installs fn as the fast handler of an external interrupt vector
+ *             (32-255) and points its IDT entry at the fast entry path.
  *
- * @brief:     Handles stack-segment fault exception.
+ * @return:    0 on success, -1 if vector is an exception vector.
  */
-void vector12(void);
+int register_fast_irq_handler(uint8_t vector, fast_irq_handler_t fn, void *ctx);
 /**
- * @fn:        vector13(void)
+ * @fn:        unregister_irq_handler(uint8_t vector)
  *
- * @brief:     Handles general protection fault exception.
+ * @brief:     Restores the default handler and the full entry path of vector.
  */
-void vector13(void);
+void unregister_irq_handler(uint8_t vector);
 /**
- * @fn:        vector14(void)
+ * @fn:        get_unhandled_count(uint8_t vector)
  *
- * @brief:     Handles page fault exception.
+ * @brief:     Returns how often vector fired without a registered handler.
  */
-void vector14(void);
+uint64_t get_unhandled_count(uint8_t vector);
 /**
- * @fn:        vector16(void)
+ * @fn:        init_idt(void)
  *
- * @brief:     Handles x87 floating-point exception.
+ * @brief:     Initializes the interrupt descriptor table.
  */
-void vector16(void);
+void init_idt(void);
 /**
- * @fn:        vector17(void)
+ * @fn:        init_idt_cpu(void)
  *
- * @brief:     Handles alignment check exception.
+ * @brief:     Loads the interrupt descriptor table on the calling CPU and
+ *             allocates its handler statistics.
  */
-void vector17(void);
+void init_idt_cpu(void);
 /**
- * @fn:        vector18(void)
+ * @fn:        get_irq_stat(uint32_t cpu, uint8_t vector)
  *
- * @brief:     Handles machine check exception.
+ * @brief:     Returns the handler statistics of vector on a CPU, or 0. The
+ *             CPU updates them without locking, a reader may see a run
+ *             counted in count but not yet in cycles.
  */
-void vector18(void);
+const struct IrqStat *get_irq_stat(uint32_t cpu, uint8_t vector);
 /**
- * @fn:        vector19(void)
+ * @fn:        dump_irq_stats(void)
  *
- * @brief:     Handles SIMD floating-point exception.
+ * @brief:     Logs the statistics of every vector that was handled, summed
+ *             over all CPUs, with printk.
  */
-void vector19(void);
+void dump_irq_stats(void);
 /**
- * @fn:        vector32(void)
+ * @fn:        init_irq_stats_task(void)
  *
- * @brief:     Handles timer interrupt.
+ * @brief:     Starts a task that calls dump_irq_stats every
+ *             IRQ_STATS_PERIOD_SEC seconds if the kernel is built with
+ *             "make IRQ_STATS=<seconds>", otherwise does nothing.
  */
-void vector32(void);
+void init_irq_stats_task(void);
 /**
- * @fn:        vector39(void)
+ * @fn:        set_idt_ist(uint8_t vector, uint8_t ist)
  *
- * @brief:     Handles keyboard interrupt.
+ * @brief:     Selects the interrupt stack table entry of a vector.
  */
-void vector39(void);
+void set_idt_ist(uint8_t vector, uint8_t ist);
 /**
- * @fn:        init_idt(void)
+ * @fn:        eoi(void)
  *
- * @brief:     Initializes the interrupt descriptor table.
+ * @brief:     Sends end of interrupt signal to the local APIC, or to the PIC
+ *             while the 8259 is in use. Defined in apic.c.
  */
-void init_idt(void);
+void eoi(void);
 /**
- * @fn:        eoi(void)
+ * @fn:        pic_eoi(void)
  *
- * @brief:     Sends end of interrupt signal.
+ * @brief:     Sends end of interrupt signal to the master PIC.
  */
-void eoi(void);
+void pic_eoi(void);
 /**
  * @fn:        load_idt(void)
  *
@@ -342,6 +370,20 @@ void load_idt(struct IdtPtr *ptr);
  *             interrupt sources.
  */
 unsigned char read_isr(void);
+/**
+ * @fn:        yield_trap(void)
+ *
+ * @brief:     Raises YIELD_VECTOR. Defined in trap.asm, the vector number is
+ *             hard-coded there.
+ */
+void yield_trap(void);
+/**
+ * @fn:        bench_trap(void)
+ *
+ * @brief:     Raises BENCH_VECTOR. Defined in trap.asm, the vector number is
+ *             hard-coded there.
+ */
+void bench_trap(void);
 /**
  * @}
  */
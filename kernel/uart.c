@@ -0,0 +1,304 @@
+/******************************************************************************
+ * @file:        uart.c
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @language:    C
+ * @platform:    x86_64
+ * @description: This file contains the 16550 UART driver of COM1.
+ *
+ *               A polled write waits for the transmitter on every byte,
+ *               about 87 us per byte at 115200 baud, for as long as the
+ *               line takes. With interrupts the writer only copies into
+ *               tx_ring, and the UART asks for the next 16 bytes with a
+ *               transmitter-empty interrupt once its FIFO has drained:
+ *
+ *                  - The ring is emptied into the FIFO by tx_kick, from the
+ *                    writer as well as from the interrupt handler. tx_busy
+ *                    lets one of them at a time be the consumer, so the
+ *                    ring keeps a single consumer, and the one that takes
+ *                    the last byte disables the transmitter interrupt.
+ *
+ *                  - A writer on a CPU with interrupts disabled may be the
+ *                    one the interrupt would reach, or may never return to
+ *                    let it in, as on a fatal error, so it drains the ring
+ *                    itself. So does a writer that finds the ring full.
+ *
+ *               The interrupt handler moves every received byte into
+ *               rx_ring and leaves the wakeup of the reader to a tasklet.
+ *               The port raises IRQ4 on an edge, so the handler loops until
+ *               the interrupt identification register reports nothing
+ *               pending, or a new condition would never raise another edge.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the UART driver.
+ *
+ *   - Revision 0.2: 10/14/2026 Marko Trickovic
+ *     uart_write reads the interrupt flag with read_rflags.
+ *
+ * Part of the os-dev-udemy-wsl.
+ *****************************************************************************/
+
+#include "uart.h"
+#include "ring.h"
+#include "softirq.h"
+#include "sched.h"
+#include "apic.h"
+#include "trap.h"
+#include "printk.h"
+#include "lib.h"
+
+#define COM1                0x3f8
+#define UART_DATA           0
+#define UART_IER            1
+#define UART_IIR            2
+#define UART_FCR            2
+#define UART_LCR            3
+#define UART_MCR            4
+#define UART_LSR            5
+
+#define UART_IER_RDA        0x01
+#define UART_IER_THRE       0x02
+#define UART_IIR_NONE       0x01
+#define UART_FCR_FIFO14     0xc7
+#define UART_LCR_DLAB       0x80
+#define UART_LCR_8N1        0x03
+#define UART_MCR_DTR        0x01
+#define UART_MCR_RTS        0x02
+#define UART_MCR_OUT2       0x08
+#define UART_LSR_DR         0x01
+#define UART_LSR_THRE       0x20
+
+#define UART_DIVISOR        1
+#define UART_FIFO_SIZE      16
+#define UART_IRQ_LOOPS      16
+
+#define RFLAGS_IF           0x200
+
+static struct ByteRing tx_ring;
+static struct ByteRing rx_ring;
+static struct Tasklet rx_tasklet;
+static struct Task *rx_waiter;
+static uint32_t rx_drops;
+static volatile uint32_t tx_busy;
+static uint8_t tx_ier;
+static bool uart_ready;
+
+/**
+ * @brief:      Writes one byte once the transmitter is empty.
+ */
+static void poll_putc(uint8_t c)
+{
+    while ((in_byte(COM1+UART_LSR)&UART_LSR_THRE) == 0) {
+        cpu_relax();
+    }
+    out_byte(COM1+UART_DATA, c);
+}
+
+/**
+ * @brief:          A function that moves bytes from tx_ring to the FIFO.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    The FIFO takes 16 bytes once the transmitter is empty. If
+ *                  another context holds tx_busy it does the work. A writer
+ *                  may put bytes after the holder found the ring empty and
+ *                  before it released tx_busy, so with the interrupt off the
+ *                  ring is checked once more.
+ */
+static void tx_kick(void)
+{
+    uint8_t ier, c;
+    int n;
+
+    do {
+        if (__atomic_exchange_n(&tx_busy, 1, __ATOMIC_ACQUIRE) != 0) {
+            return;
+        }
+
+        if ((in_byte(COM1+UART_LSR)&UART_LSR_THRE) != 0) {
+            for (n = 0; n < UART_FIFO_SIZE && ring_get(&tx_ring, &c); n++) {
+                out_byte(COM1+UART_DATA, c);
+            }
+        }
+
+        ier = UART_IER_RDA;
+        if (!ring_empty(&tx_ring)) {
+            ier |= UART_IER_THRE;
+        }
+        if (ier != tx_ier) {
+            out_byte(COM1+UART_IER, ier);
+            tx_ier = ier;
+        }
+
+        __atomic_store_n(&tx_busy, 0, __ATOMIC_RELEASE);
+    } while (ier == UART_IER_RDA && !ring_empty(&tx_ring));
+}
+
+/**
+ * @brief:      Puts one byte into tx_ring, draining it while it is full.
+ */
+static void tx_put(uint8_t c)
+{
+    while (!ring_put(&tx_ring, c)) {
+        tx_kick();
+        cpu_relax();
+    }
+}
+
+/**
+ * @brief:      The tasklet that wakes the reader after bytes arrived.
+ */
+static void rx_wake(void *ctx)
+{
+    struct Task *task = __atomic_exchange_n(&rx_waiter, 0, __ATOMIC_SEQ_CST);
+
+    if (task != 0) {
+        sched_wakeup(task);
+    }
+}
+
+/**
+ * @brief:      The handler of IRQ4.
+ */
+static void uart_interrupt(struct TrapFrame *tf, void *ctx)
+{
+    bool rx = false;
+    uint32_t i;
+    uint8_t c;
+
+    for (i = 0; i < UART_IRQ_LOOPS; i++) {
+        if ((in_byte(COM1+UART_IIR)&UART_IIR_NONE) != 0) {
+            break;
+        }
+
+        while ((in_byte(COM1+UART_LSR)&UART_LSR_DR) != 0) {
+            c = in_byte(COM1+UART_DATA);
+            if (!ring_put(&rx_ring, c)) {
+                rx_drops++;
+            }
+            rx = true;
+        }
+        tx_kick();
+    }
+
+    if (rx) {
+        tasklet_schedule(&rx_tasklet);
+    }
+    eoi();
+}
+
+/**
+ * @brief:      Programs COM1 for 115200 baud 8N1 with the FIFOs enabled and
+ *              its interrupts disabled.
+ */
+void uart_setup(void)
+{
+    out_byte(COM1+UART_IER, 0);
+    out_byte(COM1+UART_LCR, UART_LCR_DLAB);
+    out_byte(COM1+UART_DATA, UART_DIVISOR&0xff);
+    out_byte(COM1+UART_IER, UART_DIVISOR>>8);
+    out_byte(COM1+UART_LCR, UART_LCR_8N1);
+    out_byte(COM1+UART_FCR, UART_FCR_FIFO14);
+    out_byte(COM1+UART_MCR, UART_MCR_DTR|UART_MCR_RTS);
+}
+
+/**
+ * @brief:          A function that enables the interrupts of COM1.
+ *
+ * @param:          None
+ *
+ * @return:         None
+ *
+ * @description:    OUT2 gates the interrupt line of the UART on PC
+ *                  hardware. If IRQ4 cannot be routed COM1 stays polled.
+ */
+void init_uart(void)
+{
+    tasklet_init(&rx_tasklet, rx_wake, 0);
+    register_irq_handler(IRQ_BASE+UART_IRQ, uart_interrupt, 0);
+
+    tx_ier = UART_IER_RDA;
+    out_byte(COM1+UART_MCR, UART_MCR_DTR|UART_MCR_RTS|UART_MCR_OUT2);
+    out_byte(COM1+UART_IER, tx_ier);
+
+    if (enable_isa_irq(UART_IRQ) != 0) {
+        out_byte(COM1+UART_IER, 0);
+        unregister_irq_handler(IRQ_BASE+UART_IRQ);
+        printk("uart: IRQ%u not available, COM1 stays polled\n", UART_IRQ);
+        return;
+    }
+
+    __atomic_store_n(&uart_ready, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief:      Sends len bytes, a newline as CR LF.
+ */
+void uart_write(const char *s, size_t len)
+{
+    size_t i;
+
+    if (!__atomic_load_n(&uart_ready, __ATOMIC_ACQUIRE)) {
+        for (i = 0; i < len; i++) {
+            if (s[i] == '\n') {
+                poll_putc('\r');
+            }
+            poll_putc((uint8_t)s[i]);
+        }
+        return;
+    }
+
+    for (i = 0; i < len; i++) {
+        if (s[i] == '\n') {
+            tx_put('\r');
+        }
+        tx_put((uint8_t)s[i]);
+    }
+    tx_kick();
+
+    if ((read_rflags()&RFLAGS_IF) == 0) {
+        while (!ring_empty(&tx_ring)) {
+            tx_kick();
+            cpu_relax();
+        }
+    }
+}
+
+/**
+ * @brief:          A function that takes received bytes.
+ *
+ * @param:          buf   the buffer
+ * @param:          size  the size of the buffer
+ *
+ * @return:         The number of bytes stored in buf.
+ *
+ * @description:    The reader publishes itself before it checks the ring
+ *                  again, and the tasklet takes the reader after the handler
+ *                  has put the bytes, so a byte that arrives in between
+ *                  either is seen by the check or wakes the reader. A
+ *                  wakeup before sched_block makes it return at once.
+ */
+size_t uart_read(char *buf, size_t size)
+{
+    size_t n = 0;
+    uint8_t c;
+
+    while (1) {
+        while (n < size && ring_get(&rx_ring, &c)) {
+            buf[n++] = (char)c;
+        }
+        if (n > 0 || size == 0) {
+            return n;
+        }
+
+        __atomic_store_n(&rx_waiter, current_task(), __ATOMIC_SEQ_CST);
+        if (ring_empty(&rx_ring)) {
+            sched_block();
+        }
+    }
+}
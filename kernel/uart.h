@@ -0,0 +1,65 @@
+/* -----------------------------------------------------------------------------
+ * @file:        uart.h
+ * @author:      Marko Trickovic (contact@markotrickovic.com)
+ * @date:        10/14/2026 09:00 AM
+ * @license:     MIT
+ * @description: This header file contains the declarations of the 16550
+ *               UART driver of COM1.
+ *
+ *               The port runs at 115200 baud 8N1 with its 16-byte FIFOs
+ *               enabled. uart_setup programs it for polled output, which is
+ *               all printk needs at boot. Once init_uart has enabled IRQ4,
+ *               writes go to a transmit ring that the interrupt handler
+ *               feeds to the FIFO 16 bytes at a time, and received bytes
+ *               collect in a receive ring until uart_read takes them.
+ *
+ * Revision History:
+ *
+ *   - Revision 0.1: 10/14/2026 Marko Trickovic
+ *     Initial version of the UART driver.
+ *
+ * Part of the os-dev-udemy-wsl.
+ */
+
+#ifndef _UART_H_
+#define _UART_H_
+
+#include "stdint.h"
+#include "stddef.h"
+
+#define UART_IRQ            4
+
+/**
+ * @fn:        uart_setup(void)
+ *
+ * @brief:     Programs COM1 with its interrupts disabled. Works before any
+ *             other initialization.
+ */
+void uart_setup(void);
+/**
+ * @fn:        init_uart(void)
+ *
+ * @brief:     Switches COM1 to interrupt-driven transmit and receive. Must
+ *             run after init_apic.
+ */
+void init_uart(void);
+/**
+ * @fn:        uart_write(const char *s, size_t len)
+ *
+ * @brief:     Sends len bytes, a newline as CR LF. Returns once the bytes
+ *             are in the transmit ring, or sent if interrupts are disabled
+ *             on the calling CPU. Only one context may write at a time.
+ */
+void uart_write(const char *s, size_t len);
+/**
+ * @fn:        uart_read(char *buf, size_t size)
+ *
+ * @brief:     Blocks until at least one byte was received and takes up to
+ *             size bytes. Must be called from task context, by one task at
+ *             a time.
+ *
+ * @return:    The number of bytes stored in buf.
+ */
+size_t uart_read(char *buf, size_t size);
+
+#endif
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# @file:        benchcmp.py
+# @author:      Marko Trickovic (contact@markotrickovic.com)
+# @date:        10/14/2026 09:00 AM
+# @license:     MIT
+# @description: This host tool compares two runs of the kernel benchmarks.
+#
+#               It reads the "bench:" lines of two serial logs written by
+#               "make bench-qemu" or "make bench-bochs", see
+#               kernel/bench.h, and prints the fastest round of every
+#               benchmark in both runs with the change in percent:
+#
+#                   irq_trap          812        790    -2.7%
+#
+#               Usage:
+#
+#                   tools/benchcmp.py [--threshold 10] old.txt new.txt
+#
+#               The exit status is 1 if a benchmark got slower by more than
+#               the threshold percentage, or is missing in the new run, so
+#               the tool can fail a CI job. Cycle counts of runs on
+#               different machines or emulators are not comparable.
+#
+# Revision History:
+#
+#   - Revision 0.1: 10/14/2026 Marko Trickovic
+#     Initial version of the benchmark comparison.
+#
+# Part of the os-dev-udemy-wsl.
+# -----------------------------------------------------------------------------
+
+import argparse
+import re
+import sys
+
+RESULT_RE = re.compile(r"bench: (\w+) ops=\d+ min=(\d+)")
+
+
+def load_results(path):
+    """Returns the fastest round of every benchmark of a log."""
+    results = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            match = RESULT_RE.search(line)
+            if match is not None:
+                results[match.group(1)] = int(match.group(2))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare two runs of the kernel benchmarks.")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="the slowdown in percent that fails "
+                             "(default: %(default)s)")
+    parser.add_argument("old", help="the log of the reference run")
+    parser.add_argument("new", help="the log of the run to check")
+    args = parser.parse_args()
+
+    old = load_results(args.old)
+    new = load_results(args.new)
+    failed = False
+
+    for name in sorted(set(old) | set(new)):
+        if name not in new:
+            print("%-16s %10d %10s" % (name, old[name], "missing"))
+            failed = True
+            continue
+        if name not in old:
+            print("%-16s %10s %10d" % (name, "-", new[name]))
+            continue
+
+        change = 100.0*(new[name]-old[name])/max(old[name], 1)
+        mark = ""
+        if change > args.threshold:
+            mark = " slower"
+            failed = True
+        print("%-16s %10d %10d %+7.1f%%%s" % (name, old[name], new[name],
+                                              change, mark))
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# @file:        mkdesc.py
+# @author:      Marko Trickovic (contact@markotrickovic.com)
+# @date:        10/14/2026 09:00 AM
+# @license:     MIT
+# @description: This host tool generates the boot GDT and the IDT of the
+#               kernel.
+#
+#               It writes a fragment of the linker script, which
+#               kernel/link.lds includes in the .data section. The fragment
+#               holds the tables as data commands whose values are
+#               expressions of the symbols they point at, so ld splits the
+#               addresses into the descriptor fields when it links the
+#               kernel, and the tables are fully initialized in the image:
+#
+#                   - boot_gdt, the segment descriptors in the order that
+#                     SYSCALL and SYSRET expect, followed by the
+#                     descriptor of the boot Tss of kernel.asm at selector
+#                     0x28, and boot_gdt_ptr for lgdt.
+#
+#                   - idt_table, an interrupt gate for every vector that
+#                     points at its stub of trap.asm, and idt_ptr for lidt.
+#                     The stubs are 16 bytes apart from vector_stubs and
+#                     fast_stubs on, which the script checks with ASSERT.
+#
+#               The descriptor fields are encoded here, by name, instead of
+#               as hand-written constants. Usage, as kernel/Makefile runs it:
+#
+#                   tools/mkdesc.py > kernel/desc.lds
+#
+# Revision History:
+#
+#   - Revision 0.1: 10/14/2026 Marko Trickovic
+#     Initial version of the descriptor table generator.
+#
+# Part of the os-dev-udemy-wsl.
+# -----------------------------------------------------------------------------
+
+import sys
+
+KERNEL_CS = 0x08
+TSS_SELECTOR = 0x28
+TSS_SIZE = 104
+STUB_SIZE = 16
+VECTORS = 256
+FIRST_FAST_VECTOR = 32
+
+# The vectors whose IDT entry points at the fast stub at boot, the spurious
+# interrupt of the PIC, see trap.c
+FAST_VECTORS = (39,)
+
+ACCESS_PRESENT = 0x80
+ACCESS_SEGMENT = 0x10
+ACCESS_CODE = 0x08
+ACCESS_WRITABLE = 0x02
+TYPE_TSS = 0x09
+TYPE_INTERRUPT_GATE = 0x0e
+FLAG_LONG = 0x2
+
+
+def dpl(level):
+    """Returns the access bits of a descriptor privilege level."""
+    return level << 5
+
+
+def segment(access, flags):
+    """Encodes a code or data segment descriptor of long mode, base and
+    limit are ignored there and stay zero."""
+    return (access << 40) | (flags << 52)
+
+
+def code_segment(level):
+    return segment(ACCESS_PRESENT | dpl(level) | ACCESS_SEGMENT | ACCESS_CODE,
+                   FLAG_LONG)
+
+
+def data_segment(level):
+    return segment(ACCESS_PRESENT | dpl(level) | ACCESS_SEGMENT |
+                   ACCESS_WRITABLE, 0)
+
+
+GDT = [
+    ("null", 0),
+    ("kernel code", code_segment(0)),
+    ("kernel data", data_segment(0)),
+    ("user data", data_segment(3)),
+    ("user code", code_segment(3)),
+]
+
+
+def gate(out, vector, target):
+    """Writes an interrupt gate of the kernel code segment to target, an
+    expression of the linker script."""
+    out.write("    SHORT((%s) & 0xffff) SHORT(0x%02x) BYTE(0) BYTE(0x%02x)\n"
+              % (target, KERNEL_CS, ACCESS_PRESENT | TYPE_INTERRUPT_GATE))
+    out.write("    SHORT(((%s) >> 16) & 0xffff) LONG((%s) >> 32) LONG(0)"
+              "    /* vector %d */\n" % (target, target, vector))
+
+
+def write_gdt(out):
+    out.write("    . = ALIGN(16);\n")
+    out.write("    boot_gdt = .;\n")
+    for name, value in GDT:
+        out.write("    QUAD(0x%016x)    /* %s */\n" % (value, name))
+
+    if 8*len(GDT) != TSS_SELECTOR:
+        sys.exit("mkdesc.py: the TSS descriptor is not at selector 0x%02x"
+                 % TSS_SELECTOR)
+    out.write("    SHORT(0x%04x) SHORT(Tss & 0xffff)"
+              " BYTE((Tss >> 16) & 0xff) BYTE(0x%02x)\n"
+              % (TSS_SIZE-1, ACCESS_PRESENT | TYPE_TSS))
+    out.write("    BYTE(0) BYTE((Tss >> 24) & 0xff) LONG(Tss >> 32) LONG(0)"
+              "    /* boot TSS */\n")
+    out.write("    boot_gdt_end = .;\n")
+    out.write("    boot_gdt_ptr = .;\n")
+    out.write("    SHORT(boot_gdt_end - boot_gdt - 1) QUAD(boot_gdt)\n")
+
+
+def write_idt(out):
+    out.write("    . = ALIGN(16);\n")
+    out.write("    idt_table = .;\n")
+    for vector in range(VECTORS):
+        if vector in FAST_VECTORS:
+            target = "fast_stubs + %d" % (STUB_SIZE *
+                                          (vector-FIRST_FAST_VECTOR))
+        else:
+            target = "vector_stubs + %d" % (STUB_SIZE*vector)
+        gate(out, vector, target)
+    out.write("    idt_ptr = .;\n")
+    out.write("    SHORT(%d) QUAD(idt_table)\n" % (16*VECTORS-1))
+
+
+def write_asserts(out):
+    out.write("    ASSERT(vector_stubs_end - vector_stubs == %d,"
+              " \"vector stubs are not %d bytes apart\");\n"
+              % (STUB_SIZE*VECTORS, STUB_SIZE))
+    out.write("    ASSERT(fast_stubs_end - fast_stubs == %d,"
+              " \"fast stubs are not %d bytes apart\");\n"
+              % (STUB_SIZE*(VECTORS-FIRST_FAST_VECTOR), STUB_SIZE))
+    out.write("    ASSERT(Tss_end - Tss == %d,"
+              " \"the boot TSS is not %d bytes\");\n" % (TSS_SIZE, TSS_SIZE))
+
+
+def main():
+    out = sys.stdout
+    out.write("/* Generated by tools/mkdesc.py, do not edit */\n")
+    write_gdt(out)
+    write_idt(out)
+    write_asserts(out)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# -----------------------------------------------------------------------------
+# @file:        profsym.py
+# @author:      Marko Trickovic (contact@markotrickovic.com)
+# @date:        10/14/2026 09:00 AM
+# @license:     MIT
+# @description: This host tool symbolizes the samples of the kernel profiler.
+#
+#               It reads the "prof:" lines of a kernel log, such as the COM1
+#               output that bochsrc.bxrc writes to serial.txt, resolves every
+#               address against the symbols of kernel/kernel.elf with nm and
+#               prints the stacks in the folded format of flamegraph.pl:
+#
+#                   KMain;init_sched;schedule 42
+#
+#               Usage:
+#
+#                   tools/profsym.py [--elf kernel/kernel.elf] serial.txt \
+#                       | flamegraph.pl > kernel.svg
+#
+#               The addresses of a dump are offsets from KERNEL_VMA, see
+#               kernel/prof.h. Return addresses are looked up one byte
+#               earlier, which is the call instruction, so a call at the end
+#               of a function is not attributed to the next one.
+#
+# Revision History:
+#
+#   - Revision 0.1: 10/14/2026 Marko Trickovic
+#     Initial version of the profile symbolizer.
+#
+# Part of the os-dev-udemy-wsl.
+# -----------------------------------------------------------------------------
+
+import argparse
+import bisect
+import collections
+import re
+import subprocess
+import sys
+
+KERNEL_VMA = 0xffffffff80000000
+
+SAMPLE_RE = re.compile(r"prof: (\d+)((?: [0-9a-f]+)+)\s*$")
+
+
+def load_symbols(elf):
+    """Returns the sorted start addresses and names of the text symbols."""
+    out = subprocess.run(["nm", "-n", "--defined-only", elf],
+                         check=True, capture_output=True, text=True).stdout
+    addrs = []
+    names = []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) != 3 or fields[1] not in "tTwW":
+            continue
+        addrs.append(int(fields[0], 16))
+        names.append(fields[2])
+    return addrs, names
+
+
+def symbolize(addrs, names, pc):
+    """Returns the name of the function that contains pc."""
+    i = bisect.bisect_right(addrs, pc)-1
+    if i < 0:
+        return "0x%x" % pc
+    return names[i]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Fold kernel profiler samples for flamegraph.pl.")
+    parser.add_argument("--elf", default="kernel/kernel.elf",
+                        help="the kernel ELF file (default: %(default)s)")
+    parser.add_argument("logs", nargs="*", help="kernel logs, default stdin")
+    args = parser.parse_args()
+
+    addrs, names = load_symbols(args.elf)
+    stacks = collections.Counter()
+
+    files = [open(path, errors="replace") for path in args.logs] or [sys.stdin]
+    for f in files:
+        for line in f:
+            match = SAMPLE_RE.search(line)
+            if match is None:
+                continue
+
+            pcs = [(KERNEL_VMA+int(x, 16)) & (2**64-1)
+                   for x in match.group(2).split()]
+            frames = [symbolize(addrs, names, pc if i == 0 else pc-1)
+                      for i, pc in enumerate(pcs)]
+            stacks[";".join(reversed(frames))] += int(match.group(1))
+
+    for stack, count in sorted(stacks.items()):
+        print("%s %d" % (stack, count))
+
+
+if __name__ == "__main__":
+    main()